@@ -93,6 +93,7 @@ long_mode_start:
     mov rsp, stack_top
     mov edi, ebp
     mov esi, esi
+    xor ebp, ebp      ; Terminates frame-pointer backtraces
     call kmain
     cli
 .hang: 
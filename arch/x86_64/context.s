@@ -1,7 +1,14 @@
 [bits 64]
 global switch_to
 
+; Offset of task_context_t.rsp (20th field, see include/valen/task.h)
+TASK_CONTEXT_RSP equ 152
+
 ; void switch_to(task_context *prev, task_context *next)
+;
+; Callee-saved registers live on each task's own stack; the context only
+; records where that stack was left. A new task's stack is prepared by
+; task_create() so that the final 'ret' enters its function.
 switch_to:
     ; Save callee-saved registers from previous task
     push rbp
@@ -14,24 +21,11 @@ switch_to:
     ; Save stack pointer if prev is not NULL
     test rdi, rdi
     jz .skip_save
-    
-    mov [rdi + 0], r15   ; Save R15 (offset 0)
-    mov [rdi + 8], r14   ; Save R14 (offset 8)
-    mov [rdi + 16], r13  ; Save R13 (offset 16)
-    mov [rdi + 24], r12  ; Save R12 (offset 24)
-    mov [rdi + 32], rbx  ; Save RBX (offset 32)
-    mov [rdi + 40], rbp  ; Save RBP (offset 40)
-    mov [rdi + 88], rsp  ; Save RSP (offset 88)
+    mov [rdi + TASK_CONTEXT_RSP], rsp
     
 .skip_save:
     ; Load new context
-    mov r15, [rsi + 0]   ; Load R15
-    mov r14, [rsi + 8]   ; Load R14
-    mov r13, [rsi + 16]  ; Load R13
-    mov r12, [rsi + 24]  ; Load R12
-    mov rbx, [rsi + 32]  ; Load RBX
-    mov rbp, [rsi + 40]  ; Load RBP
-    mov rsp, [rsi + 88]  ; Load RSP
+    mov rsp, [rsi + TASK_CONTEXT_RSP]
     
     ; Restore callee-saved registers for new task
     pop r15
@@ -41,6 +35,5 @@ switch_to:
     pop rbx
     pop rbp
     
-    ; Jump to new task's RIP
-    mov rax, [rsi + 136] ; Load RIP
-    jmp rax
+    ; Return into the new task (where it called switch_to, or its entry)
+    ret
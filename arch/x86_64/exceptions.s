@@ -0,0 +1,121 @@
+[bits 64]
+
+;-----------------------------------------------------------------------------
+; CPU exception entry stubs, vectors 0-31.
+;
+; Every stub leaves the same frame on the stack: a zero error code for
+; vectors where the CPU does not push one, the vector number, and the
+; general purpose registers. The result is a struct pt_regs
+; (include/valen/ptrace.h) that is passed to exception_handler().
+;-----------------------------------------------------------------------------
+
+extern exception_handler
+
+global exception_stub_table
+global gdb_serial_isr
+
+section .text
+
+%macro EXCEPTION_NOERR 1
+exception_stub_%1:
+    push 0
+    push %1
+    jmp exception_common
+%endmacro
+
+%macro EXCEPTION_ERR 1
+exception_stub_%1:
+    push %1
+    jmp exception_common
+%endmacro
+
+EXCEPTION_NOERR 0   ; #DE Divide Error
+EXCEPTION_NOERR 1   ; #DB Debug
+EXCEPTION_NOERR 2   ; NMI
+EXCEPTION_NOERR 3   ; #BP Breakpoint
+EXCEPTION_NOERR 4   ; #OF Overflow
+EXCEPTION_NOERR 5   ; #BR Bound Range
+EXCEPTION_NOERR 6   ; #UD Invalid Opcode
+EXCEPTION_NOERR 7   ; #NM Device Not Available
+EXCEPTION_ERR   8   ; #DF Double Fault
+EXCEPTION_NOERR 9   ; Coprocessor Segment Overrun
+EXCEPTION_ERR   10  ; #TS Invalid TSS
+EXCEPTION_ERR   11  ; #NP Segment Not Present
+EXCEPTION_ERR   12  ; #SS Stack-Segment Fault
+EXCEPTION_ERR   13  ; #GP General Protection
+EXCEPTION_ERR   14  ; #PF Page Fault
+EXCEPTION_NOERR 15  ; Reserved
+EXCEPTION_NOERR 16  ; #MF x87 Floating-Point
+EXCEPTION_ERR   17  ; #AC Alignment Check
+EXCEPTION_NOERR 18  ; #MC Machine Check
+EXCEPTION_NOERR 19  ; #XM SIMD Floating-Point
+EXCEPTION_NOERR 20  ; #VE Virtualization
+EXCEPTION_ERR   21  ; #CP Control Protection
+EXCEPTION_NOERR 22
+EXCEPTION_NOERR 23
+EXCEPTION_NOERR 24
+EXCEPTION_NOERR 25
+EXCEPTION_NOERR 26
+EXCEPTION_NOERR 27
+EXCEPTION_NOERR 28  ; #HV Hypervisor Injection
+EXCEPTION_ERR   29  ; #VC VMM Communication
+EXCEPTION_ERR   30  ; #SX Security
+EXCEPTION_NOERR 31
+
+;-----------------------------------------------------------------------------
+; COM2 receive interrupt (IRQ 3) for the GDB stub. It takes the exception
+; path so the stub sees, and can modify, the interrupted registers.
+;-----------------------------------------------------------------------------
+gdb_serial_isr:
+    push 0
+    push 0x23
+    jmp exception_common
+
+exception_common:
+    push rax
+    push rbx
+    push rcx
+    push rdx
+    push rsi
+    push rdi
+    push rbp
+    push r8
+    push r9
+    push r10
+    push r11
+    push r12
+    push r13
+    push r14
+    push r15
+
+    ; 22 quadwords on a stack the CPU aligned to 16 bytes: still aligned
+    cld
+    mov rdi, rsp
+    call exception_handler
+
+    pop r15
+    pop r14
+    pop r13
+    pop r12
+    pop r11
+    pop r10
+    pop r9
+    pop r8
+    pop rbp
+    pop rdi
+    pop rsi
+    pop rdx
+    pop rcx
+    pop rbx
+    pop rax
+    add rsp, 16 ; Vector and error code
+    iretq
+
+section .rodata
+align 8
+exception_stub_table:
+%assign i 0
+%rep 32
+    dq exception_stub_%+i
+%assign i i+1
+%endrep
@@ -1,99 +1,89 @@
 [bits 64]
 
-extern page_fault_handler
-extern keyboard_handler
-extern generic_handler
-extern scheduler_tick
-extern pic_send_eoi
+;-----------------------------------------------------------------------------
+; Entry stubs for vectors 0x20-0xFF.
+;
+; Every vector has two stubs that push a zero error code and the vector
+; number, so the frame matches the exception frame (struct pt_regs,
+; include/valen/ptrace.h). The full stub then saves all general purpose
+; registers. The leaf stub saves only the caller-saved ones, for handlers
+; registered with IRQF_LEAF. request_vector() (kernel/hardware/irq.c)
+; points the IDT gate at the stub that fits the handler. Both call
+; irq_dispatch() on this CPU's IRQ stack.
+;-----------------------------------------------------------------------------
 
-global load_idt
-global page_fault_isr
-global keyboard_isr
-global generic_isr
-global timer_isr
+extern irq_dispatch
 
-page_fault_isr:
-    push rax
-    push rbx
-    push rcx
-    push rdx
-    push rsi
-    push rdi
-    push rbp
-    push r8
-    push r9
-    push r10
-    push r11
-    push r12
-    push r13
-    push r14
-    push r15
+global load_idt
+global irq_entry_table
+global irq_leaf_entry_table
 
-    ; x86_64 pushes an error code onto the stack for Page Faults.
-    ; It is located at [rsp + 120] after our pushes.
-    mov rdi, [rsp + 120]
-    call page_fault_handler
+; Offsets into struct irq_stack (include/valen/stack.h), addressed via GS
+IRQ_STACK_TOP equ 0
+IRQ_STACK_DEPTH equ 8
 
-    pop r15
-    pop r14
-    pop r13
-    pop r12
-    pop r11
-    pop r10
-    pop r9
-    pop r8
-    pop rbp
-    pop rdi
-    pop rsi
-    pop rdx
-    pop rcx
-    pop rbx
-    pop rax
-    add rsp, 8 ; Clean up the error code pushed by the CPU before returning
-    iretq
+; Offsets into struct pt_regs
+PT_REGS_R11 equ 32
+PT_REGS_R10 equ 40
+PT_REGS_R9 equ 48
+PT_REGS_R8 equ 56
+PT_REGS_RDI equ 72
+PT_REGS_RSI equ 80
+PT_REGS_RDX equ 88
+PT_REGS_RCX equ 96
+PT_REGS_RAX equ 112
+PT_REGS_VECTOR equ 120
+PT_REGS_RIP equ 136
 
 ;-----------------------------------------------------------------------------
-; @brief Keyboard Interrupt Service Routine.
-; Routes IRQ 1 (mapped to Vector 33 via I/O APIC).
+; With rdi pointing at the pt_regs frame: moves onto this CPU's IRQ stack,
+; unless an IRQ is already running there, and aligns it for the C call.
+; Two copies of the frame pointer (one is padding) sit under a frame
+; holding the interrupted rip, which links the handler's backtrace to the
+; code it interrupted. Leaves rbp on that frame.
 ;-----------------------------------------------------------------------------
-keyboard_isr:
-    push rax
-    push rcx
-    push rdx
-    push rsi
+%macro IRQ_STACK_ENTER 0
+    inc qword [gs:IRQ_STACK_DEPTH]
+    cmp qword [gs:IRQ_STACK_DEPTH], 1
+    jne %%nested
+    mov rsp, [gs:IRQ_STACK_TOP]
+%%nested:
+    and rsp, -16
     push rdi
+    push rdi
+    push qword [rdi + PT_REGS_RIP]
     push rbp
-    push r8
-    push r9
-    push r10
-    push r11
-    push r12
-    push r13
-    push r14
-    push r15
-    call keyboard_handler
-    pop r15
-    pop r14
-    pop r13
-    pop r12
-    pop r11
-    pop r10
-    pop r9
-    pop r8
+    mov rbp, rsp
+%endmacro
+
+; Back to the pt_regs frame, with the interrupted rbp restored
+%macro IRQ_STACK_EXIT 0
+    dec qword [gs:IRQ_STACK_DEPTH]
+    mov rsp, rbp
     pop rbp
-    pop rdi
-    pop rsi
-    pop rdx
-    pop rcx
-    pop rax
-    iretq
+    add rsp, 8
+    pop rsp
+%endmacro
 
-;-----------------------------------------------------------------------------
-; @brief Timer Interrupt Service Routine.
-; Routes IRQ 0 (mapped to Vector 0x20 via I/O APIC).
-;-----------------------------------------------------------------------------
-timer_isr:
+%macro IRQ_STUBS 2
+%assign vec 0x20
+%rep 0xE0
+%1_%+vec:
+    push 0
+    push vec
+    jmp %2
+%assign vec vec+1
+%endrep
+%endmacro
+
+section .text
+
+IRQ_STUBS irq_entry, irq_common
+IRQ_STUBS irq_leaf_entry, irq_leaf_common
+
+irq_common:
     push rax
+    push rbx
     push rcx
     push rdx
     push rsi
@@ -107,9 +97,13 @@ timer_isr:
     push r13
     push r14
     push r15
-    call scheduler_tick
-    mov rdi, 0
-    call pic_send_eoi
+
+    cld
+    mov rdi, rsp
+    IRQ_STACK_ENTER
+    call irq_dispatch
+    IRQ_STACK_EXIT
+
     pop r15
     pop r14
     pop r13
@@ -123,42 +117,58 @@ timer_isr:
     pop rsi
     pop rdx
     pop rcx
+    pop rbx
     pop rax
+    add rsp, 16 ; Vector and error code
     iretq
 
-generic_isr:
-    push rax
-    push rcx
-    push rdx
-    push rsi
-    push rdi
-    push rbp
-    push r8
-    push r9
-    push r10
-    push r11
-    push r12
-    push r13
-    push r14
-    push r15
-    ; Call generic handler
-    call generic_handler
-    pop r15
-    pop r14
-    pop r13
-    pop r12
-    pop r11
-    pop r10
-    pop r9
-    pop r8
-    pop rbp
-    pop rdi
-    pop rsi
-    pop rdx
-    pop rcx
-    pop rax
+; rbx, rbp and r12-r15 are preserved by the C code, so their slots stay empty
+irq_leaf_common:
+    sub rsp, PT_REGS_VECTOR
+    mov [rsp + PT_REGS_RAX], rax
+    mov [rsp + PT_REGS_RCX], rcx
+    mov [rsp + PT_REGS_RDX], rdx
+    mov [rsp + PT_REGS_RSI], rsi
+    mov [rsp + PT_REGS_RDI], rdi
+    mov [rsp + PT_REGS_R8], r8
+    mov [rsp + PT_REGS_R9], r9
+    mov [rsp + PT_REGS_R10], r10
+    mov [rsp + PT_REGS_R11], r11
+
+    cld
+    mov rdi, rsp
+    IRQ_STACK_ENTER
+    call irq_dispatch
+    IRQ_STACK_EXIT
+
+    mov r11, [rsp + PT_REGS_R11]
+    mov r10, [rsp + PT_REGS_R10]
+    mov r9, [rsp + PT_REGS_R9]
+    mov r8, [rsp + PT_REGS_R8]
+    mov rdi, [rsp + PT_REGS_RDI]
+    mov rsi, [rsp + PT_REGS_RSI]
+    mov rdx, [rsp + PT_REGS_RDX]
+    mov rcx, [rsp + PT_REGS_RCX]
+    mov rax, [rsp + PT_REGS_RAX]
+    add rsp, PT_REGS_VECTOR + 16
     iretq
 
 load_idt:
     lidt [rdi]
-    ret
\ No newline at end of file
+    ret
+
+section .rodata
+align 8
+irq_entry_table:
+%assign vec 0x20
+%rep 0xE0
+    dq irq_entry_%+vec
+%assign vec vec+1
+%endrep
+
+irq_leaf_entry_table:
+%assign vec 0x20
+%rep 0xE0
+    dq irq_leaf_entry_%+vec
+%assign vec vec+1
+%endrep
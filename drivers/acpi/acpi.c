@@ -0,0 +1,354 @@
+/**
+ * @file acpi.c
+ * @brief ACPI static table parser.
+ *
+ * GRUB hands over a copy of the RSDP in a multiboot2 tag; without one the
+ * BIOS areas below 1MB are searched. The RSDT or XSDT lists every other
+ * table. acpi_init() maps each table once, checks its checksum and keeps
+ * it in a small cache, so later lookups never touch the firmware lists
+ * again. Tables below 1GB are read through the direct map; QEMU puts them
+ * just below the top of low RAM, where vmm_map_phys() maps them.
+ */
+
+#include <valen/acpi.h>
+#include <valen/vmm.h>
+#include <valen/stdio.h>
+#include <valen/string.h>
+
+#define KERNEL_VIRT_OFFSET 0xFFFFFFFF80000000ULL
+#define PHYS_TO_VIRT(p) ((void *)((uint64_t)(p) + KERNEL_VIRT_OFFSET))
+
+/* Mapped by boot.s; anything above needs vmm_map_phys() */
+#define DIRECT_MAP_SIZE 0x40000000ULL
+
+#define ACPI_MAX_TABLES 32
+
+struct acpi_table
+{
+    uint64_t phys;
+    const struct acpi_sdt_header *header;
+};
+
+static struct acpi_table tables[ACPI_MAX_TABLES];
+static int table_count = 0;
+static struct acpi_info info;
+
+/* Parsed once; NULL when the firmware has no such table */
+static const struct acpi_madt *madt;
+static const struct acpi_srat *srat;
+static const struct acpi_mcfg *mcfg;
+static const struct acpi_slit *slit;
+
+static const void *acpi_map(uint64_t phys, uint64_t len)
+{
+    if (phys + len <= DIRECT_MAP_SIZE)
+        return PHYS_TO_VIRT(phys);
+    return vmm_map_phys(phys, len, PAGE_PRESENT);
+}
+
+static int checksum_ok(const void *data, uint64_t len)
+{
+    const uint8_t *p = data;
+    uint8_t sum = 0;
+
+    for (uint64_t i = 0; i < len; i++)
+        sum += p[i];
+    return sum == 0;
+}
+
+static int rsdp_valid(const struct acpi_rsdp *rsdp)
+{
+    if (strncmp(rsdp->signature, "RSD PTR ", 8) != 0 || !checksum_ok(rsdp, 20))
+        return 0;
+    if (rsdp->revision >= 2 && !checksum_ok(rsdp, rsdp->length))
+        return 0;
+    return 1;
+}
+
+/**
+ * @brief Looks for the RSDP on 16-byte boundaries in [start, start + len).
+ */
+static const struct acpi_rsdp *rsdp_scan(uint64_t start, uint64_t len)
+{
+    for (uint64_t p = start; p + sizeof(struct acpi_rsdp) <= start + len; p += 16)
+    {
+        const struct acpi_rsdp *rsdp = PHYS_TO_VIRT(p);
+        if (rsdp_valid(rsdp))
+            return rsdp;
+    }
+    return NULL;
+}
+
+static const struct acpi_rsdp *rsdp_find(void)
+{
+    /* First KB of the EBDA, whose segment is stored at 0x40E */
+    uint64_t ebda = (uint64_t)*(uint16_t *)PHYS_TO_VIRT(0x40E) << 4;
+    const struct acpi_rsdp *rsdp = ebda ? rsdp_scan(ebda, 1024) : NULL;
+
+    return rsdp ? rsdp : rsdp_scan(0xE0000, 0x20000);
+}
+
+/**
+ * @brief NUL-terminates a fixed-size ACPI name field into out (n + 1 bytes).
+ */
+static const char *fixed_str(char *out, const char *in, int n)
+{
+    memcpy(out, in, n);
+    out[n] = '\0';
+    return out;
+}
+
+/**
+ * @brief Maps a whole table and adds it to the cache if its checksum holds.
+ */
+static const struct acpi_sdt_header *table_load(uint64_t phys)
+{
+    const struct acpi_sdt_header *hdr = acpi_map(phys, sizeof(*hdr));
+
+    /* The first mapping covers the rest of its page; remap if that is short */
+    if (hdr && hdr->length > 4096 - (phys & 0xFFF))
+        hdr = acpi_map(phys, hdr->length);
+
+    /* NULL when a device already maps these frames with another type */
+    if (!hdr)
+        return NULL;
+
+    if (hdr->length < sizeof(*hdr) || !checksum_ok(hdr, hdr->length))
+    {
+        char sig[5];
+        printf("acpi: bad checksum in %s at %llx, ignored\n", fixed_str(sig, hdr->signature, 4),
+               (unsigned long long)phys);
+        return NULL;
+    }
+    return hdr;
+}
+
+static void table_add(uint64_t phys)
+{
+    if (table_count == ACPI_MAX_TABLES)
+        return;
+
+    const struct acpi_sdt_header *hdr = table_load(phys);
+    if (!hdr)
+        return;
+
+    tables[table_count].phys = phys;
+    tables[table_count].header = hdr;
+    table_count++;
+}
+
+const struct acpi_sdt_header *acpi_find_table(const char *signature)
+{
+    for (int i = 0; i < table_count; i++)
+    {
+        if (strncmp(tables[i].header->signature, signature, 4) == 0)
+            return tables[i].header;
+    }
+    return NULL;
+}
+
+/**
+ * @brief Walks the type/length entries that follow a table's fixed part.
+ */
+static const void *entry_next(const void *table, uint64_t first, const void *prev, int type)
+{
+    if (!table)
+        return NULL;
+
+    const uint8_t *end = (const uint8_t *)table + ((const struct acpi_sdt_header *)table)->length;
+    const uint8_t *p = prev ? (const uint8_t *)prev + ((const struct acpi_madt_entry *)prev)->length
+                            : (const uint8_t *)table + first;
+
+    while (p + sizeof(struct acpi_madt_entry) <= end)
+    {
+        const struct acpi_madt_entry *e = (const struct acpi_madt_entry *)p;
+        /* A zero length would loop forever on broken firmware */
+        if (e->length < sizeof(*e) || p + e->length > end)
+            return NULL;
+        if (e->type == type)
+            return e;
+        p += e->length;
+    }
+    return NULL;
+}
+
+const void *acpi_madt_next(const void *prev, int type)
+{
+    return entry_next(madt, sizeof(struct acpi_madt), prev, type);
+}
+
+const void *acpi_srat_next(const void *prev, int type)
+{
+    return entry_next(srat, sizeof(struct acpi_srat), prev, type);
+}
+
+const struct acpi_mcfg_entry *acpi_mcfg_next(const struct acpi_mcfg_entry *prev)
+{
+    if (!mcfg)
+        return NULL;
+
+    uint64_t count = (mcfg->header.length - sizeof(struct acpi_mcfg)) / sizeof(struct acpi_mcfg_entry);
+    uint64_t next = prev ? (uint64_t)(prev - mcfg->entries) + 1 : 0;
+    return next < count ? &mcfg->entries[next] : NULL;
+}
+
+int acpi_slit_distance(uint32_t from, uint32_t to)
+{
+    if (slit && from < slit->localities && to < slit->localities)
+        return slit->entries[from * slit->localities + to];
+    return from == to ? ACPI_LOCAL_DISTANCE : ACPI_REMOTE_DISTANCE;
+}
+
+const struct acpi_info *acpi_get_info(void)
+{
+    return &info;
+}
+
+/**
+ * @brief Counts CPUs, IOAPICs and NUMA nodes for acpi_info.
+ */
+static void summarize(void)
+{
+    info.tables = table_count;
+
+    if (madt)
+    {
+        info.lapic_base = madt->lapic_address;
+        acpi_for_each_madt(o, ACPI_MADT_LAPIC_OVERRIDE, struct acpi_madt_lapic_override)
+            info.lapic_base = o->address;
+        acpi_for_each_madt(cpu, ACPI_MADT_LAPIC, struct acpi_madt_lapic)
+            info.cpus += (cpu->flags & ACPI_MADT_ENABLED) != 0;
+        acpi_for_each_madt(cpu, ACPI_MADT_X2APIC, struct acpi_madt_x2apic)
+            info.cpus += (cpu->flags & ACPI_MADT_ENABLED) != 0;
+        acpi_for_each_madt(io, ACPI_MADT_IOAPIC, struct acpi_madt_ioapic)
+            info.ioapics++;
+    }
+
+    /* Domains need not be numbered densely; count the distinct ones */
+    uint64_t seen = 0;
+    acpi_for_each_srat(mem, ACPI_SRAT_MEMORY, struct acpi_srat_memory)
+    {
+        if ((mem->flags & ACPI_SRAT_ENABLED) && mem->domain < 64 && !(seen & (1ULL << mem->domain)))
+        {
+            seen |= 1ULL << mem->domain;
+            info.nodes++;
+        }
+    }
+}
+
+void acpi_init(const void *rsdp)
+{
+    const struct acpi_rsdp *found = rsdp;
+
+    if (!found || !rsdp_valid(found))
+        found = rsdp_find();
+    if (!found)
+    {
+        printf("acpi: no RSDP found, running without ACPI\n");
+        return;
+    }
+
+    info.revision = found->revision;
+
+    /* The XSDT has 64-bit pointers; prefer it when there is one */
+    int xsdt = found->revision >= 2 && found->xsdt_address;
+    const struct acpi_sdt_header *root = table_load(xsdt ? found->xsdt_address : found->rsdt_address);
+    if (!root)
+        return;
+
+    uint64_t width = xsdt ? 8 : 4;
+    uint64_t count = (root->length - sizeof(*root)) / width;
+    const uint8_t *entries = (const uint8_t *)(root + 1);
+    for (uint64_t i = 0; i < count; i++)
+    {
+        uint64_t phys = xsdt ? *(const uint64_t *)(entries + i * 8) : *(const uint32_t *)(entries + i * 4);
+        if (phys)
+            table_add(phys);
+    }
+
+    madt = (const struct acpi_madt *)acpi_find_table("APIC");
+    srat = (const struct acpi_srat *)acpi_find_table("SRAT");
+    mcfg = (const struct acpi_mcfg *)acpi_find_table("MCFG");
+    slit = (const struct acpi_slit *)acpi_find_table("SLIT");
+    summarize();
+
+    printf("acpi: ACPI %s (%s), %d tables, %d CPUs, %d IOAPICs, %d NUMA nodes\n",
+           info.revision >= 2 ? "2.0+" : "1.0", xsdt ? "XSDT" : "RSDT", info.tables,
+           info.cpus, info.ioapics, info.nodes);
+}
+
+void acpi_dump(void)
+{
+    if (!table_count)
+    {
+        puts("No ACPI tables.\n");
+        return;
+    }
+
+    puts("\n--- ACPI Tables ---\n");
+    for (int i = 0; i < table_count; i++)
+    {
+        const struct acpi_sdt_header *h = tables[i].header;
+        char sig[5], oem[7], oem_table[9];
+        printf_fmt("  %s  %016llx  len %-6u rev %u  %s %s\n", fixed_str(sig, h->signature, 4),
+                   (unsigned long long)tables[i].phys, h->length, h->revision,
+                   fixed_str(oem, h->oem_id, 6), fixed_str(oem_table, h->oem_table_id, 8));
+    }
+
+    printf_fmt("\nLocal APIC at %llx\n", (unsigned long long)info.lapic_base);
+    acpi_for_each_madt(cpu, ACPI_MADT_LAPIC, struct acpi_madt_lapic)
+        printf_fmt("  CPU  apic %-3u acpi %-3u %s\n", cpu->apic_id, cpu->processor_id,
+                   (cpu->flags & ACPI_MADT_ENABLED) ? "enabled" : "disabled");
+    acpi_for_each_madt(cpu, ACPI_MADT_X2APIC, struct acpi_madt_x2apic)
+        printf_fmt("  CPU  x2apic %-3u uid %-3u %s\n", cpu->x2apic_id, cpu->uid,
+                   (cpu->flags & ACPI_MADT_ENABLED) ? "enabled" : "disabled");
+    acpi_for_each_madt(io, ACPI_MADT_IOAPIC, struct acpi_madt_ioapic)
+        printf_fmt("  IOAPIC id %-3u at %08x gsi %u+\n", io->ioapic_id, io->address, io->gsi_base);
+    acpi_for_each_madt(iso, ACPI_MADT_ISO, struct acpi_madt_iso)
+        printf_fmt("  IRQ %-2u -> GSI %-3u flags %x\n", iso->source, iso->gsi, iso->flags);
+
+    const struct acpi_hpet *hpet = (const struct acpi_hpet *)acpi_find_table("HPET");
+    if (hpet)
+        printf_fmt("HPET %u at %llx, min tick %u\n", hpet->hpet_number,
+                   (unsigned long long)hpet->address.address, hpet->min_tick);
+
+    acpi_for_each_mcfg(e)
+        printf_fmt("PCIe ECAM segment %u bus %u-%u at %llx\n", e->segment, e->start_bus, e->end_bus,
+                   (unsigned long long)e->base);
+
+    if (srat)
+    {
+        printf_fmt("NUMA nodes: %d\n", info.nodes);
+        acpi_for_each_srat(mem, ACPI_SRAT_MEMORY, struct acpi_srat_memory)
+        {
+            if (mem->flags & ACPI_SRAT_ENABLED)
+                printf_fmt("  node %-2u mem %016llx-%016llx%s\n", mem->domain,
+                           (unsigned long long)mem->base,
+                           (unsigned long long)(mem->base + mem->length),
+                           (mem->flags & ACPI_SRAT_HOTPLUG) ? " hotplug" : "");
+        }
+        acpi_for_each_srat(cpu, ACPI_SRAT_CPU, struct acpi_srat_cpu)
+        {
+            if (cpu->flags & ACPI_SRAT_ENABLED)
+                printf_fmt("  node %-2u cpu apic %u\n", acpi_srat_cpu_domain(cpu), cpu->apic_id);
+        }
+        acpi_for_each_srat(cpu, ACPI_SRAT_X2APIC, struct acpi_srat_x2apic)
+        {
+            if (cpu->flags & ACPI_SRAT_ENABLED)
+                printf_fmt("  node %-2u cpu x2apic %u\n", cpu->domain, cpu->x2apic_id);
+        }
+    }
+
+    if (slit)
+    {
+        puts("Distances (SLIT):\n");
+        for (uint64_t i = 0; i < slit->localities && i < 16; i++)
+        {
+            char line[128];
+            int n = snprintf(line, sizeof(line), "  %2llu:", (unsigned long long)i);
+            for (uint64_t j = 0; j < slit->localities && j < 16; j++)
+                n += snprintf(line + n, sizeof(line) - n, " %3d", acpi_slit_distance(i, j));
+            printf_fmt("%s\n", line);
+        }
+    }
+}
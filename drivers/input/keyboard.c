@@ -7,11 +7,18 @@
 #include <valen/io.h>
 #include <valen/shell.h>
 #include <valen/pic.h>
+#include <valen/irq.h>
+#include <valen/ring.h>
 
-extern int system_ready;
+extern volatile int system_ready;
 
 volatile int key_pressed_flag;
-static char pending_key = 0;
+
+/* Keys from the IRQ handler to process_pending_key(). A ring rather than
+ * a single slot, so keys typed while the shell is busy are not lost. */
+#define KEY_RING_SIZE 64
+static char key_buffer[KEY_RING_SIZE];
+static struct spsc_ring key_ring;
 
 static int shift_pressed = 0;
 
@@ -32,8 +39,11 @@ void keyboard_init(void)
 {
     while (inb(0x64) & 1)
         inb(0x60);
-    
+
+    spsc_ring_init(&key_ring, key_buffer, KEY_RING_SIZE, 1);
+
     /* Enable keyboard IRQ */
+    request_irq(IRQ_KEYBOARD, keyboard_handler, IRQF_LEAF, "keyboard");
     pic_irq_enable(IRQ_KEYBOARD);
 }
 
@@ -49,10 +59,11 @@ void wait_for_keypress(void)
 
 
 /**
- * @brief Primary PS/2 IRQ1 Handler.
+ * @brief Primary PS/2 IRQ1 Handler; irq_dispatch() sends the EOI.
  */
-void keyboard_handler()
+void keyboard_handler(struct pt_regs *regs)
 {
+    (void)regs;
     uint8_t status = inb(0x64);
 
     if ((status & 0x01) && !(status & 0x20)) {
@@ -65,39 +76,49 @@ void keyboard_handler()
         else if (!(scancode & 0x80)) {
             key_pressed_flag = 1;
             if (system_ready) {
+                char key = 0;
+
                 switch (scancode) {
                 case 0x0E:
-                    pending_key = '\b';
+                    key = '\b';
                     break;
                 case 0x1C:
-                    pending_key = '\n';
+                    key = '\n';
                     break;
                 case 0x4B:
-                    pending_key = -1;
+                    key = -1;
                     break;
                 case 0x4D:
-                    pending_key = -2;
+                    key = -2;
                     break;
                 default:
                     /* Only process ASCII characters for valid scancodes */
                     if (scancode < sizeof(scancode_to_ascii)) {
                         char c = shift_pressed ? scancode_to_ascii_shift[scancode] : scancode_to_ascii[scancode];
                         if (c && c != '\0') {
-                            pending_key = c;
+                            key = c;
                         }
                     }
                     break;
                 }
+                /* A full ring drops the key, like a full hardware buffer */
+                if (key)
+                    spsc_ring_push(&key_ring, &key);
             }
         }
     }
+}
 
-    pic_send_eoi(IRQ_KEYBOARD);
+/**
+ * @brief Non-zero when a key is waiting for process_pending_key().
+ */
+int keyboard_pending(void) {
+    return !spsc_ring_empty(&key_ring);
 }
 
 void process_pending_key(void) {
-    if (pending_key != 0) {
-        shell_input(pending_key);
-        pending_key = 0;
-    }
+    char key;
+
+    if (spsc_ring_pop(&key_ring, &key))
+        shell_input(key);
 }
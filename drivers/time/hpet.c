@@ -0,0 +1,249 @@
+/**
+ * @file hpet.c
+ * @brief High Precision Event Timer driver.
+ *
+ * The HPET has a 64-bit main counter at 10MHz or more and a handful of
+ * comparators. The counter is a clocksource that does not depend on the
+ * TSC. In legacy replacement mode timer 0 drives IRQ 0 instead of the PIT
+ * (the periodic tick) and timer 1 drives IRQ 8, which is used for
+ * one-shot events. Programming either is a couple of MMIO writes, against
+ * the PIT's port I/O at a fixed 1.19MHz.
+ */
+
+#include <valen/hpet.h>
+#include <valen/acpi.h>
+#include <valen/vmm.h>
+#include <valen/pic.h>
+#include <valen/irq.h>
+#include <valen/clock.h>
+#include <valen/stdio.h>
+
+/* Femtoseconds per second, and the slowest period the specification allows */
+#define FS_PER_SEC 1000000000000000ULL
+#define HPET_MAX_PERIOD_FS 100000000ULL
+
+/* Smallest one-shot delta; nearer deadlines may pass while being written */
+#define HPET_MIN_DELTA 64
+
+#define HPET_TICK_TIMER 0
+#define HPET_EVENT_TIMER 1
+
+static volatile uint64_t *regs;
+static uint64_t freq;
+static uint64_t ticks_per_ns; /* ticks = ns * ticks_per_ns >> 32 */
+static int timer_count;
+static int counter_64;
+static int legacy_capable;
+static int tick_running;
+static int event_32bit;
+
+static void (*volatile event_fn)(void);
+static uint64_t event_count;
+
+static inline uint64_t hpet_reg(uint32_t offset)
+{
+    return regs[offset / 8];
+}
+
+static inline void hpet_write(uint32_t offset, uint64_t value)
+{
+    regs[offset / 8] = value;
+}
+
+uint64_t hpet_read(void)
+{
+    if (counter_64)
+        return hpet_reg(HPET_COUNTER);
+    return (uint32_t)hpet_reg(HPET_COUNTER);
+}
+
+static struct clocksource hpet_clocksource = {
+    .name = "hpet",
+    .read = hpet_read,
+    .rating = 250,
+};
+
+int hpet_init(void)
+{
+    const struct acpi_hpet *table = (const struct acpi_hpet *)acpi_find_table("HPET");
+    if (!table || table->address.space_id != 0 || !table->address.address)
+        return -1;
+
+    regs = vmm_map_uc(table->address.address, 1024);
+    if (!regs)
+        return -1;
+
+    uint64_t cap = hpet_reg(HPET_CAP);
+    uint64_t period_fs = cap >> 32;
+    if (period_fs == 0 || period_fs > HPET_MAX_PERIOD_FS)
+    {
+        printf("hpet: bogus period %llu fs, ignored\n", (unsigned long long)period_fs);
+        regs = NULL;
+        return -1;
+    }
+
+    freq = FS_PER_SEC / period_fs;
+    ticks_per_ns = (freq << 32) / 1000000000ULL;
+    timer_count = ((cap >> 8) & 0x1F) + 1;
+    counter_64 = (cap & HPET_CAP_COUNTER_64) != 0;
+    legacy_capable = (cap & HPET_CAP_LEGACY) != 0;
+
+    /* Quiet every comparator, then restart the main counter from zero */
+    for (int n = 0; n < timer_count; n++)
+    {
+        uint64_t tcfg = hpet_reg(HPET_TIMER_CONFIG(n));
+        hpet_write(HPET_TIMER_CONFIG(n), tcfg & ~(HPET_TN_ENABLE | HPET_TN_PERIODIC));
+    }
+    uint64_t cfg = hpet_reg(HPET_CONFIG) & ~(HPET_CONFIG_ENABLE | HPET_CONFIG_LEGACY);
+    hpet_write(HPET_CONFIG, cfg);
+    hpet_write(HPET_COUNTER, 0);
+    hpet_write(HPET_CONFIG, cfg | HPET_CONFIG_ENABLE);
+
+    /* Some emulators expose the table but never advance the counter */
+    uint64_t start = hpet_read();
+    for (int i = 0; i < 100000 && hpet_read() == start; i++)
+        asm volatile("pause");
+    if (hpet_read() == start)
+    {
+        printf("hpet: counter does not advance, ignored\n");
+        regs = NULL;
+        return -1;
+    }
+
+    printf("hpet: %d timers, %llu kHz, %d-bit counter%s\n", timer_count,
+           (unsigned long long)(freq / 1000), counter_64 ? 64 : 32,
+           legacy_capable ? ", legacy routing" : "");
+
+    /* A 32-bit counter wraps within a minute; only a 64-bit one keeps time */
+    if (counter_64)
+    {
+        hpet_clocksource.freq = freq;
+        clocksource_register(&hpet_clocksource);
+    }
+    return 0;
+}
+
+int hpet_available(void)
+{
+    return regs != NULL;
+}
+
+uint64_t hpet_frequency(void)
+{
+    return freq;
+}
+
+static uint64_t ns_to_ticks(uint64_t ns)
+{
+    return (uint64_t)(((unsigned __int128)ns * ticks_per_ns) >> 32);
+}
+
+/**
+ * @brief Timer 1 matched: runs the pending one-shot. IRQ 8.
+ */
+static void hpet_interrupt(struct pt_regs *regs)
+{
+    (void)regs;
+    void (*fn)(void) = event_fn;
+
+    event_fn = NULL;
+    event_count++;
+    if (fn)
+        fn();
+}
+
+int hpet_start_tick(uint32_t hz)
+{
+    if (!regs || !legacy_capable || hz == 0)
+        return -1;
+
+    uint64_t tcfg = hpet_reg(HPET_TIMER_CONFIG(HPET_TICK_TIMER));
+    if (!(tcfg & HPET_TN_PERIODIC_CAP))
+        return -1;
+
+    uint64_t period = freq / hz;
+
+    /* Edge-triggered periodic; with SETVAL the second write is the period */
+    tcfg &= ~(HPET_TN_LEVEL | HPET_TN_32BIT);
+    tcfg |= HPET_TN_ENABLE | HPET_TN_PERIODIC | HPET_TN_SETVAL;
+    hpet_write(HPET_TIMER_CONFIG(HPET_TICK_TIMER), tcfg);
+    hpet_write(HPET_TIMER_COMPARATOR(HPET_TICK_TIMER), hpet_read() + period);
+    hpet_write(HPET_TIMER_COMPARATOR(HPET_TICK_TIMER), period);
+
+    if (!tick_running)
+    {
+        /* Timer 1 stays armed but fires only when a comparator is written */
+        if (timer_count > HPET_EVENT_TIMER)
+        {
+            uint64_t ecfg = hpet_reg(HPET_TIMER_CONFIG(HPET_EVENT_TIMER));
+            ecfg &= ~(HPET_TN_LEVEL | HPET_TN_PERIODIC | HPET_TN_32BIT);
+            event_32bit = !counter_64 || !(ecfg & HPET_TN_64BIT_CAP);
+            if (event_32bit)
+                ecfg |= HPET_TN_32BIT;
+            hpet_write(HPET_TIMER_COMPARATOR(HPET_EVENT_TIMER), ~0ULL);
+            hpet_write(HPET_TIMER_CONFIG(HPET_EVENT_TIMER), ecfg | HPET_TN_ENABLE);
+
+            request_irq(IRQ_RTC, hpet_interrupt, IRQF_LEAF, "hpet");
+            pic_irq_enable(IRQ_CASCADE);
+            pic_irq_enable(IRQ_RTC);
+        }
+
+        /* From here the PIT's interrupt line is disconnected */
+        hpet_write(HPET_CONFIG, hpet_reg(HPET_CONFIG) | HPET_CONFIG_LEGACY);
+        pic_irq_enable(IRQ_TIMER);
+        tick_running = 1;
+    }
+    return 0;
+}
+
+int hpet_has_oneshot(void)
+{
+    return tick_running && timer_count > HPET_EVENT_TIMER;
+}
+
+int hpet_oneshot(uint64_t delta_ns, void (*fn)(void))
+{
+    if (!hpet_has_oneshot())
+        return -1;
+
+    uint64_t delta = ns_to_ticks(delta_ns);
+    if (delta < HPET_MIN_DELTA)
+        delta = HPET_MIN_DELTA;
+
+    event_fn = fn;
+    uint64_t deadline = hpet_read() + delta;
+    hpet_write(HPET_TIMER_COMPARATOR(HPET_EVENT_TIMER), deadline);
+
+    /* The comparator fires on an exact match only, so a deadline that is
+     * already behind the counter would never fire */
+    uint64_t now = hpet_read();
+    int passed = event_32bit ? (int32_t)((uint32_t)now - (uint32_t)deadline) >= 0
+                             : (int64_t)(now - deadline) >= 0;
+    if (passed)
+    {
+        event_fn = NULL;
+        return -1;
+    }
+    return 0;
+}
+
+void hpet_dump(void)
+{
+    if (!regs)
+    {
+        puts("No HPET.\n");
+        return;
+    }
+
+    printf("HPET: %llu Hz, %d-bit counter at %llu, %d timers, tick %s, %llu events\n",
+           (unsigned long long)freq, counter_64 ? 64 : 32, (unsigned long long)hpet_read(),
+           timer_count, tick_running ? "on timer 0" : "off", (unsigned long long)event_count);
+    for (int n = 0; n < timer_count; n++)
+    {
+        uint64_t tcfg = hpet_reg(HPET_TIMER_CONFIG(n));
+        printf("  timer %d: %s%s%s irq routes %x\n", n,
+               (tcfg & HPET_TN_ENABLE) ? "enabled" : "disabled",
+               (tcfg & HPET_TN_PERIODIC_CAP) ? ", periodic capable" : "",
+               (tcfg & HPET_TN_64BIT_CAP) ? ", 64-bit" : ", 32-bit", (unsigned)(tcfg >> 32));
+    }
+}
@@ -8,16 +8,42 @@
 
 #include <valen/io.h>
 #include <valen/pic.h>
+#include <valen/pit.h>
+#include <valen/param.h>
+#include <valen/clock.h>
+#include <valen/tsc.h>
 
 #define PIT_COMMAND_PORT 0x43
 #define PIT_DATA_PORT_0 0x40
+#define PIT_DATA_PORT_2 0x42
+#define PIT_GATE_PORT 0x61 /* Bit 0 gates channel 2, bit 5 is its output */
+#define PIT_BASE_FREQUENCY 1193180
+
+static int pit_hz = 50;
+
+static void pit_hz_changed(const kernel_param_t *param)
+{
+    (void)param;
+    clock_set_tick_hz(pit_hz);
+}
+
+/* The 16-bit divisor limits the slowest rate to ~19 Hz */
+param_int_notify(pit_hz, pit_hz, 19, 10000, pit_hz_changed, "Timer interrupt frequency (Hz)");
+
+/**
+ * @brief Current timer frequency; also the default for pit_init()
+ */
+uint32_t pit_get_hz(void) {
+    return pit_hz;
+}
 
 /**
  * @brief Initialize the PIT with specified frequency
  * @param frequency The desired timer frequency in Hz
  */
 void pit_init(uint32_t frequency) {
-    uint32_t divisor = 1193180 / frequency;
+    uint32_t divisor = PIT_BASE_FREQUENCY / frequency;
+    pit_hz = frequency;
     
     // Configure Channel 0, square wave mode, access mode, lobyte/hibyte, mode 3
     outb(PIT_COMMAND_PORT, 0x36);
@@ -27,3 +53,25 @@ void pit_init(uint32_t frequency) {
     // Enable timer IRQ (IRQ 0) in PIC
     pic_irq_enable(0);
 }
+
+/**
+ * @brief Measures the TSC against a 10ms one-shot on channel 2, which
+ * needs no interrupt and leaves channel 0 (the tick) alone.
+ * @return TSC frequency in kHz.
+ */
+uint64_t pit_calibrate_tsc(void) {
+    uint32_t count = PIT_BASE_FREQUENCY / 100;
+
+    // Gate high, speaker off; channel 2, lobyte/hibyte, mode 0
+    outb(PIT_GATE_PORT, (inb(PIT_GATE_PORT) & ~0x02) | 0x01);
+    outb(PIT_COMMAND_PORT, 0xB0);
+    outb(PIT_DATA_PORT_2, count & 0xFF);
+    outb(PIT_DATA_PORT_2, (count >> 8) & 0xFF);
+
+    uint64_t start = rdtsc_ordered();
+    while (!(inb(PIT_GATE_PORT) & 0x20))
+        ;
+    uint64_t cycles = rdtsc_ordered() - start;
+
+    return cycles * PIT_BASE_FREQUENCY / count / 1000;
+}
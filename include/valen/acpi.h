@@ -0,0 +1,291 @@
+#ifndef ACPI_H
+#define ACPI_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * ACPI static tables (drivers/acpi/acpi.c). The tables are found and
+ * checked once at boot and stay mapped; lookups afterwards only walk a
+ * small cache. Layouts follow the ACPI 6.x specification.
+ */
+
+struct acpi_rsdp
+{
+    char signature[8]; /* "RSD PTR " */
+    uint8_t checksum;  /* First 20 bytes sum to zero */
+    char oem_id[6];
+    uint8_t revision; /* 0 for ACPI 1.0, 2 for 2.0+ */
+    uint32_t rsdt_address;
+    /* ACPI 2.0+ */
+    uint32_t length;
+    uint64_t xsdt_address;
+    uint8_t extended_checksum; /* Whole structure sums to zero */
+    uint8_t reserved[3];
+} __attribute__((packed));
+
+struct acpi_sdt_header
+{
+    char signature[4];
+    uint32_t length; /* Including this header */
+    uint8_t revision;
+    uint8_t checksum;
+    char oem_id[6];
+    char oem_table_id[8];
+    uint32_t oem_revision;
+    uint32_t creator_id;
+    uint32_t creator_revision;
+} __attribute__((packed));
+
+/* Generic Address Structure */
+struct acpi_gas
+{
+    uint8_t space_id; /* 0 memory, 1 I/O port */
+    uint8_t bit_width;
+    uint8_t bit_offset;
+    uint8_t access_size;
+    uint64_t address;
+} __attribute__((packed));
+
+/* --- MADT ("APIC"): interrupt controllers and CPUs --- */
+
+#define ACPI_MADT_LAPIC 0
+#define ACPI_MADT_IOAPIC 1
+#define ACPI_MADT_ISO 2 /* Interrupt source override */
+#define ACPI_MADT_LAPIC_NMI 4
+#define ACPI_MADT_LAPIC_OVERRIDE 5
+#define ACPI_MADT_X2APIC 9
+
+#define ACPI_MADT_ENABLED 0x1        /* LAPIC/x2APIC flags */
+#define ACPI_MADT_ONLINE_CAPABLE 0x2 /* Disabled now, can be enabled */
+
+struct acpi_madt
+{
+    struct acpi_sdt_header header;
+    uint32_t lapic_address;
+    uint32_t flags; /* Bit 0: legacy 8259 PICs present */
+} __attribute__((packed));
+
+struct acpi_madt_entry
+{
+    uint8_t type;
+    uint8_t length;
+} __attribute__((packed));
+
+struct acpi_madt_lapic
+{
+    struct acpi_madt_entry entry;
+    uint8_t processor_id;
+    uint8_t apic_id;
+    uint32_t flags;
+} __attribute__((packed));
+
+struct acpi_madt_ioapic
+{
+    struct acpi_madt_entry entry;
+    uint8_t ioapic_id;
+    uint8_t reserved;
+    uint32_t address;
+    uint32_t gsi_base;
+} __attribute__((packed));
+
+struct acpi_madt_iso
+{
+    struct acpi_madt_entry entry;
+    uint8_t bus; /* Always 0 (ISA) */
+    uint8_t source; /* ISA IRQ */
+    uint32_t gsi;
+    uint16_t flags; /* Polarity (bits 0-1) and trigger mode (bits 2-3) */
+} __attribute__((packed));
+
+struct acpi_madt_lapic_nmi
+{
+    struct acpi_madt_entry entry;
+    uint8_t processor_id; /* 0xFF: all processors */
+    uint16_t flags;
+    uint8_t lint;
+} __attribute__((packed));
+
+struct acpi_madt_lapic_override
+{
+    struct acpi_madt_entry entry;
+    uint16_t reserved;
+    uint64_t address;
+} __attribute__((packed));
+
+struct acpi_madt_x2apic
+{
+    struct acpi_madt_entry entry;
+    uint16_t reserved;
+    uint32_t x2apic_id;
+    uint32_t flags;
+    uint32_t uid;
+} __attribute__((packed));
+
+/* --- HPET --- */
+
+struct acpi_hpet
+{
+    struct acpi_sdt_header header;
+    uint32_t event_timer_block_id;
+    struct acpi_gas address;
+    uint8_t hpet_number;
+    uint16_t min_tick;
+    uint8_t page_protection;
+} __attribute__((packed));
+
+/* --- MCFG: PCIe enhanced configuration space (ECAM) --- */
+
+struct acpi_mcfg_entry
+{
+    uint64_t base;
+    uint16_t segment;
+    uint8_t start_bus;
+    uint8_t end_bus;
+    uint32_t reserved;
+} __attribute__((packed));
+
+struct acpi_mcfg
+{
+    struct acpi_sdt_header header;
+    uint64_t reserved;
+    struct acpi_mcfg_entry entries[];
+} __attribute__((packed));
+
+/* --- SRAT: CPU and memory proximity domains (NUMA nodes) --- */
+
+#define ACPI_SRAT_CPU 0
+#define ACPI_SRAT_MEMORY 1
+#define ACPI_SRAT_X2APIC 2
+
+#define ACPI_SRAT_ENABLED 0x1
+#define ACPI_SRAT_HOTPLUG 0x2     /* Memory affinity only */
+#define ACPI_SRAT_NONVOLATILE 0x4 /* Memory affinity only */
+
+struct acpi_srat
+{
+    struct acpi_sdt_header header;
+    uint32_t reserved1;
+    uint64_t reserved2;
+} __attribute__((packed));
+
+/* SRAT entries share the MADT entry header */
+struct acpi_srat_cpu
+{
+    struct acpi_madt_entry entry;
+    uint8_t domain_lo;
+    uint8_t apic_id;
+    uint32_t flags;
+    uint8_t sapic_eid;
+    uint8_t domain_hi[3];
+    uint32_t clock_domain;
+} __attribute__((packed));
+
+struct acpi_srat_memory
+{
+    struct acpi_madt_entry entry;
+    uint32_t domain;
+    uint16_t reserved1;
+    uint64_t base;
+    uint64_t length;
+    uint32_t reserved2;
+    uint32_t flags;
+    uint64_t reserved3;
+} __attribute__((packed));
+
+struct acpi_srat_x2apic
+{
+    struct acpi_madt_entry entry;
+    uint16_t reserved1;
+    uint32_t domain;
+    uint32_t x2apic_id;
+    uint32_t flags;
+    uint32_t clock_domain;
+    uint32_t reserved2;
+} __attribute__((packed));
+
+/**
+ * @brief Proximity domain of an SRAT CPU entry (split over two fields).
+ */
+static inline uint32_t acpi_srat_cpu_domain(const struct acpi_srat_cpu *cpu)
+{
+    return cpu->domain_lo | (uint32_t)cpu->domain_hi[0] << 8 |
+           (uint32_t)cpu->domain_hi[1] << 16 | (uint32_t)cpu->domain_hi[2] << 24;
+}
+
+/* --- SLIT: relative distance between proximity domains --- */
+
+#define ACPI_LOCAL_DISTANCE 10
+#define ACPI_REMOTE_DISTANCE 20
+
+struct acpi_slit
+{
+    struct acpi_sdt_header header;
+    uint64_t localities;
+    uint8_t entries[]; /* localities x localities matrix */
+} __attribute__((packed));
+
+/* --- Summary of the topology found at boot --- */
+
+struct acpi_info
+{
+    uint8_t revision;    /* RSDP revision: 0 for ACPI 1.0, 2 for 2.0+ */
+    int tables;          /* Valid tables in the cache, 0 without ACPI */
+    uint64_t lapic_base; /* Local APIC registers (physical) */
+    int cpus;            /* Enabled LAPIC and x2APIC entries */
+    int ioapics;
+    int nodes;           /* Proximity domains in the SRAT, 0 without one */
+};
+
+/**
+ * @brief Finds, maps and checks the ACPI tables.
+ * @param rsdp RSDP copy from the multiboot2 ACPI tag, or NULL to search
+ * the BIOS areas below 1MB.
+ */
+void acpi_init(const void *rsdp);
+
+/**
+ * @brief Summary built by acpi_init(). All zero if there is no ACPI.
+ */
+const struct acpi_info *acpi_get_info(void);
+
+/**
+ * @brief Looks up a table by signature, e.g. "APIC" for the MADT.
+ * @return The first valid table with that signature, or NULL.
+ */
+const struct acpi_sdt_header *acpi_find_table(const char *signature);
+
+/**
+ * @brief Next MADT/SRAT entry of the given type after prev (NULL: first).
+ */
+const void *acpi_madt_next(const void *prev, int type);
+const void *acpi_srat_next(const void *prev, int type);
+
+#define acpi_for_each_madt(var, type, ctype) \
+    for (const ctype *var = acpi_madt_next(NULL, type); var; var = acpi_madt_next(var, type))
+
+#define acpi_for_each_srat(var, type, ctype) \
+    for (const ctype *var = acpi_srat_next(NULL, type); var; var = acpi_srat_next(var, type))
+
+/**
+ * @brief Next MCFG entry after prev (NULL: first); one per PCIe segment
+ * and bus range.
+ */
+const struct acpi_mcfg_entry *acpi_mcfg_next(const struct acpi_mcfg_entry *prev);
+
+#define acpi_for_each_mcfg(var) \
+    for (const struct acpi_mcfg_entry *var = acpi_mcfg_next(NULL); var; var = acpi_mcfg_next(var))
+
+/**
+ * @brief Distance between two proximity domains from the SLIT. Without a
+ * SLIT (or for domains it does not list) ACPI_LOCAL_DISTANCE /
+ * ACPI_REMOTE_DISTANCE.
+ */
+int acpi_slit_distance(uint32_t from, uint32_t to);
+
+/**
+ * @brief Prints the table list and topology ('acpi' shell command).
+ */
+void acpi_dump(void);
+
+#endif
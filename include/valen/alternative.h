@@ -0,0 +1,58 @@
+#ifndef ALTERNATIVE_H
+#define ALTERNATIVE_H
+
+#include <stdint.h>
+
+/*
+ * Boot-time instruction patching (kernel/hardware/alternative.c).
+ *
+ *   asm volatile(ALTERNATIVE("old", "new", X86_FEATURE_FOO) ...);
+ *
+ * emits "old", padded with NOPs to the length of "new", and records both
+ * in .altinstructions. apply_alternatives() copies "new" over "old" on
+ * CPUs with the feature. "new" is assembled elsewhere and copied, so it
+ * must not contain RIP-relative operands or relative jumps and calls that
+ * leave it. An empty "new" turns "old" into NOPs.
+ */
+
+struct alt_instr
+{
+    int32_t instr_offset; /* Original code, relative to this field */
+    int32_t repl_offset;  /* Replacement, relative to this field */
+    uint16_t feature;     /* X86_FEATURE_* */
+    uint8_t instrlen;     /* Original code including padding */
+    uint8_t replacementlen;
+} __attribute__((packed));
+
+#define __ALT_STR(x) #x
+#define __ALT_XSTR(x) __ALT_STR(x)
+
+/* GAS evaluates a true comparison to -1, hence the leading minus */
+#define ALTERNATIVE(oldinstr, newinstr, feature)                                    \
+    "661:\n\t" oldinstr "\n662:\n\t"                                                \
+    ".skip -(((665f-664f)-(662b-661b)) > 0) * ((665f-664f)-(662b-661b)),0x90\n"     \
+    "663:\n\t"                                                                      \
+    ".pushsection .altinstructions,\"a\"\n\t"                                       \
+    ".long 661b - .\n\t"                                                            \
+    ".long 664f - .\n\t"                                                            \
+    ".word " __ALT_XSTR(feature) "\n\t"                                             \
+    ".byte 663b - 661b\n\t"                                                         \
+    ".byte 665f - 664f\n\t"                                                         \
+    ".popsection\n\t"                                                               \
+    ".pushsection .altinstr_replacement,\"ax\"\n"                                   \
+    "664:\n\t" newinstr "\n665:\n\t"                                                \
+    ".popsection\n"
+
+/**
+ * @brief Patches every recorded site whose feature the boot CPU has.
+ * Called by cpu_detect().
+ * @return Number of sites patched.
+ */
+int apply_alternatives(void);
+
+/**
+ * @brief Sites recorded and sites patched, for 'cpuinfo'.
+ */
+void alternatives_stats(int *total, int *patched);
+
+#endif
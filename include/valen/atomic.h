@@ -0,0 +1,222 @@
+#ifndef ATOMIC_H
+#define ATOMIC_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * Atomic operations over the GCC __atomic builtins, which implement the
+ * C11 memory model without needing <stdatomic.h> in a freestanding build.
+ *
+ * atomic_t and atomic64_t wrap a counter so it cannot be read or written
+ * by accident without these helpers. Operations that return a value are
+ * fully ordered (seq_cst, a locked instruction on x86). The _relaxed
+ * forms only guarantee atomicity, enough for statistics. Plain
+ * atomic_add()/atomic_inc() return nothing and are relaxed.
+ *
+ * The barrier macros follow Linux: on x86 only stores followed by loads
+ * can be reordered, so smp_rmb()/smp_wmb() and acquire/release only need
+ * to stop the compiler, and smp_mb() is the only real fence.
+ */
+
+typedef struct
+{
+    volatile int counter;
+} atomic_t;
+
+typedef struct
+{
+    volatile int64_t counter;
+} atomic64_t;
+
+#define ATOMIC_INIT(i) {(i)}
+#define ATOMIC64_INIT(i) {(i)}
+
+/* --- Barriers and single accesses --- */
+
+#define barrier() asm volatile("" ::: "memory")
+
+/* A locked add to the stack is a full fence and cheaper than mfence */
+#define smp_mb() asm volatile("lock addl $0, -4(%%rsp)" ::: "memory", "cc")
+#define smp_rmb() barrier()
+#define smp_wmb() barrier()
+
+/** @brief One load or store the compiler may neither tear, merge nor elide. */
+#define READ_ONCE(x) (*(const volatile __typeof__(x) *)&(x))
+#define WRITE_ONCE(x, val) (*(volatile __typeof__(x) *)&(x) = (val))
+
+/** @brief Load that later accesses cannot be moved before. */
+#define smp_load_acquire(p) __atomic_load_n(p, __ATOMIC_ACQUIRE)
+
+/** @brief Store that earlier accesses cannot be moved after. */
+#define smp_store_release(p, v) __atomic_store_n(p, v, __ATOMIC_RELEASE)
+
+static inline void cpu_relax(void)
+{
+    asm volatile("pause" ::: "memory");
+}
+
+/* --- atomic_t --- */
+
+static inline int atomic_read(const atomic_t *v)
+{
+    return __atomic_load_n(&v->counter, __ATOMIC_RELAXED);
+}
+
+static inline void atomic_set(atomic_t *v, int i)
+{
+    __atomic_store_n(&v->counter, i, __ATOMIC_RELAXED);
+}
+
+static inline void atomic_add(int i, atomic_t *v)
+{
+    __atomic_fetch_add(&v->counter, i, __ATOMIC_RELAXED);
+}
+
+static inline void atomic_sub(int i, atomic_t *v)
+{
+    __atomic_fetch_sub(&v->counter, i, __ATOMIC_RELAXED);
+}
+
+static inline void atomic_inc(atomic_t *v)
+{
+    atomic_add(1, v);
+}
+
+static inline void atomic_dec(atomic_t *v)
+{
+    atomic_sub(1, v);
+}
+
+static inline int atomic_fetch_add(int i, atomic_t *v)
+{
+    return __atomic_fetch_add(&v->counter, i, __ATOMIC_SEQ_CST);
+}
+
+static inline int atomic_fetch_add_relaxed(int i, atomic_t *v)
+{
+    return __atomic_fetch_add(&v->counter, i, __ATOMIC_RELAXED);
+}
+
+static inline int atomic_add_return(int i, atomic_t *v)
+{
+    return __atomic_add_fetch(&v->counter, i, __ATOMIC_SEQ_CST);
+}
+
+static inline int atomic_inc_return(atomic_t *v)
+{
+    return atomic_add_return(1, v);
+}
+
+static inline int atomic_dec_return(atomic_t *v)
+{
+    return atomic_add_return(-1, v);
+}
+
+/** @brief Decrements and returns true when the result is zero (last reference). */
+static inline bool atomic_dec_and_test(atomic_t *v)
+{
+    return atomic_dec_return(v) == 0;
+}
+
+static inline int atomic_xchg(atomic_t *v, int i)
+{
+    return __atomic_exchange_n(&v->counter, i, __ATOMIC_SEQ_CST);
+}
+
+/**
+ * @brief Sets v to new if it holds old; returns the value it held.
+ */
+static inline int atomic_cmpxchg(atomic_t *v, int old, int new)
+{
+    __atomic_compare_exchange_n(&v->counter, &old, new, false, __ATOMIC_SEQ_CST,
+                                __ATOMIC_SEQ_CST);
+    return old;
+}
+
+/**
+ * @brief Sets v to new if it holds *old. On failure *old is updated to
+ * the current value, ready for the next attempt of a CAS loop.
+ */
+static inline bool atomic_try_cmpxchg(atomic_t *v, int *old, int new)
+{
+    return __atomic_compare_exchange_n(&v->counter, old, new, false, __ATOMIC_SEQ_CST,
+                                       __ATOMIC_SEQ_CST);
+}
+
+/* --- atomic64_t --- */
+
+static inline int64_t atomic64_read(const atomic64_t *v)
+{
+    return __atomic_load_n(&v->counter, __ATOMIC_RELAXED);
+}
+
+static inline void atomic64_set(atomic64_t *v, int64_t i)
+{
+    __atomic_store_n(&v->counter, i, __ATOMIC_RELAXED);
+}
+
+static inline void atomic64_add(int64_t i, atomic64_t *v)
+{
+    __atomic_fetch_add(&v->counter, i, __ATOMIC_RELAXED);
+}
+
+static inline void atomic64_sub(int64_t i, atomic64_t *v)
+{
+    __atomic_fetch_sub(&v->counter, i, __ATOMIC_RELAXED);
+}
+
+static inline void atomic64_inc(atomic64_t *v)
+{
+    atomic64_add(1, v);
+}
+
+static inline void atomic64_dec(atomic64_t *v)
+{
+    atomic64_sub(1, v);
+}
+
+static inline int64_t atomic64_fetch_add(int64_t i, atomic64_t *v)
+{
+    return __atomic_fetch_add(&v->counter, i, __ATOMIC_SEQ_CST);
+}
+
+static inline int64_t atomic64_fetch_add_relaxed(int64_t i, atomic64_t *v)
+{
+    return __atomic_fetch_add(&v->counter, i, __ATOMIC_RELAXED);
+}
+
+static inline int64_t atomic64_add_return(int64_t i, atomic64_t *v)
+{
+    return __atomic_add_fetch(&v->counter, i, __ATOMIC_SEQ_CST);
+}
+
+static inline int64_t atomic64_inc_return(atomic64_t *v)
+{
+    return atomic64_add_return(1, v);
+}
+
+static inline bool atomic64_dec_and_test(atomic64_t *v)
+{
+    return atomic64_add_return(-1, v) == 0;
+}
+
+static inline int64_t atomic64_xchg(atomic64_t *v, int64_t i)
+{
+    return __atomic_exchange_n(&v->counter, i, __ATOMIC_SEQ_CST);
+}
+
+static inline int64_t atomic64_cmpxchg(atomic64_t *v, int64_t old, int64_t new)
+{
+    __atomic_compare_exchange_n(&v->counter, &old, new, false, __ATOMIC_SEQ_CST,
+                                __ATOMIC_SEQ_CST);
+    return old;
+}
+
+static inline bool atomic64_try_cmpxchg(atomic64_t *v, int64_t *old, int64_t new)
+{
+    return __atomic_compare_exchange_n(&v->counter, old, new, false, __ATOMIC_SEQ_CST,
+                                       __ATOMIC_SEQ_CST);
+}
+
+#endif
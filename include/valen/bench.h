@@ -0,0 +1,48 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stdint.h>
+
+/** @brief Samples collected per benchmark (percentiles are taken over these). */
+#define BENCH_SAMPLES 1024
+
+/** @brief I/O port of QEMU's isa-debug-exit device (see scripts/run.sh). */
+#define BENCH_EXIT_PORT 0xF4
+
+/** @brief Test threads and histogram range (1us buckets) of latency_run(). */
+#define LATENCY_MAX_THREADS 8
+#define LATENCY_HIST_US 200
+
+/**
+ * @brief Runs one benchmark by name, or every benchmark for "all".
+ * Results go to the screen and, as "BENCH key=value ..." lines, to COM1.
+ * @return 0 on success, -1 if no benchmark matched.
+ */
+int bench_run(const char *name);
+
+/**
+ * @brief Prints the names of all benchmarks.
+ */
+void bench_list(void);
+
+/**
+ * @brief Task entry for headless runs (bench=<name> on the command line):
+ * runs the requested benchmarks and exits QEMU through isa-debug-exit.
+ */
+void bench_task_main(void);
+
+/**
+ * @brief Selects what bench_task_main() runs.
+ */
+void bench_set_boot_mode(const char *name);
+
+/**
+ * @brief cyclictest: nthreads top-priority threads each sleep nloops times
+ * until a deadline interval_us apart and record how late they wake up.
+ * Prints per-thread statistics and a per-CPU histogram to the screen and,
+ * as "LATENCY ..." lines, to COM1.
+ * @return 0, or -1 for invalid arguments.
+ */
+int latency_run(int nthreads, uint64_t interval_us, int nloops);
+
+#endif
@@ -0,0 +1,191 @@
+#ifndef BITMAP_H
+#define BITMAP_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <valen/cpufeature.h>
+
+/*
+ * Bitmaps of 64-bit words (lib/bitmap.c), with the Linux interface. Bit
+ * nr lives in word nr / 64 at position nr % 64; on x86 that is the same
+ * memory layout as a byte array indexed by nr / 8.
+ *
+ * The find functions return size when there is no such bit. They scan a
+ * word at a time and locate the bit with tzcnt, so a run of used words
+ * costs one compare each. Bits past size in the last word are ignored.
+ *
+ * __set_bit()/__clear_bit() are plain read-modify-writes for maps under
+ * a lock. set_bit(), clear_bit() and the test_and_ variants are locked
+ * instructions, safe against other CPUs and interrupts.
+ */
+
+#define BITS_PER_LONG 64
+#define BITS_TO_LONGS(nr) (((nr) + BITS_PER_LONG - 1) / BITS_PER_LONG)
+#define BIT_WORD(nr) ((nr) / BITS_PER_LONG)
+#define BIT_MASK(nr) (1ULL << ((nr) % BITS_PER_LONG))
+
+/* Bits of the last word that belong to a map of nbits bits */
+#define BITMAP_LAST_WORD_MASK(nbits) (~0ULL >> (-(nbits) & (BITS_PER_LONG - 1)))
+
+#define DECLARE_BITMAP(name, bits) uint64_t name[BITS_TO_LONGS(bits)]
+
+/**
+ * @brief Index of the lowest set bit. word must not be 0.
+ */
+static inline unsigned int __ffs(uint64_t word)
+{
+    uint64_t bit;
+
+    /* tzcnt on CPUs with BMI1 and bsf on the rest (the rep prefix is
+     * ignored); both give the same answer for a non-zero word */
+    asm("rep; bsf %1, %0" : "=r"(bit) : "rm"(word));
+    return bit;
+}
+
+/** @brief Index of the lowest clear bit. word must not be ~0. */
+static inline unsigned int ffz(uint64_t word)
+{
+    return __ffs(~word);
+}
+
+/** @brief Index of the highest set bit. word must not be 0. */
+static inline unsigned int __fls(uint64_t word)
+{
+    uint64_t bit;
+
+    asm("bsr %1, %0" : "=r"(bit) : "rm"(word));
+    return bit;
+}
+
+/** @brief Set bits in word without the popcnt instruction. */
+static inline unsigned int __sw_hweight64(uint64_t w)
+{
+    w -= (w >> 1) & 0x5555555555555555ULL;
+    w = (w & 0x3333333333333333ULL) + ((w >> 2) & 0x3333333333333333ULL);
+    w = (w + (w >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+    return (w * 0x0101010101010101ULL) >> 56;
+}
+
+/** @brief Set bits in word: popcnt when the CPU has it. */
+static inline unsigned int hweight64(uint64_t w)
+{
+    if (static_cpu_has(X86_FEATURE_POPCNT))
+    {
+        uint64_t n;
+        asm("popcnt %1, %0" : "=r"(n) : "rm"(w));
+        return n;
+    }
+    return __sw_hweight64(w);
+}
+
+static inline bool test_bit(uint64_t nr, const uint64_t *map)
+{
+    return (map[BIT_WORD(nr)] >> (nr % BITS_PER_LONG)) & 1;
+}
+
+static inline void __set_bit(uint64_t nr, uint64_t *map)
+{
+    map[BIT_WORD(nr)] |= BIT_MASK(nr);
+}
+
+static inline void __clear_bit(uint64_t nr, uint64_t *map)
+{
+    map[BIT_WORD(nr)] &= ~BIT_MASK(nr);
+}
+
+static inline void set_bit(uint64_t nr, uint64_t *map)
+{
+    asm volatile("lock btsq %1, %0" : "+m"(map[BIT_WORD(nr)]) : "r"(nr % BITS_PER_LONG) : "memory");
+}
+
+static inline void clear_bit(uint64_t nr, uint64_t *map)
+{
+    asm volatile("lock btrq %1, %0" : "+m"(map[BIT_WORD(nr)]) : "r"(nr % BITS_PER_LONG) : "memory");
+}
+
+/** @brief Sets bit nr and returns its old value, atomically. */
+static inline bool test_and_set_bit(uint64_t nr, uint64_t *map)
+{
+    bool old;
+
+    asm volatile("lock btsq %2, %0"
+                 : "+m"(map[BIT_WORD(nr)]), "=@ccc"(old)
+                 : "r"(nr % BITS_PER_LONG)
+                 : "memory");
+    return old;
+}
+
+/** @brief Clears bit nr and returns its old value, atomically. */
+static inline bool test_and_clear_bit(uint64_t nr, uint64_t *map)
+{
+    bool old;
+
+    asm volatile("lock btrq %2, %0"
+                 : "+m"(map[BIT_WORD(nr)]), "=@ccc"(old)
+                 : "r"(nr % BITS_PER_LONG)
+                 : "memory");
+    return old;
+}
+
+static inline void bitmap_zero(uint64_t *map, uint64_t nbits)
+{
+    for (uint64_t i = 0; i < BITS_TO_LONGS(nbits); i++)
+        map[i] = 0;
+}
+
+/** @brief Sets every bit, including the unused tail of the last word. */
+static inline void bitmap_fill(uint64_t *map, uint64_t nbits)
+{
+    for (uint64_t i = 0; i < BITS_TO_LONGS(nbits); i++)
+        map[i] = ~0ULL;
+}
+
+/** @brief First set bit at or after start, or size. */
+uint64_t find_next_bit(const uint64_t *map, uint64_t size, uint64_t start);
+
+/** @brief First clear bit at or after start, or size. */
+uint64_t find_next_zero_bit(const uint64_t *map, uint64_t size, uint64_t start);
+
+static inline uint64_t find_first_bit(const uint64_t *map, uint64_t size)
+{
+    return find_next_bit(map, size, 0);
+}
+
+static inline uint64_t find_first_zero_bit(const uint64_t *map, uint64_t size)
+{
+    return find_next_zero_bit(map, size, 0);
+}
+
+#define for_each_set_bit(bit, map, size)                                                   \
+    for ((bit) = find_first_bit(map, size); (bit) < (size);                                \
+         (bit) = find_next_bit(map, size, (bit) + 1))
+
+#define for_each_clear_bit(bit, map, size)                                                 \
+    for ((bit) = find_first_zero_bit(map, size); (bit) < (size);                           \
+         (bit) = find_next_zero_bit(map, size, (bit) + 1))
+
+/** @brief Sets bits [start, start + len), whole words at a time. */
+void bitmap_set(uint64_t *map, uint64_t start, uint64_t len);
+
+/** @brief Clears bits [start, start + len). */
+void bitmap_clear(uint64_t *map, uint64_t start, uint64_t len);
+
+/** @brief Set bits in [start, end). */
+uint64_t bitmap_weight_range(const uint64_t *map, uint64_t start, uint64_t end);
+
+/** @brief Set bits among the first nbits. */
+static inline uint64_t bitmap_weight(const uint64_t *map, uint64_t nbits)
+{
+    return bitmap_weight_range(map, 0, nbits);
+}
+
+/**
+ * @brief Finds nr clear bits in a row, at or after start and below size.
+ * The run starts at a multiple of align_mask + 1 (a power of two; 0 for
+ * no alignment).
+ * @return The first bit of the run, or size if there is none.
+ */
+uint64_t bitmap_find_next_zero_area(const uint64_t *map, uint64_t size, uint64_t start,
+                                    uint64_t nr, uint64_t align_mask);
+
+#endif
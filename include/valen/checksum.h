@@ -0,0 +1,40 @@
+#ifndef CHECKSUM_H
+#define CHECKSUM_H
+
+#include <stdint.h>
+
+/*
+ * The Internet checksum (RFC 1071) of IP, TCP, UDP and ICMP (lib/checksum.c):
+ * the one's complement of the one's complement sum of 16-bit words.
+ *
+ * csum_partial() returns an unfolded 32-bit sum, so pieces can be summed
+ * separately (a pseudo-header, then the payload) and folded once at the
+ * end. Every piece but the last must have an even length. Words are
+ * summed in memory order, so the result is already in network byte order
+ * when stored back.
+ */
+
+uint32_t csum_partial(const void *buf, uint64_t len, uint32_t sum);
+
+/** @brief Folds a 32-bit partial sum to 16 bits and complements it. */
+static inline uint16_t csum_fold(uint32_t sum)
+{
+    sum = (sum & 0xFFFF) + (sum >> 16);
+    sum = (sum & 0xFFFF) + (sum >> 16);
+    return (uint16_t)~sum;
+}
+
+/** @brief Adds two partial sums with end-around carry. */
+static inline uint32_t csum_add(uint32_t a, uint32_t b)
+{
+    uint32_t sum = a + b;
+    return sum + (sum < a);
+}
+
+/** @brief The checksum of a whole buffer; 0 when a buffer with its checksum field checks out. */
+static inline uint16_t ip_compute_csum(const void *buf, uint64_t len)
+{
+    return csum_fold(csum_partial(buf, len, 0));
+}
+
+#endif
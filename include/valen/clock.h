@@ -0,0 +1,74 @@
+#ifndef CLOCK_H
+#define CLOCK_H
+
+#include <stdint.h>
+
+/*
+ * Time keeping (kernel/time/clock.c). A clocksource is a free-running
+ * counter; the best rated one backs clock_ns(). The tick device raises
+ * IRQ 0 at pit_hz: HPET timer 0 when the HPET can take over the PIT's
+ * interrupt line, the PIT otherwise.
+ */
+
+struct clocksource
+{
+    const char *name;
+    uint64_t (*read)(void);
+    uint64_t freq; /* Hz */
+    int rating;    /* The highest rated source is used */
+
+    /* Filled in by clocksource_register() */
+    uint64_t mult; /* ns = cycles * mult >> 32 */
+    struct clocksource *next;
+};
+
+/**
+ * @brief Adds a clocksource and switches to it if it is rated higher than
+ * the current one (or named by the clocksource= parameter).
+ */
+void clocksource_register(struct clocksource *cs);
+
+/**
+ * @brief Switches clock_ns() to the named source without a jump in time.
+ * @return 0, or -1 if no source has that name.
+ */
+int clocksource_select(const char *name);
+
+/**
+ * @brief Nanoseconds since the first clocksource was registered.
+ */
+uint64_t clock_ns(void);
+
+/**
+ * @brief Busy-waits at least us microseconds.
+ */
+void clock_udelay(uint64_t us);
+
+/**
+ * @brief TSC frequency measured at boot, in kHz.
+ */
+uint64_t clock_tsc_khz(void);
+
+/**
+ * @brief Finds the HPET, calibrates the TSC against it (or the PIT),
+ * registers the clocksources and starts the tick at pit_hz.
+ */
+void clock_init(void);
+
+/**
+ * @brief Reprograms the tick device (pit_hz changes).
+ */
+void clock_set_tick_hz(uint32_t hz);
+
+/**
+ * @brief Prints clocksources, read costs and the tick device ('clock').
+ */
+void clock_dump(void);
+
+/**
+ * @brief Starts a series of short hrtimers and prints how late they fire
+ * ('clock test').
+ */
+void clock_oneshot_test(void);
+
+#endif
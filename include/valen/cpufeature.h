@@ -0,0 +1,165 @@
+#ifndef CPUFEATURE_H
+#define CPUFEATURE_H
+
+#include <stdint.h>
+#include <valen/alternative.h>
+
+/*
+ * CPU feature database (kernel/hardware/cpufeature.c). Each feature is a
+ * bit in one of NCAPWORDS 32-bit words, one word per CPUID register that
+ * is read, so X86_FEATURE_* = word * 32 + bit of that register.
+ */
+
+#define CPUID_1_EDX 0
+#define CPUID_1_ECX 1
+#define CPUID_80000001_EDX 2
+#define CPUID_80000001_ECX 3
+#define CPUID_7_0_EBX 4
+#define CPUID_7_0_ECX 5
+#define CPUID_7_0_EDX 6
+#define CPUID_80000007_EDX 7
+#define CPUID_D_1_EAX 8
+#define NCAPWORDS 9
+
+/* CPUID 1, EDX */
+#define X86_FEATURE_FPU (CPUID_1_EDX * 32 + 0)
+#define X86_FEATURE_TSC (CPUID_1_EDX * 32 + 4)
+#define X86_FEATURE_MSR (CPUID_1_EDX * 32 + 5)
+#define X86_FEATURE_APIC (CPUID_1_EDX * 32 + 9)
+#define X86_FEATURE_PGE (CPUID_1_EDX * 32 + 13)
+#define X86_FEATURE_PAT (CPUID_1_EDX * 32 + 16)
+#define X86_FEATURE_CLFLUSH (CPUID_1_EDX * 32 + 19)
+#define X86_FEATURE_FXSR (CPUID_1_EDX * 32 + 24)
+#define X86_FEATURE_SSE2 (CPUID_1_EDX * 32 + 26)
+
+/* CPUID 1, ECX */
+#define X86_FEATURE_SSE3 (CPUID_1_ECX * 32 + 0)
+#define X86_FEATURE_PCLMULQDQ (CPUID_1_ECX * 32 + 1)
+#define X86_FEATURE_PCID (CPUID_1_ECX * 32 + 17)
+#define X86_FEATURE_SSE4_2 (CPUID_1_ECX * 32 + 20) /* Includes the CRC32 instruction */
+#define X86_FEATURE_X2APIC (CPUID_1_ECX * 32 + 21)
+#define X86_FEATURE_MOVBE (CPUID_1_ECX * 32 + 22)
+#define X86_FEATURE_POPCNT (CPUID_1_ECX * 32 + 23)
+#define X86_FEATURE_TSC_DEADLINE (CPUID_1_ECX * 32 + 24)
+#define X86_FEATURE_XSAVE (CPUID_1_ECX * 32 + 26)
+#define X86_FEATURE_AVX (CPUID_1_ECX * 32 + 28)
+#define X86_FEATURE_RDRAND (CPUID_1_ECX * 32 + 30)
+#define X86_FEATURE_HYPERVISOR (CPUID_1_ECX * 32 + 31)
+
+/* CPUID 80000001h, EDX */
+#define X86_FEATURE_NX (CPUID_80000001_EDX * 32 + 20)
+#define X86_FEATURE_GBPAGES (CPUID_80000001_EDX * 32 + 26) /* 1GB pages */
+#define X86_FEATURE_RDTSCP (CPUID_80000001_EDX * 32 + 27)
+#define X86_FEATURE_LM (CPUID_80000001_EDX * 32 + 29)
+
+/* CPUID 80000001h, ECX */
+#define X86_FEATURE_LAHF_LM (CPUID_80000001_ECX * 32 + 0)
+#define X86_FEATURE_ABM (CPUID_80000001_ECX * 32 + 5) /* LZCNT */
+
+/* CPUID 7.0, EBX */
+#define X86_FEATURE_FSGSBASE (CPUID_7_0_EBX * 32 + 0)
+#define X86_FEATURE_BMI1 (CPUID_7_0_EBX * 32 + 3) /* Includes TZCNT */
+#define X86_FEATURE_AVX2 (CPUID_7_0_EBX * 32 + 5)
+#define X86_FEATURE_SMEP (CPUID_7_0_EBX * 32 + 7)
+#define X86_FEATURE_BMI2 (CPUID_7_0_EBX * 32 + 8)
+#define X86_FEATURE_ERMS (CPUID_7_0_EBX * 32 + 9) /* Enhanced REP MOVSB/STOSB */
+#define X86_FEATURE_INVPCID (CPUID_7_0_EBX * 32 + 10)
+#define X86_FEATURE_RDSEED (CPUID_7_0_EBX * 32 + 18)
+#define X86_FEATURE_ADX (CPUID_7_0_EBX * 32 + 19)
+#define X86_FEATURE_SMAP (CPUID_7_0_EBX * 32 + 20)
+#define X86_FEATURE_CLFLUSHOPT (CPUID_7_0_EBX * 32 + 23)
+#define X86_FEATURE_CLWB (CPUID_7_0_EBX * 32 + 24)
+
+/* CPUID 7.0, ECX */
+#define X86_FEATURE_UMIP (CPUID_7_0_ECX * 32 + 2)
+#define X86_FEATURE_PKU (CPUID_7_0_ECX * 32 + 3)
+#define X86_FEATURE_LA57 (CPUID_7_0_ECX * 32 + 16)
+#define X86_FEATURE_RDPID (CPUID_7_0_ECX * 32 + 22)
+
+/* CPUID 7.0, EDX */
+#define X86_FEATURE_FSRM (CPUID_7_0_EDX * 32 + 4) /* Fast short REP MOVSB */
+
+/* CPUID 80000007h, EDX */
+#define X86_FEATURE_CONSTANT_TSC (CPUID_80000007_EDX * 32 + 8) /* Invariant TSC */
+
+/* CPUID 0Dh.1, EAX */
+#define X86_FEATURE_XSAVEOPT (CPUID_D_1_EAX * 32 + 0)
+#define X86_FEATURE_XSAVEC (CPUID_D_1_EAX * 32 + 1)
+#define X86_FEATURE_XSAVES (CPUID_D_1_EAX * 32 + 3)
+
+struct cpuinfo_x86
+{
+    char vendor[13];
+    char model_name[49];
+    uint32_t family;
+    uint32_t model;
+    uint32_t stepping;
+    uint32_t max_leaf;
+    uint32_t max_ext_leaf;
+    uint32_t caps[NCAPWORDS];
+};
+
+extern struct cpuinfo_x86 boot_cpu_data;
+
+static inline void cpuid_count(uint32_t leaf, uint32_t subleaf, uint32_t *eax, uint32_t *ebx,
+                               uint32_t *ecx, uint32_t *edx)
+{
+    asm volatile("cpuid"
+                 : "=a"(*eax), "=b"(*ebx), "=c"(*ecx), "=d"(*edx)
+                 : "a"(leaf), "c"(subleaf));
+}
+
+/**
+ * @brief Non-zero if the boot CPU has the feature. A memory load and a
+ * test; use static_cpu_has() on hot paths.
+ */
+static inline int boot_cpu_has(int feature)
+{
+    return (boot_cpu_data.caps[feature / 32] >> (feature % 32)) & 1;
+}
+
+/**
+ * @brief Same answer as boot_cpu_has(), but with no load or compare: the
+ * branch is a jump that apply_alternatives() turns into NOPs when the
+ * feature is present. Reads as absent until then. feature must be a
+ * constant.
+ */
+#define static_cpu_has(feature)                                                  \
+    ({                                                                           \
+        __label__ __no_feature;                                                  \
+        int __has = 1;                                                           \
+        asm goto(ALTERNATIVE("jmp %l[__no_feature]", "", feature)               \
+                 : : : : __no_feature);                                          \
+        if (0)                                                                   \
+        {                                                                        \
+        __no_feature:                                                            \
+            __has = 0;                                                           \
+        }                                                                        \
+        __has;                                                                   \
+    })
+
+/**
+ * @brief Reads the boot CPU's CPUID leaves into boot_cpu_data, drops the
+ * features named by clearcpuid= and patches the alternatives. Runs right
+ * after the command line is parsed.
+ */
+void cpu_detect(void);
+
+/**
+ * @brief Marks a feature as absent. Code already patched for it by
+ * cpu_detect() keeps the patched variant.
+ */
+void cpu_clear_feature(int feature);
+
+/**
+ * @brief Name of a feature as listed by 'cpuinfo', or NULL.
+ */
+const char *cpu_feature_name(int feature);
+
+/**
+ * @brief Prints the CPU model, its features and the patched alternatives
+ * ('cpuinfo').
+ */
+void cpu_dump(void);
+
+#endif
@@ -0,0 +1,99 @@
+#ifndef CRASHDUMP_H
+#define CRASHDUMP_H
+
+#include <stdint.h>
+#include <valen/ptrace.h>
+
+/*
+ * Crash image kept in a reserved physical region. RAM contents survive a
+ * warm reboot (reset button, PS/2 reset, QEMU system_reset), so the panic
+ * path writes the image there and the next boot picks it up.
+ */
+#define CRASHDUMP_PHYS 0x1000000ULL /* 16MB: above the kernel and its bitmap */
+#define CRASHDUMP_SIZE 0x10000ULL   /* 64KB */
+
+#define CRASHDUMP_MAGIC 0x504D554448534352ULL /* "RCSHDUMP" */
+#define CRASHDUMP_VERSION 1
+
+#define CRASHDUMP_MAX_TASKS 32
+#define CRASHDUMP_MAX_FRAMES 32
+#define CRASHDUMP_PMM_CHUNKS 1024 /* Used pages per 2MB, first 2GB */
+
+#define CRASHDUMP_HAS_REGS 0x1
+
+struct crashdump_task
+{
+    int32_t pid;
+    int32_t state;
+    char comm[16];
+    uint64_t rsp;
+    uint64_t stack;
+    uint64_t stack_size;
+};
+
+struct crashdump
+{
+    uint64_t magic;
+    uint32_t version;
+    uint32_t checksum; /* FNV-1a over the image with this field zero */
+    uint32_t size;     /* Bytes of the image that are valid */
+    uint32_t flags;
+    uint64_t tsc;
+
+    /* Symbols are only resolved by the kernel that wrote the image */
+    uint64_t build_id;
+
+    char reason[128];
+    struct pt_regs regs;
+    uint64_t cr2;
+    uint64_t cr3;
+
+    uint32_t nframes;
+    uint32_t ntasks;
+    uint64_t frames[CRASHDUMP_MAX_FRAMES];
+
+    int32_t current_pid;
+    uint32_t pad;
+    struct crashdump_task tasks[CRASHDUMP_MAX_TASKS];
+
+    uint64_t pmm_total_kb;
+    uint64_t pmm_used_kb;
+    uint16_t pmm_chunks[CRASHDUMP_PMM_CHUNKS];
+
+    uint32_t log_len;
+    char log[]; /* Newest console output, fills the rest of the region */
+};
+
+#define CRASHDUMP_LOG_MAX (CRASHDUMP_SIZE - sizeof(struct crashdump))
+
+/**
+ * @brief Tells kmain not to hand the crash region to the PMM.
+ */
+static inline int crashdump_reserved(uint64_t phys)
+{
+#ifdef CONFIG_CRASHDUMP
+    return phys >= CRASHDUMP_PHYS && phys < CRASHDUMP_PHYS + CRASHDUMP_SIZE;
+#else
+    (void)phys;
+    return 0;
+#endif
+}
+
+/**
+ * @brief Checks for an image left by the previous boot and prints a notice.
+ * @return 1 if a valid image is present.
+ */
+int crashdump_init(void);
+
+/**
+ * @brief Writes the crash image. Called from the panic path only.
+ * @param regs Exception frame, or NULL for panic().
+ */
+void crashdump_save(const char *reason, struct pt_regs *regs,
+                    const uint64_t *frames, int nframes);
+
+void crashdump_show(void);
+void crashdump_export(void);
+void crashdump_clear(void);
+
+#endif
@@ -0,0 +1,32 @@
+#ifndef CRC32C_H
+#define CRC32C_H
+
+#include <stdint.h>
+
+/*
+ * CRC-32C (Castagnoli), the checksum of iSCSI, ext4 and btrfs metadata
+ * and SCTP (lib/crc32c.c). With SSE4.2 it runs on the crc32 instruction;
+ * without, on slicing-by-8 tables. The variant is patched in at boot.
+ *
+ * The pre- and post-inversion happen inside, so the running value of a
+ * stream starts at 0 and chains directly:
+ *   crc = crc32c(0, a, n); crc = crc32c(crc, b, m);  ==  crc32c(0, a||b, n+m)
+ * The check value, crc32c(0, "123456789", 9), is 0xE3069283.
+ */
+
+/** @brief Builds the fallback tables. Runs once at boot, before any user. */
+void crc32c_init(void);
+
+uint32_t crc32c(uint32_t crc, const void *data, uint64_t len);
+
+/**
+ * @brief CRC of a||b from crc_a = crc32c(0, a, ..) and crc_b = crc32c(0, b, len_b),
+ * without touching the data. Per-block checksums can be built in any order.
+ */
+uint32_t crc32c_combine(uint32_t crc_a, uint32_t crc_b, uint64_t len_b);
+
+/* The two variants, for tests and benchmarks; use crc32c() */
+uint32_t __crc32c_sw(uint32_t crc, const void *data, uint64_t len);
+uint32_t __crc32c_hw(uint32_t crc, const void *data, uint64_t len);
+
+#endif
@@ -0,0 +1,37 @@
+#ifndef GDBSTUB_H
+#define GDBSTUB_H
+
+#include <stdint.h>
+#include <valen/ptrace.h>
+
+/* The stub talks on COM2 so COM1 stays the console and crash log */
+#define GDB_COM_PORT 0x2F8
+#define GDB_IRQ 3
+#define GDB_VECTOR (0x20 + GDB_IRQ)
+
+/* Thread id of CPU n's live context in gdb; tasks use their pid */
+#define GDB_CPU_TID_BASE 0x10000
+
+/**
+ * @brief Sets up COM2 and its receive interrupt. gdb can attach at any
+ * time afterwards: the first packet stops the kernel.
+ */
+void gdb_init(void);
+
+/**
+ * @brief Called by exception_handler() for every exception and for the
+ * COM2 interrupt.
+ * @return 1 if the stub handled it and the interrupted code should resume,
+ * 0 to continue with the normal (fatal) exception path.
+ */
+int gdb_handle_exception(struct pt_regs *regs);
+
+/**
+ * @brief Stops in the debugger, as if a breakpoint were set here.
+ */
+static inline void gdb_breakpoint(void)
+{
+    asm volatile("int3");
+}
+
+#endif
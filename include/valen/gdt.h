@@ -3,6 +3,16 @@
 
 #include <stdint.h>
 
+#define GDT_TSS_SELECTOR 0x18
+
+/* Interrupt Stack Table slots (1-based, as used in IDT entries) */
+#define IST_DOUBLE_FAULT 1
+#define IST_NMI 2
+#define IST_MACHINE_CHECK 3
+#define IST_COUNT 3
+
+#define IST_STACK_SIZE 8192
+
 struct gdt_entry
 {
     uint16_t limit_low;
@@ -19,6 +29,23 @@ struct gdt_ptr
     uint64_t base;
 } __attribute__((packed));
 
+/**
+ * @brief 64-bit Task State Segment. Valen has no ring 3, so only the IST
+ * pointers matter: the CPU switches to ist[n - 1] for gates with IST n.
+ */
+struct tss
+{
+    uint32_t reserved0;
+    uint64_t rsp[3];
+    uint64_t reserved1;
+    uint64_t ist[7];
+    uint64_t reserved2;
+    uint16_t reserved3;
+    uint16_t iomap_base;
+} __attribute__((packed));
+
+extern struct tss tss;
+
 void gdt_init();
 
-#endif
\ No newline at end of file
+#endif
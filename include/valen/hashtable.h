@@ -0,0 +1,80 @@
+#ifndef HASHTABLE_H
+#define HASHTABLE_H
+
+#include <valen/kernel.h>
+#include <valen/spinlock.h>
+
+/*
+ * Resizable intrusive hash table keyed by a 64-bit integer (lib/hashtable.c).
+ * A struct htable_node is embedded in each object. Keys that are not
+ * integers (names, tuples) are hashed to 64 bits by the caller first.
+ *
+ * Buckets are chained and protected by striped locks: each of the
+ * HTABLE_LOCKS locks covers an equal run of buckets, so operations on
+ * keys under different locks run in parallel. The table doubles when it holds more entries than buckets and
+ * halves below a quarter; a resize takes every lock.
+ *
+ * Nothing is reference counted: a node returned by htable_lookup() stays
+ * valid only as long as the caller's own rules keep it from being
+ * removed and freed. The locks do not disable interrupts, so the table
+ * must not be used from interrupt handlers.
+ */
+
+#define HTABLE_LOCK_BITS 5
+#define HTABLE_LOCKS (1 << HTABLE_LOCK_BITS)
+
+struct htable_node
+{
+    struct htable_node *next;
+    uint64_t key;
+};
+
+struct htable
+{
+    struct htable_node **buckets;
+    uint32_t bits;     /* log2 of the bucket count */
+    uint32_t min_bits; /* Never shrunk below this */
+    uint64_t count;
+    spinlock_t locks[HTABLE_LOCKS];
+};
+
+#define htable_entry(ptr, type, member) container_of(ptr, type, member)
+
+/**
+ * @brief Sets up an empty table of 2^min_bits buckets (at least
+ * HTABLE_LOCKS). Returns 0, or -1 when the bucket array cannot be allocated.
+ */
+int htable_init(struct htable *ht, uint32_t min_bits);
+
+/**
+ * @brief Frees the bucket array. The nodes belong to the caller.
+ */
+void htable_destroy(struct htable *ht);
+
+/**
+ * @brief Adds node under key. Returns 0, or -1 if the key is already present.
+ */
+int htable_insert(struct htable *ht, struct htable_node *node, uint64_t key);
+
+/**
+ * @brief The node stored under key, or NULL.
+ */
+struct htable_node *htable_lookup(struct htable *ht, uint64_t key);
+
+/**
+ * @brief Unlinks and returns the node stored under key, or NULL.
+ */
+struct htable_node *htable_remove(struct htable *ht, uint64_t key);
+
+/**
+ * @brief Calls fn on every node with every lock held. fn must not use
+ * the table.
+ */
+void htable_walk(struct htable *ht, void (*fn)(struct htable_node *node, void *arg), void *arg);
+
+static inline uint64_t htable_count(const struct htable *ht)
+{
+    return __atomic_load_n(&ht->count, __ATOMIC_RELAXED);
+}
+
+#endif
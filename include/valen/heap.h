@@ -3,8 +3,17 @@
 #include <stdint.h>
 #include <stddef.h>
 
+typedef struct heap_stats
+{
+    uint64_t total_bytes;  /* Payload bytes managed by the heap */
+    uint64_t free_bytes;   /* Payload bytes in free blocks */
+    uint64_t largest_free; /* Largest single free block */
+    uint64_t nodes;        /* Blocks in the list, free or not */
+} heap_stats_t;
+
 void heap_init();
 void *malloc(uint64_t size);
 void free(void *ptr);
+void heap_get_stats(heap_stats_t *stats);
 
 #endif
\ No newline at end of file
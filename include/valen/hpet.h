@@ -0,0 +1,101 @@
+#ifndef HPET_H
+#define HPET_H
+
+#include <stdint.h>
+
+/*
+ * High Precision Event Timer (drivers/time/hpet.c), found through the ACPI
+ * HPET table. Register layout from the IA-PC HPET specification 1.0a.
+ */
+
+#define HPET_CAP 0x000 /* Capabilities: period in fs (bits 63:32), timer count */
+#define HPET_CONFIG 0x010
+#define HPET_STATUS 0x020
+#define HPET_COUNTER 0x0F0
+#define HPET_TIMER_CONFIG(n) (0x100 + 0x20 * (n))
+#define HPET_TIMER_COMPARATOR(n) (0x108 + 0x20 * (n))
+
+#define HPET_CAP_COUNTER_64 (1ULL << 13)
+#define HPET_CAP_LEGACY (1ULL << 15) /* Can replace the PIT and RTC interrupts */
+
+#define HPET_CONFIG_ENABLE 0x1
+#define HPET_CONFIG_LEGACY 0x2 /* Timer 0 -> IRQ 0, timer 1 -> IRQ 8 */
+
+#define HPET_TN_LEVEL (1ULL << 1)
+#define HPET_TN_ENABLE (1ULL << 2)
+#define HPET_TN_PERIODIC (1ULL << 3)
+#define HPET_TN_PERIODIC_CAP (1ULL << 4)
+#define HPET_TN_64BIT_CAP (1ULL << 5)
+#define HPET_TN_SETVAL (1ULL << 6) /* Next comparator write sets the period */
+#define HPET_TN_32BIT (1ULL << 8)
+
+#ifdef CONFIG_HPET
+
+/**
+ * @brief Maps the HPET from the ACPI table and starts its main counter.
+ * @return 0, or -1 if there is no usable HPET.
+ */
+int hpet_init(void);
+
+/**
+ * @brief Non-zero once hpet_init() succeeded.
+ */
+int hpet_available(void);
+
+/**
+ * @brief Main counter value.
+ */
+uint64_t hpet_read(void);
+
+/**
+ * @brief Main counter frequency in Hz.
+ */
+uint64_t hpet_frequency(void);
+
+/**
+ * @brief Makes timer 0 raise IRQ 0 hz times a second in place of the PIT.
+ * @return 0, or -1 if the HPET cannot route timer 0 to IRQ 0.
+ */
+int hpet_start_tick(uint32_t hz);
+
+/**
+ * @brief Calls fn from IRQ 8 once delta_ns have passed, using timer 1.
+ * Only one event is pending at a time; arming again replaces it.
+ * @return 0, or -1 if there is no event timer or the deadline passed
+ * while it was being programmed (fn will not run).
+ */
+int hpet_oneshot(uint64_t delta_ns, void (*fn)(void));
+
+/**
+ * @brief Non-zero once the tick runs on the HPET and timer 1 is free for
+ * hpet_oneshot().
+ */
+int hpet_has_oneshot(void);
+
+/**
+ * @brief Prints the HPET's capabilities and timers.
+ */
+void hpet_dump(void);
+
+#else
+
+static inline int hpet_init(void) { return -1; }
+static inline int hpet_available(void) { return 0; }
+static inline uint64_t hpet_read(void) { return 0; }
+static inline uint64_t hpet_frequency(void) { return 0; }
+static inline int hpet_start_tick(uint32_t hz)
+{
+    (void)hz;
+    return -1;
+}
+static inline int hpet_oneshot(uint64_t delta_ns, void (*fn)(void))
+{
+    (void)delta_ns;
+    (void)fn;
+    return -1;
+}
+static inline int hpet_has_oneshot(void) { return 0; }
+
+#endif
+
+#endif
@@ -0,0 +1,45 @@
+#ifndef HRTIMER_H
+#define HRTIMER_H
+
+#include <stdint.h>
+
+/*
+ * High-resolution timers (kernel/time/hrtimer.c): callbacks at a
+ * clock_ns() deadline. They fire from the HPET one-shot event when there
+ * is one, and from the tick otherwise (pit_hz resolution).
+ */
+
+struct hrtimer
+{
+    uint64_t expires;                   /* clock_ns() deadline */
+    void (*fn)(struct hrtimer *timer);  /* Runs with interrupts disabled */
+    void *data;                         /* For fn */
+
+    /* Owned by hrtimer.c */
+    struct hrtimer *next;
+    int queued;
+};
+
+/**
+ * @brief Queues timer to run timer->fn at expires, replacing any earlier
+ * deadline. A deadline that has already passed runs fn before returning.
+ */
+void hrtimer_start(struct hrtimer *timer, uint64_t expires);
+
+/**
+ * @brief Dequeues timer if it has not fired yet.
+ */
+void hrtimer_cancel(struct hrtimer *timer);
+
+/**
+ * @brief Runs expired timers; called from the tick as a fallback for
+ * missing or late one-shot events.
+ */
+void hrtimer_tick(void);
+
+/**
+ * @brief Non-zero when timers fire from one-shot events rather than the tick.
+ */
+int hrtimer_is_highres(void);
+
+#endif
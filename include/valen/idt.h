@@ -23,5 +23,6 @@ struct idt_ptr
 
 void idt_init();
 void idt_set_descriptor(uint8_t vector, void *isr, uint8_t flags);
+void idt_set_ist(uint8_t vector, uint8_t ist);
 
 #endif
\ No newline at end of file
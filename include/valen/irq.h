@@ -0,0 +1,59 @@
+#ifndef IRQ_H
+#define IRQ_H
+
+#include <stdint.h>
+#include <valen/ptrace.h>
+
+/*
+ * Interrupt vectors 0x20-0xFF (kernel/hardware/irq.c). Every vector has a
+ * generated entry stub that records its number in a struct pt_regs and
+ * calls the handler registered for it, timing each call.
+ */
+
+#define FIRST_EXTERNAL_VECTOR 0x20
+#define NR_VECTORS 256
+#define NR_IRQS 16 /* Lines of the two 8259 PICs, vectors 0x20-0x2F */
+
+#define IRQ_VECTOR(irq) (FIRST_EXTERNAL_VECTOR + (irq))
+
+/* The handler uses only its arguments and the caller-saved registers. Its
+ * entry saves rax, rcx, rdx, rsi, rdi and r8-r11; the other pt_regs slots
+ * are left unwritten */
+#define IRQF_LEAF 0x1
+
+typedef void (*irq_handler_t)(struct pt_regs *regs);
+
+/**
+ * @brief Installs the entry stubs of vectors 0x20-0xFF. Called by idt_init().
+ */
+void irq_init(void);
+
+/**
+ * @brief Routes a PIC line to handler, which runs on the IRQ stack and is
+ * followed by the EOI. The line must still be unmasked with pic_irq_enable().
+ * @return 0, or -1 if the line already has a handler.
+ */
+int request_irq(int irq, irq_handler_t handler, int flags, const char *name);
+
+/**
+ * @brief Same as request_irq() for any vector from 0x20 up, e.g. one raised
+ * with 'int'. Only vectors of PIC lines get an EOI.
+ */
+int request_vector(int vector, irq_handler_t handler, int flags, const char *name);
+
+/**
+ * @brief Common C entry of every vector stub (arch/x86_64/interrupts.s).
+ */
+void irq_dispatch(struct pt_regs *regs);
+
+/**
+ * @brief Prints each vector's handler, entry path, count and cycles ('irqstat').
+ */
+void irqstat_dump(void);
+
+/**
+ * @brief Clears the counts and cycle totals.
+ */
+void irqstat_reset(void);
+
+#endif
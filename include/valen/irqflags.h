@@ -0,0 +1,87 @@
+#ifndef IRQFLAGS_H
+#define IRQFLAGS_H
+
+#include <stdint.h>
+
+#define RFLAGS_IF (1ULL << 9)
+
+/* Address of the instruction where the macro is used */
+#define _THIS_IP_                                                                        \
+    ({                                                                                   \
+        __label__ __here;                                                                \
+    __here:                                                                              \
+        (uint64_t) && __here;                                                            \
+    })
+
+static inline uint64_t arch_local_irq_save(void)
+{
+    uint64_t flags;
+    asm volatile("pushfq; pop %0; cli" : "=r"(flags) : : "memory");
+    return flags;
+}
+
+static inline void arch_local_irq_restore(uint64_t flags)
+{
+    asm volatile("push %0; popfq" : : "r"(flags) : "memory", "cc");
+}
+
+#ifdef CONFIG_IRQSOFF_TRACER
+/**
+ * @brief Interrupts were just disabled at ip (kernel/trace/irqsoff.c).
+ */
+void irqsoff_start(uint64_t ip);
+
+/**
+ * @brief Interrupts are about to be enabled again at ip.
+ */
+void irqsoff_stop(uint64_t ip);
+
+/**
+ * @brief Accounts a section that ran with interrupts disabled for cycles,
+ * such as an IRQ handler, attributed to ip.
+ */
+void irqsoff_record(uint64_t ip, uint64_t cycles);
+
+/**
+ * @brief Prints the longest interrupts-off sections by call site ('irqsoff').
+ */
+void irqsoff_dump(void);
+
+/**
+ * @brief Forgets all recorded sections.
+ */
+void irqsoff_reset(void);
+#else
+static inline void irqsoff_start(uint64_t ip) { (void)ip; }
+static inline void irqsoff_stop(uint64_t ip) { (void)ip; }
+static inline void irqsoff_record(uint64_t ip, uint64_t cycles)
+{
+    (void)ip;
+    (void)cycles;
+}
+#endif
+
+/**
+ * @brief Disables interrupts and returns the previous RFLAGS in flags.
+ * With CONFIG_IRQSOFF_TRACER the section is timed from here.
+ */
+#define local_irq_save(flags)                                                            \
+    do                                                                                   \
+    {                                                                                    \
+        (flags) = arch_local_irq_save();                                                 \
+        if ((flags) & RFLAGS_IF)                                                         \
+            irqsoff_start(_THIS_IP_);                                                    \
+    } while (0)
+
+/**
+ * @brief Restores the interrupt flag saved by local_irq_save().
+ */
+#define local_irq_restore(flags)                                                         \
+    do                                                                                   \
+    {                                                                                    \
+        if ((flags) & RFLAGS_IF)                                                         \
+            irqsoff_stop(_THIS_IP_);                                                     \
+        arch_local_irq_restore(flags);                                                   \
+    } while (0)
+
+#endif
@@ -0,0 +1,18 @@
+#ifndef KALLSYMS_H
+#define KALLSYMS_H
+
+#include <stdint.h>
+
+/**
+ * @brief Finds the function containing a code address.
+ * @param offset Set to addr minus the start of the function.
+ * @return The function name, or NULL if addr is not kernel code.
+ */
+const char *kallsyms_lookup(uint64_t addr, uint64_t *offset);
+
+/**
+ * @brief Hash of the symbol table; differs between kernels with different code.
+ */
+uint64_t kallsyms_build_id(void);
+
+#endif
@@ -0,0 +1,127 @@
+#ifndef KASAN_H
+#define KASAN_H
+
+#include <stdint.h>
+
+/*
+ * Kernel address sanitizer. Every 8 bytes of the top 2GB of the address
+ * space (kernel image, direct map, vmm region) have one shadow byte:
+ * 0 means all 8 bytes are accessible, 1-7 only the first n, and the
+ * negative values below mark the granule as poisoned and say why.
+ */
+#define KASAN_START 0xFFFFFFFF80000000ULL
+
+/* The shadow is 1/8 of 2GB, taken from physical memory at 512MB */
+#define KASAN_SHADOW_PHYS 0x20000000ULL
+#define KASAN_SHADOW_SIZE 0x10000000ULL
+
+/*
+ * shadow = (addr >> 3) + KASAN_SHADOW_OFFSET, which puts the shadow of
+ * KASAN_START at the direct mapping of KASAN_SHADOW_PHYS. The Makefile
+ * passes this value to -fasan-shadow-offset, so keep it a plain number.
+ */
+#define KASAN_SHADOW_OFFSET 0xdfffffffb0000000
+
+#define KASAN_GRANULE 8
+
+/* Poison values set by the kernel */
+#define KASAN_PAGE_FREE 0xFF    /* Page given back to the PMM */
+#define KASAN_HEAP_FREE 0xFC    /* Heap space not handed out */
+#define KASAN_HEAP_FREED 0xFB   /* Freed object waiting in the quarantine */
+#define KASAN_HEAP_REDZONE 0xFA /* Block header and padding after an object */
+
+/* Poison values set by compiler-generated code */
+#define KASAN_GLOBAL_REDZONE 0xF9
+#define KASAN_STACK_LEFT 0xF1
+#define KASAN_STACK_MID 0xF2
+#define KASAN_STACK_RIGHT 0xF3
+#define KASAN_STACK_AFTER_RETURN 0xF5
+#define KASAN_STACK_AFTER_SCOPE 0xF8
+#define KASAN_ALLOCA_LEFT 0xCA
+#define KASAN_ALLOCA_RIGHT 0xCB
+
+#ifdef CONFIG_KASAN
+
+/**
+ * @brief Clears the shadow, registers instrumented globals and turns
+ * checking on. Runs once the PMM knows which memory is free.
+ * @param max_phys End of physical RAM; the shadow must fit below it.
+ */
+void kasan_init(uint64_t max_phys);
+
+/**
+ * @brief Marks [addr, addr + size) inaccessible. addr must be 8-byte
+ * aligned; size is rounded up to whole granules.
+ */
+void kasan_poison(const void *addr, uint64_t size, uint8_t value);
+
+/**
+ * @brief Marks [addr, addr + size) accessible. A partial last granule
+ * stays poisoned past size, so off-by-one accesses are caught.
+ */
+void kasan_unpoison(const void *addr, uint64_t size);
+
+/**
+ * @brief Shadow byte for addr, or 0 for addresses outside the shadow.
+ */
+uint8_t kasan_shadow_value(const void *addr);
+
+/**
+ * @brief Reports a bad free() (double free or a pointer the heap never
+ * returned). ip is the caller's return address.
+ */
+void kasan_report_invalid_free(const void *ptr, const char *what, uint64_t ip);
+
+/**
+ * @brief Number of reports since boot, including suppressed ones.
+ */
+uint64_t kasan_report_count(void);
+
+/**
+ * @brief Makes one of each kind of bad access (kernel/debug/kasan_test.c).
+ * @return Number of tests whose report did not show up.
+ */
+int kasan_selftest(void);
+
+#else
+
+static inline void kasan_init(uint64_t max_phys) { (void)max_phys; }
+static inline void kasan_poison(const void *addr, uint64_t size, uint8_t value)
+{
+    (void)addr;
+    (void)size;
+    (void)value;
+}
+static inline void kasan_unpoison(const void *addr, uint64_t size)
+{
+    (void)addr;
+    (void)size;
+}
+static inline uint8_t kasan_shadow_value(const void *addr)
+{
+    (void)addr;
+    return 0;
+}
+static inline void kasan_report_invalid_free(const void *ptr, const char *what, uint64_t ip)
+{
+    (void)ptr;
+    (void)what;
+    (void)ip;
+}
+
+#endif
+
+/**
+ * @brief Tells kmain not to hand the shadow memory to the PMM.
+ */
+static inline int kasan_reserved(uint64_t phys)
+{
+#ifdef CONFIG_KASAN
+    return phys >= KASAN_SHADOW_PHYS && phys < KASAN_SHADOW_PHYS + KASAN_SHADOW_SIZE;
+#else
+    (void)phys;
+    return 0;
+#endif
+}
+
+#endif
@@ -2,6 +2,12 @@
 #define Valen_KERNEL_H
 
 #include <stdint.h>
+#include <stddef.h>
+
+/**
+ * @brief The structure of type that contains member at ptr.
+ */
+#define container_of(ptr, type, member) ((type *)((char *)(ptr) - offsetof(type, member)))
 
 void kmain(unsigned long magic, unsigned long addr);
 
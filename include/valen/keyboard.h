@@ -2,10 +2,12 @@
 #define KEYBOARD_H
 
 #include <stdint.h>
+#include <valen/ptrace.h>
 
 void keyboard_init(void);
-void keyboard_handler(void);
+void keyboard_handler(struct pt_regs *regs);
 void process_pending_key(void);
+int keyboard_pending(void);
 void wait_for_keypress(void);
 
 #endif
@@ -0,0 +1,89 @@
+#ifndef KMEMLEAK_H
+#define KMEMLEAK_H
+
+#include <stdint.h>
+
+/*
+ * Memory leak detector (mm/kmemleak.c). Allocators register their objects;
+ * a scan follows every pointer-sized word of .data, .bss, the live task
+ * stacks and the objects reached from them, and reports what nothing
+ * points to any more.
+ */
+
+#ifdef CONFIG_KMEMLEAK
+
+/**
+ * @brief Starts tracking [ptr, ptr + size). Records the allocating task
+ * and a backtrace that starts at the caller of the allocator.
+ */
+void kmemleak_alloc(const void *ptr, uint64_t size);
+
+/**
+ * @brief Stops tracking the object at ptr. Untracked pointers are ignored.
+ */
+void kmemleak_free(const void *ptr);
+
+/**
+ * @brief Never reports the object at ptr, and scans it like a root.
+ */
+void kmemleak_not_leak(const void *ptr);
+
+/**
+ * @brief Does not scan the object at ptr for references (task stacks,
+ * buffers without pointers). It is still reported when unreferenced.
+ */
+void kmemleak_no_scan(const void *ptr);
+
+/**
+ * @brief Keeps a static area out of the root scan, e.g. an allocator's
+ * own pool whose free space holds stale pointers.
+ */
+void kmemleak_exclude_area(const void *start, uint64_t size);
+
+/**
+ * @brief Starts the periodic scan task (kmemleak_scan_secs).
+ */
+void kmemleak_init(void);
+
+/**
+ * @brief Runs a full scan.
+ * @return Number of leaks not reported by an earlier scan.
+ */
+int kmemleak_scan(void);
+
+/**
+ * @brief Lists the suspected leaks of the last scan, then a summary line
+ * that also goes to COM1 ('kmemleak').
+ */
+void kmemleak_dump(void);
+
+/**
+ * @brief Accepts every current suspect, so later scans only show new leaks.
+ */
+void kmemleak_clear(void);
+
+/**
+ * @brief Leaks a few objects on purpose (kernel/debug/kmemleak_test.c).
+ */
+void kmemleak_selftest(void);
+
+#else
+
+static inline void kmemleak_alloc(const void *ptr, uint64_t size)
+{
+    (void)ptr;
+    (void)size;
+}
+static inline void kmemleak_free(const void *ptr) { (void)ptr; }
+static inline void kmemleak_not_leak(const void *ptr) { (void)ptr; }
+static inline void kmemleak_no_scan(const void *ptr) { (void)ptr; }
+static inline void kmemleak_exclude_area(const void *start, uint64_t size)
+{
+    (void)start;
+    (void)size;
+}
+static inline void kmemleak_init(void) {}
+
+#endif
+
+#endif
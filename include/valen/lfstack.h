@@ -0,0 +1,53 @@
+#ifndef LFSTACK_H
+#define LFSTACK_H
+
+#include <valen/kernel.h>
+#include <stdbool.h>
+
+/*
+ * Lock-free LIFO of intrusive nodes: a Treiber stack (lib/lfstack.c).
+ *
+ * A pop reads top->next and then swings top to it with a CAS. If top
+ * was popped, reused and pushed back in between, a plain pointer CAS
+ * would still succeed and install a stale next (the ABA problem). The
+ * top pointer is therefore paired with a generation count that every
+ * update bumps, and both are swapped together with cmpxchg16b.
+ *
+ * A popping CPU may read ->next of a node another CPU has just popped,
+ * so nodes must stay mapped while any pop can be in flight: keep them
+ * in memory that is never unmapped, like the kernel heap.
+ */
+
+struct lfstack_node
+{
+    struct lfstack_node *next;
+};
+
+struct lfstack
+{
+    struct lfstack_node *top;
+    uint64_t gen;
+} __attribute__((aligned(16)));
+
+#define LFSTACK_INIT {NULL, 0}
+
+#define lfstack_entry(ptr, type, member) container_of(ptr, type, member)
+
+void lfstack_push(struct lfstack *stack, struct lfstack_node *node);
+
+/** @brief The most recently pushed node, or NULL when empty. */
+struct lfstack_node *lfstack_pop(struct lfstack *stack);
+
+/**
+ * @brief Takes every node at once and returns the chain, newest first,
+ * linked through ->next. Suits batching: producers push, one consumer
+ * drains.
+ */
+struct lfstack_node *lfstack_pop_all(struct lfstack *stack);
+
+static inline bool lfstack_empty(const struct lfstack *stack)
+{
+    return __atomic_load_n(&stack->top, __ATOMIC_RELAXED) == NULL;
+}
+
+#endif
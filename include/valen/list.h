@@ -0,0 +1,207 @@
+#ifndef LIST_H
+#define LIST_H
+
+#include <valen/kernel.h>
+
+/*
+ * Intrusive doubly linked lists. A struct list_head is embedded in each
+ * element and the list itself is a struct list_head sentinel, so adding
+ * and removing never allocates and an element can sit on several lists
+ * at once. Same interface as the Linux one.
+ *
+ * hlist is the singly headed variant for hash buckets: the head is one
+ * pointer, half the size of a list_head.
+ */
+
+struct list_head
+{
+    struct list_head *next;
+    struct list_head *prev;
+};
+
+#define LIST_HEAD_INIT(name) {&(name), &(name)}
+#define LIST_HEAD(name) struct list_head name = LIST_HEAD_INIT(name)
+
+static inline void INIT_LIST_HEAD(struct list_head *list)
+{
+    list->next = list;
+    list->prev = list;
+}
+
+static inline void __list_add(struct list_head *entry, struct list_head *prev,
+                              struct list_head *next)
+{
+    next->prev = entry;
+    entry->next = next;
+    entry->prev = prev;
+    prev->next = entry;
+}
+
+/**
+ * @brief Inserts entry right after head (stack order).
+ */
+static inline void list_add(struct list_head *entry, struct list_head *head)
+{
+    __list_add(entry, head, head->next);
+}
+
+/**
+ * @brief Inserts entry right before head, at the end of the list (queue order).
+ */
+static inline void list_add_tail(struct list_head *entry, struct list_head *head)
+{
+    __list_add(entry, head->prev, head);
+}
+
+static inline void __list_del(struct list_head *prev, struct list_head *next)
+{
+    next->prev = prev;
+    prev->next = next;
+}
+
+/**
+ * @brief Unlinks entry. Its pointers are cleared, so a stale walk faults
+ * instead of silently following the old neighbours.
+ */
+static inline void list_del(struct list_head *entry)
+{
+    __list_del(entry->prev, entry->next);
+    entry->next = NULL;
+    entry->prev = NULL;
+}
+
+/**
+ * @brief Unlinks entry and leaves it an empty list, so list_empty() on
+ * it tells whether it is linked.
+ */
+static inline void list_del_init(struct list_head *entry)
+{
+    __list_del(entry->prev, entry->next);
+    INIT_LIST_HEAD(entry);
+}
+
+static inline void list_move(struct list_head *entry, struct list_head *head)
+{
+    __list_del(entry->prev, entry->next);
+    list_add(entry, head);
+}
+
+static inline void list_move_tail(struct list_head *entry, struct list_head *head)
+{
+    __list_del(entry->prev, entry->next);
+    list_add_tail(entry, head);
+}
+
+static inline int list_empty(const struct list_head *head)
+{
+    return head->next == head;
+}
+
+static inline int list_is_singular(const struct list_head *head)
+{
+    return !list_empty(head) && head->next == head->prev;
+}
+
+/**
+ * @brief Moves every element of list to the front of head; list is left empty.
+ */
+static inline void list_splice_init(struct list_head *list, struct list_head *head)
+{
+    if (list_empty(list))
+        return;
+
+    struct list_head *first = list->next;
+    struct list_head *last = list->prev;
+
+    first->prev = head;
+    last->next = head->next;
+    head->next->prev = last;
+    head->next = first;
+    INIT_LIST_HEAD(list);
+}
+
+#define list_entry(ptr, type, member) container_of(ptr, type, member)
+#define list_first_entry(head, type, member) list_entry((head)->next, type, member)
+#define list_last_entry(head, type, member) list_entry((head)->prev, type, member)
+#define list_next_entry(pos, member) list_entry((pos)->member.next, __typeof__(*(pos)), member)
+#define list_prev_entry(pos, member) list_entry((pos)->member.prev, __typeof__(*(pos)), member)
+
+#define list_for_each(pos, head) for (pos = (head)->next; pos != (head); pos = pos->next)
+
+#define list_for_each_entry(pos, head, member)                                             \
+    for (pos = list_first_entry(head, __typeof__(*pos), member); &pos->member != (head);   \
+         pos = list_next_entry(pos, member))
+
+#define list_for_each_entry_reverse(pos, head, member)                                     \
+    for (pos = list_last_entry(head, __typeof__(*pos), member); &pos->member != (head);    \
+         pos = list_prev_entry(pos, member))
+
+/**
+ * @brief Like list_for_each_entry(), but pos may be removed inside the loop.
+ */
+#define list_for_each_entry_safe(pos, n, head, member)                                     \
+    for (pos = list_first_entry(head, __typeof__(*pos), member),                           \
+        n = list_next_entry(pos, member);                                                  \
+         &pos->member != (head); pos = n, n = list_next_entry(n, member))
+
+/* --- hlist --- */
+
+struct hlist_node
+{
+    struct hlist_node *next;
+    struct hlist_node **pprev; /* The pointer that points at this node */
+};
+
+struct hlist_head
+{
+    struct hlist_node *first;
+};
+
+#define HLIST_HEAD_INIT {NULL}
+
+static inline void INIT_HLIST_NODE(struct hlist_node *node)
+{
+    node->next = NULL;
+    node->pprev = NULL;
+}
+
+static inline int hlist_empty(const struct hlist_head *head)
+{
+    return !head->first;
+}
+
+static inline int hlist_unhashed(const struct hlist_node *node)
+{
+    return !node->pprev;
+}
+
+static inline void hlist_add_head(struct hlist_node *node, struct hlist_head *head)
+{
+    node->next = head->first;
+    if (head->first)
+        head->first->pprev = &node->next;
+    head->first = node;
+    node->pprev = &head->first;
+}
+
+static inline void hlist_del_init(struct hlist_node *node)
+{
+    if (hlist_unhashed(node))
+        return;
+    *node->pprev = node->next;
+    if (node->next)
+        node->next->pprev = node->pprev;
+    INIT_HLIST_NODE(node);
+}
+
+#define hlist_entry(ptr, type, member) container_of(ptr, type, member)
+
+#define hlist_for_each(pos, head) for (pos = (head)->first; pos; pos = pos->next)
+
+/**
+ * @brief pos may be removed inside the loop.
+ */
+#define hlist_for_each_safe(pos, n, head)                                                  \
+    for (pos = (head)->first; pos && (n = pos->next, 1); pos = n)
+
+#endif
@@ -0,0 +1,50 @@
+#ifndef LZ4_H
+#define LZ4_H
+
+#include <stdint.h>
+
+/*
+ * LZ4 block compression (lib/lz4.c), in the reference block format, so
+ * blocks written here decompress with liblz4 and the other way round.
+ * Neither direction allocates: the compressor hashes into a
+ * LZ4_MEM_COMPRESS-byte work area from the caller, and the decompressor
+ * writes straight into the output buffer.
+ *
+ * Block only: there is no frame header, checksum or stored length. The
+ * caller keeps the compressed and original sizes next to the data.
+ */
+
+/* log2 of the compressor's hash table entries */
+#define LZ4_HASHLOG 12
+
+/** @brief Bytes of work area lz4_compress() needs. */
+#define LZ4_MEM_COMPRESS ((1 << LZ4_HASHLOG) * sizeof(uint32_t))
+
+/* Largest input the format can describe */
+#define LZ4_MAX_INPUT_SIZE 0x7E000000ULL
+
+/** @brief Worst-case compressed size of n bytes (incompressible input). */
+#define LZ4_COMPRESS_BOUND(n) ((n) + (n) / 255 + 16)
+
+/**
+ * @brief Compresses src_len bytes of src into dst.
+ *
+ * @param wrkmem LZ4_MEM_COMPRESS bytes, any contents, 4-byte aligned.
+ * @return Compressed size, or 0 if it would not fit in dst_cap (never the
+ * case when dst_cap >= LZ4_COMPRESS_BOUND(src_len)) or src_len is too big.
+ */
+uint64_t lz4_compress(const void *src, uint64_t src_len, void *dst, uint64_t dst_cap,
+                      void *wrkmem);
+
+/**
+ * @brief Decompresses the src_len-byte block at src into dst.
+ *
+ * Safe on any input: a corrupt or truncated block never reads outside src
+ * or writes outside dst.
+ *
+ * @return Decompressed size, or -1 if the block is malformed or its output
+ * does not fit in dst_cap.
+ */
+int64_t lz4_decompress(const void *src, uint64_t src_len, void *dst, uint64_t dst_cap);
+
+#endif
@@ -0,0 +1,54 @@
+#ifndef MIN_HEAP_H
+#define MIN_HEAP_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * Binary min-heap over a caller-provided array (lib/min_heap.c). Elements
+ * are copied in and out by value, elem_size bytes each; less() orders
+ * them. Push and pop are O(log n), the minimum is at data[0].
+ */
+
+struct min_heap
+{
+    void *data;
+    int nr;
+    int size;
+    uint64_t elem_size;
+    bool (*less)(const void *a, const void *b);
+};
+
+/**
+ * @brief Sets up an empty heap over data, which holds size elements.
+ */
+void min_heap_init(struct min_heap *heap, void *data, int size, uint64_t elem_size,
+                   bool (*less)(const void *a, const void *b));
+
+/**
+ * @brief Restores heap order after the caller filled data[0..nr) directly. O(n).
+ */
+void min_heap_heapify(struct min_heap *heap);
+
+/**
+ * @brief Copies elem in. Returns 0, or -1 when the heap is full.
+ */
+int min_heap_push(struct min_heap *heap, const void *elem);
+
+/**
+ * @brief Copies the minimum to out (may be NULL) and removes it. Returns
+ * 0, or -1 when the heap is empty.
+ */
+int min_heap_pop(struct min_heap *heap, void *out);
+
+/**
+ * @brief Replaces the minimum with elem: one sift instead of a pop and a push.
+ */
+void min_heap_pop_push(struct min_heap *heap, const void *elem);
+
+static inline void *min_heap_peek(const struct min_heap *heap)
+{
+    return heap->nr ? heap->data : (void *)0;
+}
+
+#endif
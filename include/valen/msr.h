@@ -0,0 +1,29 @@
+#ifndef MSR_H
+#define MSR_H
+
+#include <stdint.h>
+
+#define MSR_IA32_APIC_BASE 0x1B
+#define MSR_IA32_PAT 0x277
+#define MSR_EFER 0xC0000080
+#define MSR_GS_BASE 0xC0000101
+
+/**
+ * @brief Reads a model-specific register.
+ */
+static inline uint64_t rdmsr(uint32_t msr)
+{
+    uint32_t lo, hi;
+    asm volatile("rdmsr" : "=a"(lo), "=d"(hi) : "c"(msr));
+    return ((uint64_t)hi << 32) | lo;
+}
+
+/**
+ * @brief Writes a model-specific register.
+ */
+static inline void wrmsr(uint32_t msr, uint64_t value)
+{
+    asm volatile("wrmsr" : : "c"(msr), "a"((uint32_t)value), "d"((uint32_t)(value >> 32)) : "memory");
+}
+
+#endif
@@ -5,7 +5,10 @@
 
 #define MULTIBOOT2_BOOTLOADER_MAGIC 0x36d76289
 #define MULTIBOOT_TAG_TYPE_END 0
+#define MULTIBOOT_TAG_TYPE_CMDLINE 1
 #define MULTIBOOT_TAG_TYPE_MMAP 6
+#define MULTIBOOT_TAG_TYPE_ACPI_OLD 14
+#define MULTIBOOT_TAG_TYPE_ACPI_NEW 15
 #define MULTIBOOT_MEMORY_AVAILABLE 1
 #define MULTIBOOT_MEMORY_RESERVED 2
 #define MULTIBOOT_MEMORY_ACPI_RECLAIM 3
@@ -18,6 +21,13 @@ struct multiboot_tag
     uint32_t size;
 } __attribute__((packed));
 
+struct multiboot_tag_string
+{
+    uint32_t type;
+    uint32_t size;
+    char string[];
+} __attribute__((packed));
+
 struct multiboot_mmap_entry
 {
     uint64_t addr;
@@ -35,4 +45,12 @@ struct multiboot_tag_mmap
     struct multiboot_mmap_entry entries[];
 } __attribute__((packed));
 
+/* Copy of the ACPI RSDP: version 1.0 (ACPI_OLD) or 2.0+ (ACPI_NEW) */
+struct multiboot_tag_acpi
+{
+    uint32_t type;
+    uint32_t size;
+    uint8_t rsdp[];
+} __attribute__((packed));
+
 #endif
@@ -0,0 +1,81 @@
+#ifndef NUMA_H
+#define NUMA_H
+
+#include <stdint.h>
+
+/*
+ * NUMA topology (mm/numa.c). Nodes are numbered 0..numa_node_count()-1 in
+ * the order the SRAT lists them; numa_node_pxm() gives the firmware's
+ * proximity domain back. Without CONFIG_NUMA, or without an SRAT, all of
+ * memory and every CPU belong to node 0.
+ */
+
+#ifdef CONFIG_NUMA
+#define MAX_NUMNODES 8
+#else
+#define MAX_NUMNODES 1
+#endif
+
+#define NUMA_NO_NODE (-1)
+
+/* Where a task's pages come from (numa_set_policy()) */
+#define NUMA_POLICY_LOCAL 0      /* The task's home node, nearest other node when full */
+#define NUMA_POLICY_INTERLEAVE 1 /* Round robin over all nodes, page by page */
+
+#ifdef CONFIG_NUMA
+
+/**
+ * @brief Builds the nodes from the ACPI SRAT and SLIT and hands their
+ * memory ranges and fallback order to the PMM. Runs after acpi_init().
+ */
+void numa_init(void);
+
+/**
+ * @brief Number of nodes with memory, at least 1.
+ */
+int numa_node_count(void);
+
+/**
+ * @brief Node of the CPU running this code.
+ */
+int numa_cpu_node(void);
+
+/**
+ * @brief Node the next page allocation should come from, following the
+ * current task's policy. Called by the PMM for every allocation.
+ */
+int numa_mem_node(void);
+
+/**
+ * @brief Next node in the interleave rotation.
+ */
+int numa_interleave_node(void);
+
+/**
+ * @brief SLIT distance between two nodes (10 is local).
+ */
+int numa_distance(int from, int to);
+
+/**
+ * @brief Sets the current task's memory policy (NUMA_POLICY_*).
+ */
+void numa_set_policy(int policy);
+
+/**
+ * @brief Prints nodes, distances and task placement ('numa' shell command).
+ */
+void numa_dump(void);
+
+#else
+
+static inline void numa_init(void) {}
+static inline int numa_node_count(void) { return 1; }
+static inline int numa_cpu_node(void) { return 0; }
+static inline int numa_mem_node(void) { return 0; }
+static inline int numa_interleave_node(void) { return 0; }
+static inline int numa_distance(int from, int to) { return from == to ? 10 : 20; }
+static inline void numa_set_policy(int policy) { (void)policy; }
+
+#endif
+
+#endif
@@ -9,10 +9,12 @@
 #define PAGE_PWT (1ULL << 3) // Page Write-Through
 #define PAGE_PCD (1ULL << 4)  // Page-level Cache Disable
 #define PAGE_HUGE (1ULL << 7) /* PS bit for 2MB/1GB pages */
+#define PAGE_PAT (1ULL << 7)  /* PAT index bit in 4KB PTEs (the PS bit elsewhere) */
 
 void paging_init();
 void paging_map(uint64_t virt, uint64_t phys, uint64_t flags);
 void paging_map_range(uint64_t virt, uint64_t phys, uint64_t size, uint64_t flags);
 void paging_map_page(uint64_t virt, uint64_t phys, uint64_t flags);
+uint64_t paging_unmap(uint64_t virt);
 
 #endif
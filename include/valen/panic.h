@@ -1,6 +1,47 @@
 #ifndef PANIC_H
 #define PANIC_H
 
-void page_fault_handler(uint64_t error_code);
+#include <stdint.h>
+#include <valen/ptrace.h>
 
-#endif
\ No newline at end of file
+/**
+ * @brief C entry point for CPU exceptions 0-31 (arch/x86_64/exceptions.s).
+ * Everything except NMI is fatal and ends in a crash dump, unless the GDB
+ * stub handles it; the stub's COM2 interrupt arrives here as well.
+ */
+void exception_handler(struct pt_regs *regs);
+
+/**
+ * @brief Stops the system with a crash dump of the calling context.
+ */
+void panic(const char *format, ...) __attribute__((noreturn, format(printf, 1, 2)));
+
+/**
+ * @brief printf to COM1 without taking any lock, for crash paths where the
+ * console lock may be held by the code that crashed.
+ */
+void crash_printf(const char *format, ...) __attribute__((format(printf, 1, 2)));
+
+/**
+ * @brief Writes a one-line notice over the bottom VGA row without the
+ * console lock, so it shows even when the lock holder is stuck.
+ */
+void crash_notice(const char *format, ...) __attribute__((format(printf, 1, 2)));
+
+/**
+ * @brief Prints the registers of regs and the control registers to COM1.
+ */
+void show_regs(struct pt_regs *regs);
+
+/**
+ * @brief Collects a frame-pointer backtrace: rip first, then return addresses.
+ * @return Number of entries written to frames.
+ */
+int backtrace_collect(uint64_t rip, uint64_t rbp, uint64_t *frames, int max);
+
+/**
+ * @brief Prints a frame-pointer backtrace starting at the given frame.
+ */
+void dump_backtrace(uint64_t rip, uint64_t rbp, void (*out)(const char *format, ...));
+
+#endif
@@ -0,0 +1,90 @@
+#ifndef PARAM_H
+#define PARAM_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+typedef enum param_type
+{
+    PARAM_INT,
+    PARAM_BOOL,
+    PARAM_STRING,
+} param_type_t;
+
+/* Only settable from the kernel command line, read-only for sysctl */
+#define PARAM_BOOT_ONLY 0x1
+
+/**
+ * @brief A named tunable. Instances are emitted into the .params section
+ * by the param_* macros below and found by walking that section; there is
+ * no registration call.
+ */
+typedef struct kernel_param
+{
+    const char *name;
+    param_type_t type;
+    void *value;     /* int *, bool * or char[len] */
+    uint64_t len;    /* PARAM_STRING buffer size */
+    long min;        /* PARAM_INT bounds, inclusive */
+    long max;
+    uint32_t flags;
+    void (*notify)(const struct kernel_param *param); /* After a runtime change */
+    const char *help;
+} kernel_param_t;
+
+#define __param(name_, type_, ptr_, len_, min_, max_, flags_, notify_, help_)        \
+    static const kernel_param_t __param_##name_                                      \
+        __attribute__((used, section(".params"), aligned(8))) = {                    \
+            #name_, type_, ptr_, len_, min_, max_, flags_, notify_, help_}
+
+/** @brief int tunable accepting any value in [min, max]. */
+#define param_int(name, var, min, max, help) \
+    __param(name, PARAM_INT, &(var), 0, min, max, 0, 0, help)
+
+/** @brief int tunable with a hook run after sysctl changes it. */
+#define param_int_notify(name, var, min, max, notify, help) \
+    __param(name, PARAM_INT, &(var), 0, min, max, 0, notify, help)
+
+/** @brief bool tunable; a bare "name" on the command line sets it. */
+#define param_bool(name, var, help) \
+    __param(name, PARAM_BOOL, &(var), 0, 0, 1, 0, 0, help)
+
+/** @brief String tunable copied into a char array (truncated to fit). */
+#define param_string(name, buf, flags, help) \
+    __param(name, PARAM_STRING, buf, sizeof(buf), 0, 0, flags, 0, help)
+
+/** @brief String tunable with a hook run after sysctl changes it. */
+#define param_string_notify(name, buf, flags, notify, help) \
+    __param(name, PARAM_STRING, buf, sizeof(buf), 0, 0, flags, notify, help)
+
+extern const kernel_param_t _params_start[];
+extern const kernel_param_t _params_end[];
+
+#define for_each_param(p) for (const kernel_param_t *p = _params_start; p < _params_end; p++)
+
+/**
+ * @brief Applies every "name=value" (or bare "name") on the command line.
+ * Unknown names and invalid values are reported on COM1 and skipped.
+ */
+void param_parse_cmdline(const char *cmdline);
+
+/**
+ * @brief Looks up a tunable by name.
+ * @return The parameter, or NULL if none has that name.
+ */
+const kernel_param_t *param_find(const char *name);
+
+/**
+ * @brief Parses and stores a new value.
+ * @param runtime Set for sysctl: rejects PARAM_BOOT_ONLY and runs notify.
+ * @return 0 on success, -1 if the value is invalid or out of range,
+ * -2 if the parameter is read-only at runtime.
+ */
+int param_set(const kernel_param_t *param, const char *value, int runtime);
+
+/**
+ * @brief Formats the current value into buf.
+ */
+void param_format(const kernel_param_t *param, char *buf, uint64_t len);
+
+#endif
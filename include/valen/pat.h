@@ -0,0 +1,67 @@
+#ifndef PAT_H
+#define PAT_H
+
+#include <stdint.h>
+
+/*
+ * Page Attribute Table (mm/pat.c). Memory types for kernel mappings and
+ * the PTE bits that select them. The PAT is reprogrammed so that entries
+ * 0, 2 and 3 keep their power-on meaning (WB, UC-, UC) and entry 1, which
+ * is WT at power-on, becomes WC:
+ *
+ *   PAT PCD PWT  index  type
+ *    0   0   0     0    WB
+ *    0   0   1     1    WC
+ *    0   1   0     2    UC-
+ *    0   1   1     3    UC
+ *    1   0   1     5    WP
+ *    1   1   1     7    WT
+ */
+
+enum page_cache
+{
+    PAGE_CACHE_WB,       /* Write-back: RAM */
+    PAGE_CACHE_WC,       /* Write-combining: framebuffers, streaming writes */
+    PAGE_CACHE_UC_MINUS, /* Uncached, an MTRR can still make it WC */
+    PAGE_CACHE_UC,       /* Uncached: device registers */
+    PAGE_CACHE_WT,       /* Write-through: reads cached, writes go straight out */
+    PAGE_CACHE_WP,       /* Write-protect: reads cached, writes uncached; only decoded */
+};
+
+/**
+ * @brief Programs the PAT MSR (when the CPU has one). Runs from
+ * vmm_init(), before any non-WB mapping exists.
+ */
+void pat_init(void);
+
+/**
+ * @brief PTE bits (PAGE_PWT/PCD/PAT) that select a memory type in a 4KB
+ * page. Without PAT, WC degrades to UC-.
+ */
+uint64_t pat_cache_flags(enum page_cache type);
+
+/**
+ * @brief Memory type a 4KB PTE's PWT/PCD/PAT bits select.
+ */
+enum page_cache pat_flags_cache(uint64_t flags);
+
+/**
+ * @brief Records that the PHYSICAL range [start, end) is mapped with type.
+ * Mapping one frame with two types is undefined behaviour on x86, so this
+ * fails if part of the range is already mapped with another type, or is
+ * RAM in the write-back direct map and type is not WB.
+ * @return 0, or -1 on a conflict.
+ */
+int memtype_reserve(uint64_t start, uint64_t end, enum page_cache type);
+
+/**
+ * @brief Short name of a memory type ("WB", "WC", ...).
+ */
+const char *pat_cache_name(enum page_cache type);
+
+/**
+ * @brief Prints the PAT entries and the reserved ranges ('pat').
+ */
+void pat_dump(void);
+
+#endif
@@ -0,0 +1,78 @@
+#ifndef PERCPU_COUNTER_H
+#define PERCPU_COUNTER_H
+
+#include <stdint.h>
+#include <valen/smp.h>
+
+/*
+ * Per-CPU counters (lib/percpu_counter.c) for statistics updated on hot
+ * paths. Each CPU adds into its own cache line with one unlocked
+ * instruction, which is atomic against interrupts on that CPU and never
+ * pulls the line from another cache. Once a CPU's delta reaches the
+ * batch it is folded into the shared total, so the total is off by at
+ * most batch * NR_CPUS at any time.
+ *
+ * percpu_counter_read() returns the total alone, in O(1).
+ * percpu_counter_sum() adds every CPU's delta for an exact figure.
+ */
+
+#define PERCPU_COUNTER_BATCH 32
+
+struct percpu_counter_cpu
+{
+    int64_t delta;
+} __cacheline_aligned;
+
+struct percpu_counter
+{
+    int64_t count; /* Folded total */
+    int32_t batch;
+    struct percpu_counter_cpu cpu[NR_CPUS];
+} __cacheline_aligned;
+
+/**
+ * @brief Starts the counter at value. batch <= 0 picks PERCPU_COUNTER_BATCH.
+ */
+void percpu_counter_init(struct percpu_counter *c, int64_t value, int32_t batch);
+
+/** @brief Folds one CPU's delta into the total; the slow path of add. */
+void percpu_counter_fold(struct percpu_counter *c, int cpu);
+
+/**
+ * @brief Sets the counter to value. Not atomic against concurrent adds.
+ */
+void percpu_counter_set(struct percpu_counter *c, int64_t value);
+
+/** @brief Total plus every CPU's delta. */
+int64_t percpu_counter_sum(struct percpu_counter *c);
+
+static inline void percpu_counter_add(struct percpu_counter *c, int64_t amount)
+{
+    int cpu = smp_processor_id();
+    int64_t *delta = &c->cpu[cpu].delta;
+
+    /* No lock prefix: only this CPU writes its slot, and one instruction
+     * cannot be split by an interrupt */
+    asm volatile("addq %1, %0" : "+m"(*delta) : "er"(amount));
+    int64_t d = __atomic_load_n(delta, __ATOMIC_RELAXED);
+    if (d >= c->batch || d <= -c->batch)
+        percpu_counter_fold(c, cpu);
+}
+
+static inline void percpu_counter_inc(struct percpu_counter *c)
+{
+    percpu_counter_add(c, 1);
+}
+
+static inline void percpu_counter_dec(struct percpu_counter *c)
+{
+    percpu_counter_add(c, -1);
+}
+
+/** @brief The folded total: cheap, approximate. */
+static inline int64_t percpu_counter_read(const struct percpu_counter *c)
+{
+    return __atomic_load_n(&c->count, __ATOMIC_RELAXED);
+}
+
+#endif
@@ -9,4 +9,15 @@
  */
 void pit_init(uint32_t frequency);
 
+/**
+ * @brief Current timer frequency in Hz (the pit_hz parameter)
+ */
+uint32_t pit_get_hz(void);
+
+/**
+ * @brief Measures the TSC frequency over 10ms with PIT channel 2
+ * @return TSC frequency in kHz
+ */
+uint64_t pit_calibrate_tsc(void);
+
 #endif
@@ -9,9 +9,48 @@ void pmm_mark_used(uintptr_t addr);
 void *pmm_alloc_page();
 void *pmm_alloc_pages(uint64_t count);
 void pmm_free_page(void *addr);
+uint64_t pmm_usage_map(uint16_t *used, uint64_t chunks);
 
 uint64_t pmm_get_total_kb();
 uint64_t pmm_get_used_kb();
 uint64_t pmm_get_free_kb();
 
+/**
+ * @brief Allocates count contiguous pages, preferring the given node and
+ * falling back to the others in its fallback order. pmm_alloc_pages() is
+ * this with numa_mem_node().
+ * @return Direct-map address, or NULL. Only RAM below 1GB qualifies.
+ */
+void *pmm_alloc_pages_node(uint64_t count, int node);
+
+/**
+ * @brief Allocates one frame anywhere in RAM, preferring the given node.
+ * For callers that map the frame themselves (vmm_alloc_interleave()).
+ * @return PHYSICAL address, or 0.
+ */
+uint64_t pmm_alloc_frame_node(int node);
+
+/**
+ * @brief Assigns the PHYSICAL range [start, end) to a node. The first call
+ * replaces the single boot-time node that covers all of RAM.
+ * @return 0, or -1 if the range is outside RAM or the table is full.
+ */
+int pmm_add_node_range(int node, uint64_t start, uint64_t end);
+
+/**
+ * @brief Order in which nodes are tried when node runs out, nearest
+ * first. The list should start with node itself.
+ */
+void pmm_set_node_fallback(int node, const int *order, int count);
+
+/**
+ * @brief Node of the frame at a PHYSICAL address, or -1 if no node has it.
+ */
+int pmm_page_node(uint64_t phys);
+
+/**
+ * @brief Frames assigned to the node and how many of them are free.
+ */
+void pmm_node_usage(int node, uint64_t *total_kb, uint64_t *free_kb);
+
 #endif
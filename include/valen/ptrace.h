@@ -0,0 +1,40 @@
+#ifndef PTRACE_H
+#define PTRACE_H
+
+#include <stdint.h>
+
+/**
+ * @brief Register frame built by the exception stubs (arch/x86_64/exceptions.s).
+ *
+ * Laid out in stack order: the general purpose registers pushed by the
+ * stub, the vector and error code (0 for exceptions without one), then the
+ * frame pushed by the CPU.
+ */
+struct pt_regs
+{
+    uint64_t r15;
+    uint64_t r14;
+    uint64_t r13;
+    uint64_t r12;
+    uint64_t r11;
+    uint64_t r10;
+    uint64_t r9;
+    uint64_t r8;
+    uint64_t rbp;
+    uint64_t rdi;
+    uint64_t rsi;
+    uint64_t rdx;
+    uint64_t rcx;
+    uint64_t rbx;
+    uint64_t rax;
+    uint64_t vector;
+    uint64_t error_code;
+    /* Pushed by the CPU */
+    uint64_t rip;
+    uint64_t cs;
+    uint64_t rflags;
+    uint64_t rsp;
+    uint64_t ss;
+};
+
+#endif
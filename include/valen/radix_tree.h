@@ -0,0 +1,65 @@
+#ifndef RADIX_TREE_H
+#define RADIX_TREE_H
+
+#include <stdint.h>
+
+/*
+ * Radix tree mapping a 64-bit index to a pointer (lib/radix_tree.c), for
+ * sparse arrays such as a page cache indexed by file page number. Each
+ * level resolves RADIX_TREE_MAP_SHIFT bits of the index, so a lookup is
+ * a few dependent loads and dense ranges share their interior nodes. The
+ * tree is only as tall as its largest index needs.
+ *
+ * There is no internal locking; callers serialise updates. Lookups may
+ * run alongside other lookups.
+ */
+
+#define RADIX_TREE_MAP_SHIFT 6
+#define RADIX_TREE_MAP_SIZE (1 << RADIX_TREE_MAP_SHIFT)
+
+struct radix_tree_node
+{
+    uint32_t count; /* Non-NULL slots */
+    void *slots[RADIX_TREE_MAP_SIZE];
+};
+
+struct radix_tree_root
+{
+    struct radix_tree_node *node;
+    uint32_t height; /* Levels below the root pointer; 0 when empty */
+    uint64_t items;
+};
+
+#define RADIX_TREE_INIT {NULL, 0, 0}
+
+/**
+ * @brief Stores item (non-NULL) at index. Returns 0, -1 when a node
+ * cannot be allocated, or -2 if index is already occupied.
+ */
+int radix_tree_insert(struct radix_tree_root *root, uint64_t index, void *item);
+
+/**
+ * @brief The item at index, or NULL.
+ */
+void *radix_tree_lookup(const struct radix_tree_root *root, uint64_t index);
+
+/**
+ * @brief Removes and returns the item at index (NULL if none), freeing
+ * nodes that become empty and lowering the tree when it can.
+ */
+void *radix_tree_delete(struct radix_tree_root *root, uint64_t index);
+
+/**
+ * @brief Copies up to max items with index >= first into results, in
+ * index order, and their indices into indices (may be NULL). Returns the
+ * number found.
+ */
+int radix_tree_gang_lookup(const struct radix_tree_root *root, void **results,
+                           uint64_t *indices, uint64_t first, int max);
+
+/**
+ * @brief Frees every node; the items belong to the caller.
+ */
+void radix_tree_destroy(struct radix_tree_root *root);
+
+#endif
@@ -0,0 +1,258 @@
+#ifndef RBTREE_H
+#define RBTREE_H
+
+#include <valen/kernel.h>
+#include <stdbool.h>
+
+/*
+ * Intrusive red-black trees (lib/rbtree.c), with the Linux interface.
+ * The caller walks down to the insertion point itself, so comparisons
+ * are inlined and no callback runs per level:
+ *
+ *     struct rb_node **link = &root->rb_node, *parent = NULL;
+ *     while (*link) {
+ *         parent = *link;
+ *         link = key < rb_entry(parent, struct thing, node)->key
+ *                ? &parent->rb_left : &parent->rb_right;
+ *     }
+ *     rb_link_node(&thing->node, parent, link);
+ *     rb_insert_color(&thing->node, root);
+ *
+ * rb_add() and rb_find() do the same with a comparison function.
+ *
+ * Augmented trees keep a value per node that summarises its subtree (the
+ * largest interval end, the smallest deadline, ...). The tree calls back
+ * into the user on every rotation so the value stays correct in O(log n).
+ */
+
+struct rb_node
+{
+    uintptr_t __rb_parent_color; /* Parent pointer, colour in bit 0 */
+    struct rb_node *rb_right;
+    struct rb_node *rb_left;
+} __attribute__((aligned(sizeof(long))));
+
+struct rb_root
+{
+    struct rb_node *rb_node;
+};
+
+/**
+ * @brief A tree that also remembers its leftmost node, so the minimum is
+ * found in O(1) (a scheduler's next task, a timer queue's next expiry).
+ */
+struct rb_root_cached
+{
+    struct rb_root rb_root;
+    struct rb_node *rb_leftmost;
+};
+
+#define RB_ROOT {NULL}
+#define RB_ROOT_CACHED {{NULL}, NULL}
+
+#define rb_parent(r) ((struct rb_node *)((r)->__rb_parent_color & ~3UL))
+#define rb_entry(ptr, type, member) container_of(ptr, type, member)
+#define rb_entry_safe(ptr, type, member)                                                   \
+    ({                                                                                     \
+        __typeof__(ptr) ____ptr = (ptr);                                                   \
+        ____ptr ? rb_entry(____ptr, type, member) : NULL;                                  \
+    })
+
+#define RB_EMPTY_ROOT(root) ((root)->rb_node == NULL)
+
+/* A node that is on no tree points at itself */
+#define RB_EMPTY_NODE(node) ((node)->__rb_parent_color == (uintptr_t)(node))
+#define RB_CLEAR_NODE(node) ((node)->__rb_parent_color = (uintptr_t)(node))
+
+void rb_insert_color(struct rb_node *node, struct rb_root *root);
+void rb_erase(struct rb_node *node, struct rb_root *root);
+
+struct rb_node *rb_first(const struct rb_root *root);
+struct rb_node *rb_last(const struct rb_root *root);
+struct rb_node *rb_next(const struct rb_node *node);
+struct rb_node *rb_prev(const struct rb_node *node);
+
+/**
+ * @brief Puts new in victim's place without rebalancing; both must sort
+ * to the same position.
+ */
+void rb_replace_node(struct rb_node *victim, struct rb_node *new, struct rb_root *root);
+
+/**
+ * @brief Links node below parent at *link, as a red leaf. Follow with
+ * rb_insert_color() (or the augmented/cached variant).
+ */
+static inline void rb_link_node(struct rb_node *node, struct rb_node *parent,
+                                struct rb_node **link)
+{
+    node->__rb_parent_color = (uintptr_t)parent;
+    node->rb_left = node->rb_right = NULL;
+    *link = node;
+}
+
+/* --- Cached leftmost --- */
+
+static inline void rb_insert_color_cached(struct rb_node *node, struct rb_root_cached *root,
+                                          bool leftmost)
+{
+    if (leftmost)
+        root->rb_leftmost = node;
+    rb_insert_color(node, &root->rb_root);
+}
+
+static inline void rb_erase_cached(struct rb_node *node, struct rb_root_cached *root)
+{
+    if (root->rb_leftmost == node)
+        root->rb_leftmost = rb_next(node);
+    rb_erase(node, &root->rb_root);
+}
+
+#define rb_first_cached(root) ((root)->rb_leftmost)
+
+/* --- Comparison-function helpers --- */
+
+/**
+ * @brief Inserts node in order of less(); equal nodes go after existing ones.
+ */
+static inline void rb_add(struct rb_node *node, struct rb_root *tree,
+                          bool (*less)(struct rb_node *, const struct rb_node *))
+{
+    struct rb_node **link = &tree->rb_node;
+    struct rb_node *parent = NULL;
+
+    while (*link)
+    {
+        parent = *link;
+        link = less(node, parent) ? &parent->rb_left : &parent->rb_right;
+    }
+    rb_link_node(node, parent, link);
+    rb_insert_color(node, tree);
+}
+
+static inline void rb_add_cached(struct rb_node *node, struct rb_root_cached *tree,
+                                 bool (*less)(struct rb_node *, const struct rb_node *))
+{
+    struct rb_node **link = &tree->rb_root.rb_node;
+    struct rb_node *parent = NULL;
+    bool leftmost = true;
+
+    while (*link)
+    {
+        parent = *link;
+        if (less(node, parent))
+        {
+            link = &parent->rb_left;
+        }
+        else
+        {
+            link = &parent->rb_right;
+            leftmost = false;
+        }
+    }
+    rb_link_node(node, parent, link);
+    rb_insert_color_cached(node, tree, leftmost);
+}
+
+/**
+ * @brief The node cmp() reports equal to key, or NULL. cmp returns <0
+ * when key sorts before the node.
+ */
+static inline struct rb_node *rb_find(const void *key, const struct rb_root *tree,
+                                      int (*cmp)(const void *key, const struct rb_node *))
+{
+    struct rb_node *node = tree->rb_node;
+
+    while (node)
+    {
+        int c = cmp(key, node);
+        if (c < 0)
+            node = node->rb_left;
+        else if (c > 0)
+            node = node->rb_right;
+        else
+            return node;
+    }
+    return NULL;
+}
+
+/* --- Augmented trees --- */
+
+struct rb_augment_callbacks
+{
+    /* Recompute from node up to (not including) stop */
+    void (*propagate)(struct rb_node *node, struct rb_node *stop);
+    /* new takes old's place: copy old's value */
+    void (*copy)(struct rb_node *old, struct rb_node *new);
+    /* new became old's parent: copy old's value to new, recompute old */
+    void (*rotate)(struct rb_node *old, struct rb_node *new);
+};
+
+/**
+ * @brief Rebalances after rb_link_node(). The caller has already updated
+ * the augmented value of every node on the path down to the new one.
+ */
+void rb_insert_augmented(struct rb_node *node, struct rb_root *root,
+                         const struct rb_augment_callbacks *augment);
+void rb_erase_augmented(struct rb_node *node, struct rb_root *root,
+                        const struct rb_augment_callbacks *augment);
+
+/**
+ * @brief Defines callbacks for the common case of an augmented value that
+ * is the maximum of compute(node) over the subtree.
+ *
+ * rbstatic: storage class of the callbacks (e.g. static)
+ * rbname: name of the struct rb_augment_callbacks defined
+ * rbstruct, rbfield: the node's type and its struct rb_node member
+ * rbtype, rbaugmented: the type and member holding the subtree maximum
+ * rbcompute: function returning the node's own value
+ */
+#define RB_DECLARE_CALLBACKS_MAX(rbstatic, rbname, rbstruct, rbfield, rbtype, rbaugmented,  \
+                                 rbcompute)                                                 \
+    static inline bool rbname##_compute_max(rbstruct *node, bool exit)                      \
+    {                                                                                       \
+        rbtype max = rbcompute(node);                                                       \
+        if (node->rbfield.rb_left)                                                          \
+        {                                                                                   \
+            rbstruct *child = rb_entry(node->rbfield.rb_left, rbstruct, rbfield);           \
+            if (child->rbaugmented > max)                                                   \
+                max = child->rbaugmented;                                                   \
+        }                                                                                   \
+        if (node->rbfield.rb_right)                                                         \
+        {                                                                                   \
+            rbstruct *child = rb_entry(node->rbfield.rb_right, rbstruct, rbfield);          \
+            if (child->rbaugmented > max)                                                   \
+                max = child->rbaugmented;                                                   \
+        }                                                                                   \
+        if (exit && node->rbaugmented == max)                                               \
+            return true;                                                                    \
+        node->rbaugmented = max;                                                            \
+        return false;                                                                       \
+    }                                                                                       \
+    static void rbname##_propagate(struct rb_node *rb, struct rb_node *stop)                \
+    {                                                                                       \
+        while (rb != stop)                                                                  \
+        {                                                                                   \
+            rbstruct *node = rb_entry(rb, rbstruct, rbfield);                               \
+            if (rbname##_compute_max(node, true))                                           \
+                break;                                                                      \
+            rb = rb_parent(&node->rbfield);                                                 \
+        }                                                                                   \
+    }                                                                                       \
+    static void rbname##_copy(struct rb_node *rb_old, struct rb_node *rb_new)               \
+    {                                                                                       \
+        rb_entry(rb_new, rbstruct, rbfield)->rbaugmented =                                  \
+            rb_entry(rb_old, rbstruct, rbfield)->rbaugmented;                               \
+    }                                                                                       \
+    static void rbname##_rotate(struct rb_node *rb_old, struct rb_node *rb_new)             \
+    {                                                                                       \
+        rbstruct *old = rb_entry(rb_old, rbstruct, rbfield);                                \
+        rb_entry(rb_new, rbstruct, rbfield)->rbaugmented = old->rbaugmented;                \
+        rbname##_compute_max(old, false);                                                   \
+    }                                                                                       \
+    rbstatic const struct rb_augment_callbacks rbname = {                                   \
+        .propagate = rbname##_propagate,                                                    \
+        .copy = rbname##_copy,                                                              \
+        .rotate = rbname##_rotate,                                                          \
+    }
+
+#endif
@@ -0,0 +1,89 @@
+#ifndef RING_H
+#define RING_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <valen/smp.h>
+
+/*
+ * Bounded lock-free ring queues of fixed-size elements (lib/ring.c). The
+ * caller provides the storage; sizes are a power of two. Push fails when
+ * the ring is full and pop when it is empty; neither ever waits.
+ *
+ * spsc_ring: one producer and one consumer, e.g. an interrupt handler
+ * feeding a task. Each side writes only its own index, kept on its own
+ * cache line, and rereads the other side's index only when its cached
+ * copy says the ring is full (or empty).
+ *
+ * mpmc_ring: any number of producers and consumers (Vyukov's bounded
+ * queue). Each cell carries a sequence number that says whether it is
+ * ready to be written or read in the current lap, so a slot is claimed
+ * with one compare-and-swap on the shared position.
+ */
+
+struct spsc_ring
+{
+    uint8_t *data;
+    uint32_t mask;
+    uint32_t elem_size;
+
+    /* Producer's line */
+    uint32_t head __cacheline_aligned; /* Next slot to fill */
+    uint32_t cached_tail;
+
+    /* Consumer's line */
+    uint32_t tail __cacheline_aligned; /* Next slot to drain */
+    uint32_t cached_head;
+} __cacheline_aligned;
+
+/**
+ * @brief Sets up an empty ring over buffer, which holds size elements of
+ * elem_size bytes. Returns -1 if size is not a power of two.
+ */
+int spsc_ring_init(struct spsc_ring *ring, void *buffer, uint32_t size, uint32_t elem_size);
+
+/** @brief Copies elem in; false when the ring is full. Producer only. */
+bool spsc_ring_push(struct spsc_ring *ring, const void *elem);
+
+/** @brief Copies the oldest element to out; false when empty. Consumer only. */
+bool spsc_ring_pop(struct spsc_ring *ring, void *out);
+
+/** @brief Elements queued; exact only when called by one of the two sides. */
+static inline uint32_t spsc_ring_count(const struct spsc_ring *ring)
+{
+    return __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) -
+           __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+}
+
+static inline bool spsc_ring_empty(const struct spsc_ring *ring)
+{
+    return spsc_ring_count(ring) == 0;
+}
+
+/* Bytes of one MPMC cell: the sequence number, then the element */
+#define MPMC_RING_STRIDE(elem_size) ((8 + (elem_size) + 7) & ~7U)
+
+/* Bytes of storage for size elements of elem_size bytes (8-byte aligned) */
+#define MPMC_RING_BYTES(size, elem_size) ((uint64_t)(size) * MPMC_RING_STRIDE(elem_size))
+
+struct mpmc_ring
+{
+    uint8_t *cells;
+    uint32_t mask;
+    uint32_t elem_size;
+    uint32_t stride;
+
+    uint64_t enqueue_pos __cacheline_aligned;
+    uint64_t dequeue_pos __cacheline_aligned;
+} __cacheline_aligned;
+
+/**
+ * @brief Sets up an empty ring over MPMC_RING_BYTES(size, elem_size)
+ * bytes at buffer. Returns -1 if size is not a power of two.
+ */
+int mpmc_ring_init(struct mpmc_ring *ring, void *buffer, uint32_t size, uint32_t elem_size);
+
+bool mpmc_ring_push(struct mpmc_ring *ring, const void *elem);
+bool mpmc_ring_pop(struct mpmc_ring *ring, void *out);
+
+#endif
@@ -0,0 +1,26 @@
+#ifndef SIPHASH_H
+#define SIPHASH_H
+
+#include <stdint.h>
+
+/*
+ * SipHash-2-4 (lib/siphash.c): a keyed 64-bit hash. Without the key,
+ * nobody can pick inputs that collide, so a hash table keyed by outside
+ * data (packet fields, file names) cannot be driven into its worst case.
+ * Draw the key from a random source once per table or per boot.
+ */
+
+typedef struct
+{
+    uint64_t key[2];
+} siphash_key_t;
+
+uint64_t siphash(const void *data, uint64_t len, const siphash_key_t *key);
+
+/** @brief siphash() of the 8 bytes of first: the fast path for integer keys. */
+uint64_t siphash_1u64(uint64_t first, const siphash_key_t *key);
+
+/** @brief siphash() of first then second, 16 bytes. */
+uint64_t siphash_2u64(uint64_t first, uint64_t second, const siphash_key_t *key);
+
+#endif
@@ -0,0 +1,39 @@
+#ifndef SMP_H
+#define SMP_H
+
+#include <stdint.h>
+
+/** @brief Upper bound for per-CPU arrays (Kconfig NR_CPUS). */
+#ifdef CONFIG_NR_CPUS
+#define NR_CPUS CONFIG_NR_CPUS
+#else
+#define NR_CPUS 1
+#endif
+
+/**
+ * @brief Size of a cache line. Data written by different CPUs is kept in
+ * separate lines so writes do not bounce the line between caches.
+ */
+#define SMP_CACHE_BYTES 64
+#define __cacheline_aligned __attribute__((aligned(SMP_CACHE_BYTES)))
+
+#ifdef VALEN_HOST
+/* Host harness (tests/host): each test thread plays one CPU */
+extern __thread int host_cpu;
+
+static inline int smp_processor_id(void)
+{
+    return host_cpu;
+}
+#else
+/**
+ * @brief Index of the CPU executing this code, 0..NR_CPUS-1.
+ * Only the bootstrap processor runs today, so this is always 0.
+ */
+static inline int smp_processor_id(void)
+{
+    return 0;
+}
+#endif
+
+#endif
@@ -3,15 +3,41 @@
 
 #include <stdint.h>
 
-typedef struct {
+typedef struct spinlock {
     volatile uint32_t lock;
+#ifdef CONFIG_LOCKSTAT
+    const char *name;        /* Shown by 'lockstat'; NULL prints the address */
+    uint32_t registered;     /* On the lockstat list */
+    uint64_t acquired;       /* Successful acquisitions */
+    uint64_t contended;      /* Acquisitions that had to spin */
+    uint64_t spins;          /* Total pause iterations */
+    struct spinlock *stat_next;
+#endif
 } spinlock_t;
 
-#define SPINLOCK_INIT { .lock = 0 }
+#ifdef CONFIG_LOCKSTAT
+#define SPINLOCK_INIT_NAMED(n) { .lock = 0, .name = (n) }
+#else
+#define SPINLOCK_INIT_NAMED(n) { .lock = 0 }
+#endif
+
+#define SPINLOCK_INIT SPINLOCK_INIT_NAMED(0)
 
 void spinlock_init(spinlock_t *lock);
 void spinlock_acquire(spinlock_t *lock);
 void spinlock_release(spinlock_t *lock);
 uint8_t spinlock_try_acquire(spinlock_t *lock);
 
-#endif
\ No newline at end of file
+#ifdef CONFIG_LOCKSTAT
+/**
+ * @brief Prints the statistics of every lock that has been taken so far.
+ */
+void lockstat_dump(void);
+
+/**
+ * @brief Zeroes the counters of every registered lock.
+ */
+void lockstat_reset(void);
+#endif
+
+#endif
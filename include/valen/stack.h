@@ -0,0 +1,53 @@
+#ifndef STACK_H
+#define STACK_H
+
+#include <stdint.h>
+
+/* Per-CPU interrupt stack; hardware IRQs run on it instead of the
+ * interrupted task's stack */
+#define IRQ_STACK_SIZE 16384
+
+/* Fills unused stack so stack_used() can find the deepest write */
+#define STACK_POISON 0x57ac57ac57ac57acULL
+
+/**
+ * @brief Per-CPU IRQ stack state. GS points at this CPU's entry, and the
+ * IRQ stubs in arch/x86_64/interrupts.s use the fields by offset, so keep
+ * the layout in step with IRQ_STACK_TOP and IRQ_STACK_DEPTH there.
+ */
+struct irq_stack
+{
+    uint64_t top;   /* gs:0, initial rsp of the IRQ stack */
+    uint64_t depth; /* gs:8, IRQs being handled; 0 while on a task stack */
+};
+
+/**
+ * @brief Points GS at this CPU's IRQ stack state and poisons the IRQ and
+ * IST stacks. Must run after gdt_init() (loading GS clears its base) and
+ * before interrupts are enabled.
+ */
+void irq_stack_init(void);
+
+/**
+ * @brief Non-zero while an IRQ handler is running on this CPU.
+ */
+int in_irq(void);
+
+/**
+ * @brief Fills a stack with STACK_POISON.
+ */
+void stack_poison(void *base, uint64_t size);
+
+/**
+ * @brief Most bytes ever used of a stack filled by stack_poison(): the
+ * distance from the top to the deepest overwritten word.
+ */
+uint64_t stack_used(const void *base, uint64_t size);
+
+/**
+ * @brief Prints the size and high-water mark of the IRQ, IST and task
+ * stacks ('stacks').
+ */
+void stack_dump(void);
+
+#endif
@@ -27,9 +27,31 @@ void print_newline();
 // String to number conversion
 int atoi(const char *str);
 
+/** @brief Size of the console log ring (see console_log_copy()). */
+#define CONSOLE_LOG_SIZE 16384
+
+uint64_t console_log_copy(char *out, uint64_t len);
+
+/**
+ * @brief Switches VGA output to a write-combining mapping of text memory.
+ * Called once the VMM is up; output goes through the direct map until then.
+ */
+void console_map_wc(void);
+
 void serial_write(char *s);
 void serial_write_int(uint64_t n);
 void serial_write_hex(uint32_t n);
+void serial_printf(const char *format, ...);
+
+// Formatting into a buffer
+int vsnprintf(char *buf, uint64_t size, const char *format, va_list args);
+int snprintf(char *buf, uint64_t size, const char *format, ...);
+
+/**
+ * @brief printf() with the vsnprintf() format: field widths, the '0' and
+ * '-' flags and length modifiers, for tables. Output stops at 256 bytes.
+ */
+void printf_fmt(const char *format, ...);
 
 void update_cursor(int x, int y);
 void set_cursor(int x, int y);
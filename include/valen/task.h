@@ -3,6 +3,7 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include <valen/list.h>
 
 // Process ID type
 typedef int pid_t;
@@ -48,6 +49,8 @@ typedef struct task_context {
     uint64_t ss;
 } task_context_t;
 
+struct hrtimer;
+
 // Task Control Block
 typedef struct task {
     // Task identification
@@ -68,9 +71,8 @@ typedef struct task {
     void *stack;
     unsigned long stack_size;
     
-    // Linked list for runqueue
-    struct task *next;
-    struct task *prev;
+    // Entry on the runqueue; empty once the task has left it
+    struct list_head run_list;
     
     // Task function
     void (*task_func)(void);
@@ -81,6 +83,19 @@ typedef struct task {
     
     // Flags
     unsigned int flags;
+
+    // NUMA placement: stack and pages come from the home node
+    int numa_node;
+    int mempolicy;              // NUMA_POLICY_*
+    uint64_t numa_remote_runs;  // Times scheduled on a CPU outside numa_node
+
+    // Pending wakeup of task_sleep_until(), on the task's own stack
+    struct hrtimer *sleep_timer;
+
+    // Hung-task detector (kernel/debug/watchdog.c)
+    uint64_t nr_switches;        // Times switched in
+    uint64_t last_switch_count;  // nr_switches when the detector last looked
+    uint64_t last_switch_time;   // clock_ns() when that count last changed
 } task_t;
 
 // Global current task
@@ -88,6 +103,7 @@ extern task_t *current_task;
 
 // Core task management functions
 task_t *task_create(void (*func)(void), const char *name);
+task_t *task_create_on_node(void (*func)(void), const char *name, int node);
 void task_exit(long exit_code);
 void schedule(void);
 void context_switch(task_t *prev, task_t *next);
@@ -105,7 +121,19 @@ void remove_task_from_runqueue(task_t *task);
 task_t *get_current_task(void);
 pid_t get_current_pid(void);
 void yield(void);
+int need_resched(void);
+void task_wake_up(task_t *task);
+void task_sleep_until(uint64_t ns);
+void task_set_prio(task_t *task, int prio);
 task_t *find_task_by_pid(pid_t pid);
+struct list_head *task_list_head(void);
+
+/**
+ * @brief Walks the runqueue without locking, for crash and debug paths.
+ */
+#define for_each_task(t) \
+    for (task_t *t = list_first_entry(task_list_head(), task_t, run_list); \
+         &t->run_list != task_list_head(); t = list_next_entry(t, run_list))
 int kill_task(pid_t pid);
 
 #endif // VALEN_TASK_H
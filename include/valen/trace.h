@@ -0,0 +1,47 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+
+/** @brief One recorded event; event names are string literals. */
+typedef struct trace_entry
+{
+    uint64_t tsc;
+    const char *event;
+    uint64_t a;
+    uint64_t b;
+    int cpu;
+} trace_entry_t;
+
+#ifdef CONFIG_TRACING
+
+/**
+ * @brief Appends an event to the trace ring, overwriting the oldest entry
+ * when full. Safe to call from interrupt context.
+ */
+void trace_record(const char *event, uint64_t a, uint64_t b);
+
+/**
+ * @brief Prints the ring, oldest entry first.
+ * @param last Print at most this many of the newest entries (0 = all).
+ * @param out  printf-style sink: printf for the console, or the lockless
+ *             crash output when called from an exception.
+ */
+void trace_dump(int last, void (*out)(const char *format, ...));
+
+#define trace(event, a, b) trace_record(event, (uint64_t)(a), (uint64_t)(b))
+
+#else
+
+/* Arguments are still type-checked but no code is emitted */
+#define trace(event, a, b)                                    \
+    do                                                        \
+    {                                                         \
+        (void)sizeof(event);                                  \
+        (void)sizeof(a);                                      \
+        (void)sizeof(b);                                      \
+    } while (0)
+
+#endif
+
+#endif
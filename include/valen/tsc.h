@@ -0,0 +1,27 @@
+#ifndef TSC_H
+#define TSC_H
+
+#include <stdint.h>
+
+/**
+ * @brief Reads the Time Stamp Counter.
+ * @return Cycles since reset (not serialized against earlier instructions).
+ */
+static inline uint64_t rdtsc(void)
+{
+    uint32_t lo, hi;
+    asm volatile("rdtsc" : "=a"(lo), "=d"(hi));
+    return ((uint64_t)hi << 32) | lo;
+}
+
+/**
+ * @brief Reads the TSC after all earlier instructions have completed.
+ * Use this to bracket short measured regions.
+ */
+static inline uint64_t rdtsc_ordered(void)
+{
+    asm volatile("lfence" ::: "memory");
+    return rdtsc();
+}
+
+#endif
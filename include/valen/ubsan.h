@@ -0,0 +1,24 @@
+#ifndef UBSAN_H
+#define UBSAN_H
+
+#include <stdint.h>
+
+/*
+ * Runtime for -fsanitize=undefined (lib/ubsan.c). The compiler calls a
+ * __ubsan_handle_* function when it catches undefined behaviour; each
+ * source location is reported once, on COM1.
+ */
+
+/**
+ * @brief Number of distinct problems reported since boot.
+ */
+uint64_t ubsan_report_count(void);
+
+/**
+ * @brief Triggers one of each checked kind of undefined behaviour
+ * (kernel/debug/ubsan_test.c).
+ * @return Number of tests whose report did not show up.
+ */
+int ubsan_selftest(void);
+
+#endif
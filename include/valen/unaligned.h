@@ -0,0 +1,47 @@
+#ifndef UNALIGNED_H
+#define UNALIGNED_H
+
+#include <stdint.h>
+
+/*
+ * Loads and stores at any address. x86 handles misaligned accesses in
+ * hardware; these only tell the compiler not to assume alignment and
+ * that the bytes may also be accessed through other types. Little-endian
+ * only, like the rest of the kernel.
+ */
+
+typedef uint16_t __attribute__((may_alias, aligned(1))) una_u16;
+typedef uint32_t __attribute__((may_alias, aligned(1))) una_u32;
+typedef uint64_t __attribute__((may_alias, aligned(1))) una_u64;
+
+static inline uint16_t get_unaligned_le16(const void *p)
+{
+    return *(const una_u16 *)p;
+}
+
+static inline uint32_t get_unaligned_le32(const void *p)
+{
+    return *(const una_u32 *)p;
+}
+
+static inline uint64_t get_unaligned_le64(const void *p)
+{
+    return *(const una_u64 *)p;
+}
+
+static inline void put_unaligned_le16(uint16_t v, void *p)
+{
+    *(una_u16 *)p = v;
+}
+
+static inline void put_unaligned_le32(uint32_t v, void *p)
+{
+    *(una_u32 *)p = v;
+}
+
+static inline void put_unaligned_le64(uint64_t v, void *p)
+{
+    *(una_u64 *)p = v;
+}
+
+#endif
@@ -8,6 +8,7 @@
 
 #include <stdint.h>
 #include <stddef.h>
+#include <valen/pat.h>
 
 /** @brief Page Table Entry Flags (Standard x86_64) */
 #define PAGE_PRESENT (1ULL << 0)
@@ -16,6 +17,7 @@
 #define PAGE_PWT (1ULL << 3)  /* Page-level Write-Through */
 #define PAGE_PCD (1ULL << 4)  /* Page-level Cache Disable (Required for MMIO) */
 #define PAGE_HUGE (1ULL << 7) /* PS bit for 2MB/1GB pages */
+#define PAGE_PAT (1ULL << 7)  /* PAT index bit in 4KB PTEs (the PS bit elsewhere) */
 
 /**
  * @brief Initializes the VMM and sets up initial kernel paging.
@@ -45,4 +47,56 @@ uintptr_t vmm_get_phys(uintptr_t virtual_addr);
  */
 void *vmm_alloc(uint64_t pages, uint64_t flags);
 
+/**
+ * @brief Like vmm_alloc(), but page i comes from the next node in the
+ * interleave rotation and the frames need not be contiguous. For large
+ * buffers every CPU uses; frames above the direct map are fine here.
+ */
+void *vmm_alloc_interleave(uint64_t pages, uint64_t flags);
+
+/**
+ * @brief Kernel virtual space handed out by vmm_alloc() and
+ * vmm_alloc_interleave() so far, in KB. It is never given back.
+ */
+uint64_t vmm_get_used_kb(void);
+
+/**
+ * @brief Maps a physical range that is not direct-mapped, e.g. ACPI tables
+ * above 1GB. The memory type follows the PWT/PCD/PAT bits in flags; prefer
+ * vmm_map_phys_cache() for device memory. Never unmapped.
+ * @return Virtual address of phys itself (not page-aligned if phys is
+ * not), or NULL if the range is already mapped with another memory type.
+ */
+void *vmm_map_phys(uint64_t phys, uint64_t size, uint64_t flags);
+
+/**
+ * @brief vmm_map_phys() with an explicit memory type. flags must not
+ * contain caching bits.
+ */
+void *vmm_map_phys_cache(uint64_t phys, uint64_t size, uint64_t flags, enum page_cache type);
+
+/** @brief Device registers: uncached, strongly ordered. */
+static inline void *vmm_map_uc(uint64_t phys, uint64_t size)
+{
+    return vmm_map_phys_cache(phys, size, PAGE_PRESENT | PAGE_WRITE, PAGE_CACHE_UC);
+}
+
+/** @brief Framebuffers and other write-mostly device memory. */
+static inline void *vmm_map_wc(uint64_t phys, uint64_t size)
+{
+    return vmm_map_phys_cache(phys, size, PAGE_PRESENT | PAGE_WRITE, PAGE_CACHE_WC);
+}
+
+/** @brief Read-mostly device memory, e.g. ROM images. */
+static inline void *vmm_map_wt(uint64_t phys, uint64_t size)
+{
+    return vmm_map_phys_cache(phys, size, PAGE_PRESENT | PAGE_WRITE, PAGE_CACHE_WT);
+}
+
+/** @brief RAM outside the direct map. */
+static inline void *vmm_map_wb(uint64_t phys, uint64_t size)
+{
+    return vmm_map_phys_cache(phys, size, PAGE_PRESENT | PAGE_WRITE, PAGE_CACHE_WB);
+}
+
 #endif
\ No newline at end of file
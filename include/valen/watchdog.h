@@ -0,0 +1,52 @@
+#ifndef WATCHDOG_H
+#define WATCHDOG_H
+
+#include <valen/ptrace.h>
+
+/*
+ * Soft-lockup and hung-task detectors (kernel/debug/watchdog.c).
+ *
+ * A CPU that has not been through schedule() for watchdog_thresh seconds
+ * is reported from its timer tick with the interrupted registers and a
+ * backtrace. A task that stays TASK_UNINTERRUPTIBLE without running for
+ * hung_task_timeout_secs is reported by the khungtaskd task with its
+ * saved stack.
+ */
+
+#ifdef CONFIG_LOCKUP_DETECTOR
+/**
+ * @brief Marks this CPU as scheduling. Called by schedule(); call it from
+ * code that keeps the CPU on purpose for a long time, such as benchmarks.
+ */
+void watchdog_touch(void);
+
+/**
+ * @brief Soft-lockup check, from the timer tick with the interrupted
+ * registers.
+ */
+void watchdog_tick(struct pt_regs *regs);
+
+/**
+ * @brief Starts the khungtaskd task. Runs after scheduler_init().
+ */
+void watchdog_init(void);
+
+/**
+ * @brief Prints thresholds, per-CPU state and report counts ('watchdog').
+ */
+void watchdog_dump(void);
+
+/**
+ * @brief Provokes a report: "softlockup" spins the calling task with
+ * interrupts enabled, "hung" starts a task that blocks forever in
+ * TASK_UNINTERRUPTIBLE.
+ * @return 0, or -1 for an unknown test.
+ */
+int watchdog_test(const char *name);
+#else
+static inline void watchdog_touch(void) {}
+static inline void watchdog_tick(struct pt_regs *regs) { (void)regs; }
+static inline void watchdog_init(void) {}
+#endif
+
+#endif
@@ -0,0 +1,16 @@
+#ifndef XXHASH_H
+#define XXHASH_H
+
+#include <stdint.h>
+
+/*
+ * xxHash64 (lib/xxhash.c): a fast non-cryptographic hash, with the same
+ * output as the reference implementation. Use it where keys cannot be
+ * chosen by an attacker: content fingerprints, same-page detection,
+ * tables keyed by kernel addresses. For tables an outsider can fill,
+ * use siphash() with a secret key.
+ */
+
+uint64_t xxh64(const void *data, uint64_t len, uint64_t seed);
+
+#endif
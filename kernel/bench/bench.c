@@ -0,0 +1,609 @@
+/**
+ * @file bench.c
+ * @brief In-kernel microbenchmark suite.
+ *
+ * Every benchmark collects BENCH_SAMPLES TSC-timed samples, which are
+ * sorted and reduced to percentiles. Results are shown on screen and sent
+ * to COM1 as one machine-readable line each:
+ *
+ *   BENCH name=page_alloc unit=cycles n=1024 min=.. p50=.. p90=.. p99=.. max=.. mean=..
+ *
+ * Lines starting with '#' on the serial port are not results. Run from the
+ * shell with 'bench', or headless with 'bench=all' on the kernel command
+ * line (see scripts/bench.sh).
+ */
+
+#include <valen/bench.h>
+#include <valen/tsc.h>
+#include <valen/stdio.h>
+#include <valen/string.h>
+#include <valen/task.h>
+#include <valen/pmm.h>
+#include <valen/numa.h>
+#include <valen/vmm.h>
+#include <valen/paging.h>
+#include <valen/heap.h>
+#include <valen/spinlock.h>
+#include <valen/io.h>
+#include <valen/clock.h>
+#include <valen/hpet.h>
+#include <valen/irq.h>
+#include <valen/watchdog.h>
+#include <valen/crc32c.h>
+#include <valen/xxhash.h>
+#include <valen/checksum.h>
+#include <valen/lz4.h>
+
+/* Operations per sample for benchmarks that are cheaper than rdtsc itself */
+#define BENCH_BATCH 64
+
+typedef struct
+{
+    const char *name;
+    int (*run)(uint64_t *samples); /* Returns the number of samples taken */
+    const char *help;
+} bench_t;
+
+static uint64_t samples[BENCH_SAMPLES];
+static char boot_mode[32] = "all";
+
+/* --- Scheduler --- */
+
+static volatile uint64_t pong_tsc;
+
+/**
+ * @brief Partner task for the scheduler benchmarks: stamps the TSC as soon
+ * as it is switched to and immediately hands the CPU back.
+ */
+static void bench_partner_main(void)
+{
+    while (1)
+    {
+        pong_tsc = rdtsc_ordered();
+        schedule();
+    }
+}
+
+/**
+ * @brief Ping-pongs with a partner task through schedule().
+ * @param one_way Record the switch-in latency instead of the round trip.
+ */
+static int bench_pingpong(uint64_t *out, int one_way)
+{
+    task_t *partner = task_create(bench_partner_main, "bench-pong");
+    if (!partner)
+        return 0;
+
+    /* First switch enters the partner for the first time; not measured */
+    schedule();
+
+    for (int i = 0; i < BENCH_SAMPLES; i++)
+    {
+        uint64_t t0 = rdtsc_ordered();
+        schedule();
+        uint64_t t2 = rdtsc_ordered();
+        out[i] = one_way ? pong_tsc - t0 : t2 - t0;
+    }
+
+    kill_task(partner->pid);
+    return BENCH_SAMPLES;
+}
+
+static int bench_ctx_switch(uint64_t *out)
+{
+    return bench_pingpong(out, 1);
+}
+
+static int bench_yield(uint64_t *out)
+{
+    return bench_pingpong(out, 0);
+}
+
+/* --- Memory --- */
+
+static int bench_page_alloc(uint64_t *out)
+{
+    for (int i = 0; i < BENCH_SAMPLES; i++)
+    {
+        uint64_t t0 = rdtsc_ordered();
+        void *page = pmm_alloc_page();
+        pmm_free_page(page);
+        out[i] = rdtsc_ordered() - t0;
+
+        if (!page)
+            return i;
+    }
+    return BENCH_SAMPLES;
+}
+
+/**
+ * @brief Mixed-size malloc/free: keeps 16 blocks live and replaces the
+ * oldest one per sample.
+ */
+static int bench_malloc_free(uint64_t *out)
+{
+    static const uint64_t sizes[] = {16, 48, 200, 64, 1000, 24, 512, 96};
+    void *live[16] = {0};
+
+    for (int i = 0; i < BENCH_SAMPLES; i++)
+    {
+        int slot = i % 16;
+        uint64_t t0 = rdtsc_ordered();
+        free(live[slot]);
+        live[slot] = malloc(sizes[i % 8]);
+        out[i] = rdtsc_ordered() - t0;
+    }
+
+    for (int i = 0; i < 16; i++)
+        free(live[i]);
+    return BENCH_SAMPLES;
+}
+
+static int bench_paging_map(uint64_t *out)
+{
+    static void *scratch = NULL;
+
+    if (!scratch)
+        scratch = vmm_alloc(1, PAGE_PRESENT | PAGE_WRITE);
+    if (!scratch)
+        return 0;
+
+    uint64_t virt = (uint64_t)scratch;
+    uint64_t phys = vmm_get_phys(virt);
+
+    for (int i = 0; i < BENCH_SAMPLES; i++)
+    {
+        uint64_t t0 = rdtsc_ordered();
+        paging_map(virt, phys, PAGE_PRESENT | PAGE_WRITE);
+        out[i] = rdtsc_ordered() - t0;
+    }
+    return BENCH_SAMPLES;
+}
+
+/* Larger than the last-level cache of most hosts */
+#define MEM_CHASE_PAGES 2048
+
+/**
+ * @brief Load latency of memory on node: a pointer chase through one
+ * random cycle over every cache line of an 8MB buffer.
+ */
+static int bench_mem_chase(uint64_t *out, int node)
+{
+    uint64_t *buf = pmm_alloc_pages_node(MEM_CHASE_PAGES, node);
+    if (!buf)
+        return 0;
+
+    /* A fallback to another node would measure the wrong thing */
+    if (pmm_page_node(vmm_get_phys((uintptr_t)buf)) != node)
+    {
+        for (int i = 0; i < MEM_CHASE_PAGES; i++)
+            pmm_free_page((uint8_t *)buf + i * 4096);
+        return 0;
+    }
+
+    /* Word 0 of each 64-byte line holds the permutation, word 1 the link */
+    uint64_t lines = MEM_CHASE_PAGES * 4096 / 64;
+    uint64_t seed = rdtsc_ordered() | 1;
+    for (uint64_t i = 0; i < lines; i++)
+        buf[i * 8] = i;
+    for (uint64_t i = lines - 1; i > 0; i--)
+    {
+        seed ^= seed << 13;
+        seed ^= seed >> 7;
+        seed ^= seed << 17;
+        uint64_t j = seed % i; /* Sattolo: a single cycle */
+        uint64_t t = buf[i * 8];
+        buf[i * 8] = buf[j * 8];
+        buf[j * 8] = t;
+    }
+    for (uint64_t i = 0; i < lines; i++)
+        buf[buf[i * 8] * 8 + 1] = (uint64_t)&buf[buf[((i + 1) % lines) * 8] * 8];
+
+    volatile uint64_t *p = &buf[buf[0] * 8];
+    for (int i = 0; i < BENCH_SAMPLES; i++)
+    {
+        uint64_t t0 = rdtsc_ordered();
+        for (int j = 0; j < BENCH_BATCH; j++)
+            p = (volatile uint64_t *)p[1];
+        out[i] = (rdtsc_ordered() - t0) / BENCH_BATCH;
+    }
+
+    for (int i = 0; i < MEM_CHASE_PAGES; i++)
+        pmm_free_page((uint8_t *)buf + i * 4096);
+    return BENCH_SAMPLES;
+}
+
+static int bench_mem_local(uint64_t *out)
+{
+    return bench_mem_chase(out, numa_cpu_node());
+}
+
+/**
+ * @brief Same chase on the node farthest from this CPU; skipped with a
+ * single node.
+ */
+static int bench_mem_remote(uint64_t *out)
+{
+    int local = numa_cpu_node();
+    int far = local;
+
+    for (int n = 0; n < numa_node_count(); n++)
+    {
+        if (numa_distance(local, n) > numa_distance(local, far))
+            far = n;
+    }
+    return far == local ? 0 : bench_mem_chase(out, far);
+}
+
+/* --- Interrupts and locking --- */
+
+static void bench_irq_handler(struct pt_regs *regs)
+{
+    (void)regs;
+}
+
+/**
+ * @brief Software interrupt round trip: stub, IRQ stack switch, dispatch
+ * with accounting, an empty handler and iretq. Vector 0x81 has the full
+ * register save, 0x82 the leaf one.
+ */
+static int bench_irq_vector(uint64_t *out, int leaf)
+{
+    /* Fails harmlessly when an earlier run registered it */
+    if (leaf)
+        request_vector(0x82, bench_irq_handler, IRQF_LEAF, "bench");
+    else
+        request_vector(0x81, bench_irq_handler, 0, "bench");
+
+    for (int i = 0; i < BENCH_SAMPLES; i++)
+    {
+        uint64_t t0 = rdtsc_ordered();
+        if (leaf)
+            asm volatile("int $0x82" ::: "memory");
+        else
+            asm volatile("int $0x81" ::: "memory");
+        out[i] = rdtsc_ordered() - t0;
+    }
+    return BENCH_SAMPLES;
+}
+
+static int bench_irq_roundtrip(uint64_t *out)
+{
+    return bench_irq_vector(out, 0);
+}
+
+static int bench_irq_leaf(uint64_t *out)
+{
+    return bench_irq_vector(out, 1);
+}
+
+static int bench_spinlock(uint64_t *out)
+{
+    static spinlock_t lock = SPINLOCK_INIT;
+
+    for (int i = 0; i < BENCH_SAMPLES; i++)
+    {
+        uint64_t t0 = rdtsc_ordered();
+        for (int j = 0; j < BENCH_BATCH; j++)
+        {
+            spinlock_acquire(&lock);
+            spinlock_release(&lock);
+        }
+        out[i] = (rdtsc_ordered() - t0) / BENCH_BATCH;
+    }
+    return BENCH_SAMPLES;
+}
+
+/**
+ * @brief Cost of a failed trylock on a held lock: the cache line bounce a
+ * waiter pays per spin. True multi-CPU contention needs SMP bring-up.
+ */
+static int bench_spinlock_busy(uint64_t *out)
+{
+    static spinlock_t lock = SPINLOCK_INIT;
+
+    spinlock_acquire(&lock);
+    for (int i = 0; i < BENCH_SAMPLES; i++)
+    {
+        uint64_t t0 = rdtsc_ordered();
+        for (int j = 0; j < BENCH_BATCH; j++)
+            spinlock_try_acquire(&lock);
+        out[i] = (rdtsc_ordered() - t0) / BENCH_BATCH;
+    }
+    spinlock_release(&lock);
+    return BENCH_SAMPLES;
+}
+
+/* --- Console --- */
+
+static const char bench_line[] =
+    "# valen console throughput .......................................................\n";
+
+static int bench_console_vga(uint64_t *out)
+{
+    for (int i = 0; i < BENCH_SAMPLES; i++)
+    {
+        uint64_t t0 = rdtsc_ordered();
+        puts(bench_line + 2);
+        out[i] = rdtsc_ordered() - t0;
+    }
+    return BENCH_SAMPLES;
+}
+
+static int bench_console_serial(uint64_t *out)
+{
+    for (int i = 0; i < BENCH_SAMPLES; i++)
+    {
+        uint64_t t0 = rdtsc_ordered();
+        serial_write((char *)bench_line);
+        out[i] = rdtsc_ordered() - t0;
+    }
+    return BENCH_SAMPLES;
+}
+
+/* --- Memory copies --- */
+
+static uint8_t copy_src[4096], copy_dst[4096];
+
+static int bench_memcpy(uint64_t *out, uint64_t len)
+{
+    for (int i = 0; i < BENCH_SAMPLES; i++)
+    {
+        uint64_t t0 = rdtsc_ordered();
+        memcpy(copy_dst, copy_src, len);
+        out[i] = rdtsc_ordered() - t0;
+    }
+    return BENCH_SAMPLES;
+}
+
+static int bench_memcpy_64(uint64_t *out)
+{
+    return bench_memcpy(out, 64);
+}
+
+static int bench_memcpy_4k(uint64_t *out)
+{
+    return bench_memcpy(out, 4096);
+}
+
+static int bench_memset_4k(uint64_t *out)
+{
+    for (int i = 0; i < BENCH_SAMPLES; i++)
+    {
+        uint64_t t0 = rdtsc_ordered();
+        memset(copy_dst, i, sizeof(copy_dst));
+        out[i] = rdtsc_ordered() - t0;
+    }
+    return BENCH_SAMPLES;
+}
+
+/* --- Hashing --- */
+
+static volatile uint64_t hash_sink;
+
+static int bench_crc32c_4k(uint64_t *out)
+{
+    for (int i = 0; i < BENCH_SAMPLES; i++)
+    {
+        uint64_t t0 = rdtsc_ordered();
+        hash_sink = crc32c(0, copy_src, sizeof(copy_src));
+        out[i] = rdtsc_ordered() - t0;
+    }
+    return BENCH_SAMPLES;
+}
+
+static int bench_xxh64_4k(uint64_t *out)
+{
+    for (int i = 0; i < BENCH_SAMPLES; i++)
+    {
+        uint64_t t0 = rdtsc_ordered();
+        hash_sink = xxh64(copy_src, sizeof(copy_src), 0);
+        out[i] = rdtsc_ordered() - t0;
+    }
+    return BENCH_SAMPLES;
+}
+
+static int bench_csum_1500(uint64_t *out)
+{
+    for (int i = 0; i < BENCH_SAMPLES; i++)
+    {
+        uint64_t t0 = rdtsc_ordered();
+        hash_sink = csum_partial(copy_src, 1500, 0);
+        out[i] = rdtsc_ordered() - t0;
+    }
+    return BENCH_SAMPLES;
+}
+
+/* --- Compression --- */
+
+/* The first page of kernel code: as compressible as a typical anonymous
+ * page, unlike the all-zero copy buffers */
+extern char _code_start[];
+
+static uint8_t lz4_comp[LZ4_COMPRESS_BOUND(4096)];
+static uint32_t lz4_wrkmem[LZ4_MEM_COMPRESS / sizeof(uint32_t)];
+static volatile uint64_t lz4_sink;
+
+static int bench_lz4_compress(uint64_t *out)
+{
+    for (int i = 0; i < BENCH_SAMPLES; i++)
+    {
+        uint64_t t0 = rdtsc_ordered();
+        lz4_sink = lz4_compress(_code_start, 4096, lz4_comp, sizeof(lz4_comp), lz4_wrkmem);
+        out[i] = rdtsc_ordered() - t0;
+    }
+    return BENCH_SAMPLES;
+}
+
+static int bench_lz4_decompress(uint64_t *out)
+{
+    uint64_t len = lz4_compress(_code_start, 4096, lz4_comp, sizeof(lz4_comp), lz4_wrkmem);
+
+    for (int i = 0; i < BENCH_SAMPLES; i++)
+    {
+        uint64_t t0 = rdtsc_ordered();
+        lz4_sink = lz4_decompress(lz4_comp, len, copy_dst, sizeof(copy_dst));
+        out[i] = rdtsc_ordered() - t0;
+    }
+    return BENCH_SAMPLES;
+}
+
+/* --- Clocks --- */
+
+static int bench_clock_ns(uint64_t *out)
+{
+    for (int i = 0; i < BENCH_SAMPLES; i++)
+    {
+        uint64_t t0 = rdtsc_ordered();
+        for (int j = 0; j < BENCH_BATCH; j++)
+            clock_ns();
+        out[i] = (rdtsc_ordered() - t0) / BENCH_BATCH;
+    }
+    return BENCH_SAMPLES;
+}
+
+/**
+ * @brief One uncached MMIO read of the HPET main counter; skipped without
+ * an HPET.
+ */
+static int bench_hpet_read(uint64_t *out)
+{
+    if (!hpet_available())
+        return 0;
+
+    for (int i = 0; i < BENCH_SAMPLES; i++)
+    {
+        uint64_t t0 = rdtsc_ordered();
+        hpet_read();
+        out[i] = rdtsc_ordered() - t0;
+    }
+    return BENCH_SAMPLES;
+}
+
+/* --- Calibration --- */
+
+static int bench_tsc_overhead(uint64_t *out)
+{
+    for (int i = 0; i < BENCH_SAMPLES; i++)
+    {
+        uint64_t t0 = rdtsc_ordered();
+        out[i] = rdtsc_ordered() - t0;
+    }
+    return BENCH_SAMPLES;
+}
+
+static const bench_t benches[] = {
+    {"tsc", bench_tsc_overhead, "Timer read overhead (floor for all results)"},
+    {"ctx_switch", bench_ctx_switch, "One-way task switch via schedule()"},
+    {"yield", bench_yield, "schedule() round trip with a partner task"},
+    {"page_alloc", bench_page_alloc, "pmm_alloc_page + pmm_free_page"},
+    {"malloc_free", bench_malloc_free, "Mixed-size free + malloc, 16 blocks live"},
+    {"mem_local", bench_mem_local, "Dependent load from this CPU's node (8MB chase)"},
+    {"mem_remote", bench_mem_remote, "Dependent load from the farthest node"},
+    {"paging_map", bench_paging_map, "paging_map of a mapped page incl. invlpg"},
+    {"irq", bench_irq_roundtrip, "Software interrupt round trip, full save (int 0x81)"},
+    {"irq_leaf", bench_irq_leaf, "Software interrupt round trip, leaf save (int 0x82)"},
+    {"spinlock", bench_spinlock, "Uncontended acquire + release"},
+    {"spinlock_busy", bench_spinlock_busy, "Failed trylock on a held lock"},
+    {"console_vga", bench_console_vga, "One 80-column line to VGA"},
+    {"console_serial", bench_console_serial, "One 80-column line to COM1"},
+    {"memcpy_64", bench_memcpy_64, "memcpy of 64 bytes (rep movsb with FSRM)"},
+    {"memcpy_4k", bench_memcpy_4k, "memcpy of 4KB (rep movsb with ERMS)"},
+    {"memset_4k", bench_memset_4k, "memset of 4KB (rep stosb with ERMS)"},
+    {"crc32c_4k", bench_crc32c_4k, "crc32c of 4KB (crc32 instruction with SSE4.2)"},
+    {"xxh64_4k", bench_xxh64_4k, "xxh64 of 4KB"},
+    {"csum_1500", bench_csum_1500, "Internet checksum of a 1500-byte frame"},
+    {"lz4_compress", bench_lz4_compress, "LZ4 compression of a 4KB page of kernel code"},
+    {"lz4_decompress", bench_lz4_decompress, "LZ4 decompression of the same page"},
+    {"clock_ns", bench_clock_ns, "clock_ns() on the current clocksource"},
+    {"hpet_read", bench_hpet_read, "HPET main counter read"},
+    {NULL, NULL, NULL},
+};
+
+/* --- Reporting --- */
+
+static void sort_samples(uint64_t *s, int n)
+{
+    for (int i = 1; i < n; i++)
+    {
+        uint64_t v = s[i];
+        int j = i - 1;
+        while (j >= 0 && s[j] > v)
+        {
+            s[j + 1] = s[j];
+            j--;
+        }
+        s[j + 1] = v;
+    }
+}
+
+static void report(const char *name, uint64_t *s, int n)
+{
+    if (n == 0)
+    {
+        printf("  %s: skipped\n", name);
+        serial_printf("BENCH name=%s status=skipped\n", name);
+        return;
+    }
+
+    sort_samples(s, n);
+
+    uint64_t sum = 0;
+    for (int i = 0; i < n; i++)
+        sum += s[i];
+
+    uint64_t p50 = s[n / 2];
+    uint64_t p90 = s[(n * 90) / 100];
+    uint64_t p99 = s[(n * 99) / 100];
+
+    printf_fmt("  %-15s p50=%-8lu p99=%-8lu max=%lu cycles\n", name, p50, p99, s[n - 1]);
+
+    serial_printf("BENCH name=%s unit=cycles n=%d min=%lu p50=%lu p90=%lu p99=%lu max=%lu mean=%lu\n",
+                  name, n, s[0], p50, p90, p99, s[n - 1], sum / n);
+}
+
+void bench_list(void)
+{
+    for (int i = 0; benches[i].name; i++)
+        printf_fmt("  %-15s %s\n", benches[i].name, benches[i].help);
+}
+
+int bench_run(const char *name)
+{
+    int matched = 0;
+    int all = strcmp(name, "all") == 0;
+
+    for (int i = 0; benches[i].name; i++)
+    {
+        if (!all && strcmp(name, benches[i].name) != 0)
+            continue;
+
+        /* A full run keeps the CPU well past watchdog_thresh on purpose */
+        watchdog_touch();
+        matched++;
+        memset(samples, 0, sizeof(samples));
+        int n = benches[i].run(samples);
+        report(benches[i].name, samples, n);
+    }
+
+    return matched ? 0 : -1;
+}
+
+void bench_set_boot_mode(const char *name)
+{
+    strncpy(boot_mode, name, sizeof(boot_mode) - 1);
+    boot_mode[sizeof(boot_mode) - 1] = '\0';
+}
+
+void bench_task_main(void)
+{
+    serial_printf("BENCH-START mode=%s\n", boot_mode);
+    int status = bench_run(boot_mode) == 0 ? 0 : 1;
+    serial_printf("BENCH-DONE status=%d\n", status);
+
+    /* QEMU exits with (status << 1) | 1; on real hardware this is a no-op */
+    outb(BENCH_EXIT_PORT, (uint8_t)status);
+
+    while (1)
+        asm volatile("hlt");
+}
@@ -0,0 +1,168 @@
+/**
+ * @file latency.c
+ * @brief Wakeup latency tester in the style of cyclictest.
+ *
+ * Each test thread runs at the highest priority and sleeps on an
+ * hrtimer until an absolute deadline, then records how late it woke up:
+ * clock_ns() after the wakeup minus the deadline. That covers the timer
+ * interrupt, the wakeup and the wait until the running task yields (the
+ * scheduler is cooperative). Latencies go into a histogram per CPU with
+ * 1us buckets.
+ */
+
+#include <valen/bench.h>
+#include <valen/task.h>
+#include <valen/clock.h>
+#include <valen/hrtimer.h>
+#include <valen/irqflags.h>
+#include <valen/smp.h>
+#include <valen/string.h>
+#include <valen/stdio.h>
+
+/* Where the shell waits for the threads, between checks */
+#define POLL_NS 10000000ULL
+
+struct lat_thread
+{
+    pid_t pid;
+    int cpu;
+    uint64_t count;
+    uint64_t min;
+    uint64_t max;
+    uint64_t sum;
+    uint64_t overruns; /* Deadlines skipped because the thread woke too late */
+    volatile int done;
+};
+
+static struct lat_thread threads[LATENCY_MAX_THREADS];
+static uint32_t hist[NR_CPUS][LATENCY_HIST_US + 1];
+static int nr_threads;
+static volatile int next_thread;
+static uint64_t interval_ns;
+static int loops;
+
+static void latency_thread_main(void)
+{
+    struct lat_thread *t = &threads[next_thread++];
+    uint64_t next = clock_ns() + interval_ns;
+
+    t->pid = get_current_pid();
+    t->cpu = smp_processor_id();
+    for (int i = 0; i < loops; i++)
+    {
+        task_sleep_until(next);
+        uint64_t now = clock_ns();
+        uint64_t lat = now > next ? now - next : 0;
+
+        t->count++;
+        t->sum += lat;
+        if (lat < t->min)
+            t->min = lat;
+        if (lat > t->max)
+            t->max = lat;
+        hist[t->cpu][lat / 1000 < LATENCY_HIST_US ? lat / 1000 : LATENCY_HIST_US]++;
+
+        next += interval_ns;
+        while (next <= now)
+        {
+            next += interval_ns;
+            t->overruns++;
+        }
+    }
+    t->done = 1;
+}
+
+static void report(void)
+{
+    puts("\n");
+    for (int i = 0; i < nr_threads; i++)
+    {
+        struct lat_thread *t = &threads[i];
+        uint64_t avg = t->count ? t->sum / t->count : 0;
+
+        printf_fmt("T:%d (%d) P:0 I:%llu C:%llu Min:%6llu Avg:%6llu Max:%8llu ns\n", i, t->pid,
+                   (unsigned long long)(interval_ns / 1000), (unsigned long long)t->count,
+                   (unsigned long long)t->min, (unsigned long long)avg, (unsigned long long)t->max);
+        serial_printf("LATENCY thread=%d cpu=%d unit=ns interval_us=%lu n=%lu min=%lu avg=%lu "
+                      "max=%lu overruns=%lu\n",
+                      i, t->cpu, interval_ns / 1000, t->count, t->min, avg, t->max, t->overruns);
+    }
+
+    for (int cpu = 0; cpu < NR_CPUS; cpu++)
+    {
+        int column = 0;
+        int shown = 0;
+
+        for (int us = 0; us <= LATENCY_HIST_US; us++)
+        {
+            if (!hist[cpu][us])
+                continue;
+            if (!shown++)
+                printf_fmt("\nCPU %d histogram (us: wakeups):\n", cpu);
+            if (column == 6)
+            {
+                puts("\n");
+                column = 0;
+            }
+            if (us < LATENCY_HIST_US)
+                printf_fmt("  %4d:%6u", us, hist[cpu][us]);
+            else
+                printf_fmt("  >=%d:%u", us, hist[cpu][us]);
+            column++;
+            serial_printf("LATENCY-HIST cpu=%d us=%d%s count=%u\n", cpu, us,
+                          us < LATENCY_HIST_US ? "" : "+", hist[cpu][us]);
+        }
+        if (shown)
+            puts("\n");
+    }
+}
+
+int latency_run(int nthreads, uint64_t interval_us, int nloops)
+{
+    if (nthreads < 1 || nthreads > LATENCY_MAX_THREADS || interval_us == 0 || nloops < 1)
+        return -1;
+
+    memset(threads, 0, sizeof(threads));
+    memset(hist, 0, sizeof(hist));
+    nr_threads = nthreads;
+    next_thread = 0;
+    interval_ns = interval_us * 1000;
+    loops = nloops;
+#ifdef CONFIG_IRQSOFF_TRACER
+    irqsoff_reset();
+#endif
+
+    if (!hrtimer_is_highres())
+        puts("No HPET one-shot timer: wakeups come from the tick, expect up to 1/pit_hz.\n");
+    printf_fmt("%d thread(s), %llu us interval, %d loops...\n", nthreads,
+               (unsigned long long)interval_us, nloops);
+    serial_printf("LATENCY-START threads=%d interval_us=%lu loops=%d\n", nthreads, interval_us,
+                  nloops);
+
+    for (int i = 0; i < nthreads; i++)
+        threads[i].min = ~0ULL;
+    for (int i = 0; i < nthreads; i++)
+    {
+        task_t *task = task_create(latency_thread_main, "cyclictest");
+        if (!task)
+        {
+            nr_threads = i;
+            break;
+        }
+        task_set_prio(task, 0);
+    }
+
+    /* Sleep rather than spin, so the test threads get the CPU */
+    for (int i = 0; i < nr_threads; i++)
+    {
+        while (!threads[i].done)
+            task_sleep_until(clock_ns() + POLL_NS);
+    }
+
+    report();
+#ifdef CONFIG_IRQSOFF_TRACER
+    irqsoff_dump();
+#endif
+    serial_printf("LATENCY-DONE\n");
+    return 0;
+}
@@ -0,0 +1,986 @@
+/**
+ * @file gdbstub.c
+ * @brief GDB remote serial protocol stub on COM2.
+ *
+ * gdb can attach to a running kernel at any time, without booting QEMU
+ * with -s -S:
+ *
+ *   make run EXTRA_ARGS="-serial tcp::1234,server,nowait"
+ *   gdb bin/valen.bin -ex 'target remote :1234'
+ *
+ * The first packet that arrives stops the kernel inside the COM2 interrupt.
+ * While stopped, the stub polls the UART with interrupts off and serves
+ * register and memory access, software breakpoints (Z0), single step and
+ * thread queries. Every task is a gdb thread (thread id = pid), and every
+ * stopped CPU has a thread of its own (GDB_CPU_TID_BASE + cpu) showing the
+ * exact trap frame.
+ *
+ * With gdb_sample enabled, register reads ('g', 'p') that arrive while the
+ * kernel runs are answered from the interrupted context and the kernel
+ * continues at once, which turns a periodic reader into a sampling
+ * profiler (scripts/gdb_sample.sh).
+ */
+
+#include <stdbool.h>
+#include <valen/gdbstub.h>
+#include <valen/io.h>
+#include <valen/idt.h>
+#include <valen/pic.h>
+#include <valen/task.h>
+#include <valen/smp.h>
+#include <valen/vmm.h>
+#include <valen/string.h>
+#include <valen/stdio.h>
+#include <valen/param.h>
+
+#define UART_DATA (GDB_COM_PORT + 0)
+#define UART_IER (GDB_COM_PORT + 1)
+#define UART_FCR (GDB_COM_PORT + 2)
+#define UART_LCR (GDB_COM_PORT + 3)
+#define UART_MCR (GDB_COM_PORT + 4)
+#define UART_LSR (GDB_COM_PORT + 5)
+
+#define LSR_DATA_READY 0x01
+#define LSR_THR_EMPTY 0x20
+
+#define GDB_BUF_SIZE 4096
+#define GDB_MAX_BREAKPOINTS 32
+
+/* gdb's x86-64 'g' packet: rax..r15 and rip are 64-bit, then eflags,
+ * cs, ss, ds, es, fs and gs as 32-bit values */
+#define GDB_NUM_REGS 24
+#define GDB_NUM_REGS64 17
+#define GDB_REG_RIP 16
+#define GDB_REG_RFLAGS 17
+
+#define GDB_SIGINT 2
+#define GDB_SIGILL 4
+#define GDB_SIGTRAP 5
+#define GDB_SIGBUS 7
+#define GDB_SIGFPE 8
+#define GDB_SIGSEGV 11
+
+#define RFLAGS_TF 0x100
+#define INT3 0xCC
+
+typedef enum
+{
+    GDB_STAY,
+    GDB_RESUME,
+} gdb_action_t;
+
+struct gdb_bp
+{
+    uint64_t addr;
+    uint8_t saved;
+    uint8_t active;
+};
+
+extern void gdb_serial_isr(void);
+
+static const char hexchars[] = "0123456789abcdef";
+
+static char in_buf[GDB_BUF_SIZE];
+static char out_buf[GDB_BUF_SIZE];
+
+static struct gdb_bp breakpoints[GDB_MAX_BREAKPOINTS];
+
+/* Trap frame of every CPU that is stopped in the stub */
+static struct pt_regs *cpu_regs[NR_CPUS];
+
+static int stop_signal;
+static int selected_tid; /* Hg; 0 means the thread that stopped */
+static int connected = 0;
+static int no_ack = 0;
+static volatile int in_stub = 0;
+
+static bool gdb_sample = false;
+param_bool(gdb_sample, gdb_sample, "Answer gdb register reads without stopping the kernel");
+
+static bool gdb_wait = false;
+param_bool(gdb_wait, gdb_wait, "Stop at boot until gdb attaches on COM2");
+
+/* --- UART --- */
+
+static void uart_init(void)
+{
+    outb(UART_IER, 0x00);
+    outb(UART_LCR, 0x80);  /* DLAB: set the divisor */
+    outb(UART_DATA, 0x01); /* 115200 baud */
+    outb(UART_IER, 0x00);
+    outb(UART_LCR, 0x03);  /* 8N1 */
+    outb(UART_FCR, 0x07);  /* FIFO on and cleared, interrupt per byte */
+    outb(UART_MCR, 0x0B);  /* DTR, RTS and OUT2, which gates the IRQ */
+    outb(UART_IER, 0x01);  /* Interrupt on received data */
+}
+
+static int uart_rx_ready(void)
+{
+    return inb(UART_LSR) & LSR_DATA_READY;
+}
+
+static char uart_getc(void)
+{
+    while (!uart_rx_ready())
+        ;
+    return inb(UART_DATA);
+}
+
+static void uart_putc(char c)
+{
+    while (!(inb(UART_LSR) & LSR_THR_EMPTY))
+        ;
+    outb(UART_DATA, c);
+}
+
+/* --- Hex encoding --- */
+
+static int hex_val(char c)
+{
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+    return -1;
+}
+
+static uint64_t parse_hex(const char **p)
+{
+    uint64_t v = 0;
+    int d;
+
+    while ((d = hex_val(**p)) >= 0)
+    {
+        v = (v << 4) | d;
+        (*p)++;
+    }
+    return v;
+}
+
+/** @brief Parses a thread id, which may be "-1" (all threads). */
+static int parse_tid(const char *p)
+{
+    if (p[0] == '-')
+        return -1;
+    return (int)parse_hex(&p);
+}
+
+static char *put_hex_byte(char *out, uint8_t b)
+{
+    *out++ = hexchars[b >> 4];
+    *out++ = hexchars[b & 0xF];
+    return out;
+}
+
+/** @brief Appends a value as little-endian target bytes. */
+static char *put_le(char *out, uint64_t v, int bytes)
+{
+    for (int i = 0; i < bytes; i++)
+        out = put_hex_byte(out, (uint8_t)(v >> (8 * i)));
+    return out;
+}
+
+static uint64_t get_le(const char **p, int bytes)
+{
+    uint64_t v = 0;
+
+    for (int i = 0; i < bytes; i++)
+    {
+        int hi = hex_val((*p)[0]);
+        int lo = hex_val((*p)[1]);
+        if (hi < 0 || lo < 0)
+            break;
+        v |= (uint64_t)((hi << 4) | lo) << (8 * i);
+        *p += 2;
+    }
+    return v;
+}
+
+static void put_string_hex(char *out, const char *s)
+{
+    while (*s)
+        out = put_hex_byte(out, (uint8_t)*s++);
+    *out = '\0';
+}
+
+/* --- Packets --- */
+
+/**
+ * @brief Reads a packet whose '$' was already consumed.
+ * @return 0 on success, -1 on a bad checksum (a retransmit is requested).
+ */
+static int get_packet_body(char *buf)
+{
+    uint8_t sum = 0;
+    int n = 0;
+    char c;
+
+    while ((c = uart_getc()) != '#')
+    {
+        /* A new '$' restarts the packet */
+        if (c == '$')
+        {
+            n = 0;
+            sum = 0;
+            continue;
+        }
+        if (n < GDB_BUF_SIZE - 1)
+            buf[n++] = c;
+        sum += (uint8_t)c;
+    }
+    buf[n] = '\0';
+
+    int hi = hex_val(uart_getc());
+    int lo = hex_val(uart_getc());
+
+    if (no_ack)
+        return 0;
+    if (hi < 0 || lo < 0 || ((hi << 4) | lo) != sum)
+    {
+        uart_putc('-');
+        return -1;
+    }
+    uart_putc('+');
+    return 0;
+}
+
+static void get_packet(char *buf)
+{
+    while (1)
+    {
+        /* Acks and a ^C that arrives while already stopped are ignored */
+        if (uart_getc() == '$' && get_packet_body(buf) == 0)
+            return;
+    }
+}
+
+static void put_packet(const char *buf)
+{
+    while (1)
+    {
+        uint8_t sum = 0;
+
+        uart_putc('$');
+        for (const char *p = buf; *p; p++)
+        {
+            uart_putc(*p);
+            sum += (uint8_t)*p;
+        }
+        uart_putc('#');
+        uart_putc(hexchars[sum >> 4]);
+        uart_putc(hexchars[sum & 0xF]);
+
+        if (no_ack)
+            return;
+
+        /* '-' asks for a retransmit */
+        char c;
+        do
+            c = uart_getc();
+        while (c != '+' && c != '-');
+        if (c == '+')
+            return;
+    }
+}
+
+/* --- Memory --- */
+
+static int canonical(uint64_t addr)
+{
+    return addr < 0x0000800000000000ULL || addr >= 0xFFFF800000000000ULL;
+}
+
+/**
+ * @brief Checks that every page of a range is mapped, so that a bad address
+ * from gdb gets an error reply instead of a page fault inside the stub.
+ */
+static int mem_ok(uint64_t addr, uint64_t len)
+{
+    if (len == 0)
+        return 1;
+
+    uint64_t end = addr + len - 1;
+    if (end < addr)
+        return 0;
+
+    for (uint64_t page = addr & ~0xFFFULL;; page += 4096)
+    {
+        if (!canonical(page) || !vmm_get_phys(page))
+            return 0;
+        if (page == (end & ~0xFFFULL))
+            return 1;
+    }
+}
+
+static struct gdb_bp *find_breakpoint(uint64_t addr)
+{
+    for (int i = 0; i < GDB_MAX_BREAKPOINTS; i++)
+    {
+        if (breakpoints[i].active && breakpoints[i].addr == addr)
+            return &breakpoints[i];
+    }
+    return NULL;
+}
+
+static int set_breakpoint(uint64_t addr)
+{
+    if (find_breakpoint(addr))
+        return 0;
+    if (!mem_ok(addr, 1))
+        return -1;
+
+    for (int i = 0; i < GDB_MAX_BREAKPOINTS; i++)
+    {
+        if (!breakpoints[i].active)
+        {
+            breakpoints[i].addr = addr;
+            breakpoints[i].saved = *(volatile uint8_t *)addr;
+            breakpoints[i].active = 1;
+            *(volatile uint8_t *)addr = INT3;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+static int clear_breakpoint(uint64_t addr)
+{
+    struct gdb_bp *bp = find_breakpoint(addr);
+    if (!bp)
+        return -1;
+
+    *(volatile uint8_t *)addr = bp->saved;
+    bp->active = 0;
+    return 0;
+}
+
+static void clear_all_breakpoints(void)
+{
+    for (int i = 0; i < GDB_MAX_BREAKPOINTS; i++)
+    {
+        if (breakpoints[i].active)
+            clear_breakpoint(breakpoints[i].addr);
+    }
+}
+
+/* --- Threads and registers --- */
+
+static int stop_tid(void)
+{
+    task_t *task = current_task;
+    return task ? task->pid : GDB_CPU_TID_BASE + smp_processor_id();
+}
+
+static task_t *find_task(int tid)
+{
+    /* Lockless: the stopped code may hold the runqueue lock */
+    for_each_task(t)
+    {
+        if (t->pid == tid)
+            return t;
+    }
+    return NULL;
+}
+
+/**
+ * @brief Returns the trap frame behind a thread id, if the thread is one
+ * that is executing on a stopped CPU rather than switched out.
+ */
+static struct pt_regs *thread_trap_regs(int tid)
+{
+    if (tid <= 0)
+        tid = stop_tid();
+
+    if (tid >= GDB_CPU_TID_BASE && tid < GDB_CPU_TID_BASE + NR_CPUS)
+        return cpu_regs[tid - GDB_CPU_TID_BASE];
+
+    task_t *task = current_task;
+    if (task && task->pid == tid)
+        return cpu_regs[smp_processor_id()];
+    return NULL;
+}
+
+static uint64_t *trap_reg(struct pt_regs *r, int n)
+{
+    switch (n)
+    {
+    case 0: return &r->rax;
+    case 1: return &r->rbx;
+    case 2: return &r->rcx;
+    case 3: return &r->rdx;
+    case 4: return &r->rsi;
+    case 5: return &r->rdi;
+    case 6: return &r->rbp;
+    case 7: return &r->rsp;
+    case 8: return &r->r8;
+    case 9: return &r->r9;
+    case 10: return &r->r10;
+    case 11: return &r->r11;
+    case 12: return &r->r12;
+    case 13: return &r->r13;
+    case 14: return &r->r14;
+    case 15: return &r->r15;
+    case 16: return &r->rip;
+    case 17: return &r->rflags;
+    case 18: return &r->cs;
+    case 19: return &r->ss;
+    default: return NULL;
+    }
+}
+
+/**
+ * @brief Fills regs in gdb order for a thread.
+ * @return 0, or -1 for an unknown thread.
+ */
+static int thread_regs(int tid, uint64_t *regs)
+{
+    uint16_t ds, es, fs, gs;
+    asm volatile("mov %%ds, %0" : "=r"(ds));
+    asm volatile("mov %%es, %0" : "=r"(es));
+    asm volatile("mov %%fs, %0" : "=r"(fs));
+    asm volatile("mov %%gs, %0" : "=r"(gs));
+
+    memset(regs, 0, GDB_NUM_REGS * sizeof(uint64_t));
+    regs[20] = ds;
+    regs[21] = es;
+    regs[22] = fs;
+    regs[23] = gs;
+
+    struct pt_regs *trap = thread_trap_regs(tid);
+    if (trap)
+    {
+        for (int n = 0; n < 20; n++)
+            regs[n] = *trap_reg(trap, n);
+        return 0;
+    }
+
+    task_t *task = find_task(tid);
+    if (!task)
+        return -1;
+
+    /* A switched-out task: switch_to() left r15, r14, r13, r12, rbx, rbp
+     * and its return address on the task's stack (arch/x86_64/context.s) */
+    uint64_t *sp = (uint64_t *)task->context.rsp;
+    if (!mem_ok((uint64_t)sp, 7 * sizeof(uint64_t)))
+        return -1;
+
+    regs[15] = sp[0];
+    regs[14] = sp[1];
+    regs[13] = sp[2];
+    regs[12] = sp[3];
+    regs[1] = sp[4];
+    regs[6] = sp[5];
+    regs[GDB_REG_RIP] = sp[6];
+    regs[7] = (uint64_t)(sp + 7);
+    regs[GDB_REG_RFLAGS] = 0x2;
+    regs[18] = 0x08;
+    regs[19] = 0x10;
+    return 0;
+}
+
+static int reg_size(int n)
+{
+    return n < GDB_NUM_REGS64 ? 8 : 4;
+}
+
+static int thread_alive(int tid)
+{
+    if (tid >= GDB_CPU_TID_BASE && tid < GDB_CPU_TID_BASE + NR_CPUS)
+        return cpu_regs[tid - GDB_CPU_TID_BASE] != NULL;
+    return find_task(tid) != NULL;
+}
+
+static char *put_tid(char *out, int tid, int first)
+{
+    if (!first)
+        *out++ = ',';
+    char tmp[12];
+    int n = 0;
+    do
+    {
+        tmp[n++] = hexchars[tid & 0xF];
+        tid >>= 4;
+    } while (tid);
+    while (n)
+        *out++ = tmp[--n];
+    return out;
+}
+
+static void thread_list(char *out)
+{
+    int first = 1;
+
+    *out++ = 'm';
+    for (int cpu = 0; cpu < NR_CPUS; cpu++)
+    {
+        if (cpu_regs[cpu])
+        {
+            out = put_tid(out, GDB_CPU_TID_BASE + cpu, first);
+            first = 0;
+        }
+    }
+    for_each_task(t)
+    {
+        /* Stay well inside the packet; gdb sees the rest as missing */
+        if (out - out_buf > GDB_BUF_SIZE - 16)
+            break;
+        out = put_tid(out, t->pid, first);
+        first = 0;
+    }
+    *out = '\0';
+}
+
+static void thread_extra_info(int tid, char *out)
+{
+    char text[64];
+
+    if (tid >= GDB_CPU_TID_BASE)
+    {
+        snprintf(text, sizeof(text), "CPU %d", tid - GDB_CPU_TID_BASE);
+    }
+    else
+    {
+        task_t *task = find_task(tid);
+        task_t *cur = current_task;
+        if (task)
+            snprintf(text, sizeof(text), "%s%s", task->comm, task == cur ? " (running)" : "");
+        else
+            snprintf(text, sizeof(text), "exited");
+    }
+    put_string_hex(out, text);
+}
+
+/* --- Commands --- */
+
+static int exception_signal(uint64_t vector)
+{
+    switch (vector)
+    {
+    case 0:
+    case 16:
+    case 19:
+        return GDB_SIGFPE;
+    case 1:
+    case 3:
+        return GDB_SIGTRAP;
+    case 6:
+        return GDB_SIGILL;
+    case 12:
+    case 13:
+    case 14:
+        return GDB_SIGSEGV;
+    default:
+        return GDB_SIGBUS;
+    }
+}
+
+static void stop_reply(char *out)
+{
+    char *p = out;
+    *p++ = 'T';
+    p = put_hex_byte(p, (uint8_t)stop_signal);
+    memcpy(p, "thread:", 7);
+    p = put_tid(p + 7, stop_tid(), 1);
+    *p++ = ';';
+    *p = '\0';
+}
+
+/**
+ * @brief 'monitor' commands (qRcmd). Output goes back as an 'O' packet.
+ */
+static void monitor_command(const char *hex)
+{
+    char cmd[64];
+    int n = 0;
+
+    while (hex[0] && hex[1] && n < (int)sizeof(cmd) - 1)
+    {
+        cmd[n++] = (char)((hex_val(hex[0]) << 4) | hex_val(hex[1]));
+        hex += 2;
+    }
+    cmd[n] = '\0';
+
+    const char *reply;
+    if (strcmp(cmd, "sample on") == 0)
+    {
+        gdb_sample = true;
+        reply = "sampling on: register reads no longer stop the kernel\n";
+    }
+    else if (strcmp(cmd, "sample off") == 0)
+    {
+        gdb_sample = false;
+        reply = "sampling off\n";
+    }
+    else
+    {
+        reply = "commands: sample on, sample off\n";
+    }
+
+    out_buf[0] = 'O';
+    put_string_hex(out_buf + 1, reply);
+    put_packet(out_buf);
+    put_packet("OK");
+}
+
+static void read_memory(const char *p, char *out)
+{
+    uint64_t addr = parse_hex(&p);
+    p++;
+    uint64_t len = parse_hex(&p);
+
+    if (len > (GDB_BUF_SIZE - 1) / 2)
+        len = (GDB_BUF_SIZE - 1) / 2;
+    if (!mem_ok(addr, len))
+    {
+        strcpy(out, "E14");
+        return;
+    }
+
+    for (uint64_t i = 0; i < len; i++)
+    {
+        /* Show the original byte under our own breakpoints */
+        struct gdb_bp *bp = find_breakpoint(addr + i);
+        uint8_t b = bp ? bp->saved : *(volatile uint8_t *)(addr + i);
+        out = put_hex_byte(out, b);
+    }
+    *out = '\0';
+}
+
+static void write_memory(const char *p, char *out)
+{
+    uint64_t addr = parse_hex(&p);
+    p++;
+    uint64_t len = parse_hex(&p);
+    p++;
+
+    if (strlen(p) < len * 2 || !mem_ok(addr, len))
+    {
+        strcpy(out, "E14");
+        return;
+    }
+
+    for (uint64_t i = 0; i < len; i++)
+    {
+        uint8_t b = (uint8_t)get_le(&p, 1);
+        struct gdb_bp *bp = find_breakpoint(addr + i);
+        if (bp)
+            bp->saved = b;
+        else
+            *(volatile uint8_t *)(addr + i) = b;
+    }
+    strcpy(out, "OK");
+}
+
+static void read_registers(char *out)
+{
+    uint64_t regs[GDB_NUM_REGS];
+
+    if (thread_regs(selected_tid, regs) != 0)
+    {
+        strcpy(out, "E01");
+        return;
+    }
+    for (int n = 0; n < GDB_NUM_REGS; n++)
+        out = put_le(out, regs[n], reg_size(n));
+    *out = '\0';
+}
+
+static void write_registers(const char *p, char *out)
+{
+    struct pt_regs *trap = thread_trap_regs(selected_tid);
+
+    /* Switched-out tasks are read-only */
+    if (!trap)
+    {
+        strcpy(out, "E01");
+        return;
+    }
+    for (int n = 0; n < 20 && *p; n++)
+        *trap_reg(trap, n) = get_le(&p, reg_size(n));
+    strcpy(out, "OK");
+}
+
+static void read_register(const char *p, char *out)
+{
+    int n = (int)parse_hex(&p);
+    uint64_t regs[GDB_NUM_REGS];
+
+    if (n >= GDB_NUM_REGS)
+    {
+        /* Registers beyond the core set (x87, SSE) are not tracked */
+        out[0] = '\0';
+        return;
+    }
+    if (thread_regs(selected_tid, regs) != 0)
+    {
+        strcpy(out, "E01");
+        return;
+    }
+    out = put_le(out, regs[n], reg_size(n));
+    *out = '\0';
+}
+
+static void write_register(const char *p, char *out)
+{
+    int n = (int)parse_hex(&p);
+    struct pt_regs *trap = thread_trap_regs(selected_tid);
+
+    if (*p++ != '=' || !trap || !trap_reg(trap, n))
+    {
+        strcpy(out, "E01");
+        return;
+    }
+    *trap_reg(trap, n) = get_le(&p, reg_size(n));
+    strcpy(out, "OK");
+}
+
+static void query(const char *p, char *out)
+{
+    if (strncmp(p, "qSupported", 10) == 0)
+        snprintf(out, GDB_BUF_SIZE, "PacketSize=%x;QStartNoAckMode+", GDB_BUF_SIZE);
+    else if (strcmp(p, "qAttached") == 0)
+        strcpy(out, "1");
+    else if (strcmp(p, "qC") == 0)
+    {
+        out[0] = 'Q';
+        out[1] = 'C';
+        *put_tid(out + 2, stop_tid(), 1) = '\0';
+    }
+    else if (strcmp(p, "qfThreadInfo") == 0)
+        thread_list(out);
+    else if (strcmp(p, "qsThreadInfo") == 0)
+        strcpy(out, "l");
+    else if (strncmp(p, "qThreadExtraInfo,", 17) == 0)
+        thread_extra_info(parse_tid(p + 17), out);
+    else
+        out[0] = '\0';
+}
+
+/**
+ * @brief Handles one packet while stopped.
+ * @return GDB_RESUME when the kernel should continue.
+ */
+static gdb_action_t handle_packet(struct pt_regs *regs, const char *p)
+{
+    char *out = out_buf;
+    out[0] = '\0';
+
+    switch (p[0])
+    {
+    case '?':
+        stop_reply(out);
+        break;
+    case 'g':
+        read_registers(out);
+        break;
+    case 'G':
+        write_registers(p + 1, out);
+        break;
+    case 'p':
+        read_register(p + 1, out);
+        break;
+    case 'P':
+        write_register(p + 1, out);
+        break;
+    case 'm':
+        read_memory(p + 1, out);
+        break;
+    case 'M':
+        write_memory(p + 1, out);
+        break;
+    case 'H':
+        if (p[1] == 'g')
+            selected_tid = parse_tid(p + 2);
+        strcpy(out, "OK");
+        break;
+    case 'T':
+        strcpy(out, thread_alive(parse_tid(p + 1)) ? "OK" : "E01");
+        break;
+    case 'Z':
+    case 'z':
+    {
+        /* Only software breakpoints; gdb falls back for other types */
+        if (p[1] != '0')
+            break;
+        const char *a = p + 3;
+        uint64_t addr = parse_hex(&a);
+        int err = p[0] == 'Z' ? set_breakpoint(addr) : clear_breakpoint(addr);
+        strcpy(out, err ? "E22" : "OK");
+        break;
+    }
+    case 'c':
+    case 's':
+    {
+        const char *a = p + 1;
+        if (*a)
+            regs->rip = parse_hex(&a);
+        if (p[0] == 's')
+            regs->rflags |= RFLAGS_TF;
+        else
+            regs->rflags &= ~RFLAGS_TF;
+        return GDB_RESUME;
+    }
+    case 'D':
+    case 'k':
+        clear_all_breakpoints();
+        regs->rflags &= ~RFLAGS_TF;
+        if (p[0] == 'D')
+            put_packet("OK");
+        connected = 0;
+        no_ack = 0;
+        return GDB_RESUME;
+    case 'q':
+        if (strncmp(p, "qRcmd,", 6) == 0)
+        {
+            monitor_command(p + 6);
+            return GDB_STAY;
+        }
+        query(p, out);
+        break;
+    case 'Q':
+        if (strcmp(p, "QStartNoAckMode") == 0)
+        {
+            put_packet("OK");
+            no_ack = 1;
+            return GDB_STAY;
+        }
+        break;
+    default:
+        /* Unsupported: the empty reply */
+        break;
+    }
+
+    put_packet(out);
+    return GDB_STAY;
+}
+
+/**
+ * @brief Stops this CPU and serves gdb until it resumes the kernel.
+ * @param first A packet that was already read, or NULL.
+ */
+static void gdb_stop(struct pt_regs *regs, int signal, const char *first)
+{
+    int cpu = smp_processor_id();
+    gdb_action_t action = GDB_STAY;
+
+    in_stub = 1;
+    cpu_regs[cpu] = regs;
+    stop_signal = signal;
+    selected_tid = 0;
+
+    if (first)
+    {
+        connected = 1;
+        action = handle_packet(regs, first);
+    }
+    else if (connected)
+    {
+        /* gdb is waiting for the reply to 'c', 's' or ^C */
+        stop_reply(out_buf);
+        put_packet(out_buf);
+    }
+
+    while (action == GDB_STAY)
+    {
+        get_packet(in_buf);
+        connected = 1;
+        action = handle_packet(regs, in_buf);
+    }
+
+    cpu_regs[cpu] = NULL;
+    in_stub = 0;
+}
+
+/**
+ * @brief Sampling: answers a register read from the interrupted context
+ * without stopping. Returns 0 for packets that need a stopped kernel.
+ */
+static int sample_packet(struct pt_regs *regs, const char *p)
+{
+    if (p[0] != 'g' && p[0] != 'p' && strncmp(p, "qSupported", 10) != 0 &&
+        strcmp(p, "QStartNoAckMode") != 0)
+        return 0;
+
+    int cpu = smp_processor_id();
+    in_stub = 1;
+    cpu_regs[cpu] = regs;
+    selected_tid = 0;
+    handle_packet(regs, p);
+    cpu_regs[cpu] = NULL;
+    in_stub = 0;
+    return 1;
+}
+
+static int handle_serial_irq(struct pt_regs *regs)
+{
+    while (uart_rx_ready())
+    {
+        char c = inb(UART_DATA);
+
+        if (c == 0x03)
+        {
+            pic_send_eoi(GDB_IRQ);
+            gdb_stop(regs, GDB_SIGINT, NULL);
+            return 1;
+        }
+        if (c != '$' || get_packet_body(in_buf) != 0)
+            continue;
+        if (gdb_sample && sample_packet(regs, in_buf))
+            continue;
+
+        /* Any other packet, e.g. gdb attaching: stop and serve it */
+        pic_send_eoi(GDB_IRQ);
+        gdb_stop(regs, GDB_SIGTRAP, in_buf);
+        return 1;
+    }
+
+    pic_send_eoi(GDB_IRQ);
+    return 1;
+}
+
+int gdb_handle_exception(struct pt_regs *regs)
+{
+    /* A fault inside the stub itself takes the normal crash path */
+    if (in_stub)
+        return 0;
+
+    switch (regs->vector)
+    {
+    case GDB_VECTOR:
+        return handle_serial_irq(regs);
+    case 1:
+        regs->rflags &= ~RFLAGS_TF;
+        asm volatile("mov %0, %%dr6" ::"r"(0ULL));
+        gdb_stop(regs, GDB_SIGTRAP, NULL);
+        return 1;
+    case 3:
+        /* Report our breakpoints at their address, not after the int3 */
+        if (find_breakpoint(regs->rip - 1))
+            regs->rip--;
+        gdb_stop(regs, GDB_SIGTRAP, NULL);
+        return 1;
+    default:
+        break;
+    }
+
+    /* Fatal exceptions: an attached gdb gets to look first. Moving rip
+     * past the fault resumes the kernel, anything else ends in the dump */
+    if (!connected)
+        return 0;
+
+    uint64_t rip = regs->rip;
+    gdb_stop(regs, exception_signal(regs->vector), NULL);
+    return regs->rip != rip;
+}
+
+void gdb_init(void)
+{
+    uart_init();
+    idt_set_descriptor(GDB_VECTOR, gdb_serial_isr, 0x8E);
+    pic_irq_enable(GDB_IRQ);
+
+    if (gdb_wait)
+        gdb_breakpoint();
+}
@@ -0,0 +1,95 @@
+/**
+ * @file kasan_test.c
+ * @brief Deliberate memory errors that KASAN must catch.
+ *
+ * Run by 'sanitize test'. Each case makes one bad access through a
+ * volatile pointer so the compiler keeps it, and passes if the report
+ * count went up. The reports themselves go to COM1 as usual; boot with
+ * kasan_multi_shot to see all of them.
+ */
+
+#include <valen/kasan.h>
+#include <valen/heap.h>
+#include <valen/pmm.h>
+#include <valen/stdio.h>
+
+static char test_global[10];
+
+static void heap_out_of_bounds(void)
+{
+    volatile char *p = malloc(13);
+    (void)p[13];
+    free((void *)p);
+}
+
+static void heap_use_after_free(void)
+{
+    volatile char *p = malloc(32);
+    free((void *)p);
+    (void)p[8];
+}
+
+static void heap_double_free(void)
+{
+    char *p = malloc(16);
+    free(p);
+    free(p);
+}
+
+static void heap_invalid_free(void)
+{
+    char *p = malloc(32);
+    free(p + 8);
+    free(p);
+}
+
+static void page_use_after_free(void)
+{
+    volatile char *p = pmm_alloc_page();
+    pmm_free_page((void *)p);
+    (void)p[100];
+}
+
+static void stack_out_of_bounds(void)
+{
+    volatile char buf[16];
+    volatile int i = 16;
+    (void)buf[i];
+}
+
+static void global_out_of_bounds(void)
+{
+    volatile char *p = test_global;
+    volatile int i = 10;
+    (void)p[i];
+}
+
+static const struct
+{
+    const char *name;
+    void (*fn)(void);
+} cases[] = {
+    {"heap-out-of-bounds", heap_out_of_bounds},
+    {"heap-use-after-free", heap_use_after_free},
+    {"double-free", heap_double_free},
+    {"invalid-free", heap_invalid_free},
+    {"page-use-after-free", page_use_after_free},
+    {"stack-out-of-bounds", stack_out_of_bounds},
+    {"global-out-of-bounds", global_out_of_bounds},
+};
+
+int kasan_selftest(void)
+{
+    int missed = 0;
+
+    for (unsigned i = 0; i < sizeof(cases) / sizeof(cases[0]); i++)
+    {
+        uint64_t before = kasan_report_count();
+        cases[i].fn();
+        int caught = kasan_report_count() > before;
+
+        printf("  kasan %s: %s\n", cases[i].name, caught ? "caught" : "MISSED");
+        missed += !caught;
+    }
+    return missed;
+}
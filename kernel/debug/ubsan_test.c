@@ -0,0 +1,89 @@
+/**
+ * @file ubsan_test.c
+ * @brief Deliberate undefined behaviour that UBSan must catch.
+ *
+ * Run by 'sanitize test'. Only cases that are harmless once reported are
+ * here: a division by zero would still fault after its report. Every
+ * source location is reported once per boot, so the test only runs once.
+ */
+
+#include <stdbool.h>
+#include <valen/ubsan.h>
+#include <valen/stdio.h>
+#include <valen/string.h>
+
+static void signed_overflow(void)
+{
+    volatile int x = 0x7fffffff;
+    volatile int y = x + 1;
+    (void)y;
+}
+
+static void shift_too_large(void)
+{
+    volatile int x = 1;
+    volatile int n = 32;
+    volatile int y = x << n;
+    (void)y;
+}
+
+static void negative_shift(void)
+{
+    volatile int x = 1;
+    volatile int n = -1;
+    volatile int y = x >> n;
+    (void)y;
+}
+
+static void index_out_of_bounds(void)
+{
+    int arr[4] = {0};
+    volatile int i = 4;
+    volatile int v = arr[i];
+    (void)v;
+}
+
+static void invalid_bool(void)
+{
+    volatile char raw = 3;
+    bool b;
+    memcpy(&b, (const void *)&raw, 1);
+    volatile int v = b;
+    (void)v;
+}
+
+static const struct
+{
+    const char *name;
+    void (*fn)(void);
+} cases[] = {
+    {"signed-overflow", signed_overflow},
+    {"shift-too-large", shift_too_large},
+    {"negative-shift", negative_shift},
+    {"index-out-of-bounds", index_out_of_bounds},
+    {"invalid-bool", invalid_bool},
+};
+
+int ubsan_selftest(void)
+{
+    static int ran = 0;
+    int missed = 0;
+
+    if (ran)
+    {
+        puts("  ubsan: already tested this boot (each location reports once)\n");
+        return 0;
+    }
+    ran = 1;
+
+    for (unsigned i = 0; i < sizeof(cases) / sizeof(cases[0]); i++)
+    {
+        uint64_t before = ubsan_report_count();
+        cases[i].fn();
+        int caught = ubsan_report_count() > before;
+
+        printf("  ubsan %s: %s\n", cases[i].name, caught ? "caught" : "MISSED");
+        missed += !caught;
+    }
+    return missed;
+}
@@ -0,0 +1,238 @@
+/**
+ * @file watchdog.c
+ * @brief Soft-lockup and hung-task detectors.
+ *
+ * Scheduling is cooperative, so a task that never yields keeps its CPU
+ * and the system just looks slow. schedule() stamps the time on every
+ * call, and the timer tick reports a CPU whose stamp is older than
+ * watchdog_thresh seconds, with the registers it interrupted. The tick
+ * keeps coming while a task spins, so the report needs nothing from the
+ * stuck CPU but interrupts.
+ *
+ * Hung tasks are the opposite case: a task in TASK_UNINTERRUPTIBLE that
+ * has not run for hung_task_timeout_secs. khungtaskd wakes every second
+ * and compares each such task's switch count with the one it saw last.
+ */
+
+#include <valen/watchdog.h>
+#include <valen/task.h>
+#include <valen/clock.h>
+#include <valen/panic.h>
+#include <valen/param.h>
+#include <valen/trace.h>
+#include <valen/smp.h>
+#include <valen/string.h>
+#include <valen/stdio.h>
+
+#define NSEC_PER_SEC 1000000000ULL
+
+/* How often khungtaskd looks, and trace events printed per report */
+#define HUNG_CHECK_NS NSEC_PER_SEC
+#define WATCHDOG_TRACE_EVENTS 16
+
+static int watchdog_thresh = 10;
+param_int(watchdog_thresh, watchdog_thresh, 0, 60,
+          "Seconds without scheduling before a soft lockup is reported (0: off)");
+static bool softlockup_panic = false;
+param_bool(softlockup_panic, softlockup_panic, "Panic on a soft lockup");
+
+static int hung_task_timeout_secs = 120;
+param_int(hung_task_timeout_secs, hung_task_timeout_secs, 0, 3600,
+          "Seconds blocked in TASK_UNINTERRUPTIBLE before a task is reported (0: off)");
+static int hung_task_warnings = 10;
+param_int(hung_task_warnings, hung_task_warnings, 0, 1000, "Hung-task reports left to print");
+static bool hung_task_panic = false;
+param_bool(hung_task_panic, hung_task_panic, "Panic on a hung task");
+
+static struct
+{
+    volatile uint64_t touched; /* clock_ns() of the last schedule(), 0 before the first */
+    volatile int reported;     /* The current lockup was reported */
+    uint64_t lockups;
+} cpu_watchdog[NR_CPUS];
+
+static uint64_t hung_reports;
+
+static void show_trace(void)
+{
+#ifdef CONFIG_TRACING
+    crash_printf("Last trace events:\n");
+    trace_dump(WATCHDOG_TRACE_EVENTS, crash_printf);
+#endif
+}
+
+void watchdog_touch(void)
+{
+    int cpu = smp_processor_id();
+
+    cpu_watchdog[cpu].touched = clock_ns();
+    cpu_watchdog[cpu].reported = 0;
+}
+
+void watchdog_tick(struct pt_regs *regs)
+{
+    int cpu = smp_processor_id();
+    uint64_t touched = cpu_watchdog[cpu].touched;
+
+    if (!watchdog_thresh || !touched || cpu_watchdog[cpu].reported)
+        return;
+
+    uint64_t stuck = clock_ns() - touched;
+    if (stuck < (uint64_t)watchdog_thresh * NSEC_PER_SEC)
+        return;
+
+    cpu_watchdog[cpu].reported = 1;
+    cpu_watchdog[cpu].lockups++;
+
+    /* The stuck task may hold the console lock: COM1 and the bottom row only */
+    task_t *task = current_task;
+    const char *comm = task ? task->comm : "boot";
+    int pid = task ? task->pid : 0;
+    uint64_t secs = stuck / NSEC_PER_SEC;
+
+    crash_notice("BUG: soft lockup - CPU#%d stuck for %llus [%s:%d] - see COM1", cpu,
+                 (unsigned long long)secs, comm, pid);
+    crash_printf("\n------------[ soft lockup ]------------\n");
+    crash_printf("BUG: soft lockup - CPU#%d stuck for %lus! [%s:%d]\n", cpu, secs, comm, pid);
+    show_regs(regs);
+    dump_backtrace(regs->rip, regs->rbp, crash_printf);
+    show_trace();
+    crash_printf("------------[ end of soft lockup ]------------\n");
+
+    if (softlockup_panic)
+        panic("softlockup: CPU#%d stuck for %lus [%s:%d]", cpu, secs, comm, pid);
+}
+
+static void report_hung_task(task_t *t, uint64_t blocked)
+{
+    /* switch_to() left rbp and the return address on top of the stack */
+    uint64_t *sp = (uint64_t *)t->context.rsp;
+    uint64_t secs = blocked / NSEC_PER_SEC;
+
+    printf("INFO: task %s:%d blocked for more than %llu seconds (details on COM1)\n", t->comm,
+           t->pid, (unsigned long long)secs);
+    crash_printf("\n------------[ hung task ]------------\n");
+    crash_printf("INFO: task %s:%d blocked for more than %lu seconds.\n", t->comm, t->pid, secs);
+    dump_backtrace(sp[6], sp[5], crash_printf);
+    show_trace();
+    crash_printf("------------[ end of hung task ]------------\n");
+
+    if (hung_task_panic)
+        panic("hung_task: %s:%d blocked for more than %lus", t->comm, t->pid, secs);
+}
+
+static void check_hung_task(task_t *t, uint64_t now)
+{
+    /* It ran since the last look: the blocked time starts over */
+    if (t->nr_switches != t->last_switch_count)
+    {
+        t->last_switch_count = t->nr_switches;
+        t->last_switch_time = now;
+        return;
+    }
+
+    uint64_t blocked = now - t->last_switch_time;
+    if (blocked < (uint64_t)hung_task_timeout_secs * NSEC_PER_SEC || !hung_task_warnings)
+        return;
+
+    /* Report again only after another full timeout */
+    t->last_switch_time = now;
+    hung_task_warnings--;
+    hung_reports++;
+    report_hung_task(t, blocked);
+}
+
+static void khungtaskd_main(void)
+{
+    while (1)
+    {
+        task_sleep_until(clock_ns() + HUNG_CHECK_NS);
+        if (!hung_task_timeout_secs)
+            continue;
+
+        uint64_t now = clock_ns();
+        for_each_task(t)
+        {
+            if (t->state == TASK_UNINTERRUPTIBLE)
+                check_hung_task(t, now);
+        }
+    }
+}
+
+void watchdog_init(void)
+{
+    if (!task_create(khungtaskd_main, "khungtaskd"))
+        printf("watchdog: cannot start khungtaskd, hung tasks go unreported\n");
+}
+
+void watchdog_dump(void)
+{
+    uint64_t now = clock_ns();
+
+    if (watchdog_thresh)
+        printf("\nSoft lockup after %d s%s\n", watchdog_thresh,
+               softlockup_panic ? ", then panic" : "");
+    else
+        puts("\nSoft-lockup detector off (watchdog_thresh=0)\n");
+    for (int cpu = 0; cpu < NR_CPUS; cpu++)
+    {
+        if (!cpu_watchdog[cpu].touched)
+            continue;
+        printf("  CPU%d: last scheduled %llu ms ago, %llu lockups\n", cpu,
+               (unsigned long long)((now - cpu_watchdog[cpu].touched) / 1000000),
+               (unsigned long long)cpu_watchdog[cpu].lockups);
+    }
+
+    if (hung_task_timeout_secs)
+        printf("\nHung task after %d s%s, %d reports left, %llu so far\n", hung_task_timeout_secs,
+               hung_task_panic ? ", then panic" : "", hung_task_warnings,
+               (unsigned long long)hung_reports);
+    else
+        puts("\nHung-task detector off (hung_task_timeout_secs=0)\n");
+    for_each_task(t)
+    {
+        if (t->state == TASK_UNINTERRUPTIBLE && t->last_switch_time)
+            printf("  %s (pid %d): blocked, not run for %llu s\n", t->comm, t->pid,
+                   (unsigned long long)((now - t->last_switch_time) / NSEC_PER_SEC));
+    }
+}
+
+static void hung_test_main(void)
+{
+    task_t *self = get_current_task();
+
+    /* Nothing ever wakes it; 'kill' ends it */
+    while (1)
+    {
+        self->state = TASK_UNINTERRUPTIBLE;
+        schedule();
+    }
+}
+
+int watchdog_test(const char *name)
+{
+    if (strcmp(name, "softlockup") == 0)
+    {
+        if (!watchdog_thresh)
+        {
+            puts("Soft-lockup detector is off (watchdog_thresh=0).\n");
+            return 0;
+        }
+        printf("Spinning for %d s with interrupts enabled...\n", watchdog_thresh + 2);
+        uint64_t end = clock_ns() + (uint64_t)(watchdog_thresh + 2) * NSEC_PER_SEC;
+        while (clock_ns() < end)
+            asm volatile("pause");
+        puts("Done.\n");
+        return 0;
+    }
+    if (strcmp(name, "hung") == 0)
+    {
+        task_t *t = task_create(hung_test_main, "hung_test");
+        if (!t)
+            return -1;
+        printf("Started hung_test (pid %d); reported after %d s, 'kill %d' ends it.\n", t->pid,
+               hung_task_timeout_secs, t->pid);
+        return 0;
+    }
+    return -1;
+}
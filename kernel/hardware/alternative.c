@@ -0,0 +1,81 @@
+/**
+ * @file alternative.c
+ * @brief Boot-time patching of ALTERNATIVE() sites.
+ *
+ * Each site records its original code, a replacement and the feature the
+ * replacement needs. On a CPU with the feature the replacement is copied
+ * over the original and the rest of the site is filled with long NOPs.
+ * Kernel text is still mapped writable, and only the boot CPU runs, so
+ * patching is plain stores followed by a serializing instruction.
+ */
+
+#include <valen/alternative.h>
+#include <valen/cpufeature.h>
+
+extern struct alt_instr __alt_instructions[];
+extern struct alt_instr __alt_instructions_end[];
+
+static int sites_patched;
+
+/* Recommended multi-byte NOPs (Intel SDM, NOP instruction), by length */
+static const uint8_t nops[8][8] = {
+    {0x90},
+    {0x66, 0x90},
+    {0x0F, 0x1F, 0x00},
+    {0x0F, 0x1F, 0x40, 0x00},
+    {0x0F, 0x1F, 0x44, 0x00, 0x00},
+    {0x66, 0x0F, 0x1F, 0x44, 0x00, 0x00},
+    {0x0F, 0x1F, 0x80, 0x00, 0x00, 0x00, 0x00},
+    {0x0F, 0x1F, 0x84, 0x00, 0x00, 0x00, 0x00, 0x00},
+};
+
+/**
+ * @brief Byte copy into kernel text. Not memcpy(): memcpy has sites of
+ * its own that are being patched.
+ */
+static void text_write(uint8_t *dst, const uint8_t *src, int len)
+{
+    for (int i = 0; i < len; i++)
+        ((volatile uint8_t *)dst)[i] = src[i];
+}
+
+/**
+ * @brief Fills len bytes with as few NOP instructions as possible.
+ */
+static void add_nops(uint8_t *p, int len)
+{
+    while (len > 0)
+    {
+        int n = len > 8 ? 8 : len;
+        text_write(p, nops[n - 1], n);
+        p += n;
+        len -= n;
+    }
+}
+
+int apply_alternatives(void)
+{
+    for (struct alt_instr *a = __alt_instructions; a < __alt_instructions_end; a++)
+    {
+        uint8_t *instr = (uint8_t *)&a->instr_offset + a->instr_offset;
+        const uint8_t *repl = (const uint8_t *)&a->repl_offset + a->repl_offset;
+
+        if (!boot_cpu_has(a->feature) || a->replacementlen > a->instrlen)
+            continue;
+
+        text_write(instr, repl, a->replacementlen);
+        add_nops(instr + a->replacementlen, a->instrlen - a->replacementlen);
+        sites_patched++;
+    }
+
+    /* Drop any prefetched copy of the old instructions */
+    uint32_t eax, ebx, ecx, edx;
+    cpuid_count(0, 0, &eax, &ebx, &ecx, &edx);
+    return sites_patched;
+}
+
+void alternatives_stats(int *total, int *patched)
+{
+    *total = __alt_instructions_end - __alt_instructions;
+    *patched = sites_patched;
+}
@@ -0,0 +1,244 @@
+/**
+ * @file cpufeature.c
+ * @brief CPUID feature detection.
+ *
+ * The boot CPU's feature flags are read once into boot_cpu_data.caps,
+ * one word per CPUID register. Code then either tests them at run time
+ * with boot_cpu_has(), or has its fast variant patched in at boot with
+ * ALTERNATIVE()/static_cpu_has(), so a single image built for plain
+ * x86-64 uses ERMS, POPCNT, CRC32 and friends wherever the CPU has them.
+ */
+
+#include <valen/cpufeature.h>
+#include <valen/param.h>
+#include <valen/string.h>
+#include <valen/stdio.h>
+
+struct cpuinfo_x86 boot_cpu_data;
+
+/* clearcpuid=erms,fsrm hides features, e.g. to compare variants */
+static char clearcpuid[128];
+param_string(clearcpuid, clearcpuid, PARAM_BOOT_ONLY, "Features to hide, comma separated");
+
+static const struct
+{
+    uint16_t feature;
+    const char *name;
+} feature_names[] = {
+    {X86_FEATURE_FPU, "fpu"},
+    {X86_FEATURE_TSC, "tsc"},
+    {X86_FEATURE_MSR, "msr"},
+    {X86_FEATURE_APIC, "apic"},
+    {X86_FEATURE_PGE, "pge"},
+    {X86_FEATURE_PAT, "pat"},
+    {X86_FEATURE_CLFLUSH, "clflush"},
+    {X86_FEATURE_FXSR, "fxsr"},
+    {X86_FEATURE_SSE2, "sse2"},
+    {X86_FEATURE_SSE3, "sse3"},
+    {X86_FEATURE_PCLMULQDQ, "pclmulqdq"},
+    {X86_FEATURE_PCID, "pcid"},
+    {X86_FEATURE_SSE4_2, "sse4_2"},
+    {X86_FEATURE_X2APIC, "x2apic"},
+    {X86_FEATURE_MOVBE, "movbe"},
+    {X86_FEATURE_POPCNT, "popcnt"},
+    {X86_FEATURE_TSC_DEADLINE, "tsc_deadline"},
+    {X86_FEATURE_XSAVE, "xsave"},
+    {X86_FEATURE_AVX, "avx"},
+    {X86_FEATURE_RDRAND, "rdrand"},
+    {X86_FEATURE_HYPERVISOR, "hypervisor"},
+    {X86_FEATURE_NX, "nx"},
+    {X86_FEATURE_GBPAGES, "pdpe1gb"},
+    {X86_FEATURE_RDTSCP, "rdtscp"},
+    {X86_FEATURE_LM, "lm"},
+    {X86_FEATURE_LAHF_LM, "lahf_lm"},
+    {X86_FEATURE_ABM, "abm"},
+    {X86_FEATURE_FSGSBASE, "fsgsbase"},
+    {X86_FEATURE_BMI1, "bmi1"},
+    {X86_FEATURE_AVX2, "avx2"},
+    {X86_FEATURE_SMEP, "smep"},
+    {X86_FEATURE_BMI2, "bmi2"},
+    {X86_FEATURE_ERMS, "erms"},
+    {X86_FEATURE_INVPCID, "invpcid"},
+    {X86_FEATURE_RDSEED, "rdseed"},
+    {X86_FEATURE_ADX, "adx"},
+    {X86_FEATURE_SMAP, "smap"},
+    {X86_FEATURE_CLFLUSHOPT, "clflushopt"},
+    {X86_FEATURE_CLWB, "clwb"},
+    {X86_FEATURE_UMIP, "umip"},
+    {X86_FEATURE_PKU, "pku"},
+    {X86_FEATURE_LA57, "la57"},
+    {X86_FEATURE_RDPID, "rdpid"},
+    {X86_FEATURE_FSRM, "fsrm"},
+    {X86_FEATURE_CONSTANT_TSC, "constant_tsc"},
+    {X86_FEATURE_XSAVEOPT, "xsaveopt"},
+    {X86_FEATURE_XSAVEC, "xsavec"},
+    {X86_FEATURE_XSAVES, "xsaves"},
+};
+
+#define NR_FEATURE_NAMES (sizeof(feature_names) / sizeof(feature_names[0]))
+
+const char *cpu_feature_name(int feature)
+{
+    for (uint64_t i = 0; i < NR_FEATURE_NAMES; i++)
+    {
+        if (feature_names[i].feature == feature)
+            return feature_names[i].name;
+    }
+    return NULL;
+}
+
+void cpu_clear_feature(int feature)
+{
+    boot_cpu_data.caps[feature / 32] &= ~(1U << (feature % 32));
+}
+
+static void read_model(struct cpuinfo_x86 *c)
+{
+    uint32_t eax, ebx, ecx, edx;
+
+    cpuid_count(0, 0, &c->max_leaf, &ebx, &ecx, &edx);
+    memcpy(c->vendor, &ebx, 4);
+    memcpy(c->vendor + 4, &edx, 4);
+    memcpy(c->vendor + 8, &ecx, 4);
+    c->vendor[12] = 0;
+
+    cpuid_count(1, 0, &eax, &ebx, &ecx, &edx);
+    c->family = (eax >> 8) & 0xF;
+    c->model = (eax >> 4) & 0xF;
+    c->stepping = eax & 0xF;
+    if (c->family == 0xF)
+        c->family += (eax >> 20) & 0xFF;
+    if (c->family >= 0x6)
+        c->model += ((eax >> 16) & 0xF) << 4;
+    c->caps[CPUID_1_EDX] = edx;
+    c->caps[CPUID_1_ECX] = ecx;
+
+    cpuid_count(0x80000000, 0, &c->max_ext_leaf, &ebx, &ecx, &edx);
+    if (c->max_ext_leaf < 0x80000000)
+        c->max_ext_leaf = 0;
+
+    /* Brand string, 16 bytes per leaf */
+    if (c->max_ext_leaf >= 0x80000004)
+    {
+        uint32_t *name = (uint32_t *)c->model_name;
+        for (uint32_t leaf = 0; leaf < 3; leaf++)
+            cpuid_count(0x80000002 + leaf, 0, &name[leaf * 4], &name[leaf * 4 + 1],
+                        &name[leaf * 4 + 2], &name[leaf * 4 + 3]);
+        c->model_name[48] = 0;
+    }
+}
+
+static void read_caps(struct cpuinfo_x86 *c)
+{
+    uint32_t eax, ebx, ecx, edx;
+
+    if (c->max_leaf >= 7)
+    {
+        cpuid_count(7, 0, &eax, &ebx, &ecx, &edx);
+        c->caps[CPUID_7_0_EBX] = ebx;
+        c->caps[CPUID_7_0_ECX] = ecx;
+        c->caps[CPUID_7_0_EDX] = edx;
+    }
+    if (c->max_leaf >= 0xD)
+    {
+        cpuid_count(0xD, 1, &eax, &ebx, &ecx, &edx);
+        c->caps[CPUID_D_1_EAX] = eax;
+    }
+    if (c->max_ext_leaf >= 0x80000001)
+    {
+        cpuid_count(0x80000001, 0, &eax, &ebx, &ecx, &edx);
+        c->caps[CPUID_80000001_EDX] = edx;
+        c->caps[CPUID_80000001_ECX] = ecx;
+    }
+    if (c->max_ext_leaf >= 0x80000007)
+    {
+        cpuid_count(0x80000007, 0, &eax, &ebx, &ecx, &edx);
+        c->caps[CPUID_80000007_EDX] = edx;
+    }
+
+    /* XSAVEOPT and friends mean nothing when XSAVE itself is absent */
+    if (!boot_cpu_has(X86_FEATURE_XSAVE))
+        c->caps[CPUID_D_1_EAX] = 0;
+}
+
+/**
+ * @brief Clears the features listed in clearcpuid=.
+ */
+static void apply_clearcpuid(void)
+{
+    const char *p = clearcpuid;
+
+    while (*p)
+    {
+        char name[24];
+        int len = 0;
+
+        while (*p && *p != ',')
+        {
+            if (len < (int)sizeof(name) - 1)
+                name[len++] = *p;
+            p++;
+        }
+        name[len] = 0;
+        if (*p == ',')
+            p++;
+        if (len == 0)
+            continue;
+
+        uint64_t i;
+        for (i = 0; i < NR_FEATURE_NAMES; i++)
+        {
+            if (strcmp(feature_names[i].name, name) == 0)
+            {
+                cpu_clear_feature(feature_names[i].feature);
+                break;
+            }
+        }
+        if (i == NR_FEATURE_NAMES)
+            printf("cpu: clearcpuid: unknown feature '%s'\n", name);
+    }
+}
+
+void cpu_detect(void)
+{
+    read_model(&boot_cpu_data);
+    read_caps(&boot_cpu_data);
+    apply_clearcpuid();
+    apply_alternatives();
+}
+
+void cpu_dump(void)
+{
+    struct cpuinfo_x86 *c = &boot_cpu_data;
+    int total, patched;
+
+    printf("\n%s, family %u model %u stepping %u\n", c->vendor, c->family, c->model, c->stepping);
+    if (c->model_name[0])
+    {
+        /* The brand string is often right-justified with spaces */
+        const char *name = c->model_name;
+        while (*name == ' ')
+            name++;
+        printf("%s\n", name);
+    }
+
+    puts("\nFeatures:");
+    int column = 0;
+    for (uint64_t i = 0; i < NR_FEATURE_NAMES; i++)
+    {
+        if (!boot_cpu_has(feature_names[i].feature))
+            continue;
+        int len = strlen(feature_names[i].name) + 1;
+        if (column + len > 72)
+        {
+            puts("\n ");
+            column = 0;
+        }
+        printf(" %s", feature_names[i].name);
+        column += len;
+    }
+    puts("\n");
+
+    alternatives_stats(&total, &patched);
+    printf("\nAlternatives: %d of %d sites patched\n", patched, total);
+}
@@ -1,7 +1,13 @@
 #include <valen/gdt.h>
+#include <valen/string.h>
 
-struct gdt_entry gdt[3];
+/* null, kernel code, kernel data, then the 16-byte TSS descriptor */
+struct gdt_entry gdt[5];
 struct gdt_ptr gp;
+struct tss tss;
+
+/* Known-good stacks for exceptions that must not trust the current one */
+static uint8_t ist_stacks[IST_COUNT][IST_STACK_SIZE] __attribute__((aligned(16)));
 
 extern void gdt_flush(uint64_t gdt_ptr);
 
@@ -18,9 +24,24 @@ void gdt_set_gate(int num, uint32_t base, uint32_t limit, uint8_t access, uint8_
     gdt[num].access = access;
 }
 
+/**
+ * @brief Installs the 64-bit TSS descriptor, which spans two GDT slots:
+ * a normal descriptor for the low 32 bits of the base, followed by the
+ * upper 32 bits of the base.
+ */
+static void gdt_set_tss(int num, uint64_t base, uint32_t limit)
+{
+    // Access: 0x89 -> Present, Ring 0, Available 64-bit TSS
+    gdt_set_gate(num, (uint32_t)base, limit, 0x89, 0x00);
+
+    uint32_t *high = (uint32_t *)&gdt[num + 1];
+    high[0] = (uint32_t)(base >> 32);
+    high[1] = 0;
+}
+
 void gdt_init()
 {
-    gp.limit = (sizeof(struct gdt_entry) * 3) - 1;
+    gp.limit = sizeof(gdt) - 1;
     gp.base = (uint64_t)&gdt;
 
     // Entry 0: Null Descriptor
@@ -35,5 +56,14 @@ void gdt_init()
     // Access: 0x92 (10010010b) -> Present, Ring 0, Data, Writable
     gdt_set_gate(2, 0, 0, 0x92, 0x00);
 
+    // Entries 3-4: Task State Segment, only used for its IST stack pointers
+    memset(&tss, 0, sizeof(tss));
+    for (int i = 0; i < IST_COUNT; i++)
+        tss.ist[i] = (uint64_t)&ist_stacks[i][IST_STACK_SIZE];
+    tss.iomap_base = sizeof(tss);
+    gdt_set_tss(3, (uint64_t)&tss, sizeof(tss) - 1);
+
     gdt_flush((uint64_t)&gp);
-}
\ No newline at end of file
+
+    asm volatile("ltr %w0" : : "r"(GDT_TSS_SELECTOR));
+}
@@ -9,7 +9,8 @@
 
 #include <valen/idt.h>
 #include <valen/pic.h>
-#include <valen/keyboard.h>
+#include <valen/irq.h>
+#include <valen/gdt.h>
 
 /* --- Global IDT Structures --- */
 
@@ -21,21 +22,9 @@ struct idt_ptr idtp;
 
 /* --- External Assembly Stubs --- */
 
-extern void page_fault_isr();
-extern void keyboard_isr();
-extern void generic_isr();
-extern void scheduler_tick();
-extern void timer_isr();
+extern void *exception_stub_table[32];
 extern void load_idt(struct idt_ptr *ptr);
 
-/* --- Generic Handler --- */
-
-void generic_handler(void)
-{
-    /* Generic interrupt handler - just send EOI and return */
-    pic_send_eoi(0);
-}
-
 /**
  * @brief Configures an individual IDT gate.
  * @param vector The interrupt vector index (0-255).
@@ -48,45 +37,52 @@ void idt_set_descriptor(uint8_t vector, void *isr, uint8_t flags)
 
     idt[vector].isr_low = addr & 0xFFFF;
     idt[vector].kernel_cs = 0x08; /* Kernel Code Segment Offset */
-    idt[vector].ist = 0;          /* Interrupt Stack Table (not used) */
+    idt[vector].ist = 0;          /* Current stack; see idt_set_ist() */
     idt[vector].attributes = flags;
     idt[vector].isr_mid = (addr >> 16) & 0xFFFF;
     idt[vector].isr_high = (addr >> 32) & 0xFFFFFFFF;
     idt[vector].reserved = 0;
 }
 
+/**
+ * @brief Makes a vector switch to a dedicated TSS stack on entry.
+ * @param ist IST slot 1-7, or 0 to stay on the interrupted stack.
+ */
+void idt_set_ist(uint8_t vector, uint8_t ist)
+{
+    idt[vector].ist = ist & 0x7;
+}
+
 /**
  * @brief Initializes the IDT and prepares the CPU for interrupt handling.
  * This function performs the following steps:
  * 1. Initialize PIC and remap interrupts
- * 2. Initialize all vectors with a default generic handler
- * 3. Register specific CPU exceptions (e.g., Page Faults)
- * 4. Register hardware IRQ stubs (Timer, Keyboard, Mouse)
- * 5. Load the IDT pointer into the CPU's IDTR register
+ * 2. Register all CPU exceptions, with IST stacks for #DF, NMI and #MC
+ * 3. Install the entry stubs of vectors 0x20-0xFF; drivers attach their
+ *    handlers later with request_irq()
+ * 4. Load the IDT pointer into the CPU's IDTR register
  */
 void idt_init()
 {
     /* 1. Initialize PIC and remap interrupts */
     pic_init();
 
-    /* 2. Initialize all vectors with a default generic handler to prevent triple faults */
-    for (int i = 0; i < 256; i++)
+    /* 2. Register CPU Exceptions (Vectors 0-31) */
+    for (int i = 0; i < 32; i++)
     {
-        idt_set_descriptor(i, generic_isr, 0x8E);
+        idt_set_descriptor(i, exception_stub_table[i], 0x8E);
     }
 
-    /* 3. Register CPU Exceptions (Vectors 0-31) */
-    /* Vector 14: Page Fault - Critical for Virtual Memory Management */
-    idt_set_descriptor(14, page_fault_isr, 0x8E);
+    /* These can arrive with a corrupt or exhausted stack (a stack overflow
+     * escalates to #DF), so they always run on their own */
+    idt_set_ist(2, IST_NMI);
+    idt_set_ist(8, IST_DOUBLE_FAULT);
+    idt_set_ist(18, IST_MACHINE_CHECK);
 
-    /* 4. Register Hardware IRQs */
-    /* IRQ 1: Keyboard - Vector 0x21 (0x20 + 1) */
-    idt_set_descriptor(33, keyboard_isr, 0x8E);
-    
-    /* IRQ 0: Timer - Vector 0x20 (0x20 + 0) */
-    idt_set_descriptor(32, timer_isr, 0x8E);
+    /* 3. Every other vector gets a stub that reports which one fired */
+    irq_init();
 
-    /* 5. Configure IDT Pointer and load into CPU register */
+    /* 4. Configure IDT Pointer and load into CPU register */
     idtp.limit = (sizeof(struct idt_entry) * 256) - 1;
     idtp.base = (uint64_t)&idt;
 
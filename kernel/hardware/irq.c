@@ -0,0 +1,144 @@
+/**
+ * @file irq.c
+ * @brief Vector registration, dispatch and per-vector accounting.
+ *
+ * Each vector from 0x20 up has two generated entry stubs. The full one
+ * saves every general purpose register into a struct pt_regs. The leaf
+ * one fills in only the caller-saved slots, which is all a handler
+ * declared with IRQF_LEAF can disturb. request_vector() points the IDT
+ * gate at one or the other, so a hot IRQ pays only for what its handler
+ * needs. Both end in irq_dispatch(), which times the handler and the EOI
+ * with the TSC.
+ */
+
+#include <valen/irq.h>
+#include <valen/idt.h>
+#include <valen/pic.h>
+#include <valen/tsc.h>
+#include <valen/irqflags.h>
+#include <valen/spinlock.h>
+#include <valen/stdio.h>
+
+struct irq_desc
+{
+    irq_handler_t handler;
+    const char *name;
+    int flags;
+    uint64_t count;
+    uint64_t cycles;
+    uint64_t max_cycles;
+    uint64_t spurious;
+};
+
+/* Entry stubs for vectors 0x20-0xFF, from arch/x86_64/interrupts.s */
+extern void *irq_entry_table[NR_VECTORS - FIRST_EXTERNAL_VECTOR];
+extern void *irq_leaf_entry_table[NR_VECTORS - FIRST_EXTERNAL_VECTOR];
+
+static struct irq_desc irq_desc[NR_VECTORS];
+static spinlock_t irq_desc_lock = SPINLOCK_INIT_NAMED("irq_desc_lock");
+
+void irq_init(void)
+{
+    for (int v = FIRST_EXTERNAL_VECTOR; v < NR_VECTORS; v++)
+        idt_set_descriptor(v, irq_entry_table[v - FIRST_EXTERNAL_VECTOR], 0x8E);
+}
+
+int request_vector(int vector, irq_handler_t handler, int flags, const char *name)
+{
+    if (vector < FIRST_EXTERNAL_VECTOR || vector >= NR_VECTORS || !handler)
+        return -1;
+
+    struct irq_desc *desc = &irq_desc[vector];
+    void **table = (flags & IRQF_LEAF) ? irq_leaf_entry_table : irq_entry_table;
+
+    spinlock_acquire(&irq_desc_lock);
+    if (desc->handler)
+    {
+        spinlock_release(&irq_desc_lock);
+        return -1;
+    }
+    desc->name = name;
+    desc->flags = flags;
+    desc->handler = handler;
+    idt_set_descriptor(vector, table[vector - FIRST_EXTERNAL_VECTOR], 0x8E);
+    spinlock_release(&irq_desc_lock);
+    return 0;
+}
+
+int request_irq(int irq, irq_handler_t handler, int flags, const char *name)
+{
+    if (irq < 0 || irq >= NR_IRQS)
+        return -1;
+    return request_vector(IRQ_VECTOR(irq), handler, flags, name);
+}
+
+void irq_dispatch(struct pt_regs *regs)
+{
+    uint64_t t0 = rdtsc();
+    int vector = regs->vector & 0xFF;
+    int irq = vector - FIRST_EXTERNAL_VECTOR;
+    int pic = irq >= 0 && irq < NR_IRQS;
+    struct irq_desc *desc = &irq_desc[vector];
+
+    /* The PICs report a request that went away before it was acknowledged
+     * as IRQ 7 or 15 with nothing in service. It must not be EOI'd, except
+     * on the master for a spurious IRQ 15 */
+    if ((irq == IRQ_LPT1 || irq == IRQ_ATA2) && !(pic_get_isr() & (1 << irq)))
+    {
+        desc->spurious++;
+        if (irq == IRQ_ATA2)
+            pic_send_eoi(IRQ_CASCADE);
+        return;
+    }
+
+    if (desc->handler)
+        desc->handler(regs);
+    if (pic)
+        pic_send_eoi(irq);
+
+    uint64_t cycles = rdtsc() - t0;
+    if (desc->handler)
+        irqsoff_record((uint64_t)desc->handler, cycles);
+    desc->count++;
+    desc->cycles += cycles;
+    if (cycles > desc->max_cycles)
+        desc->max_cycles = cycles;
+}
+
+void irqstat_dump(void)
+{
+    uint64_t total = 0;
+
+    printf_fmt("\n  %-4s %-3s %-10s %-4s %10s %8s %8s %5s\n", "Vec", "IRQ", "Handler", "Path",
+               "Count", "Avg", "Max", "Spur");
+    for (int v = FIRST_EXTERNAL_VECTOR; v < NR_VECTORS; v++)
+    {
+        struct irq_desc *desc = &irq_desc[v];
+        int irq = v - FIRST_EXTERNAL_VECTOR;
+        char line[4] = "-";
+
+        if (!desc->handler && !desc->count && !desc->spurious)
+            continue;
+        if (irq < NR_IRQS)
+            snprintf(line, sizeof(line), "%d", irq);
+        printf_fmt("  0x%02x %-3s %-10s %-4s %10llu %8llu %8llu %5llu\n", v, line,
+                   desc->handler ? desc->name : "(none)",
+                   (desc->flags & IRQF_LEAF) ? "leaf" : "full", (unsigned long long)desc->count,
+                   (unsigned long long)(desc->count ? desc->cycles / desc->count : 0),
+                   (unsigned long long)desc->max_cycles, (unsigned long long)desc->spurious);
+        total += desc->count;
+    }
+    printf_fmt("\n  %llu interrupts; Avg and Max are TSC cycles of handler plus EOI\n",
+               (unsigned long long)total);
+}
+
+void irqstat_reset(void)
+{
+    for (int v = 0; v < NR_VECTORS; v++)
+    {
+        irq_desc[v].count = 0;
+        irq_desc[v].cycles = 0;
+        irq_desc[v].max_cycles = 0;
+        irq_desc[v].spurious = 0;
+    }
+}
@@ -2,7 +2,7 @@
 #include <valen/io.h>
 #include <valen/spinlock.h>
 
-static spinlock_t pic_lock = SPINLOCK_INIT;
+static spinlock_t pic_lock = SPINLOCK_INIT_NAMED("pic_lock");
 
 /* Helper functions to wait for PIC command completion */
 static void pic_wait_command(uint16_t port)
@@ -0,0 +1,93 @@
+/**
+ * @file stack.c
+ * @brief Per-CPU IRQ stacks and stack high-water marks.
+ *
+ * The IRQ stubs move onto this CPU's IRQ stack before calling the
+ * handler, so an interrupt costs a task stack only the CPU frame and the
+ * saved registers, however deep the handler goes. #DF, NMI and #MC keep
+ * their IST stacks (gdt.c).
+ *
+ * Every stack is filled with STACK_POISON before first use. The lowest
+ * word that no longer holds the pattern marks the deepest the stack has
+ * ever been, which is what 'stacks' reports.
+ */
+
+#include <valen/stack.h>
+#include <valen/gdt.h>
+#include <valen/msr.h>
+#include <valen/smp.h>
+#include <valen/task.h>
+#include <valen/stdio.h>
+
+static uint8_t irq_stacks[NR_CPUS][IRQ_STACK_SIZE] __attribute__((aligned(16)));
+static struct irq_stack irq_stack_state[NR_CPUS];
+
+static const char *const ist_names[IST_COUNT] = {"#DF", "NMI", "#MC"};
+
+void stack_poison(void *base, uint64_t size)
+{
+    uint64_t *p = base;
+
+    for (uint64_t i = 0; i < size / 8; i++)
+        p[i] = STACK_POISON;
+}
+
+uint64_t stack_used(const void *base, uint64_t size)
+{
+    const uint64_t *p = base;
+    uint64_t i = 0;
+
+    while (i < size / 8 && p[i] == STACK_POISON)
+        i++;
+    return size - i * 8;
+}
+
+void irq_stack_init(void)
+{
+    int cpu = smp_processor_id();
+
+    for (int i = 0; i < IST_COUNT; i++)
+        stack_poison((void *)(tss.ist[i] - IST_STACK_SIZE), IST_STACK_SIZE);
+
+    stack_poison(irq_stacks[cpu], IRQ_STACK_SIZE);
+    irq_stack_state[cpu].top = (uint64_t)&irq_stacks[cpu][IRQ_STACK_SIZE];
+    irq_stack_state[cpu].depth = 0;
+    wrmsr(MSR_GS_BASE, (uint64_t)&irq_stack_state[cpu]);
+}
+
+int in_irq(void)
+{
+    return irq_stack_state[smp_processor_id()].depth != 0;
+}
+
+static void show_stack(const char *name, const void *base, uint64_t size)
+{
+    uint64_t used = stack_used(base, size);
+
+    printf_fmt("  %-20s %6llu %6llu %3llu%%\n", name, (unsigned long long)size,
+               (unsigned long long)used, (unsigned long long)(used * 100 / size));
+}
+
+void stack_dump(void)
+{
+    char name[24];
+
+    printf_fmt("\n  %-20s %6s %6s %4s\n", "Stack", "Size", "Peak", "Use");
+    for (int cpu = 0; cpu < NR_CPUS; cpu++)
+    {
+        if (!irq_stack_state[cpu].top)
+            continue;
+        snprintf(name, sizeof(name), "irq/%d", cpu);
+        show_stack(name, irq_stacks[cpu], IRQ_STACK_SIZE);
+    }
+    for (int i = 0; i < IST_COUNT; i++)
+    {
+        snprintf(name, sizeof(name), "ist/%s", ist_names[i]);
+        show_stack(name, (void *)(tss.ist[i] - IST_STACK_SIZE), IST_STACK_SIZE);
+    }
+    for_each_task(t)
+    {
+        snprintf(name, sizeof(name), "%d %s", t->pid, t->comm);
+        show_stack(name, t->stack, t->stack_size);
+    }
+}
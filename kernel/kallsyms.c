@@ -0,0 +1,54 @@
+/**
+ * @file kallsyms.c
+ * @brief Address to symbol lookup for backtraces.
+ *
+ * The table itself is generated at link time by scripts/kallsyms.sh and
+ * linked in as a separate object (see the Makefile).
+ */
+
+#include <valen/kallsyms.h>
+
+extern const uint64_t kallsyms_num;
+extern const uint64_t kallsyms_addresses[];
+extern const uint32_t kallsyms_offsets[];
+extern const char kallsyms_names[];
+
+extern char _code_start[];
+extern char _code_end[];
+
+const char *kallsyms_lookup(uint64_t addr, uint64_t *offset)
+{
+    if (kallsyms_num == 0 || addr < (uint64_t)_code_start || addr >= (uint64_t)_code_end)
+        return 0;
+
+    /* Last symbol at or below addr */
+    uint64_t lo = 0, hi = kallsyms_num;
+    while (hi - lo > 1)
+    {
+        uint64_t mid = (lo + hi) / 2;
+        if (kallsyms_addresses[mid] <= addr)
+            lo = mid;
+        else
+            hi = mid;
+    }
+
+    if (kallsyms_addresses[lo] > addr)
+        return 0;
+
+    if (offset)
+        *offset = addr - kallsyms_addresses[lo];
+    return &kallsyms_names[kallsyms_offsets[lo]];
+}
+
+uint64_t kallsyms_build_id(void)
+{
+    /* FNV-1a over the symbol addresses and the code size */
+    uint64_t hash = 0xcbf29ce484222325ULL ^ ((uint64_t)_code_end - (uint64_t)_code_start);
+
+    for (uint64_t i = 0; i < kallsyms_num; i++)
+    {
+        hash ^= kallsyms_addresses[i];
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
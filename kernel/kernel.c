@@ -10,15 +10,42 @@
 #include <valen/shell.h>
 #include <valen/keyboard.h>
 #include <valen/task.h>
-#include <valen/pit.h>
+#include <valen/clock.h>
+#include <valen/string.h>
+#include <valen/param.h>
+#include <valen/crashdump.h>
+#include <valen/gdbstub.h>
+#include <valen/kasan.h>
+#include <valen/acpi.h>
+#include <valen/numa.h>
+#include <valen/cpufeature.h>
+#include <valen/stack.h>
+#include <valen/watchdog.h>
+#include <valen/kmemleak.h>
+#include <valen/crc32c.h>
+#ifdef CONFIG_BENCH
+#include <valen/bench.h>
+#endif
  
-int system_ready = 0;
+volatile int system_ready = 0;
  
 #define KERNEL_VIRT_OFFSET 0xFFFFFFFF80000000ULL
 #define PHYS_TO_VIRT(p) ((void *)((uint64_t)(p) + KERNEL_VIRT_OFFSET))
 #define VIRT_TO_PHYS(v) ((uint64_t)(v) - KERNEL_VIRT_OFFSET)
  
 extern char _kernel_end[];
+
+/* Copy of the multiboot command line; the tag itself may be reused later */
+static char cmdline[256];
+
+/* Same for the ACPI RSDP, read by acpi_init() once paging can map tables */
+static struct acpi_rsdp acpi_rsdp;
+
+#ifdef CONFIG_BENCH
+/* bench=<name|all> boots into the benchmark suite instead of the shell */
+static char bench_mode[32];
+param_string(bench, bench_mode, PARAM_BOOT_ONLY, "Benchmark to run headless at boot");
+#endif
  
 void kmain(unsigned long magic, unsigned long addr)
 {
@@ -26,6 +53,7 @@ void kmain(unsigned long magic, unsigned long addr)
 
     idt_init();
     gdt_init();
+    irq_stack_init();  // IRQs run on their own stack once enabled
     
     if (magic != MULTIBOOT2_BOOTLOADER_MAGIC)
     {
@@ -35,11 +63,26 @@ void kmain(unsigned long magic, unsigned long addr)
 
     uint64_t max_physical_addr = 0;
     struct multiboot_tag_mmap *mmap_tag = NULL;
+    int have_rsdp = 0;
 
     struct multiboot_tag *tag = (struct multiboot_tag *)PHYS_TO_VIRT(addr + 8);
     while (tag->type != MULTIBOOT_TAG_TYPE_END)
     {
-        if (tag->type == MULTIBOOT_TAG_TYPE_MMAP)
+        if (tag->type == MULTIBOOT_TAG_TYPE_CMDLINE)
+        {
+            struct multiboot_tag_string *str = (struct multiboot_tag_string *)tag;
+            strncpy(cmdline, str->string, sizeof(cmdline) - 1);
+        }
+        else if (tag->type == MULTIBOOT_TAG_TYPE_ACPI_NEW ||
+                 (tag->type == MULTIBOOT_TAG_TYPE_ACPI_OLD && !have_rsdp))
+        {
+            // Prefer the 2.0+ RSDP (XSDT) when GRUB passes both
+            uint32_t len = tag->size - sizeof(struct multiboot_tag);
+            memcpy(&acpi_rsdp, ((struct multiboot_tag_acpi *)tag)->rsdp,
+                   len < sizeof(acpi_rsdp) ? len : sizeof(acpi_rsdp));
+            have_rsdp = 1;
+        }
+        else if (tag->type == MULTIBOOT_TAG_TYPE_MMAP)
         {
             mmap_tag = (struct multiboot_tag_mmap *)tag;
             uint32_t entries = (mmap_tag->size - sizeof(struct multiboot_tag_mmap)) / mmap_tag->entry_size;
@@ -56,6 +99,10 @@ void kmain(unsigned long magic, unsigned long addr)
         tag = (struct multiboot_tag *)((uint8_t *)tag + ((tag->size + 7) & ~7));
     }
 
+    param_parse_cmdline(cmdline);
+    cpu_detect();  // Feature flags, then ALTERNATIVE() patching (clearcpuid= applies)
+    crc32c_init();  // Tables for CPUs without SSE4.2
+
     if (max_physical_addr == 0)
         max_physical_addr = 0x20000000;
 
@@ -75,7 +122,8 @@ void kmain(unsigned long magic, unsigned long addr)
             {
                 for (uint64_t a = mmap_tag->entries[i].addr; a < mmap_tag->entries[i].addr + mmap_tag->entries[i].len; a += 4096)
                 {
-                    if (a < 0x200000 || (a >= bitmap_phys && a < b_end))
+                    if (a < 0x200000 || (a >= bitmap_phys && a < b_end) || crashdump_reserved(a) ||
+                        kasan_reserved(a))
                         continue;
                     pmm_mark_free(a);
                 }
@@ -83,17 +131,48 @@ void kmain(unsigned long magic, unsigned long addr)
         }
     }
  
+#ifdef CONFIG_CRASHDUMP
+    crashdump_init();
+#endif
+
+#ifdef CONFIG_KASAN
+    // Before the first allocation: heap and PMM poison from here on
+    kasan_init(max_physical_addr);
+#endif
+
     vmm_init();
+    console_map_wc();
     heap_init();
+    acpi_init(have_rsdp ? &acpi_rsdp : NULL);
+    numa_init();  // Splits the PMM into nodes; allocations are node-local from here
     keyboard_init();
-    pit_init(50);  // 50Hz timer for responsive scheduling
+    clock_init();  // HPET or PIT tick at pit_hz (50Hz by default)
     scheduler_init();
+    watchdog_init();  // khungtaskd; the soft-lockup check runs from the tick
+    kmemleak_init();  // Periodic leak scans
+
+#ifdef CONFIG_GDB_STUB
+    // gdb can attach on COM2 from here on (gdb_wait stops until it does)
+    gdb_init();
+#endif
     
-    // Create shell task
-    task_t *shell_task = task_create(shell_task_main, "shell");
-    if (!shell_task) {
-        printf("Failed to create shell task!\n");
-        while (1) asm volatile("hlt");
+#ifdef CONFIG_BENCH
+    // Headless benchmark runs replace the shell (bench=<name|all>)
+    if (bench_mode[0]) {
+        bench_set_boot_mode(bench_mode);
+        if (!task_create(bench_task_main, "bench")) {
+            printf("Failed to create bench task!\n");
+            while (1) asm volatile("hlt");
+        }
+    } else
+#endif
+    {
+        // Create shell task
+        task_t *shell_task = task_create(shell_task_main, "shell");
+        if (!shell_task) {
+            printf("Failed to create shell task!\n");
+            while (1) asm volatile("hlt");
+        }
     }
 
     set_color(COLOR_DARK_GREY);
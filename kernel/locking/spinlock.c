@@ -1,5 +1,55 @@
 #include <valen/spinlock.h>
 
+#ifdef CONFIG_LOCKSTAT
+#include <valen/stdio.h>
+
+/* Every lock that has been acquired at least once, newest first */
+static spinlock_t *lockstat_list;
+
+/**
+ * @brief Accounts one acquisition; called with the lock held.
+ */
+static void lockstat_acquired(spinlock_t *lock, uint64_t spins)
+{
+    lock->acquired++;
+    if (spins) {
+        lock->contended++;
+        lock->spins += spins;
+    }
+
+    if (!lock->registered) {
+        lock->registered = 1;
+        /* Lockless push: registering must not take another spinlock */
+        spinlock_t *head = __atomic_load_n(&lockstat_list, __ATOMIC_RELAXED);
+        do {
+            lock->stat_next = head;
+        } while (!__atomic_compare_exchange_n(&lockstat_list, &head, lock, 0,
+                                              __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+    }
+}
+
+void lockstat_dump(void)
+{
+    printf_fmt("  %-20s %12s %10s %12s\n", "lock", "acquired", "contended", "spins");
+    for (spinlock_t *l = lockstat_list; l; l = l->stat_next) {
+        char addr[20];
+        if (!l->name)
+            snprintf(addr, sizeof(addr), "%p", (void *)l);
+        printf_fmt("  %-20s %12lu %10lu %12lu\n", l->name ? l->name : addr, l->acquired,
+                   l->contended, l->spins);
+    }
+}
+
+void lockstat_reset(void)
+{
+    for (spinlock_t *l = lockstat_list; l; l = l->stat_next) {
+        l->acquired = 0;
+        l->contended = 0;
+        l->spins = 0;
+    }
+}
+#endif
+
 void spinlock_init(spinlock_t *lock)
 {
     lock->lock = 0;
@@ -7,6 +57,10 @@ void spinlock_init(spinlock_t *lock)
 
 void spinlock_acquire(spinlock_t *lock)
 {
+#ifdef CONFIG_LOCKSTAT
+    uint64_t spins = 0;
+#endif
+
     while (1) {
         uint32_t expected = 0;
         uint32_t desired = 1;
@@ -23,7 +77,14 @@ void spinlock_acquire(spinlock_t *lock)
         }
         
         asm volatile ("pause");
+#ifdef CONFIG_LOCKSTAT
+        spins++;
+#endif
     }
+
+#ifdef CONFIG_LOCKSTAT
+    lockstat_acquired(lock, spins);
+#endif
 }
 
 void spinlock_release(spinlock_t *lock)
@@ -48,5 +109,9 @@ uint8_t spinlock_try_acquire(spinlock_t *lock)
         : "memory", "cc"
     );
     
+#ifdef CONFIG_LOCKSTAT
+    if (expected == 0)
+        lockstat_acquired(lock, 0);
+#endif
     return (expected == 0);
 }
\ No newline at end of file
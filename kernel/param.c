@@ -0,0 +1,176 @@
+/**
+ * @file param.c
+ * @brief Kernel command line parsing and runtime tunables.
+ *
+ * Tunables are declared next to the variable they control with the
+ * param_* macros, which place a descriptor in the .params section. The
+ * command line is applied once at boot; sysctl reads and writes the same
+ * descriptors afterwards.
+ */
+
+#include <valen/param.h>
+#include <valen/string.h>
+#include <valen/stdio.h>
+
+/**
+ * @brief Parses a decimal or 0x-prefixed hexadecimal integer.
+ * @return 0 on success, -1 if str is not entirely a number.
+ */
+static int parse_long(const char *str, long *out)
+{
+    int negative = 0;
+    int base = 10;
+    long result = 0;
+
+    if (*str == '-' || *str == '+')
+        negative = *str++ == '-';
+
+    if (str[0] == '0' && (str[1] == 'x' || str[1] == 'X'))
+    {
+        base = 16;
+        str += 2;
+    }
+
+    if (!*str)
+        return -1;
+
+    for (; *str; str++)
+    {
+        int digit;
+        if (*str >= '0' && *str <= '9')
+            digit = *str - '0';
+        else if (base == 16 && *str >= 'a' && *str <= 'f')
+            digit = *str - 'a' + 10;
+        else if (base == 16 && *str >= 'A' && *str <= 'F')
+            digit = *str - 'A' + 10;
+        else
+            return -1;
+        result = result * base + digit;
+    }
+
+    *out = negative ? -result : result;
+    return 0;
+}
+
+static int parse_bool(const char *str, bool *out)
+{
+    if (!strcmp(str, "1") || !strcmp(str, "y") || !strcmp(str, "on") || !strcmp(str, "true"))
+        *out = true;
+    else if (!strcmp(str, "0") || !strcmp(str, "n") || !strcmp(str, "off") || !strcmp(str, "false"))
+        *out = false;
+    else
+        return -1;
+    return 0;
+}
+
+const kernel_param_t *param_find(const char *name)
+{
+    for_each_param(p)
+    {
+        if (strcmp(p->name, name) == 0)
+            return p;
+    }
+    return NULL;
+}
+
+int param_set(const kernel_param_t *param, const char *value, int runtime)
+{
+    if (runtime && (param->flags & PARAM_BOOT_ONLY))
+        return -2;
+
+    switch (param->type)
+    {
+    case PARAM_INT:
+    {
+        long v;
+        if (parse_long(value, &v) != 0 || v < param->min || v > param->max)
+            return -1;
+        *(int *)param->value = (int)v;
+        break;
+    }
+    case PARAM_BOOL:
+    {
+        bool v;
+        if (parse_bool(value, &v) != 0)
+            return -1;
+        *(bool *)param->value = v;
+        break;
+    }
+    case PARAM_STRING:
+        strncpy((char *)param->value, value, param->len - 1);
+        ((char *)param->value)[param->len - 1] = '\0';
+        break;
+    }
+
+    if (runtime && param->notify)
+        param->notify(param);
+    return 0;
+}
+
+void param_format(const kernel_param_t *param, char *buf, uint64_t len)
+{
+    switch (param->type)
+    {
+    case PARAM_INT:
+        snprintf(buf, len, "%d", *(int *)param->value);
+        break;
+    case PARAM_BOOL:
+        snprintf(buf, len, "%s", *(bool *)param->value ? "on" : "off");
+        break;
+    case PARAM_STRING:
+        snprintf(buf, len, "%s", (char *)param->value);
+        break;
+    }
+}
+
+void param_parse_cmdline(const char *cmdline)
+{
+    const char *p = cmdline;
+
+    while (*p)
+    {
+        while (*p == ' ')
+            p++;
+        if (!*p)
+            break;
+
+        /* Split one "name[=value]" token into bounded copies */
+        char name[32];
+        char value[128];
+        int n = 0, v = 0;
+
+        while (*p && *p != ' ' && *p != '=')
+        {
+            if (n < (int)sizeof(name) - 1)
+                name[n++] = *p;
+            p++;
+        }
+        name[n] = '\0';
+
+        if (*p == '=')
+        {
+            p++;
+            while (*p && *p != ' ')
+            {
+                if (v < (int)sizeof(value) - 1)
+                    value[v++] = *p;
+                p++;
+            }
+            value[v] = '\0';
+        }
+        else
+        {
+            /* A bare name switches a bool on */
+            strcpy(value, "1");
+        }
+
+        const kernel_param_t *param = param_find(name);
+        if (!param)
+        {
+            serial_printf("param: unknown parameter '%s'\n", name);
+            continue;
+        }
+        if (param_set(param, value, 0) != 0)
+            serial_printf("param: invalid value '%s' for '%s'\n", value, name);
+    }
+}
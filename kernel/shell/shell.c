@@ -16,6 +16,24 @@
 #include <valen/spinlock.h>
 #include <valen/color.h>
 #include <valen/keyboard.h>
+#include <valen/trace.h>
+#include <valen/param.h>
+#include <valen/crashdump.h>
+#include <valen/acpi.h>
+#include <valen/numa.h>
+#include <valen/clock.h>
+#include <valen/cpufeature.h>
+#include <valen/pat.h>
+#include <valen/stack.h>
+#include <valen/irq.h>
+#include <valen/irqflags.h>
+#include <valen/kasan.h>
+#include <valen/ubsan.h>
+#include <valen/watchdog.h>
+#include <valen/kmemleak.h>
+#ifdef CONFIG_BENCH
+#include <valen/bench.h>
+#endif
 
 #define MAX_BUFFER 256
 #define PROMPT "valen >> "
@@ -25,7 +43,7 @@ static char input_buffer[MAX_BUFFER];
 static int buffer_len = 0;
 static int cursor_idx = 0;
 static int prompt_start_y = 1;
-static spinlock_t shell_lock = SPINLOCK_INIT;
+static spinlock_t shell_lock = SPINLOCK_INIT_NAMED("shell_lock");
 
 /**
  * @brief Resets shell state and initializes prompt.
@@ -92,6 +110,41 @@ static void cmd_mem(const char *arg);
 static void cmd_tasks(const char *arg);
 static void cmd_kill(const char *arg);
 static void cmd_reboot(const char *arg);
+static void cmd_sysctl(const char *arg);
+static void cmd_acpi(const char *arg);
+static void cmd_clock(const char *arg);
+static void cmd_cpuinfo(const char *arg);
+static void cmd_pat(const char *arg);
+static void cmd_stacks(const char *arg);
+static void cmd_irqstat(const char *arg);
+#ifdef CONFIG_NUMA
+static void cmd_numa(const char *arg);
+#endif
+#ifdef CONFIG_BENCH
+static void cmd_bench(const char *arg);
+static void cmd_cyclictest(const char *arg);
+#endif
+#ifdef CONFIG_TRACING
+static void cmd_trace(const char *arg);
+#endif
+#ifdef CONFIG_LOCKSTAT
+static void cmd_lockstat(const char *arg);
+#endif
+#ifdef CONFIG_IRQSOFF_TRACER
+static void cmd_irqsoff(const char *arg);
+#endif
+#ifdef CONFIG_LOCKUP_DETECTOR
+static void cmd_watchdog(const char *arg);
+#endif
+#ifdef CONFIG_KMEMLEAK
+static void cmd_kmemleak(const char *arg);
+#endif
+#ifdef CONFIG_CRASHDUMP
+static void cmd_crashdump(const char *arg);
+#endif
+#if defined(CONFIG_KASAN) || defined(CONFIG_UBSAN)
+static void cmd_sanitize(const char *arg);
+#endif
 
 // Command structure
 typedef struct {
@@ -108,6 +161,41 @@ static const command_t commands[] = {
     {"tasks", cmd_tasks, "List running tasks"},
     {"kill", cmd_kill, "Kill a task (usage: kill <pid>)"},
     {"reboot", cmd_reboot, "Restart the system via PS/2"},
+    {"sysctl", cmd_sysctl, "Show or set tunables (usage: sysctl [name[=value]])"},
+    {"acpi", cmd_acpi, "Show ACPI tables, CPUs, interrupt controllers and NUMA nodes"},
+    {"clock", cmd_clock, "Show clocksources and timers (usage: clock [test])"},
+    {"cpuinfo", cmd_cpuinfo, "Show CPU model, feature flags and patched alternatives"},
+    {"pat", cmd_pat, "Show PAT memory types and typed physical mappings"},
+    {"stacks", cmd_stacks, "Show peak usage of the IRQ, IST and task stacks"},
+    {"irqstat", cmd_irqstat, "Show per-vector interrupt counts and cycles ('irqstat reset')"},
+#ifdef CONFIG_NUMA
+    {"numa", cmd_numa, "Show NUMA nodes, free memory per node and task placement"},
+#endif
+#ifdef CONFIG_BENCH
+    {"bench", cmd_bench, "Run microbenchmarks (usage: bench [all|list|<name>])"},
+    {"cyclictest", cmd_cyclictest, "Wakeup latency (usage: cyclictest [threads] [interval_us] [loops])"},
+#endif
+#ifdef CONFIG_TRACING
+    {"trace", cmd_trace, "Show recent trace events (usage: trace [count])"},
+#endif
+#ifdef CONFIG_LOCKSTAT
+    {"lockstat", cmd_lockstat, "Spinlock statistics (usage: lockstat [reset])"},
+#endif
+#ifdef CONFIG_IRQSOFF_TRACER
+    {"irqsoff", cmd_irqsoff, "Longest interrupts-off sections (usage: irqsoff [reset])"},
+#endif
+#ifdef CONFIG_LOCKUP_DETECTOR
+    {"watchdog", cmd_watchdog, "Lockup detectors (usage: watchdog [test softlockup|hung])"},
+#endif
+#ifdef CONFIG_KMEMLEAK
+    {"kmemleak", cmd_kmemleak, "Suspected memory leaks (usage: kmemleak [scan|clear|test])"},
+#endif
+#ifdef CONFIG_CRASHDUMP
+    {"crashdump", cmd_crashdump, "Previous boot's crash image (usage: crashdump [show|export|clear])"},
+#endif
+#if defined(CONFIG_KASAN) || defined(CONFIG_UBSAN)
+    {"sanitize", cmd_sanitize, "Sanitizer reports so far (usage: sanitize [test])"},
+#endif
     {NULL, NULL, NULL} // Sentinel
 };
 
@@ -210,9 +298,7 @@ static void cmd_tasks(const char *arg) {
     
     // Count and list all tasks
     int task_count = 0;
-    task_t *task = current;
-    
-    do {
+    for_each_task(task) {
         const char *state_str = "UNKNOWN";
         switch (task->state) {
             case TASK_RUNNING: state_str = "RUNNING"; break;
@@ -231,8 +317,7 @@ static void cmd_tasks(const char *arg) {
         puts(state_str);
         puts(")\n");
         task_count++;
-        task = task->next;
-    } while (task != current && task != NULL);
+    }
     
     printf("  Total tasks: %d\n", task_count);
     puts("---------------------\n");
@@ -273,6 +358,253 @@ static void cmd_reboot(const char *arg) {
     outb(0x64, 0xFE);
 }
 
+static void cmd_sysctl(const char *arg) {
+    char value[64];
+
+    if (strlen(arg) == 0) {
+        puts("\n--- Tunables ---\n");
+        for_each_param(p) {
+            param_format(p, value, sizeof(value));
+            printf_fmt("  %-18s = %-10s %s\n", p->name, value, p->help);
+        }
+        return;
+    }
+
+    /* "name=value" or "name value" */
+    char name[32];
+    int i = 0;
+    while (*arg && *arg != '=' && *arg != ' ' && i < (int)sizeof(name) - 1) {
+        name[i++] = *arg++;
+    }
+    name[i] = '\0';
+    while (*arg == '=' || *arg == ' ') {
+        arg++;
+    }
+
+    const kernel_param_t *param = param_find(name);
+    if (!param) {
+        printf("Error: No tunable named '%s'.\n", name);
+        return;
+    }
+
+    if (*arg) {
+        int result = param_set(param, arg, 1);
+        if (result == -2) {
+            printf("Error: '%s' can only be set on the kernel command line.\n", name);
+            return;
+        }
+        if (result != 0) {
+            if (param->type == PARAM_INT)
+                printf("Error: '%s' must be an integer in [%lld, %lld].\n", name, (long long)param->min, (long long)param->max);
+            else
+                printf("Error: Invalid value for '%s'.\n", name);
+            return;
+        }
+    }
+
+    param_format(param, value, sizeof(value));
+    printf("%s = %s\n", name, value);
+}
+
+static void cmd_acpi(const char *arg) {
+    (void)arg; // Unused parameter
+    acpi_dump();
+}
+
+static void cmd_clock(const char *arg) {
+    if (strcmp(arg, "test") == 0)
+        clock_oneshot_test();
+    else
+        clock_dump();
+}
+
+static void cmd_cpuinfo(const char *arg) {
+    (void)arg; // Unused parameter
+    cpu_dump();
+}
+
+static void cmd_pat(const char *arg) {
+    (void)arg; // Unused parameter
+    pat_dump();
+}
+
+static void cmd_stacks(const char *arg) {
+    (void)arg; // Unused parameter
+    stack_dump();
+}
+
+static void cmd_irqstat(const char *arg) {
+    if (strcmp(arg, "reset") == 0) {
+        irqstat_reset();
+        puts("Interrupt statistics cleared.\n");
+        return;
+    }
+    irqstat_dump();
+}
+
+#ifdef CONFIG_NUMA
+static void cmd_numa(const char *arg) {
+    (void)arg; // Unused parameter
+    numa_dump();
+}
+#endif
+
+#ifdef CONFIG_BENCH
+static void cmd_bench(const char *arg) {
+    if (strcmp(arg, "list") == 0) {
+        puts("\n--- Benchmarks ---\n");
+        bench_list();
+        return;
+    }
+
+    const char *name = strlen(arg) ? arg : "all";
+    puts("\n--- Benchmarks (cycles) ---\n");
+    if (bench_run(name) != 0) {
+        printf("Error: No benchmark named '%s'. Try 'bench list'.\n", name);
+    }
+}
+
+/**
+ * @brief Skips the current word of an argument list and the spaces after it
+ */
+static const char *next_word(const char *s) {
+    while (*s && *s != ' ')
+        s++;
+    while (*s == ' ')
+        s++;
+    return s;
+}
+
+static void cmd_cyclictest(const char *arg) {
+    int threads = 1, interval_us = 1000, loops = 1000;
+
+    if (*arg)
+        threads = atoi(arg);
+    arg = next_word(arg);
+    if (*arg)
+        interval_us = atoi(arg);
+    arg = next_word(arg);
+    if (*arg)
+        loops = atoi(arg);
+
+    puts("\n--- Wakeup latency ---\n");
+    if (latency_run(threads, interval_us > 0 ? interval_us : 0, loops) != 0) {
+        printf("Error: Need 1-%d threads, an interval and a loop count above 0.\n",
+               LATENCY_MAX_THREADS);
+    }
+}
+#endif
+
+#ifdef CONFIG_TRACING
+static void cmd_trace(const char *arg) {
+    int count = strlen(arg) ? atoi(arg) : 20;
+    puts("\n--- Trace (cpu, cycles since first shown) ---\n");
+    trace_dump(count, printf);
+}
+#endif
+
+#ifdef CONFIG_LOCKSTAT
+static void cmd_lockstat(const char *arg) {
+    if (strcmp(arg, "reset") == 0) {
+        lockstat_reset();
+        puts("Lock statistics reset.\n");
+        return;
+    }
+    puts("\n--- Lock Statistics ---\n");
+    lockstat_dump();
+}
+#endif
+
+#ifdef CONFIG_IRQSOFF_TRACER
+static void cmd_irqsoff(const char *arg) {
+    if (strcmp(arg, "reset") == 0) {
+        irqsoff_reset();
+        puts("Interrupts-off statistics reset.\n");
+        return;
+    }
+    irqsoff_dump();
+}
+#endif
+
+#ifdef CONFIG_LOCKUP_DETECTOR
+static void cmd_watchdog(const char *arg) {
+    if (strncmp(arg, "test ", 5) == 0) {
+        if (watchdog_test(arg + 5) != 0) {
+            printf("Error: Unknown test '%s'. Use softlockup or hung.\n", arg + 5);
+        }
+        return;
+    }
+    puts("\n--- Lockup Detectors ---");
+    watchdog_dump();
+}
+#endif
+
+#ifdef CONFIG_KMEMLEAK
+static void cmd_kmemleak(const char *arg) {
+    if (strcmp(arg, "test") == 0) {
+        kmemleak_selftest();
+        return;
+    }
+    if (strcmp(arg, "clear") == 0) {
+        kmemleak_clear();
+        puts("Current suspects accepted; later scans show only new leaks.\n");
+        return;
+    }
+    if (strcmp(arg, "scan") == 0) {
+        printf("Scan found %d new suspected leaks.\n", kmemleak_scan());
+    } else if (strlen(arg)) {
+        puts("Usage: kmemleak [scan|clear|test]\n");
+        return;
+    }
+    puts("\n--- Memory Leaks (full reports on COM1) ---\n");
+    kmemleak_dump();
+}
+#endif
+
+#ifdef CONFIG_CRASHDUMP
+static void cmd_crashdump(const char *arg) {
+    if (strlen(arg) == 0 || strcmp(arg, "show") == 0) {
+        crashdump_show();
+    } else if (strcmp(arg, "export") == 0) {
+        crashdump_export();
+    } else if (strcmp(arg, "clear") == 0) {
+        crashdump_clear();
+        puts("Crash image cleared.\n");
+    } else {
+        puts("Usage: crashdump [show|export|clear]\n");
+    }
+}
+#endif
+
+#if defined(CONFIG_KASAN) || defined(CONFIG_UBSAN)
+static void cmd_sanitize(const char *arg) {
+    int missed = 0;
+
+    if (strlen(arg) && strcmp(arg, "test") != 0) {
+        puts("Usage: sanitize [test]\n");
+        return;
+    }
+
+    if (strcmp(arg, "test") == 0) {
+        puts("\n--- Sanitizer Self-Test (reports on COM1) ---\n");
+#ifdef CONFIG_KASAN
+        missed += kasan_selftest();
+#endif
+#ifdef CONFIG_UBSAN
+        missed += ubsan_selftest();
+#endif
+        printf("%s\n", missed ? "Some errors were MISSED." : "All errors caught.");
+    }
+
+#ifdef CONFIG_KASAN
+    printf("KASAN reports: %llu\n", (unsigned long long)kasan_report_count());
+#endif
+#ifdef CONFIG_UBSAN
+    printf("UBSan reports: %llu\n", (unsigned long long)ubsan_report_count());
+#endif
+}
+#endif
+
 /**
  * @brief Handles raw keyboard input characters for the shell.
  * This function is called by the keyboard interrupt handler to process
@@ -367,5 +699,15 @@ void shell_task_main(void) {
     
     while (1) {
         process_pending_key();
+        yield();
+
+        // Halt until the next interrupt (a key, the tick or a wakeup)
+        // unless one already left work; sti only takes effect after hlt
+        asm volatile("cli");
+        if (keyboard_pending() || need_resched()) {
+            asm volatile("sti");
+        } else {
+            asm volatile("sti; hlt");
+        }
     }
 }
\ No newline at end of file
@@ -1,18 +1,33 @@
 #include <valen/task.h>
 #include <valen/heap.h>
+#include <valen/pmm.h>
+#include <valen/numa.h>
 #include <valen/stdio.h>
 #include <valen/string.h>
 #include <valen/spinlock.h>
+#include <valen/trace.h>
+#include <valen/param.h>
+#include <valen/stack.h>
+#include <valen/hrtimer.h>
+#include <valen/irqflags.h>
+#include <valen/watchdog.h>
+#include <valen/kmemleak.h>
 
 // Global task management
 task_t *current_task = NULL;
-static task_t *runqueue = NULL;
+static LIST_HEAD(runqueue);
 static pid_t next_pid = 1;
-static spinlock_t runqueue_lock = SPINLOCK_INIT;
-static spinlock_t current_task_lock = SPINLOCK_INIT;
+static spinlock_t runqueue_lock = SPINLOCK_INIT_NAMED("runqueue_lock");
+static spinlock_t current_task_lock = SPINLOCK_INIT_NAMED("current_task_lock");
 static volatile uint8_t need_schedule = 0;
 static volatile uint8_t tasks_exist = 0;
 
+static int sched_slice = 25;
+static int task_stack_size = 8192;
+
+param_int(sched_slice, sched_slice, 1, 10000, "Timer ticks per time slice");
+param_int(task_stack_size, task_stack_size, 4096, 1048576, "Kernel stack size of new tasks (bytes)");
+
 // Assembly context switch function
 extern void switch_to(task_context_t *prev, task_context_t *next);
 
@@ -21,7 +36,7 @@ extern void switch_to(task_context_t *prev, task_context_t *next);
  */
 void scheduler_init(void) {
     current_task = NULL;
-    runqueue = NULL;
+    INIT_LIST_HEAD(&runqueue);
     next_pid = 1;
     need_schedule = 0;
     tasks_exist = 0;
@@ -32,20 +47,7 @@ void scheduler_init(void) {
  */
 void add_task_to_runqueue(task_t *task) {
     spinlock_acquire(&runqueue_lock);
-    
-    if (!runqueue) {
-        runqueue = task;
-        task->next = task;
-        task->prev = task;
-    } else {
-        // Insert at head of circular doubly-linked list
-        task->next = runqueue;
-        task->prev = runqueue->prev;
-        runqueue->prev->next = task;
-        runqueue->prev = task;
-        runqueue = task;
-    }
-    
+    list_add(&task->run_list, &runqueue);
     tasks_exist = 1;  // Set flag that tasks exist
     spinlock_release(&runqueue_lock);
 }
@@ -56,32 +58,36 @@ void add_task_to_runqueue(task_t *task) {
 void remove_task_from_runqueue(task_t *task) {
     spinlock_acquire(&runqueue_lock);
     
-    if (!task || !runqueue) {
+    if (!task || list_empty(&task->run_list)) {
         spinlock_release(&runqueue_lock);
         return;
     }
     
-    if (task->next == task) {
-        // Only task in queue
-        runqueue = NULL;
-        tasks_exist = 0;  // No tasks exist
-    } else {
-        task->prev->next = task->next;
-        task->next->prev = task->prev;
-        if (runqueue == task) {
-            runqueue = task->next;
-        }
-    }
-    task->next = NULL;
-    task->prev = NULL;
+    list_del_init(&task->run_list);
+    tasks_exist = !list_empty(&runqueue);
     
     spinlock_release(&runqueue_lock);
 }
 
+/**
+ * @brief Landing pad for task functions that return
+ */
+static void task_return(void) {
+    task_exit(0);
+}
+
 /**
  * @brief Create a new task
  */
 task_t *task_create(void (*func)(void), const char *name) {
+    return task_create_on_node(func, name, NUMA_NO_NODE);
+}
+
+/**
+ * @brief Create a new task whose stack and pages come from node
+ * (NUMA_NO_NODE: the creator's home node)
+ */
+task_t *task_create_on_node(void (*func)(void), const char *name, int node) {
     task_t *task = (task_t*)malloc(sizeof(task_t));
     if (!task) {
         return NULL;
@@ -109,13 +115,25 @@ task_t *task_create(void (*func)(void), const char *name) {
         strcpy(task->comm, "unknown");
     }
     
-    // Allocate kernel stack
-    task->stack_size = 8192;
-    task->stack = malloc(task->stack_size);
+    // Home node and memory policy are inherited unless a node is given
+    if (node < 0 || node >= numa_node_count()) {
+        node = current_task ? current_task->numa_node : numa_cpu_node();
+    }
+    task->numa_node = node;
+    task->mempolicy = current_task ? current_task->mempolicy : NUMA_POLICY_LOCAL;
+    
+    // Allocate kernel stack from whole pages on the home node
+    uint64_t stack_pages = (task_stack_size + 4095) / 4096;
+    task->stack_size = stack_pages * 4096;
+    task->stack = pmm_alloc_pages_node(stack_pages, node);
     if (!task->stack) {
         free(task);
         return NULL;
     }
+    stack_poison(task->stack, task->stack_size);  // For the 'stacks' high-water mark
+    // Scanned from the saved stack pointer while the task lives, not as a whole
+    kmemleak_alloc(task->stack, task->stack_size);
+    kmemleak_no_scan(task->stack);
     
     // Set up initial stack for new task
     uint64_t *stack_top = (uint64_t*)((uint8_t*)task->stack + task->stack_size);
@@ -123,14 +141,18 @@ task_t *task_create(void (*func)(void), const char *name) {
     // Align stack to 16-byte boundary
     stack_top = (uint64_t*)((uint64_t)stack_top & ~0xF);
     
-    // Push initial values that context switch expects to pop
-    // The context switch will pop: r15, r14, r13, r12, rbx, rbp
-    *--stack_top = 0;  // r15
-    *--stack_top = 0;  // r14  
-    *--stack_top = 0;  // r13
-    *--stack_top = 0;  // r12
-    *--stack_top = 0;  // rbx
+    // Frame consumed by switch_to(): it pops r15, r14, r13, r12, rbx, rbp
+    // and then returns into the task function. If the function ever
+    // returns, it lands in task_return() with the stack aligned as after
+    // a call instruction.
+    *--stack_top = (uint64_t)task_return;
+    *--stack_top = (uint64_t)func;
     *--stack_top = 0;  // rbp
+    *--stack_top = 0;  // rbx
+    *--stack_top = 0;  // r12
+    *--stack_top = 0;  // r13
+    *--stack_top = 0;  // r14
+    *--stack_top = 0;  // r15
     
     // Set up context structure
     task->context.rsp = (uint64_t)stack_top;
@@ -157,6 +179,8 @@ task_t *task_create(void (*func)(void), const char *name) {
     task->context.rdi = 0;
     task->context.orig_rax = 0;
     
+    trace("task_create", task->pid, func);
+
     // Add to runqueue
     add_task_to_runqueue(task);
     
@@ -179,6 +203,7 @@ void task_exit(long exit_code) {
     
     current_task->state = TASK_ZOMBIE;
     current_task->exit_code = exit_code;
+    trace("task_exit", current_task->pid, exit_code);
     
     // Save current_task pointer before releasing lock
     task_t *exiting_task = current_task;
@@ -190,33 +215,105 @@ void task_exit(long exit_code) {
     schedule();
 }
 
+/**
+ * @brief Picks the task to run after current (both locks held)
+ */
+static task_t *pick_next_task(void) {
+    // A task that just left the runqueue (task_exit) has no successor,
+    // so restart from the queue head.
+    struct list_head *start = (current_task && !list_empty(&current_task->run_list))
+                                  ? current_task->run_list.next : runqueue.next;
+    struct list_head *pos = start;
+
+#ifdef CONFIG_SCHED_PRIO
+    // Lowest prio value wins; scanning from current's successor makes
+    // tasks of equal priority take turns.
+    task_t *best = NULL;
+    do {
+        if (pos != &runqueue) {
+            task_t *t = list_entry(pos, task_t, run_list);
+            if (t->state == TASK_RUNNING && (!best || t->prio < best->prio)) {
+                best = t;
+            }
+        }
+        pos = pos->next;
+    } while (pos != start);
+    return best;
+#else
+    // Sleeping tasks stay on the queue and are skipped
+    do {
+        if (pos != &runqueue) {
+            task_t *t = list_entry(pos, task_t, run_list);
+            if (t->state == TASK_RUNNING) {
+                return t;
+            }
+        }
+        pos = pos->next;
+    } while (pos != start);
+    return NULL;
+#endif
+}
+
+/**
+ * @brief Set the scheduling priority of a task (lower runs first with
+ * the priority scheduler; ignored by round robin)
+ */
+void task_set_prio(task_t *task, int prio) {
+    spinlock_acquire(&runqueue_lock);
+    task->prio = prio;
+    task->normal_prio = prio;
+    spinlock_release(&runqueue_lock);
+}
+
 /**
  * @brief Core scheduler
  */
 void schedule(void) {
+    watchdog_touch();
+
     spinlock_acquire(&runqueue_lock);
     spinlock_acquire(&current_task_lock);
     
-    if (!runqueue) {
+    if (list_empty(&runqueue)) {
         spinlock_release(&current_task_lock);
         spinlock_release(&runqueue_lock);
         return;
     }
     
-    task_t *next = NULL;
     task_t *old_current = current_task;
-    
-    // Find next runnable task
-    if (!current_task) {
-        next = runqueue;
-    } else {
-        next = current_task->next;
-        if (next == current_task) {
-            next = current_task; // Only one task
+    task_t *next;
+
+    // Nothing runnable: idle on the current stack until an interrupt
+    // wakes a task. The second look runs with interrupts off, so a wakeup
+    // cannot slip in between it and the hlt (sti takes effect after hlt).
+    while (!(next = pick_next_task())) {
+        asm volatile("cli" ::: "memory");
+        int idle = !pick_next_task();
+        spinlock_release(&current_task_lock);
+        spinlock_release(&runqueue_lock);
+        if (idle) {
+            asm volatile("sti; hlt" ::: "memory");
+        } else {
+            asm volatile("sti" ::: "memory");
+        }
+        watchdog_touch();
+        spinlock_acquire(&runqueue_lock);
+        spinlock_acquire(&current_task_lock);
+        if (list_empty(&runqueue)) {
+            spinlock_release(&current_task_lock);
+            spinlock_release(&runqueue_lock);
+            return;
         }
     }
     
     if (next && next != current_task) {
+        trace("sched_switch", old_current ? old_current->pid : 0, next->pid);
+
+        if (next->numa_node != numa_cpu_node()) {
+            next->numa_remote_runs++;
+        }
+        next->nr_switches++;
+
         // Update current_task while holding both locks
         current_task = next;
         
@@ -224,19 +321,9 @@ void schedule(void) {
         spinlock_release(&current_task_lock);
         spinlock_release(&runqueue_lock);
         
-        // Perform context switch
-        if (old_current) {
-            switch_to(&old_current->context, &next->context);
-        } else {
-            // First task - set up stack and jump directly
-            asm volatile (
-                "mov %0, %%rsp\n"
-                "jmp *%1"
-                :
-                : "r" (next->context.rsp), "r" (next->context.rip)
-                : "memory"
-            );
-        }
+        // Perform context switch. The very first switch comes from the
+        // boot stack, which is never resumed, so there is nothing to save.
+        switch_to(old_current ? &old_current->context : NULL, &next->context);
     } else {
         spinlock_release(&current_task_lock);
         spinlock_release(&runqueue_lock);
@@ -256,8 +343,8 @@ void scheduler_tick(void) {
     static int counter = 0;
     counter++;
     
-    // Schedule every 25 ticks (0.5 seconds at 50Hz)
-    if (counter >= 25) {
+    // Schedule every sched_slice ticks (0.5 seconds at the default 50Hz)
+    if (counter >= sched_slice) {
         counter = 0;
         need_schedule = 1;  // Set flag for deferred scheduling
     }
@@ -293,6 +380,53 @@ void yield(void) {
     }
 }
 
+/**
+ * @brief Non-zero when a time slice ended or a task woke up since the
+ * last yield()
+ */
+int need_resched(void) {
+    return need_schedule;
+}
+
+/**
+ * @brief Make a sleeping task runnable; it runs at the next yield() or
+ * schedule(). Safe from interrupt handlers.
+ */
+void task_wake_up(task_t *task) {
+    if (task->state == TASK_INTERRUPTIBLE) {
+        task->state = TASK_RUNNING;
+        need_schedule = 1;
+    }
+}
+
+static void sleep_timer_fn(struct hrtimer *timer) {
+    task_wake_up(timer->data);
+}
+
+/**
+ * @brief Sleep until clock_ns() reaches ns; other tasks run meanwhile
+ */
+void task_sleep_until(uint64_t ns) {
+    struct hrtimer timer = { .fn = sleep_timer_fn, .data = current_task };
+    uint64_t flags;
+
+    if (!current_task) {
+        return;
+    }
+
+    // The timer may fire any time after it is queued, so the task must
+    // already be marked asleep
+    local_irq_save(flags);
+    current_task->state = TASK_INTERRUPTIBLE;
+    current_task->sleep_timer = &timer;
+    hrtimer_start(&timer, ns);
+    local_irq_restore(flags);
+
+    schedule();
+    hrtimer_cancel(&timer);
+    current_task->sleep_timer = NULL;
+}
+
 /**
  * @brief Find task by PID
  */
@@ -301,26 +435,27 @@ task_t *find_task_by_pid(pid_t pid) {
     
     spinlock_acquire(&runqueue_lock);
     
-    if (!runqueue) {
-        spinlock_release(&runqueue_lock);
-        return NULL;
-    }
-    
-    task_t *current = runqueue;
+    task_t *t;
     task_t *found = NULL;
     
-    do {
-        if (current->pid == pid) {
-            found = current;
+    list_for_each_entry(t, &runqueue, run_list) {
+        if (t->pid == pid) {
+            found = t;
             break;
         }
-        current = current->next;
-    } while (current != runqueue);
+    }
     
     spinlock_release(&runqueue_lock);
     return found;
 }
 
+/**
+ * @brief Returns the runqueue for for_each_task(); no lock is taken.
+ */
+struct list_head *task_list_head(void) {
+    return &runqueue;
+}
+
 /**
  * @brief Kill a task by PID
  */
@@ -329,17 +464,14 @@ int kill_task(pid_t pid) {
     
     spinlock_acquire(&runqueue_lock);
     
+    task_t *t;
     task_t *target = NULL;
-    task_t *current = runqueue;
     
-    if (runqueue) {
-        do {
-            if (current->pid == pid) {
-                target = current;
-                break;
-            }
-            current = current->next;
-        } while (current != runqueue);
+    list_for_each_entry(t, &runqueue, run_list) {
+        if (t->pid == pid) {
+            target = t;
+            break;
+        }
     }
     
     if (!target) {
@@ -356,24 +488,22 @@ int kill_task(pid_t pid) {
     // Mark as zombie and remove from runqueue
     target->state = TASK_ZOMBIE;
     
-    if (target->next == target) {
-        // Only task in queue
-        runqueue = NULL;
-    } else {
-        target->prev->next = target->next;
-        target->next->prev = target->prev;
-        if (runqueue == target) {
-            runqueue = target->next;
-        }
-    }
-    target->next = NULL;
-    target->prev = NULL;
+    list_del_init(&target->run_list);
+    tasks_exist = !list_empty(&runqueue);
     
     spinlock_release(&runqueue_lock);
+
+    // A sleeping task's timer lives on the stack about to be freed
+    if (target->sleep_timer) {
+        hrtimer_cancel(target->sleep_timer);
+    }
     
     // Free the task's resources (safe to do outside lock)
     if (target->stack) {
-        free(target->stack);
+        kmemleak_free(target->stack);
+        for (unsigned long off = 0; off < target->stack_size; off += 4096) {
+            pmm_free_page((uint8_t *)target->stack + off);
+        }
     }
     free(target);
     
@@ -0,0 +1,314 @@
+/**
+ * @file clock.c
+ * @brief Clocksources, TSC calibration and the tick device.
+ *
+ * clock_ns() scales the current clocksource's cycle count to nanoseconds
+ * with a 32.32 fixed-point multiplier, so a read is one counter access, a
+ * multiply and a shift. The TSC is preferred when it is invariant; the
+ * HPET main counter is the fallback when it is not. The TSC frequency is
+ * measured against the HPET when there is one, otherwise against PIT
+ * channel 2.
+ */
+
+#include <valen/clock.h>
+#include <valen/hpet.h>
+#include <valen/pit.h>
+#include <valen/tsc.h>
+#include <valen/cpufeature.h>
+#include <valen/irq.h>
+#include <valen/irqflags.h>
+#include <valen/hrtimer.h>
+#include <valen/pic.h>
+#include <valen/task.h>
+#include <valen/watchdog.h>
+#include <valen/param.h>
+#include <valen/string.h>
+#include <valen/stdio.h>
+
+#define NSEC_PER_SEC 1000000000ULL
+
+/* Length of one calibration window, and how many are taken */
+#define CALIBRATE_MS 10
+#define CALIBRATE_RUNS 3
+
+/* A soft-lockup report prints every register of the interrupted code and
+ * unwinds from its rbp; the leaf stub leaves rbx, rbp and r12-r15 unsaved */
+#ifdef CONFIG_LOCKUP_DETECTOR
+#define TICK_IRQ_FLAGS 0
+#else
+#define TICK_IRQ_FLAGS IRQF_LEAF
+#endif
+
+#define ONESHOT_RUNS 20
+#define ONESHOT_DELAY_NS 100000
+
+static struct clocksource *sources;
+static struct clocksource *current;
+static uint64_t base_ns;
+static uint64_t base_cycles;
+static uint64_t tsc_khz;
+static int hpet_tick;
+
+static char clocksource_name[16];
+
+static void clocksource_changed(const kernel_param_t *param)
+{
+    (void)param;
+    if (clocksource_name[0] && clocksource_select(clocksource_name) < 0)
+        printf("clock: no clocksource '%s'\n", clocksource_name);
+}
+
+param_string_notify(clocksource, clocksource_name, 0, clocksource_changed,
+                    "Clocksource for clock_ns (tsc, hpet); empty picks the best rated");
+
+static uint64_t cycles_to_ns(const struct clocksource *cs, uint64_t cycles)
+{
+    return (uint64_t)(((unsigned __int128)cycles * cs->mult) >> 32);
+}
+
+uint64_t clock_ns(void)
+{
+    struct clocksource *cs = current;
+
+    if (!cs)
+        return 0;
+    return base_ns + cycles_to_ns(cs, cs->read() - base_cycles);
+}
+
+/**
+ * @brief Makes cs the source of clock_ns(), continuing from the time the
+ * old source reached.
+ */
+static void use_clocksource(struct clocksource *cs)
+{
+    uint64_t flags;
+
+    local_irq_save(flags);
+    base_ns = clock_ns();
+    base_cycles = cs->read();
+    current = cs;
+    local_irq_restore(flags);
+}
+
+void clocksource_register(struct clocksource *cs)
+{
+    cs->mult = (NSEC_PER_SEC << 32) / cs->freq;
+    cs->next = sources;
+    sources = cs;
+
+    /* A source picked with clocksource= stays until the user changes it */
+    if (clocksource_name[0])
+    {
+        if (strcmp(cs->name, clocksource_name) == 0)
+            use_clocksource(cs);
+        if (current && strcmp(current->name, clocksource_name) == 0)
+            return;
+    }
+    if (!current || cs->rating > current->rating)
+        use_clocksource(cs);
+}
+
+int clocksource_select(const char *name)
+{
+    for (struct clocksource *cs = sources; cs; cs = cs->next)
+    {
+        if (strcmp(cs->name, name) == 0)
+        {
+            if (cs != current)
+                use_clocksource(cs);
+            return 0;
+        }
+    }
+    return -1;
+}
+
+void clock_udelay(uint64_t us)
+{
+    uint64_t end = clock_ns() + us * 1000;
+
+    while (clock_ns() < end)
+        asm volatile("pause");
+}
+
+uint64_t clock_tsc_khz(void)
+{
+    return tsc_khz;
+}
+
+/* --- TSC --- */
+
+static uint64_t tsc_read(void)
+{
+    return rdtsc();
+}
+
+static struct clocksource tsc_clocksource = {
+    .name = "tsc",
+    .read = tsc_read,
+};
+
+/**
+ * @brief TSC cycles over CALIBRATE_MS of HPET time, in kHz.
+ */
+static uint64_t hpet_calibrate_tsc(void)
+{
+    uint64_t ticks = hpet_frequency() * CALIBRATE_MS / 1000;
+
+    uint64_t h0 = hpet_read();
+    uint64_t t0 = rdtsc_ordered();
+    uint64_t h1;
+    while ((h1 = hpet_read()) - h0 < ticks)
+        asm volatile("pause");
+    uint64_t t1 = rdtsc_ordered();
+
+    /* Scale by the HPET ticks actually elapsed, not the ones asked for.
+     * 10ms of cycles times the HPET rate stays far below 2^64. */
+    return (t1 - t0) * hpet_frequency() / (h1 - h0) / 1000;
+}
+
+/**
+ * @brief Median of a few calibration runs; one run can be stretched by an
+ * SMI or an emulator's vCPU being descheduled.
+ */
+static uint64_t calibrate_tsc(void)
+{
+    uint64_t khz[CALIBRATE_RUNS];
+
+    for (int i = 0; i < CALIBRATE_RUNS; i++)
+    {
+        khz[i] = hpet_available() ? hpet_calibrate_tsc() : pit_calibrate_tsc();
+        for (int j = i; j > 0 && khz[j - 1] > khz[j]; j--)
+        {
+            uint64_t t = khz[j];
+            khz[j] = khz[j - 1];
+            khz[j - 1] = t;
+        }
+    }
+    return khz[CALIBRATE_RUNS / 2];
+}
+
+/* --- Tick and events --- */
+
+void clock_set_tick_hz(uint32_t hz)
+{
+    if (hpet_tick && hpet_start_tick(hz) == 0)
+        return;
+    hpet_tick = 0;
+    pit_init(hz);
+}
+
+/**
+ * @brief IRQ 0, from the PIT or HPET timer 0.
+ */
+static void tick_interrupt(struct pt_regs *regs)
+{
+    hrtimer_tick();
+    scheduler_tick();
+    watchdog_tick(regs);
+}
+
+void clock_init(void)
+{
+    hpet_init();
+
+    tsc_khz = calibrate_tsc();
+    tsc_clocksource.freq = tsc_khz * 1000;
+    tsc_clocksource.rating = boot_cpu_has(X86_FEATURE_CONSTANT_TSC) ? 300 : 100;
+    clocksource_register(&tsc_clocksource);
+
+    printf_fmt("clock: tsc %llu.%03llu MHz%s (%s), using %s\n",
+               (unsigned long long)(tsc_khz / 1000), (unsigned long long)(tsc_khz % 1000),
+               tsc_clocksource.rating > 100 ? "" : ", not invariant",
+               hpet_available() ? "hpet calibrated" : "pit calibrated", current->name);
+
+    hpet_tick = hpet_available();
+    request_irq(IRQ_TIMER, tick_interrupt, TICK_IRQ_FLAGS, "timer");
+    clock_set_tick_hz(pit_get_hz());
+}
+
+/**
+ * @brief Cheapest of a batch of reads, in TSC cycles.
+ */
+static uint64_t read_cost(struct clocksource *cs)
+{
+    uint64_t best = ~0ULL;
+
+    for (int i = 0; i < 64; i++)
+    {
+        uint64_t t0 = rdtsc_ordered();
+        cs->read();
+        uint64_t t = rdtsc_ordered() - t0;
+        if (t < best)
+            best = t;
+    }
+    return best;
+}
+
+void clock_dump(void)
+{
+    puts("\n--- Clocksources ---\n");
+    for (struct clocksource *cs = sources; cs; cs = cs->next)
+        printf_fmt("  %c %-6s %12llu Hz  rating %3d  read %4llu cycles\n",
+                   cs == current ? '*' : ' ', cs->name, (unsigned long long)cs->freq, cs->rating,
+                   (unsigned long long)read_cost(cs));
+
+    printf_fmt("\nclock_ns %llu, tsc %llu kHz, tick %u Hz from %s\n",
+               (unsigned long long)clock_ns(), (unsigned long long)tsc_khz, pit_get_hz(),
+               hpet_tick ? "hpet" : "pit");
+#ifdef CONFIG_HPET
+    puts("\n");
+    hpet_dump();
+#endif
+}
+
+static volatile uint64_t oneshot_fired;
+
+static void oneshot_fn(struct hrtimer *timer)
+{
+    (void)timer;
+    oneshot_fired = rdtsc();
+}
+
+void clock_oneshot_test(void)
+{
+    uint64_t late_min = ~0ULL, late_max = 0, late_sum = 0;
+    int done = 0, missed = 0;
+
+    for (int i = 0; i < ONESHOT_RUNS; i++)
+    {
+        struct hrtimer timer = {.fn = oneshot_fn};
+
+        oneshot_fired = 0;
+        uint64_t t0 = rdtsc();
+        hrtimer_start(&timer, clock_ns() + ONESHOT_DELAY_NS);
+
+        /* Ten times the delay is plenty; anything past that never fired */
+        uint64_t timeout = t0 + tsc_khz * ONESHOT_DELAY_NS * 10 / 1000000;
+        while (!oneshot_fired && rdtsc() < timeout)
+            asm volatile("pause");
+        if (!oneshot_fired)
+        {
+            hrtimer_cancel(&timer);
+            missed++;
+            continue;
+        }
+
+        uint64_t ns = (oneshot_fired - t0) * 1000000 / tsc_khz;
+        uint64_t late = ns > ONESHOT_DELAY_NS ? ns - ONESHOT_DELAY_NS : 0;
+        late_sum += late;
+        if (late < late_min)
+            late_min = late;
+        if (late > late_max)
+            late_max = late;
+        done++;
+    }
+
+    if (done == 0)
+    {
+        puts("No timer fired within 1ms (no HPET event timer: timers run from the tick).\n");
+        return;
+    }
+    printf("%d one-shots of %d us: late by min %llu ns, avg %llu ns, max %llu ns; %d missed\n",
+           done, ONESHOT_DELAY_NS / 1000, (unsigned long long)late_min,
+           (unsigned long long)(late_sum / done), (unsigned long long)late_max, missed);
+}
@@ -0,0 +1,99 @@
+/**
+ * @file hrtimer.c
+ * @brief High-resolution timers on the HPET one-shot event.
+ *
+ * Pending timers sit on a list sorted by deadline, and the HPET event
+ * timer is armed for the first one. When it fires every expired timer
+ * runs and the event is re-armed for the next. Without an event timer
+ * the tick polls the list, so deadlines are only met to 1/pit_hz.
+ */
+
+#include <valen/hrtimer.h>
+#include <valen/hpet.h>
+#include <valen/clock.h>
+#include <valen/irqflags.h>
+
+static struct hrtimer *pending;
+
+static void hrtimer_event(void);
+
+/**
+ * @brief Runs every expired timer and arms the event for the next one.
+ * Called with interrupts disabled.
+ */
+static void run_expired(void)
+{
+    while (pending)
+    {
+        uint64_t now = clock_ns();
+        struct hrtimer *t = pending;
+
+        if (t->expires > now)
+        {
+            /* A deadline that passed while being programmed is run now */
+            if (!hpet_has_oneshot() || hpet_oneshot(t->expires - now, hrtimer_event) == 0)
+                return;
+            if (clock_ns() < t->expires)
+                continue;
+        }
+
+        pending = t->next;
+        t->queued = 0;
+        t->fn(t);
+    }
+}
+
+static void hrtimer_event(void)
+{
+    run_expired();
+}
+
+void hrtimer_start(struct hrtimer *timer, uint64_t expires)
+{
+    uint64_t flags;
+
+    local_irq_save(flags);
+    if (timer->queued)
+        hrtimer_cancel(timer);
+
+    struct hrtimer **p = &pending;
+    while (*p && (*p)->expires <= expires)
+        p = &(*p)->next;
+    timer->expires = expires;
+    timer->next = *p;
+    timer->queued = 1;
+    *p = timer;
+
+    if (pending == timer)
+        run_expired();
+    local_irq_restore(flags);
+}
+
+void hrtimer_cancel(struct hrtimer *timer)
+{
+    uint64_t flags;
+
+    local_irq_save(flags);
+    for (struct hrtimer **p = &pending; *p; p = &(*p)->next)
+    {
+        if (*p == timer)
+        {
+            *p = timer->next;
+            timer->queued = 0;
+            break;
+        }
+    }
+    /* The armed event may now be early; run_expired() re-arms when it fires */
+    local_irq_restore(flags);
+}
+
+void hrtimer_tick(void)
+{
+    if (pending && pending->expires <= clock_ns())
+        run_expired();
+}
+
+int hrtimer_is_highres(void)
+{
+    return hpet_has_oneshot();
+}
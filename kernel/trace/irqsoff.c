@@ -0,0 +1,183 @@
+/**
+ * @file irqsoff.c
+ * @brief Interrupts-off latency tracer.
+ *
+ * local_irq_save() timestamps the moment it disables interrupts and
+ * local_irq_restore() accounts the section to the call site that started
+ * it. irq_dispatch() adds every IRQ handler, which runs with interrupts
+ * off as well. A wakeup cannot be delivered sooner than the longest of
+ * these, so the table answers "what delayed the timer interrupt".
+ * Spinlocks do not disable interrupts and are not covered.
+ */
+
+#include <valen/irqflags.h>
+#include <valen/kallsyms.h>
+#include <valen/clock.h>
+#include <valen/spinlock.h>
+#include <valen/smp.h>
+#include <valen/tsc.h>
+#include <valen/string.h>
+#include <valen/stdio.h>
+
+#define IRQSOFF_SITES 64
+#define IRQSOFF_SHOWN 16
+
+struct irqsoff_site
+{
+    uint64_t ip;     /* Where interrupts were disabled, or the IRQ handler */
+    uint64_t end_ip; /* Where the longest section enabled them again */
+    uint64_t count;
+    uint64_t total;
+    uint64_t max; /* Cycles */
+};
+
+static struct
+{
+    uint64_t tsc;
+    uint64_t ip;
+} section[NR_CPUS];
+
+static struct irqsoff_site sites[IRQSOFF_SITES];
+static uint64_t dropped;
+static spinlock_t irqsoff_lock = SPINLOCK_INIT;
+
+/**
+ * @brief Adds a section. Interrupts are off; a contended table drops the
+ * sample rather than spin in the path being measured.
+ */
+static void account(uint64_t ip, uint64_t end_ip, uint64_t cycles)
+{
+    if (!spinlock_try_acquire(&irqsoff_lock))
+    {
+        dropped++;
+        return;
+    }
+
+    /* Open addressing on the call site; the table only ever grows */
+    uint32_t slot = (uint32_t)((ip * 0x9E3779B97F4A7C15ULL) >> 58) % IRQSOFF_SITES;
+    for (int i = 0; i < IRQSOFF_SITES; i++, slot = (slot + 1) % IRQSOFF_SITES)
+    {
+        struct irqsoff_site *s = &sites[slot];
+        if (s->ip && s->ip != ip)
+            continue;
+
+        s->ip = ip;
+        s->count++;
+        s->total += cycles;
+        if (cycles > s->max)
+        {
+            s->max = cycles;
+            s->end_ip = end_ip;
+        }
+        spinlock_release(&irqsoff_lock);
+        return;
+    }
+    dropped++;
+    spinlock_release(&irqsoff_lock);
+}
+
+void irqsoff_start(uint64_t ip)
+{
+    int cpu = smp_processor_id();
+
+    section[cpu].ip = ip;
+    section[cpu].tsc = rdtsc();
+}
+
+void irqsoff_stop(uint64_t ip)
+{
+    int cpu = smp_processor_id();
+    uint64_t cycles = rdtsc() - section[cpu].tsc;
+
+    if (section[cpu].ip)
+        account(section[cpu].ip, ip, cycles);
+    section[cpu].ip = 0;
+}
+
+void irqsoff_record(uint64_t ip, uint64_t cycles)
+{
+    account(ip, 0, cycles);
+}
+
+static uint64_t cycles_to_ns(uint64_t cycles)
+{
+    uint64_t khz = clock_tsc_khz();
+
+    return khz ? cycles * 1000000 / khz : cycles;
+}
+
+/**
+ * @brief Formats ip as function+offset.
+ */
+static void symbolize(char *buf, int size, uint64_t ip)
+{
+    uint64_t offset;
+    const char *name = kallsyms_lookup(ip, &offset);
+
+    if (name)
+        snprintf(buf, size, "%s+0x%lx", name, offset);
+    else
+        snprintf(buf, size, "%p", (void *)ip);
+}
+
+void irqsoff_dump(void)
+{
+    static struct irqsoff_site copy[IRQSOFF_SITES];
+    char start[48], end[48];
+    uint64_t flags = arch_local_irq_save();
+    int n = 0;
+
+    spinlock_acquire(&irqsoff_lock);
+    for (int i = 0; i < IRQSOFF_SITES; i++)
+    {
+        if (sites[i].ip)
+            copy[n++] = sites[i];
+    }
+    spinlock_release(&irqsoff_lock);
+    arch_local_irq_restore(flags);
+
+    /* Longest first */
+    for (int i = 1; i < n; i++)
+    {
+        struct irqsoff_site s = copy[i];
+        int j = i;
+        for (; j > 0 && copy[j - 1].max < s.max; j--)
+            copy[j] = copy[j - 1];
+        copy[j] = s;
+    }
+
+    puts("\n--- Interrupts-off sections ---\n");
+    printf_fmt("  %-32s %10s %10s %8s  %s\n", "disabled at", "max ns", "avg ns", "count",
+               "enabled at");
+    for (int i = 0; i < n; i++)
+    {
+        struct irqsoff_site *s = &copy[i];
+        uint64_t max_ns = cycles_to_ns(s->max);
+        uint64_t avg_ns = cycles_to_ns(s->total / s->count);
+
+        symbolize(start, sizeof(start), s->ip);
+        if (s->end_ip)
+            symbolize(end, sizeof(end), s->end_ip);
+        else
+            strcpy(end, "(irq handler)");
+        if (i < IRQSOFF_SHOWN)
+            printf_fmt("  %-32s %10lu %10lu %8lu  %s\n", start, max_ns, avg_ns, s->count, end);
+        serial_printf("IRQSOFF site=%s end=%s n=%lu max_ns=%lu avg_ns=%lu\n", start, end,
+                      s->count, max_ns, avg_ns);
+    }
+    if (n > IRQSOFF_SHOWN)
+        printf("  ... %d more on COM1\n", n - IRQSOFF_SHOWN);
+    if (dropped)
+        printf("  %llu sections not recorded (table busy or full)\n", (unsigned long long)dropped);
+}
+
+void irqsoff_reset(void)
+{
+    uint64_t flags = arch_local_irq_save();
+
+    spinlock_acquire(&irqsoff_lock);
+    memset(sites, 0, sizeof(sites));
+    dropped = 0;
+    spinlock_release(&irqsoff_lock);
+    arch_local_irq_restore(flags);
+}
@@ -0,0 +1,55 @@
+/**
+ * @file trace.c
+ * @brief Lockless event trace ring.
+ *
+ * Writers claim a slot with one atomic increment and fill it in; the ring
+ * wraps and overwrites the oldest events. Readers are diagnostic only and
+ * may observe a slot that is still being written.
+ */
+
+#include <valen/trace.h>
+#include <valen/tsc.h>
+#include <valen/smp.h>
+
+#ifndef CONFIG_TRACE_BUF_SHIFT
+#define CONFIG_TRACE_BUF_SHIFT 10
+#endif
+
+#define TRACE_ENTRIES (1UL << CONFIG_TRACE_BUF_SHIFT)
+
+static trace_entry_t ring[TRACE_ENTRIES];
+static volatile uint64_t head;
+
+void trace_record(const char *event, uint64_t a, uint64_t b)
+{
+    uint64_t idx = __atomic_fetch_add(&head, 1, __ATOMIC_RELAXED);
+    trace_entry_t *e = &ring[idx & (TRACE_ENTRIES - 1)];
+
+    e->tsc = rdtsc();
+    e->event = event;
+    e->a = a;
+    e->b = b;
+    e->cpu = smp_processor_id();
+}
+
+void trace_dump(int last, void (*out)(const char *format, ...))
+{
+    uint64_t end = head;
+    uint64_t count = end < TRACE_ENTRIES ? end : TRACE_ENTRIES;
+
+    if (last > 0 && (uint64_t)last < count)
+        count = last;
+
+    if (count == 0)
+    {
+        out("  (trace buffer empty)\n");
+        return;
+    }
+
+    uint64_t base = ring[(end - count) & (TRACE_ENTRIES - 1)].tsc;
+    for (uint64_t i = end - count; i < end; i++)
+    {
+        trace_entry_t *e = &ring[i & (TRACE_ENTRIES - 1)];
+        out("  [%d] +%llu %s %llx %llx\n", e->cpu, e->tsc - base, e->event, e->a, e->b);
+    }
+}
@@ -0,0 +1,140 @@
+/**
+ * @file bitmap.c
+ * @brief Bitmap search, range and weight operations.
+ *
+ * Everything works on whole words: a word that cannot contain the answer
+ * is rejected with one compare, and the bit inside the word that can is
+ * found with tzcnt. Partial words at either end of a range are masked.
+ */
+
+#include <valen/bitmap.h>
+
+#define __always_inline inline __attribute__((always_inline))
+
+/* Bits of the first word of a range that starts at start */
+#define BITMAP_FIRST_WORD_MASK(start) (~0ULL << ((start) & (BITS_PER_LONG - 1)))
+
+/**
+ * @brief First bit at or after start that is set in map ^ invert.
+ * invert is 0 to find set bits and ~0 to find clear ones.
+ */
+static __always_inline uint64_t find_next(const uint64_t *map, uint64_t size, uint64_t start,
+                                          uint64_t invert)
+{
+    if (start >= size)
+        return size;
+
+    uint64_t idx = BIT_WORD(start);
+    uint64_t word = (map[idx] ^ invert) & BITMAP_FIRST_WORD_MASK(start);
+
+    while (!word)
+    {
+        if ((++idx) * BITS_PER_LONG >= size)
+            return size;
+        word = map[idx] ^ invert;
+    }
+
+    uint64_t bit = idx * BITS_PER_LONG + __ffs(word);
+    return bit < size ? bit : size;
+}
+
+uint64_t find_next_bit(const uint64_t *map, uint64_t size, uint64_t start)
+{
+    return find_next(map, size, start, 0);
+}
+
+uint64_t find_next_zero_bit(const uint64_t *map, uint64_t size, uint64_t start)
+{
+    return find_next(map, size, start, ~0ULL);
+}
+
+void bitmap_set(uint64_t *map, uint64_t start, uint64_t len)
+{
+    uint64_t *p = map + BIT_WORD(start);
+    uint64_t end = start + len;
+    uint64_t bits = BITS_PER_LONG - start % BITS_PER_LONG;
+    uint64_t mask = BITMAP_FIRST_WORD_MASK(start);
+
+    while (len >= bits)
+    {
+        *p++ |= mask;
+        len -= bits;
+        bits = BITS_PER_LONG;
+        mask = ~0ULL;
+    }
+    if (len)
+        *p |= mask & BITMAP_LAST_WORD_MASK(end);
+}
+
+void bitmap_clear(uint64_t *map, uint64_t start, uint64_t len)
+{
+    uint64_t *p = map + BIT_WORD(start);
+    uint64_t end = start + len;
+    uint64_t bits = BITS_PER_LONG - start % BITS_PER_LONG;
+    uint64_t mask = BITMAP_FIRST_WORD_MASK(start);
+
+    while (len >= bits)
+    {
+        *p++ &= ~mask;
+        len -= bits;
+        bits = BITS_PER_LONG;
+        mask = ~0ULL;
+    }
+    if (len)
+        *p &= ~(mask & BITMAP_LAST_WORD_MASK(end));
+}
+
+static __always_inline uint64_t weight_range(const uint64_t *map, uint64_t start, uint64_t end,
+                                             unsigned int (*weight)(uint64_t))
+{
+    uint64_t first = BIT_WORD(start);
+    uint64_t last = BIT_WORD(end - 1);
+    uint64_t head = BITMAP_FIRST_WORD_MASK(start);
+    uint64_t tail = BITMAP_LAST_WORD_MASK(end);
+
+    if (first == last)
+        return weight(map[first] & head & tail);
+
+    uint64_t w = weight(map[first] & head);
+    for (uint64_t i = first + 1; i < last; i++)
+        w += weight(map[i]);
+    return w + weight(map[last] & tail);
+}
+
+static inline unsigned int popcnt64(uint64_t w)
+{
+    uint64_t n;
+
+    asm("popcnt %1, %0" : "=r"(n) : "rm"(w));
+    return n;
+}
+
+uint64_t bitmap_weight_range(const uint64_t *map, uint64_t start, uint64_t end)
+{
+    if (start >= end)
+        return 0;
+
+    /* Decide once, not per word: each variant is its own inlined loop */
+    if (static_cpu_has(X86_FEATURE_POPCNT))
+        return weight_range(map, start, end, popcnt64);
+    return weight_range(map, start, end, __sw_hweight64);
+}
+
+uint64_t bitmap_find_next_zero_area(const uint64_t *map, uint64_t size, uint64_t start,
+                                    uint64_t nr, uint64_t align_mask)
+{
+    while (1)
+    {
+        uint64_t index = find_next_zero_bit(map, size, start);
+
+        index = (index + align_mask) & ~align_mask;
+        if (index >= size || nr > size - index)
+            return size;
+
+        /* A set bit inside the candidate: restart just past it */
+        uint64_t busy = find_next_bit(map, index + nr, index);
+        if (busy >= index + nr)
+            return index;
+        start = busy + 1;
+    }
+}
@@ -0,0 +1,72 @@
+/**
+ * @file checksum.c
+ * @brief Internet checksum over 64-bit words.
+ *
+ * A one's complement sum does not depend on the word size it is computed
+ * with, as long as carries wrap around: 2^16 - 1 divides 2^64 - 1. So the
+ * buffer is summed 8 bytes at a time with one add-with-carry chain, eight
+ * words per iteration, and the 64-bit result is folded down at the end.
+ * That keeps the loop at one instruction per 8 bytes. The kernel is built
+ * without SSE registers, so there is no vector variant.
+ *
+ * KASAN builds sum 32-bit words into a 64-bit total in C instead, so the
+ * compiler can check every load.
+ */
+
+#include <valen/checksum.h>
+#include <valen/unaligned.h>
+
+static inline uint64_t add64_with_carry(uint64_t a, uint64_t b)
+{
+    asm("addq %1, %0\n\t"
+        "adcq $0, %0"
+        : "+r"(a)
+        : "r"(b));
+    return a;
+}
+
+uint32_t csum_partial(const void *buf, uint64_t len, uint32_t sum)
+{
+    const uint8_t *p = buf;
+    uint64_t acc = sum;
+
+#ifndef CONFIG_KASAN
+    for (; len >= 64; p += 64, len -= 64)
+    {
+        asm("addq 0(%[p]), %[acc]\n\t"
+            "adcq 8(%[p]), %[acc]\n\t"
+            "adcq 16(%[p]), %[acc]\n\t"
+            "adcq 24(%[p]), %[acc]\n\t"
+            "adcq 32(%[p]), %[acc]\n\t"
+            "adcq 40(%[p]), %[acc]\n\t"
+            "adcq 48(%[p]), %[acc]\n\t"
+            "adcq 56(%[p]), %[acc]\n\t"
+            "adcq $0, %[acc]"
+            : [acc] "+r"(acc)
+            : [p] "r"(p), "m"(*(const uint8_t(*)[64])p));
+    }
+    for (; len >= 8; p += 8, len -= 8)
+        acc = add64_with_carry(acc, get_unaligned_le64(p));
+#else
+    /* 2^32 words of 32 bits cannot overflow 64 bits; fold before that */
+    while (len >= 4)
+    {
+        uint64_t words = len / 4 < (1ULL << 31) ? len / 4 : (1ULL << 31);
+        uint64_t part = 0;
+        for (uint64_t i = 0; i < words; i++, p += 4)
+            part += get_unaligned_le32(p);
+        acc = add64_with_carry(acc, part);
+        len -= words * 4;
+    }
+#endif
+
+    /* The last few bytes, zero-padded to a word */
+    uint64_t tail = 0;
+    for (uint64_t i = 0; i < len; i++)
+        tail |= (uint64_t)p[i] << (8 * i);
+    acc = add64_with_carry(acc, tail);
+
+    acc = (acc & 0xFFFFFFFF) + (acc >> 32);
+    acc = (acc & 0xFFFFFFFF) + (acc >> 32);
+    return (uint32_t)acc;
+}
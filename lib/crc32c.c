@@ -0,0 +1,202 @@
+/**
+ * @file crc32c.c
+ * @brief CRC-32C on the SSE4.2 crc32 instruction, or slicing-by-8.
+ *
+ * crc32q has a latency of three cycles but can start every cycle, so one
+ * dependent chain runs at a third of the unit's speed. Long buffers are
+ * therefore cut into three lanes whose CRCs are computed interleaved and
+ * then combined: a lane's CRC is carried past the bytes after it by a
+ * multiplication by x^(8 * bytes) modulo the polynomial. That is a
+ * carry-less multiply by a constant, reduced by one more crc32q. The
+ * kernel has no SSE registers, so the multiply is done with shifts rather
+ * than pclmulqdq; it has no dependency chain and overlaps with the next
+ * lane's loads.
+ *
+ * The fallback looks up eight tables per 8-byte word instead of one per
+ * byte, which takes the table chain off the critical path.
+ *
+ * Internally CRCs are kept in the raw register form (no inversion); the
+ * exported functions invert on entry and exit.
+ */
+
+#include <valen/crc32c.h>
+#include <valen/cpufeature.h>
+#include <valen/unaligned.h>
+
+/* Castagnoli polynomial, bit-reflected */
+#define CRC32C_POLY 0x82F63B78U
+
+/*
+ * Lane sizes of the interleaved loop, and x^(8n - 33) mod P for the n that
+ * a combine skips: one and two lanes. crc32q itself multiplies by x^32,
+ * and a reflected carry-less product by one more x, hence the 33. Fixed
+ * here so the hardware path needs no setup.
+ */
+#define LONG_LANE 1024
+#define SHORT_LANE 256
+#define K_LONG_LANE 0x170076FAU   /* n = 1024 */
+#define K_LONG_LANE2 0xA51B6135U  /* n = 2048 */
+#define K_SHORT_LANE 0xB9E02B86U  /* n = 256 */
+#define K_SHORT_LANE2 0xDD7E3B0CU /* n = 512 */
+
+static uint32_t crc32c_table[8][256];
+
+/**
+ * @brief a * b modulo the polynomial, in the reflected representation
+ * (bit 31 is x^0). Branch-free: the cost does not depend on the data.
+ */
+static uint32_t multmodp(uint32_t a, uint32_t b)
+{
+    uint32_t p = 0;
+
+    for (int i = 31; i >= 0; i--)
+    {
+        p ^= b & -((a >> i) & 1);
+        b = (b >> 1) ^ (CRC32C_POLY & -(b & 1));
+    }
+    return p;
+}
+
+/** @brief x^(8n) mod P: the factor that appends n zero bytes. */
+static uint32_t xpow8n(uint64_t n)
+{
+    uint32_t p = 1U << 31; /* x^0 */
+    uint32_t sq = 1U << 23; /* x^8 */
+
+    for (; n; n >>= 1)
+    {
+        if (n & 1)
+            p = multmodp(sq, p);
+        sq = multmodp(sq, sq);
+    }
+    return p;
+}
+
+void crc32c_init(void)
+{
+    for (uint32_t i = 0; i < 256; i++)
+    {
+        uint32_t crc = i;
+        for (int k = 0; k < 8; k++)
+            crc = (crc >> 1) ^ (CRC32C_POLY & -(crc & 1));
+        crc32c_table[0][i] = crc;
+    }
+    for (uint32_t i = 0; i < 256; i++)
+    {
+        for (int t = 1; t < 8; t++)
+        {
+            uint32_t prev = crc32c_table[t - 1][i];
+            crc32c_table[t][i] = (prev >> 8) ^ crc32c_table[0][prev & 0xFF];
+        }
+    }
+}
+
+static uint32_t sw_update(uint32_t crc, const uint8_t *p, uint64_t len)
+{
+    const uint32_t(*t)[256] = crc32c_table;
+
+    while (len >= 8)
+    {
+        uint64_t w = get_unaligned_le64(p) ^ crc;
+        crc = t[7][w & 0xFF] ^ t[6][(w >> 8) & 0xFF] ^ t[5][(w >> 16) & 0xFF] ^
+              t[4][(w >> 24) & 0xFF] ^ t[3][(w >> 32) & 0xFF] ^ t[2][(w >> 40) & 0xFF] ^
+              t[1][(w >> 48) & 0xFF] ^ t[0][w >> 56];
+        p += 8;
+        len -= 8;
+    }
+    while (len--)
+        crc = (crc >> 8) ^ t[0][(crc ^ *p++) & 0xFF];
+    return crc;
+}
+
+static inline uint64_t crc32_u64(uint64_t crc, uint64_t v)
+{
+    asm("crc32q %1, %0" : "+r"(crc) : "rm"(v));
+    return crc;
+}
+
+static inline uint32_t crc32_u8(uint32_t crc, uint8_t v)
+{
+    asm("crc32b %1, %0" : "+r"(crc) : "rm"(v));
+    return crc;
+}
+
+/** @brief Carry-less 32x32 bit product. */
+static inline uint64_t clmul32(uint32_t a, uint32_t b)
+{
+    uint64_t p = 0;
+
+    for (int i = 0; i < 32; i++)
+        p ^= ((uint64_t)b << i) & -(uint64_t)((a >> i) & 1);
+    return p;
+}
+
+/** @brief crc * k * x^33 mod P: the CRC carried past the bytes k stands for. */
+static inline uint64_t hw_shift(uint64_t crc, uint32_t k)
+{
+    return crc32_u64(0, clmul32(crc, k));
+}
+
+/**
+ * @brief Three interleaved lanes of lane bytes each; k1 and k2 carry a
+ * CRC past one and two lanes.
+ */
+static inline uint32_t hw_lanes(uint32_t crc, const uint8_t *p, uint64_t lane, uint32_t k1,
+                                uint32_t k2)
+{
+    uint64_t a = crc, b = 0, c = 0;
+
+    for (uint64_t i = 0; i < lane; i += 8)
+    {
+        a = crc32_u64(a, get_unaligned_le64(p + i));
+        b = crc32_u64(b, get_unaligned_le64(p + lane + i));
+        c = crc32_u64(c, get_unaligned_le64(p + 2 * lane + i));
+    }
+    return hw_shift(a, k2) ^ hw_shift(b, k1) ^ c;
+}
+
+static uint32_t hw_update(uint32_t crc, const uint8_t *p, uint64_t len)
+{
+    while (len >= 3 * LONG_LANE)
+    {
+        crc = hw_lanes(crc, p, LONG_LANE, K_LONG_LANE, K_LONG_LANE2);
+        p += 3 * LONG_LANE;
+        len -= 3 * LONG_LANE;
+    }
+    while (len >= 3 * SHORT_LANE)
+    {
+        crc = hw_lanes(crc, p, SHORT_LANE, K_SHORT_LANE, K_SHORT_LANE2);
+        p += 3 * SHORT_LANE;
+        len -= 3 * SHORT_LANE;
+    }
+
+    uint64_t c = crc;
+    for (; len >= 8; p += 8, len -= 8)
+        c = crc32_u64(c, get_unaligned_le64(p));
+    crc = c;
+    while (len--)
+        crc = crc32_u8(crc, *p++);
+    return crc;
+}
+
+uint32_t __crc32c_sw(uint32_t crc, const void *data, uint64_t len)
+{
+    return ~sw_update(~crc, data, len);
+}
+
+uint32_t __crc32c_hw(uint32_t crc, const void *data, uint64_t len)
+{
+    return ~hw_update(~crc, data, len);
+}
+
+uint32_t crc32c(uint32_t crc, const void *data, uint64_t len)
+{
+    if (static_cpu_has(X86_FEATURE_SSE4_2))
+        return __crc32c_hw(crc, data, len);
+    return __crc32c_sw(crc, data, len);
+}
+
+uint32_t crc32c_combine(uint32_t crc_a, uint32_t crc_b, uint64_t len_b)
+{
+    return multmodp(xpow8n(len_b), crc_a) ^ crc_b;
+}
@@ -0,0 +1,200 @@
+/**
+ * @file hashtable.c
+ * @brief Resizable hash table with striped bucket locks.
+ *
+ * A key's bucket is the top bits of a multiplicative hash (Knuth's
+ * golden-ratio constant), and its lock the top HTABLE_LOCK_BITS of the
+ * same hash. The bucket count is always at least HTABLE_LOCKS, so every
+ * bucket belongs to exactly one lock at every table size, and an
+ * operation holding that lock sees a stable bucket array: a resize must
+ * take all of them first.
+ */
+
+#include <valen/hashtable.h>
+#include <valen/heap.h>
+#include <valen/string.h>
+
+#define GOLDEN_RATIO_64 0x61C8864680B583EBULL
+
+static inline uint64_t hash_key(uint64_t key)
+{
+    return key * GOLDEN_RATIO_64;
+}
+
+static inline spinlock_t *key_lock(struct htable *ht, uint64_t hash)
+{
+    return &ht->locks[hash >> (64 - HTABLE_LOCK_BITS)];
+}
+
+/* Only valid with the key's lock held */
+static inline struct htable_node **key_bucket(struct htable *ht, uint64_t hash)
+{
+    return &ht->buckets[hash >> (64 - ht->bits)];
+}
+
+static struct htable_node **alloc_buckets(uint32_t bits)
+{
+    uint64_t size = sizeof(struct htable_node *) << bits;
+    struct htable_node **buckets = malloc(size);
+
+    if (buckets)
+        memset(buckets, 0, size);
+    return buckets;
+}
+
+int htable_init(struct htable *ht, uint32_t min_bits)
+{
+    if (min_bits < HTABLE_LOCK_BITS)
+        min_bits = HTABLE_LOCK_BITS;
+
+    ht->buckets = alloc_buckets(min_bits);
+    if (!ht->buckets)
+        return -1;
+    ht->bits = min_bits;
+    ht->min_bits = min_bits;
+    ht->count = 0;
+    for (int i = 0; i < HTABLE_LOCKS; i++)
+        spinlock_init(&ht->locks[i]);
+    return 0;
+}
+
+void htable_destroy(struct htable *ht)
+{
+    free(ht->buckets);
+    ht->buckets = NULL;
+    ht->count = 0;
+}
+
+static void lock_all(struct htable *ht)
+{
+    for (int i = 0; i < HTABLE_LOCKS; i++)
+        spinlock_acquire(&ht->locks[i]);
+}
+
+static void unlock_all(struct htable *ht)
+{
+    for (int i = HTABLE_LOCKS - 1; i >= 0; i--)
+        spinlock_release(&ht->locks[i]);
+}
+
+/**
+ * @brief Rehashes into 2^bits buckets if the table is still 2^from
+ * buckets by the time every lock is held. Failure to allocate just
+ * leaves the chains longer.
+ */
+static void resize(struct htable *ht, uint32_t from, uint32_t bits)
+{
+    struct htable_node **buckets = alloc_buckets(bits);
+    struct htable_node **old;
+
+    if (!buckets)
+        return;
+
+    lock_all(ht);
+    if (ht->bits != from)
+    {
+        /* Someone else resized first */
+        unlock_all(ht);
+        free(buckets);
+        return;
+    }
+
+    old = ht->buckets;
+    for (uint64_t i = 0; i < (1ULL << from); i++)
+    {
+        struct htable_node *node = old[i];
+        while (node)
+        {
+            struct htable_node *next = node->next;
+            struct htable_node **b = &buckets[hash_key(node->key) >> (64 - bits)];
+            node->next = *b;
+            *b = node;
+            node = next;
+        }
+    }
+    ht->buckets = buckets;
+    ht->bits = bits;
+    unlock_all(ht);
+    free(old);
+}
+
+int htable_insert(struct htable *ht, struct htable_node *node, uint64_t key)
+{
+    uint64_t hash = hash_key(key);
+    spinlock_t *lock = key_lock(ht, hash);
+
+    spinlock_acquire(lock);
+    struct htable_node **b = key_bucket(ht, hash);
+    for (struct htable_node *n = *b; n; n = n->next)
+    {
+        if (n->key == key)
+        {
+            spinlock_release(lock);
+            return -1;
+        }
+    }
+    node->key = key;
+    node->next = *b;
+    *b = node;
+    uint32_t bits = ht->bits;
+    spinlock_release(lock);
+
+    /* Keep the load factor at or below one */
+    if (__atomic_add_fetch(&ht->count, 1, __ATOMIC_RELAXED) > (1ULL << bits) && bits < 40)
+        resize(ht, bits, bits + 1);
+    return 0;
+}
+
+struct htable_node *htable_lookup(struct htable *ht, uint64_t key)
+{
+    uint64_t hash = hash_key(key);
+    spinlock_t *lock = key_lock(ht, hash);
+    struct htable_node *n;
+
+    spinlock_acquire(lock);
+    for (n = *key_bucket(ht, hash); n; n = n->next)
+    {
+        if (n->key == key)
+            break;
+    }
+    spinlock_release(lock);
+    return n;
+}
+
+struct htable_node *htable_remove(struct htable *ht, uint64_t key)
+{
+    uint64_t hash = hash_key(key);
+    spinlock_t *lock = key_lock(ht, hash);
+    struct htable_node *n;
+
+    spinlock_acquire(lock);
+    for (struct htable_node **link = key_bucket(ht, hash); (n = *link); link = &n->next)
+    {
+        if (n->key == key)
+        {
+            *link = n->next;
+            n->next = NULL;
+            break;
+        }
+    }
+    uint32_t bits = ht->bits;
+    spinlock_release(lock);
+
+    /* Shrink below a quarter full; the gap to the grow point avoids
+     * resizing back and forth around one size */
+    if (n && __atomic_sub_fetch(&ht->count, 1, __ATOMIC_RELAXED) < (1ULL << bits) / 4 &&
+        bits > ht->min_bits)
+        resize(ht, bits, bits - 1);
+    return n;
+}
+
+void htable_walk(struct htable *ht, void (*fn)(struct htable_node *node, void *arg), void *arg)
+{
+    lock_all(ht);
+    for (uint64_t i = 0; i < (1ULL << ht->bits); i++)
+    {
+        for (struct htable_node *n = ht->buckets[i]; n; n = n->next)
+            fn(n, arg);
+    }
+    unlock_all(ht);
+}
@@ -0,0 +1,61 @@
+/**
+ * @file lfstack.c
+ * @brief Treiber stack with a generation count against ABA.
+ *
+ * The expected value of the double-word CAS is read as two plain loads.
+ * A torn read just makes the CAS fail, and the CAS hands back the real
+ * current pair for the next attempt.
+ */
+
+#include <valen/lfstack.h>
+
+/**
+ * @brief Compares the stack's top and gen with *old_top and *old_gen and, if
+ * equal, stores top/gen. On failure the current pair is written back.
+ */
+static inline bool cas_top(struct lfstack *stack, struct lfstack_node **old_top,
+                           uint64_t *old_gen, struct lfstack_node *top, uint64_t gen)
+{
+    bool ok;
+
+    asm volatile("lock cmpxchg16b %1"
+                 : "=@ccz"(ok), "+m"(*stack), "+a"(*old_top), "+d"(*old_gen)
+                 : "b"(top), "c"(gen)
+                 : "memory");
+    return ok;
+}
+
+void lfstack_push(struct lfstack *stack, struct lfstack_node *node)
+{
+    struct lfstack_node *top = __atomic_load_n(&stack->top, __ATOMIC_RELAXED);
+    uint64_t gen = __atomic_load_n(&stack->gen, __ATOMIC_RELAXED);
+
+    do
+        __atomic_store_n(&node->next, top, __ATOMIC_RELAXED);
+    while (!cas_top(stack, &top, &gen, node, gen + 1));
+}
+
+struct lfstack_node *lfstack_pop(struct lfstack *stack)
+{
+    struct lfstack_node *top = __atomic_load_n(&stack->top, __ATOMIC_RELAXED);
+    uint64_t gen = __atomic_load_n(&stack->gen, __ATOMIC_RELAXED);
+
+    while (top)
+    {
+        /* May be stale if top was popped meanwhile; the gen check catches it */
+        struct lfstack_node *next = __atomic_load_n(&top->next, __ATOMIC_RELAXED);
+        if (cas_top(stack, &top, &gen, next, gen + 1))
+            return top;
+    }
+    return NULL;
+}
+
+struct lfstack_node *lfstack_pop_all(struct lfstack *stack)
+{
+    struct lfstack_node *top = __atomic_load_n(&stack->top, __ATOMIC_RELAXED);
+    uint64_t gen = __atomic_load_n(&stack->gen, __ATOMIC_RELAXED);
+
+    while (top && !cas_top(stack, &top, &gen, NULL, gen + 1))
+        ;
+    return top;
+}
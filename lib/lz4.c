@@ -0,0 +1,360 @@
+/**
+ * @file lz4.c
+ * @brief LZ4 block compressor and decompressor.
+ *
+ * A block is a list of sequences: a token byte with a 4-bit literal
+ * length and a 4-bit match length, the literals, a 16-bit little-endian
+ * offset back into the output and the match length's extension bytes.
+ * The last sequence has literals only. The format asks the compressor to
+ * end every block with at least 5 literals and to start no match in the
+ * last 12 bytes. In return, the decompressor can copy 8 bytes at a time
+ * and overrun a copy's end without checking each byte.
+ *
+ * The compressor is the reference's fast single-pass one: 4-byte windows
+ * are hashed into a table of recent positions; a hit that really matches
+ * is extended forwards 8 bytes at a time and backwards a byte at a time.
+ * The longer nothing matches, the further ahead each probe jumps, so
+ * incompressible data goes through nearly at copy speed.
+ *
+ * Both directions copy with unaligned 8-byte loads and stores. Copies near
+ * the end of a buffer fall back to exact ones, so nothing is ever read or
+ * written outside the buffers passed in.
+ */
+
+#include <valen/lz4.h>
+#include <valen/bitmap.h>
+#include <valen/unaligned.h>
+#include <valen/string.h>
+
+#define __always_inline inline __attribute__((always_inline))
+
+#define MINMATCH 4
+#define LASTLITERALS 5    /* Literals that end every block */
+#define MFLIMIT 12        /* No match starts in this many final bytes */
+#define MIN_LENGTH (MFLIMIT + 1)
+#define MAX_DISTANCE 65535
+
+#define ML_BITS 4
+#define ML_MASK ((1U << ML_BITS) - 1)
+#define RUN_MASK ((1U << (8 - ML_BITS)) - 1)
+
+/* Probes without a match before the step grows by one byte */
+#define SKIP_TRIGGER 6
+
+static __always_inline uint32_t lz4_hash(uint32_t sequence)
+{
+    return (sequence * 2654435761U) >> (32 - LZ4_HASHLOG);
+}
+
+static __always_inline uint32_t hash_at(const uint8_t *p)
+{
+    return lz4_hash(get_unaligned_le32(p));
+}
+
+/**
+ * @brief Copies 8 bytes at a time from src until dst reaches end; writes
+ * up to 7 bytes past end.
+ */
+static __always_inline void wild_copy(uint8_t *dst, const uint8_t *src, uint8_t *end)
+{
+    do
+    {
+        put_unaligned_le64(get_unaligned_le64(src), dst);
+        dst += 8;
+        src += 8;
+    } while (dst < end);
+}
+
+/**
+ * @brief Length of the common prefix of ip and match, ip stopping at limit.
+ */
+static __always_inline uint64_t match_length(const uint8_t *ip, const uint8_t *match,
+                                             const uint8_t *limit)
+{
+    const uint8_t *start = ip;
+
+    while (ip < limit - 7)
+    {
+        uint64_t diff = get_unaligned_le64(match) ^ get_unaligned_le64(ip);
+        if (diff)
+            return ip - start + (__ffs(diff) >> 3);
+        ip += 8;
+        match += 8;
+    }
+    if (ip < limit - 3 && get_unaligned_le32(match) == get_unaligned_le32(ip))
+    {
+        ip += 4;
+        match += 4;
+    }
+    if (ip < limit - 1 && get_unaligned_le16(match) == get_unaligned_le16(ip))
+    {
+        ip += 2;
+        match += 2;
+    }
+    if (ip < limit && *match == *ip)
+        ip++;
+    return ip - start;
+}
+
+/**
+ * @brief Writes the extension bytes of a length that filled its token
+ * field: 255s, then the remainder.
+ */
+static __always_inline uint8_t *put_length(uint8_t *op, uint64_t len)
+{
+    for (; len >= 255; len -= 255)
+        *op++ = 255;
+    *op++ = (uint8_t)len;
+    return op;
+}
+
+uint64_t lz4_compress(const void *src, uint64_t src_len, void *dst, uint64_t dst_cap,
+                      void *wrkmem)
+{
+    uint32_t *table = wrkmem;
+    const uint8_t *base = src;
+    const uint8_t *ip = base;
+    const uint8_t *anchor = base;
+    const uint8_t *iend = base + src_len;
+    const uint8_t *mflimit = iend - MFLIMIT;
+    const uint8_t *matchlimit = iend - LASTLITERALS;
+    uint8_t *op = dst;
+    uint8_t *oend = op + dst_cap;
+
+    if (src_len > LZ4_MAX_INPUT_SIZE)
+        return 0;
+    if (src_len < MIN_LENGTH)
+        goto last_literals;
+
+    /* Stale entries would point past ip; every one has to be valid */
+    memset(table, 0, LZ4_MEM_COMPRESS);
+
+    table[hash_at(ip)] = 0;
+    ip++;
+    uint32_t forward_h = hash_at(ip);
+
+    for (;;)
+    {
+        const uint8_t *match;
+        uint8_t *token;
+
+        /* Find a match, probing further apart the longer none turns up */
+        {
+            const uint8_t *forward_ip = ip;
+            uint32_t step = 1;
+            uint32_t attempts = 1U << SKIP_TRIGGER;
+
+            do
+            {
+                uint32_t h = forward_h;
+
+                ip = forward_ip;
+                forward_ip += step;
+                step = attempts++ >> SKIP_TRIGGER;
+                if (forward_ip > mflimit)
+                    goto last_literals;
+
+                match = base + table[h];
+                forward_h = hash_at(forward_ip);
+                table[h] = ip - base;
+            } while (ip - match > MAX_DISTANCE ||
+                     get_unaligned_le32(match) != get_unaligned_le32(ip));
+        }
+
+        /* Extend it backwards over bytes not yet emitted */
+        while (ip > anchor && match > base && ip[-1] == match[-1])
+        {
+            ip--;
+            match--;
+        }
+
+        /* Literals. The check also covers the offset, the token of the
+         * last sequence and its 5 literals, and the wild copy's overrun. */
+        uint64_t lit = ip - anchor;
+        if (1 + lit + lit / 255 + 2 + 1 + LASTLITERALS > (uint64_t)(oend - op))
+            return 0;
+        token = op++;
+        if (lit >= RUN_MASK)
+        {
+            *token = RUN_MASK << ML_BITS;
+            op = put_length(op, lit - RUN_MASK);
+        }
+        else
+            *token = lit << ML_BITS;
+        wild_copy(op, anchor, op + lit);
+        op += lit;
+
+    next_match:
+        put_unaligned_le16(ip - match, op);
+        op += 2;
+
+        uint64_t len = match_length(ip + MINMATCH, match + MINMATCH, matchlimit);
+        ip += len + MINMATCH;
+        if (len / 255 + 1 + LASTLITERALS > (uint64_t)(oend - op))
+            return 0;
+        if (len >= ML_MASK)
+        {
+            *token += ML_MASK;
+            op = put_length(op, len - ML_MASK);
+        }
+        else
+            *token += len;
+
+        anchor = ip;
+        if (ip > mflimit)
+            break;
+
+        /* Fill in a position inside the match, then try for another
+         * match right here, with no literals in between */
+        table[hash_at(ip - 2)] = ip - 2 - base;
+        uint32_t h = hash_at(ip);
+        match = base + table[h];
+        table[h] = ip - base;
+        if (ip - match <= MAX_DISTANCE && get_unaligned_le32(match) == get_unaligned_le32(ip))
+        {
+            token = op++;
+            *token = 0;
+            goto next_match;
+        }
+
+        forward_h = hash_at(++ip);
+    }
+
+last_literals:
+    {
+        uint64_t lit = iend - anchor;
+
+        if (1 + lit + (lit + 255 - RUN_MASK) / 255 > (uint64_t)(oend - op))
+            return 0;
+        if (lit >= RUN_MASK)
+        {
+            *op++ = RUN_MASK << ML_BITS;
+            op = put_length(op, lit - RUN_MASK);
+        }
+        else
+            *op++ = lit << ML_BITS;
+        memcpy(op, anchor, lit);
+        op += lit;
+    }
+    return op - (uint8_t *)dst;
+}
+
+/**
+ * @brief Reads the extension bytes of a length that filled its token
+ * field. Returns -1 if they run past iend.
+ */
+static __always_inline int read_length(const uint8_t **ip, const uint8_t *iend, uint64_t *len)
+{
+    uint8_t s;
+
+    do
+    {
+        if (*ip >= iend)
+            return -1;
+        s = *(*ip)++;
+        *len += s;
+    } while (s == 255);
+    return 0;
+}
+
+/**
+ * @brief Writes the first 8 bytes of a match less than 8 bytes back, and
+ * returns where the rest of it continues from: a copy of the same pattern
+ * at least 8 bytes behind op + 8, so word copies can take over.
+ */
+static __always_inline const uint8_t *spread_short_match(uint8_t *op, const uint8_t *match,
+                                                         uint64_t offset)
+{
+    /* After the first 4 bytes, how far to move match so the next 4
+     * continue the pattern, and then back to a whole number of periods */
+    static const uint8_t inc32[8] = {0, 1, 2, 1, 0, 4, 4, 4};
+    static const int8_t dec64[8] = {0, 0, 0, -1, -4, 1, 2, 3};
+
+    op[0] = match[0];
+    op[1] = match[1];
+    op[2] = match[2];
+    op[3] = match[3];
+    match += inc32[offset];
+    put_unaligned_le32(get_unaligned_le32(match), op + 4);
+    return match - dec64[offset];
+}
+
+int64_t lz4_decompress(const void *src, uint64_t src_len, void *dst, uint64_t dst_cap)
+{
+    const uint8_t *ip = src;
+    const uint8_t *iend = ip + src_len;
+    uint8_t *op = dst;
+    uint8_t *oend = op + dst_cap;
+
+    for (;;)
+    {
+        if (ip >= iend)
+            return -1;
+        uint32_t token = *ip++;
+
+        /* Literals */
+        uint64_t len = token >> ML_BITS;
+        if (len == RUN_MASK && read_length(&ip, iend, &len) < 0)
+            return -1;
+        if (len > (uint64_t)(iend - ip) || len > (uint64_t)(oend - op))
+            return -1;
+        if ((uint64_t)(iend - ip) - len >= 8 && (uint64_t)(oend - op) - len >= 8)
+            wild_copy(op, ip, op + len);
+        else
+            memcpy(op, ip, len);
+        ip += len;
+        op += len;
+
+        /* The last sequence is the one that ends the input */
+        if (ip == iend)
+            break;
+
+        /* Match */
+        if (iend - ip < 2)
+            return -1;
+        uint64_t offset = get_unaligned_le16(ip);
+        ip += 2;
+        if (offset == 0 || offset > (uint64_t)(op - (uint8_t *)dst))
+            return -1;
+        const uint8_t *match = op - offset;
+
+        len = token & ML_MASK;
+        if (len == ML_MASK && read_length(&ip, iend, &len) < 0)
+            return -1;
+        len += MINMATCH;
+        if (len > (uint64_t)(oend - op))
+            return -1;
+        uint8_t *cpy = op + len;
+
+        if (offset < 8 && len >= 8)
+        {
+            match = spread_short_match(op, match, offset);
+            op += 8;
+        }
+
+        if ((uint64_t)(oend - cpy) < 8)
+        {
+            /* The last match ends within a word of dst's end: whole words
+             * while they fit, then bytes, which also handle overlap */
+            if (op - match >= 8)
+            {
+                for (; cpy - op >= 8; op += 8, match += 8)
+                    put_unaligned_le64(get_unaligned_le64(match), op);
+            }
+            while (op < cpy)
+                *op++ = *match++;
+            continue;
+        }
+        if (op - match < 8)
+        {
+            /* 4 to 7 bytes from less than 8 back: one spread covers it */
+            spread_short_match(op, match, offset);
+            op = cpy;
+            continue;
+        }
+        if (op < cpy)
+            wild_copy(op, match, cpy);
+        op = cpy;
+    }
+    return op - (uint8_t *)dst;
+}
@@ -0,0 +1,129 @@
+/**
+ * @file min_heap.c
+ * @brief Array-backed binary min-heap.
+ *
+ * Sifting down uses the bottom-up variant: walk to a leaf along the
+ * smaller children, then back up to where the element belongs. That
+ * makes about half the comparisons of the textbook loop, because the
+ * element that moved to the root usually belongs near the bottom.
+ */
+
+#include <valen/min_heap.h>
+#include <valen/string.h>
+
+static inline void *elem(const struct min_heap *heap, int i)
+{
+    return (uint8_t *)heap->data + (uint64_t)i * heap->elem_size;
+}
+
+static void swap(const struct min_heap *heap, int i, int j)
+{
+    uint8_t *a = elem(heap, i), *b = elem(heap, j);
+    uint64_t n = heap->elem_size;
+
+    /* Elements are most often pointers or pairs of words */
+    if (n % 8 == 0 && ((uintptr_t)a | (uintptr_t)b) % 8 == 0)
+    {
+        for (uint64_t k = 0; k < n; k += 8)
+        {
+            uint64_t t = *(uint64_t *)(a + k);
+            *(uint64_t *)(a + k) = *(uint64_t *)(b + k);
+            *(uint64_t *)(b + k) = t;
+        }
+        return;
+    }
+    for (uint64_t k = 0; k < n; k++)
+    {
+        uint8_t t = a[k];
+        a[k] = b[k];
+        b[k] = t;
+    }
+}
+
+static void sift_down(struct min_heap *heap, int pos)
+{
+    int i = pos;
+    int child;
+
+    /* Down to a leaf along the smaller children */
+    while ((child = 2 * i + 1) < heap->nr)
+    {
+        if (child + 1 < heap->nr && heap->less(elem(heap, child + 1), elem(heap, child)))
+            child++;
+        i = child;
+    }
+
+    /* Back up to the first node not smaller than the element at pos */
+    while (i != pos && heap->less(elem(heap, pos), elem(heap, i)))
+        i = (i - 1) / 2;
+
+    /* Rotate the element at pos into i, each ancestor moving up one level */
+    while (i != pos)
+    {
+        swap(heap, pos, i);
+        i = (i - 1) / 2;
+    }
+}
+
+static void sift_up(struct min_heap *heap, int i)
+{
+    while (i > 0)
+    {
+        int parent = (i - 1) / 2;
+        if (!heap->less(elem(heap, i), elem(heap, parent)))
+            break;
+        swap(heap, i, parent);
+        i = parent;
+    }
+}
+
+void min_heap_init(struct min_heap *heap, void *data, int size, uint64_t elem_size,
+                   bool (*less)(const void *a, const void *b))
+{
+    heap->data = data;
+    heap->nr = 0;
+    heap->size = size;
+    heap->elem_size = elem_size;
+    heap->less = less;
+}
+
+void min_heap_heapify(struct min_heap *heap)
+{
+    for (int i = heap->nr / 2 - 1; i >= 0; i--)
+        sift_down(heap, i);
+}
+
+int min_heap_push(struct min_heap *heap, const void *e)
+{
+    if (heap->nr == heap->size)
+        return -1;
+    memcpy(elem(heap, heap->nr), e, heap->elem_size);
+    sift_up(heap, heap->nr++);
+    return 0;
+}
+
+int min_heap_pop(struct min_heap *heap, void *out)
+{
+    if (heap->nr == 0)
+        return -1;
+    if (out)
+        memcpy(out, heap->data, heap->elem_size);
+    heap->nr--;
+    if (heap->nr)
+    {
+        memcpy(heap->data, elem(heap, heap->nr), heap->elem_size);
+        sift_down(heap, 0);
+    }
+    return 0;
+}
+
+void min_heap_pop_push(struct min_heap *heap, const void *e)
+{
+    if (heap->nr == 0)
+    {
+        min_heap_push(heap, e);
+        return;
+    }
+    memcpy(heap->data, e, heap->elem_size);
+    sift_down(heap, 0);
+}
@@ -0,0 +1,42 @@
+/**
+ * @file percpu_counter.c
+ * @brief Batched per-CPU counters.
+ *
+ * A CPU folds by exchanging its delta with zero and adding what it took
+ * to the total. The exchange is atomic against its own interrupts, so
+ * an increment from an interrupt handler between the add and the fold
+ * is either folded now or stays in the slot for the next time.
+ */
+
+#include <valen/percpu_counter.h>
+
+void percpu_counter_init(struct percpu_counter *c, int64_t value, int32_t batch)
+{
+    c->count = value;
+    c->batch = batch > 0 ? batch : PERCPU_COUNTER_BATCH;
+    for (int cpu = 0; cpu < NR_CPUS; cpu++)
+        c->cpu[cpu].delta = 0;
+}
+
+void percpu_counter_fold(struct percpu_counter *c, int cpu)
+{
+    int64_t d = __atomic_exchange_n(&c->cpu[cpu].delta, 0, __ATOMIC_RELAXED);
+
+    __atomic_fetch_add(&c->count, d, __ATOMIC_RELAXED);
+}
+
+void percpu_counter_set(struct percpu_counter *c, int64_t value)
+{
+    for (int cpu = 0; cpu < NR_CPUS; cpu++)
+        __atomic_store_n(&c->cpu[cpu].delta, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&c->count, value, __ATOMIC_RELAXED);
+}
+
+int64_t percpu_counter_sum(struct percpu_counter *c)
+{
+    int64_t sum = __atomic_load_n(&c->count, __ATOMIC_RELAXED);
+
+    for (int cpu = 0; cpu < NR_CPUS; cpu++)
+        sum += __atomic_load_n(&c->cpu[cpu].delta, __ATOMIC_RELAXED);
+    return sum;
+}
@@ -0,0 +1,273 @@
+/**
+ * @file radix_tree.c
+ * @brief Radix tree of 64-slot nodes.
+ *
+ * A tree of height h covers indices below 2^(6h). Inserting a larger
+ * index grows the tree at the top: a new root gets the old one as slot 0.
+ * Deleting frees nodes that become empty on the way back up, then
+ * removes roots whose only child is slot 0, so the tree shrinks back.
+ */
+
+#include <valen/radix_tree.h>
+#include <valen/heap.h>
+#include <valen/string.h>
+
+/* 64 bits at 6 bits per level; the top level uses only 4 */
+#define RADIX_TREE_MAX_HEIGHT ((64 + RADIX_TREE_MAP_SHIFT - 1) / RADIX_TREE_MAP_SHIFT)
+#define MAP_MASK (RADIX_TREE_MAP_SIZE - 1)
+
+static inline uint64_t max_index(uint32_t height)
+{
+    uint32_t bits = height * RADIX_TREE_MAP_SHIFT;
+    return bits >= 64 ? ~0ULL : (1ULL << bits) - 1;
+}
+
+static struct radix_tree_node *node_alloc(void)
+{
+    struct radix_tree_node *node = malloc(sizeof(*node));
+
+    if (node)
+        memset(node, 0, sizeof(*node));
+    return node;
+}
+
+/**
+ * @brief Adds levels on top until index fits.
+ */
+static int extend(struct radix_tree_root *root, uint64_t index)
+{
+    uint32_t height = root->height ? root->height : 1;
+
+    while (index > max_index(height))
+        height++;
+
+    if (!root->node)
+    {
+        root->height = height;
+        return 0;
+    }
+
+    while (root->height < height)
+    {
+        struct radix_tree_node *node = node_alloc();
+        if (!node)
+            return -1;
+        node->slots[0] = root->node;
+        node->count = 1;
+        root->node = node;
+        root->height++;
+    }
+    return 0;
+}
+
+int radix_tree_insert(struct radix_tree_root *root, uint64_t index, void *item)
+{
+    if ((!root->node || index > max_index(root->height)) && extend(root, index) < 0)
+        return -1;
+
+    if (!root->node)
+    {
+        root->node = node_alloc();
+        if (!root->node)
+            return -1;
+    }
+
+    struct radix_tree_node *node = root->node;
+    uint32_t shift = (root->height - 1) * RADIX_TREE_MAP_SHIFT;
+
+    while (shift)
+    {
+        void **slot = &node->slots[(index >> shift) & MAP_MASK];
+        if (!*slot)
+        {
+            struct radix_tree_node *child = node_alloc();
+            if (!child)
+                return -1; /* Nodes added so far stay, for the next insert */
+            *slot = child;
+            node->count++;
+        }
+        node = *slot;
+        shift -= RADIX_TREE_MAP_SHIFT;
+    }
+
+    void **slot = &node->slots[index & MAP_MASK];
+    if (*slot)
+        return -2;
+    *slot = item;
+    node->count++;
+    root->items++;
+    return 0;
+}
+
+void *radix_tree_lookup(const struct radix_tree_root *root, uint64_t index)
+{
+    struct radix_tree_node *node = root->node;
+
+    if (!node || index > max_index(root->height))
+        return NULL;
+
+    for (uint32_t shift = (root->height - 1) * RADIX_TREE_MAP_SHIFT; shift;
+         shift -= RADIX_TREE_MAP_SHIFT)
+    {
+        node = node->slots[(index >> shift) & MAP_MASK];
+        if (!node)
+            return NULL;
+    }
+    return node->slots[index & MAP_MASK];
+}
+
+/**
+ * @brief Lowers the tree while the root only has slot 0 in use.
+ */
+static void shrink(struct radix_tree_root *root)
+{
+    while (root->height > 1 && root->node->count == 1 && root->node->slots[0])
+    {
+        struct radix_tree_node *node = root->node;
+        root->node = node->slots[0];
+        root->height--;
+        free(node);
+    }
+}
+
+void *radix_tree_delete(struct radix_tree_root *root, uint64_t index)
+{
+    struct radix_tree_node *path[RADIX_TREE_MAX_HEIGHT];
+    struct radix_tree_node *node = root->node;
+    int depth = 0;
+
+    if (!node || index > max_index(root->height))
+        return NULL;
+
+    for (uint32_t shift = (root->height - 1) * RADIX_TREE_MAP_SHIFT; shift;
+         shift -= RADIX_TREE_MAP_SHIFT)
+    {
+        path[depth++] = node;
+        node = node->slots[(index >> shift) & MAP_MASK];
+        if (!node)
+            return NULL;
+    }
+
+    void *item = node->slots[index & MAP_MASK];
+    if (!item)
+        return NULL;
+    node->slots[index & MAP_MASK] = NULL;
+    node->count--;
+    root->items--;
+
+    /* Free emptied nodes bottom up; path[d] holds the parent of level d+1 */
+    uint32_t shift = RADIX_TREE_MAP_SHIFT;
+    while (node->count == 0)
+    {
+        free(node);
+        if (depth == 0)
+        {
+            root->node = NULL;
+            root->height = 0;
+            return item;
+        }
+        node = path[--depth];
+        node->slots[(index >> shift) & MAP_MASK] = NULL;
+        node->count--;
+        shift += RADIX_TREE_MAP_SHIFT;
+    }
+
+    shrink(root);
+    return item;
+}
+
+/**
+ * @brief The first item at or after *index, with *index set to where it
+ * was found; NULL if there is none.
+ */
+static void *find_next(const struct radix_tree_root *root, uint64_t *index)
+{
+    uint64_t i = *index;
+
+restart:
+    if (i > max_index(root->height))
+        return NULL;
+
+    struct radix_tree_node *node = root->node;
+    uint32_t shift = (root->height - 1) * RADIX_TREE_MAP_SHIFT;
+
+    while (1)
+    {
+        uint32_t offset = (i >> shift) & MAP_MASK;
+        uint32_t used = offset;
+        /* Bits of the index this node resolves, its own and below */
+        uint32_t span = shift + RADIX_TREE_MAP_SHIFT;
+
+        while (used < RADIX_TREE_MAP_SIZE && !node->slots[used])
+            used++;
+
+        if (used == RADIX_TREE_MAP_SIZE)
+        {
+            /* Nothing left under this node: retry from the next one */
+            if (span >= 64 || ((i >> span) + 1) << span == 0)
+                return NULL;
+            i = ((i >> span) + 1) << span;
+            goto restart;
+        }
+        if (used != offset)
+        {
+            uint64_t low = span >= 64 ? ~0ULL : (1ULL << span) - 1;
+            i = (i & ~low) | ((uint64_t)used << shift);
+        }
+
+        if (shift == 0)
+        {
+            *index = i;
+            return node->slots[used];
+        }
+        node = node->slots[used];
+        shift -= RADIX_TREE_MAP_SHIFT;
+    }
+}
+
+int radix_tree_gang_lookup(const struct radix_tree_root *root, void **results,
+                           uint64_t *indices, uint64_t first, int max)
+{
+    uint64_t index = first;
+    int found = 0;
+
+    if (!root->node)
+        return 0;
+
+    while (found < max)
+    {
+        void *item = find_next(root, &index);
+        if (!item)
+            break;
+        results[found] = item;
+        if (indices)
+            indices[found] = index;
+        found++;
+        if (index == ~0ULL)
+            break;
+        index++;
+    }
+    return found;
+}
+
+static void destroy(struct radix_tree_node *node, uint32_t height)
+{
+    if (height > 1)
+    {
+        for (int i = 0; i < RADIX_TREE_MAP_SIZE; i++)
+        {
+            if (node->slots[i])
+                destroy(node->slots[i], height - 1);
+        }
+    }
+    free(node);
+}
+
+void radix_tree_destroy(struct radix_tree_root *root)
+{
+    if (root->node)
+        destroy(root->node, root->height);
+    root->node = NULL;
+    root->height = 0;
+    root->items = 0;
+}
@@ -0,0 +1,513 @@
+/**
+ * @file rbtree.c
+ * @brief Red-black trees, optionally augmented.
+ *
+ * The parent pointer and the colour share a word: nodes are at least
+ * 8-byte aligned, so bit 0 is free. Insertion and erasure follow the
+ * classic case analysis (and the Linux implementation): at most two
+ * rotations on insert and three on erase, with colour flips propagating
+ * upward. The plain and augmented variants are the same code, inlined
+ * twice, so plain trees pay nothing for the rotate callbacks.
+ */
+
+#include <valen/rbtree.h>
+
+#define RB_RED 0
+#define RB_BLACK 1
+
+#define __always_inline inline __attribute__((always_inline))
+
+#define __rb_parent(pc) ((struct rb_node *)((pc) & ~3UL))
+#define __rb_is_black(pc) ((pc) & 1)
+#define rb_is_black(rb) __rb_is_black((rb)->__rb_parent_color)
+#define rb_is_red(rb) (!rb_is_black(rb))
+
+static inline void rb_set_parent(struct rb_node *rb, struct rb_node *p)
+{
+    rb->__rb_parent_color = (rb->__rb_parent_color & 1) | (uintptr_t)p;
+}
+
+static inline void rb_set_parent_color(struct rb_node *rb, struct rb_node *p, int color)
+{
+    rb->__rb_parent_color = (uintptr_t)p | color;
+}
+
+static inline void rb_set_black(struct rb_node *rb)
+{
+    rb->__rb_parent_color |= RB_BLACK;
+}
+
+/* A red node's colour bit is 0, so its word is the parent pointer */
+static inline struct rb_node *rb_red_parent(struct rb_node *red)
+{
+    return (struct rb_node *)red->__rb_parent_color;
+}
+
+static inline void rb_change_child(struct rb_node *old, struct rb_node *new,
+                                   struct rb_node *parent, struct rb_root *root)
+{
+    if (!parent)
+        root->rb_node = new;
+    else if (parent->rb_left == old)
+        parent->rb_left = new;
+    else
+        parent->rb_right = new;
+}
+
+/**
+ * @brief new takes old's parent and colour; old becomes new's child
+ * with the given colour.
+ */
+static inline void rb_rotate_set_parents(struct rb_node *old, struct rb_node *new,
+                                         struct rb_root *root, int color)
+{
+    struct rb_node *parent = rb_parent(old);
+
+    new->__rb_parent_color = old->__rb_parent_color;
+    rb_set_parent_color(old, new, color);
+    rb_change_child(old, new, parent, root);
+}
+
+static __always_inline void
+rb_insert_fixup(struct rb_node *node, struct rb_root *root,
+                void (*augment_rotate)(struct rb_node *old, struct rb_node *new))
+{
+    struct rb_node *parent = rb_red_parent(node), *gparent, *tmp;
+
+    while (1)
+    {
+        /* The root is always black; a black parent needs nothing */
+        if (!parent)
+        {
+            rb_set_parent_color(node, NULL, RB_BLACK);
+            break;
+        }
+        if (rb_is_black(parent))
+            break;
+
+        gparent = rb_red_parent(parent);
+        tmp = gparent->rb_right;
+        if (parent != tmp)
+        {
+            /* parent is a left child */
+            if (tmp && rb_is_red(tmp))
+            {
+                /* Red uncle: flip colours and continue from gparent */
+                rb_set_parent_color(tmp, gparent, RB_BLACK);
+                rb_set_parent_color(parent, gparent, RB_BLACK);
+                node = gparent;
+                parent = rb_parent(node);
+                rb_set_parent_color(node, parent, RB_RED);
+                continue;
+            }
+
+            tmp = parent->rb_right;
+            if (node == tmp)
+            {
+                /* Inner grandchild: rotate left at parent */
+                tmp = node->rb_left;
+                parent->rb_right = tmp;
+                node->rb_left = parent;
+                if (tmp)
+                    rb_set_parent_color(tmp, parent, RB_BLACK);
+                rb_set_parent_color(parent, node, RB_RED);
+                augment_rotate(parent, node);
+                parent = node;
+                tmp = node->rb_right;
+            }
+
+            /* Outer grandchild: rotate right at gparent */
+            gparent->rb_left = tmp;
+            parent->rb_right = gparent;
+            if (tmp)
+                rb_set_parent_color(tmp, gparent, RB_BLACK);
+            rb_rotate_set_parents(gparent, parent, root, RB_RED);
+            augment_rotate(gparent, parent);
+            break;
+        }
+        else
+        {
+            /* Mirror image: parent is a right child */
+            tmp = gparent->rb_left;
+            if (tmp && rb_is_red(tmp))
+            {
+                rb_set_parent_color(tmp, gparent, RB_BLACK);
+                rb_set_parent_color(parent, gparent, RB_BLACK);
+                node = gparent;
+                parent = rb_parent(node);
+                rb_set_parent_color(node, parent, RB_RED);
+                continue;
+            }
+
+            tmp = parent->rb_left;
+            if (node == tmp)
+            {
+                tmp = node->rb_right;
+                parent->rb_left = tmp;
+                node->rb_right = parent;
+                if (tmp)
+                    rb_set_parent_color(tmp, parent, RB_BLACK);
+                rb_set_parent_color(parent, node, RB_RED);
+                augment_rotate(parent, node);
+                parent = node;
+                tmp = node->rb_left;
+            }
+
+            gparent->rb_right = tmp;
+            parent->rb_left = gparent;
+            if (tmp)
+                rb_set_parent_color(tmp, gparent, RB_BLACK);
+            rb_rotate_set_parents(gparent, parent, root, RB_RED);
+            augment_rotate(gparent, parent);
+            break;
+        }
+    }
+}
+
+/**
+ * @brief Restores the black height after a black node left the subtree
+ * below parent (whose child on that side is now NULL or was just fixed).
+ */
+static __always_inline void
+rb_erase_fixup(struct rb_node *parent, struct rb_root *root,
+               void (*augment_rotate)(struct rb_node *old, struct rb_node *new))
+{
+    struct rb_node *node = NULL, *sibling, *tmp1, *tmp2;
+
+    while (1)
+    {
+        sibling = parent->rb_right;
+        if (node != sibling)
+        {
+            /* node is a left child */
+            if (rb_is_red(sibling))
+            {
+                /* Red sibling: rotate left at parent to get a black one */
+                tmp1 = sibling->rb_left;
+                parent->rb_right = tmp1;
+                sibling->rb_left = parent;
+                rb_set_parent_color(tmp1, parent, RB_BLACK);
+                rb_rotate_set_parents(parent, sibling, root, RB_RED);
+                augment_rotate(parent, sibling);
+                sibling = tmp1;
+            }
+            tmp1 = sibling->rb_right;
+            if (!tmp1 || rb_is_black(tmp1))
+            {
+                tmp2 = sibling->rb_left;
+                if (!tmp2 || rb_is_black(tmp2))
+                {
+                    /* Black sibling with black children: make it red and
+                     * push the missing black up */
+                    rb_set_parent_color(sibling, parent, RB_RED);
+                    if (rb_is_red(parent))
+                    {
+                        rb_set_black(parent);
+                    }
+                    else
+                    {
+                        node = parent;
+                        parent = rb_parent(node);
+                        if (parent)
+                            continue;
+                    }
+                    break;
+                }
+                /* Only the inner nephew is red: rotate right at sibling */
+                tmp1 = tmp2->rb_right;
+                sibling->rb_left = tmp1;
+                tmp2->rb_right = sibling;
+                parent->rb_right = tmp2;
+                if (tmp1)
+                    rb_set_parent_color(tmp1, sibling, RB_BLACK);
+                augment_rotate(sibling, tmp2);
+                tmp1 = sibling;
+                sibling = tmp2;
+            }
+            /* Outer nephew red: rotate left at parent and recolour */
+            tmp2 = sibling->rb_left;
+            parent->rb_right = tmp2;
+            sibling->rb_left = parent;
+            rb_set_parent_color(tmp1, sibling, RB_BLACK);
+            if (tmp2)
+                rb_set_parent(tmp2, parent);
+            rb_rotate_set_parents(parent, sibling, root, RB_BLACK);
+            augment_rotate(parent, sibling);
+            break;
+        }
+        else
+        {
+            /* Mirror image: node is a right child */
+            sibling = parent->rb_left;
+            if (rb_is_red(sibling))
+            {
+                tmp1 = sibling->rb_right;
+                parent->rb_left = tmp1;
+                sibling->rb_right = parent;
+                rb_set_parent_color(tmp1, parent, RB_BLACK);
+                rb_rotate_set_parents(parent, sibling, root, RB_RED);
+                augment_rotate(parent, sibling);
+                sibling = tmp1;
+            }
+            tmp1 = sibling->rb_left;
+            if (!tmp1 || rb_is_black(tmp1))
+            {
+                tmp2 = sibling->rb_right;
+                if (!tmp2 || rb_is_black(tmp2))
+                {
+                    rb_set_parent_color(sibling, parent, RB_RED);
+                    if (rb_is_red(parent))
+                    {
+                        rb_set_black(parent);
+                    }
+                    else
+                    {
+                        node = parent;
+                        parent = rb_parent(node);
+                        if (parent)
+                            continue;
+                    }
+                    break;
+                }
+                tmp1 = tmp2->rb_left;
+                sibling->rb_right = tmp1;
+                tmp2->rb_left = sibling;
+                parent->rb_left = tmp2;
+                if (tmp1)
+                    rb_set_parent_color(tmp1, sibling, RB_BLACK);
+                augment_rotate(sibling, tmp2);
+                tmp1 = sibling;
+                sibling = tmp2;
+            }
+            tmp2 = sibling->rb_right;
+            parent->rb_left = tmp2;
+            sibling->rb_right = parent;
+            rb_set_parent_color(tmp1, sibling, RB_BLACK);
+            if (tmp2)
+                rb_set_parent(tmp2, parent);
+            rb_rotate_set_parents(parent, sibling, root, RB_BLACK);
+            augment_rotate(parent, sibling);
+            break;
+        }
+    }
+}
+
+/**
+ * @brief Unlinks node, splicing in its successor when it has two
+ * children. Returns the node the black-height fixup starts from, if any.
+ */
+static __always_inline struct rb_node *
+rb_erase_unlink(struct rb_node *node, struct rb_root *root,
+                void (*augment_propagate)(struct rb_node *node, struct rb_node *stop),
+                void (*augment_copy)(struct rb_node *old, struct rb_node *new))
+{
+    struct rb_node *child = node->rb_right;
+    struct rb_node *tmp = node->rb_left;
+    struct rb_node *parent, *rebalance;
+    uintptr_t pc;
+
+    if (!tmp)
+    {
+        /* At most a right child, which must be red: it takes node's place */
+        pc = node->__rb_parent_color;
+        parent = __rb_parent(pc);
+        rb_change_child(node, child, parent, root);
+        if (child)
+        {
+            child->__rb_parent_color = pc;
+            rebalance = NULL;
+        }
+        else
+        {
+            rebalance = __rb_is_black(pc) ? parent : NULL;
+        }
+        tmp = parent;
+    }
+    else if (!child)
+    {
+        /* Only a (red) left child */
+        tmp->__rb_parent_color = pc = node->__rb_parent_color;
+        parent = __rb_parent(pc);
+        rb_change_child(node, tmp, parent, root);
+        rebalance = NULL;
+        tmp = parent;
+    }
+    else
+    {
+        struct rb_node *successor = child, *child2;
+
+        tmp = child->rb_left;
+        if (!tmp)
+        {
+            /* The successor is the right child */
+            parent = successor;
+            child2 = successor->rb_right;
+            augment_copy(node, successor);
+        }
+        else
+        {
+            /* The successor is the leftmost node of the right subtree */
+            do
+            {
+                parent = successor;
+                successor = tmp;
+                tmp = tmp->rb_left;
+            } while (tmp);
+            child2 = successor->rb_right;
+            parent->rb_left = child2;
+            successor->rb_right = child;
+            rb_set_parent(child, successor);
+            augment_copy(node, successor);
+            augment_propagate(parent, successor);
+        }
+
+        tmp = node->rb_left;
+        successor->rb_left = tmp;
+        rb_set_parent(tmp, successor);
+
+        pc = node->__rb_parent_color;
+        tmp = __rb_parent(pc);
+        rb_change_child(node, successor, tmp, root);
+
+        if (child2)
+        {
+            rb_set_parent_color(child2, parent, RB_BLACK);
+            rebalance = NULL;
+        }
+        else
+        {
+            rebalance = rb_is_black(successor) ? parent : NULL;
+        }
+        successor->__rb_parent_color = pc;
+        tmp = successor;
+    }
+
+    augment_propagate(tmp, NULL);
+    return rebalance;
+}
+
+/* Plain trees: no augmented value to maintain */
+static inline void dummy_propagate(struct rb_node *node, struct rb_node *stop)
+{
+    (void)node;
+    (void)stop;
+}
+
+static inline void dummy_copy(struct rb_node *old, struct rb_node *new)
+{
+    (void)old;
+    (void)new;
+}
+
+static inline void dummy_rotate(struct rb_node *old, struct rb_node *new)
+{
+    (void)old;
+    (void)new;
+}
+
+void rb_insert_color(struct rb_node *node, struct rb_root *root)
+{
+    rb_insert_fixup(node, root, dummy_rotate);
+}
+
+void rb_erase(struct rb_node *node, struct rb_root *root)
+{
+    struct rb_node *rebalance = rb_erase_unlink(node, root, dummy_propagate, dummy_copy);
+
+    if (rebalance)
+        rb_erase_fixup(rebalance, root, dummy_rotate);
+}
+
+void rb_insert_augmented(struct rb_node *node, struct rb_root *root,
+                         const struct rb_augment_callbacks *augment)
+{
+    rb_insert_fixup(node, root, augment->rotate);
+}
+
+void rb_erase_augmented(struct rb_node *node, struct rb_root *root,
+                        const struct rb_augment_callbacks *augment)
+{
+    struct rb_node *rebalance =
+        rb_erase_unlink(node, root, augment->propagate, augment->copy);
+
+    if (rebalance)
+        rb_erase_fixup(rebalance, root, augment->rotate);
+}
+
+void rb_replace_node(struct rb_node *victim, struct rb_node *new, struct rb_root *root)
+{
+    struct rb_node *parent = rb_parent(victim);
+
+    *new = *victim;
+    if (victim->rb_left)
+        rb_set_parent(victim->rb_left, new);
+    if (victim->rb_right)
+        rb_set_parent(victim->rb_right, new);
+    rb_change_child(victim, new, parent, root);
+}
+
+/* --- Traversal --- */
+
+struct rb_node *rb_first(const struct rb_root *root)
+{
+    struct rb_node *n = root->rb_node;
+
+    if (!n)
+        return NULL;
+    while (n->rb_left)
+        n = n->rb_left;
+    return n;
+}
+
+struct rb_node *rb_last(const struct rb_root *root)
+{
+    struct rb_node *n = root->rb_node;
+
+    if (!n)
+        return NULL;
+    while (n->rb_right)
+        n = n->rb_right;
+    return n;
+}
+
+struct rb_node *rb_next(const struct rb_node *node)
+{
+    struct rb_node *parent;
+
+    if (RB_EMPTY_NODE(node))
+        return NULL;
+
+    /* Leftmost node of the right subtree, if there is one */
+    if (node->rb_right)
+    {
+        node = node->rb_right;
+        while (node->rb_left)
+            node = node->rb_left;
+        return (struct rb_node *)node;
+    }
+
+    /* Otherwise the first ancestor reached from its left side */
+    while ((parent = rb_parent(node)) && node == parent->rb_right)
+        node = parent;
+    return parent;
+}
+
+struct rb_node *rb_prev(const struct rb_node *node)
+{
+    struct rb_node *parent;
+
+    if (RB_EMPTY_NODE(node))
+        return NULL;
+
+    if (node->rb_left)
+    {
+        node = node->rb_left;
+        while (node->rb_right)
+            node = node->rb_right;
+        return (struct rb_node *)node;
+    }
+
+    while ((parent = rb_parent(node)) && node == parent->rb_left)
+        node = parent;
+    return parent;
+}
@@ -0,0 +1,155 @@
+/**
+ * @file ring.c
+ * @brief Single- and multi-producer bounded ring queues.
+ *
+ * Indices run freely and are masked on use, so full and empty are told
+ * apart without a spare slot. The release store that publishes an index
+ * (or an MPMC cell's sequence number) orders the element copy before it;
+ * the acquire load on the other side orders the copy after.
+ */
+
+#include <valen/ring.h>
+#include <valen/atomic.h>
+#include <valen/string.h>
+
+static inline bool power_of_two(uint32_t n)
+{
+    return n && !(n & (n - 1));
+}
+
+int spsc_ring_init(struct spsc_ring *ring, void *buffer, uint32_t size, uint32_t elem_size)
+{
+    if (!power_of_two(size))
+        return -1;
+
+    ring->data = buffer;
+    ring->mask = size - 1;
+    ring->elem_size = elem_size;
+    ring->head = ring->cached_tail = 0;
+    ring->tail = ring->cached_head = 0;
+    return 0;
+}
+
+bool spsc_ring_push(struct spsc_ring *ring, const void *elem)
+{
+    uint32_t head = ring->head;
+
+    if (head - ring->cached_tail > ring->mask)
+    {
+        ring->cached_tail = smp_load_acquire(&ring->tail);
+        if (head - ring->cached_tail > ring->mask)
+            return false;
+    }
+
+    memcpy(ring->data + (uint64_t)(head & ring->mask) * ring->elem_size, elem, ring->elem_size);
+    smp_store_release(&ring->head, head + 1);
+    return true;
+}
+
+bool spsc_ring_pop(struct spsc_ring *ring, void *out)
+{
+    uint32_t tail = ring->tail;
+
+    if (tail == ring->cached_head)
+    {
+        ring->cached_head = smp_load_acquire(&ring->head);
+        if (tail == ring->cached_head)
+            return false;
+    }
+
+    memcpy(out, ring->data + (uint64_t)(tail & ring->mask) * ring->elem_size, ring->elem_size);
+    smp_store_release(&ring->tail, tail + 1);
+    return true;
+}
+
+/* --- MPMC --- */
+
+static inline uint64_t *cell_seq(struct mpmc_ring *ring, uint64_t pos)
+{
+    return (uint64_t *)(ring->cells + (pos & ring->mask) * ring->stride);
+}
+
+int mpmc_ring_init(struct mpmc_ring *ring, void *buffer, uint32_t size, uint32_t elem_size)
+{
+    if (!power_of_two(size))
+        return -1;
+
+    ring->cells = buffer;
+    ring->mask = size - 1;
+    ring->elem_size = elem_size;
+    ring->stride = MPMC_RING_STRIDE(elem_size);
+    ring->enqueue_pos = 0;
+    ring->dequeue_pos = 0;
+
+    /* Cell i is ready for the producer of position i */
+    for (uint64_t i = 0; i < size; i++)
+        *cell_seq(ring, i) = i;
+    return 0;
+}
+
+bool mpmc_ring_push(struct mpmc_ring *ring, const void *elem)
+{
+    uint64_t pos = __atomic_load_n(&ring->enqueue_pos, __ATOMIC_RELAXED);
+    uint64_t *seq;
+
+    while (1)
+    {
+        seq = cell_seq(ring, pos);
+        int64_t diff = (int64_t)(smp_load_acquire(seq) - pos);
+
+        if (diff == 0)
+        {
+            /* Free for this lap: claim it (pos is reloaded on failure) */
+            if (__atomic_compare_exchange_n(&ring->enqueue_pos, &pos, pos + 1, true,
+                                            __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+                break;
+        }
+        else if (diff < 0)
+        {
+            /* Still holds the element of the previous lap */
+            return false;
+        }
+        else
+        {
+            /* Another producer claimed it first */
+            pos = __atomic_load_n(&ring->enqueue_pos, __ATOMIC_RELAXED);
+        }
+    }
+
+    memcpy(seq + 1, elem, ring->elem_size);
+    smp_store_release(seq, pos + 1);
+    return true;
+}
+
+bool mpmc_ring_pop(struct mpmc_ring *ring, void *out)
+{
+    uint64_t pos = __atomic_load_n(&ring->dequeue_pos, __ATOMIC_RELAXED);
+    uint64_t *seq;
+
+    while (1)
+    {
+        seq = cell_seq(ring, pos);
+        int64_t diff = (int64_t)(smp_load_acquire(seq) - (pos + 1));
+
+        if (diff == 0)
+        {
+            if (__atomic_compare_exchange_n(&ring->dequeue_pos, &pos, pos + 1, true,
+                                            __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+                break;
+        }
+        else if (diff < 0)
+        {
+            /* Not filled yet in this lap */
+            return false;
+        }
+        else
+        {
+            pos = __atomic_load_n(&ring->dequeue_pos, __ATOMIC_RELAXED);
+        }
+    }
+
+    memcpy(out, seq + 1, ring->elem_size);
+    /* Ready for the producer one lap later */
+    smp_store_release(seq, pos + ring->mask + 1);
+    return true;
+}
@@ -0,0 +1,119 @@
+/**
+ * @file siphash.c
+ * @brief SipHash-2-4, as specified by Aumasson and Bernstein.
+ *
+ * Two SipRounds per 8-byte word and four to finalize. The last word holds
+ * the remaining bytes and, in its top byte, the length mod 256. The
+ * fixed-size variants unroll the same steps with no tail handling.
+ */
+
+#include <valen/siphash.h>
+#include <valen/unaligned.h>
+
+static inline uint64_t rol64(uint64_t x, int r)
+{
+    return (x << r) | (x >> (64 - r));
+}
+
+#define SIPROUND                                                                           \
+    do                                                                                     \
+    {                                                                                      \
+        v0 += v1;                                                                          \
+        v1 = rol64(v1, 13);                                                                \
+        v1 ^= v0;                                                                          \
+        v0 = rol64(v0, 32);                                                                \
+        v2 += v3;                                                                          \
+        v3 = rol64(v3, 16);                                                                \
+        v3 ^= v2;                                                                          \
+        v0 += v3;                                                                          \
+        v3 = rol64(v3, 21);                                                                \
+        v3 ^= v0;                                                                          \
+        v2 += v1;                                                                          \
+        v1 = rol64(v1, 17);                                                                \
+        v1 ^= v2;                                                                          \
+        v2 = rol64(v2, 32);                                                                \
+    } while (0)
+
+#define SIPHASH_START                                                                      \
+    uint64_t v0 = 0x736F6D6570736575ULL ^ key->key[0];                                     \
+    uint64_t v1 = 0x646F72616E646F6DULL ^ key->key[1];                                     \
+    uint64_t v2 = 0x6C7967656E657261ULL ^ key->key[0];                                     \
+    uint64_t v3 = 0x7465646279746573ULL ^ key->key[1]
+
+#define SIPHASH_WORD(m)                                                                    \
+    do                                                                                     \
+    {                                                                                      \
+        v3 ^= (m);                                                                         \
+        SIPROUND;                                                                          \
+        SIPROUND;                                                                          \
+        v0 ^= (m);                                                                         \
+    } while (0)
+
+#define SIPHASH_FINISH                                                                     \
+    do                                                                                     \
+    {                                                                                      \
+        v2 ^= 0xFF;                                                                        \
+        SIPROUND;                                                                          \
+        SIPROUND;                                                                          \
+        SIPROUND;                                                                          \
+        SIPROUND;                                                                          \
+        return v0 ^ v1 ^ v2 ^ v3;                                                          \
+    } while (0)
+
+uint64_t siphash(const void *data, uint64_t len, const siphash_key_t *key)
+{
+    const uint8_t *p = data;
+    const uint8_t *end = p + (len & ~7ULL);
+    uint64_t last = len << 56;
+    SIPHASH_START;
+
+    for (; p < end; p += 8)
+        SIPHASH_WORD(get_unaligned_le64(p));
+
+    switch (len & 7)
+    {
+    case 7:
+        last |= (uint64_t)p[6] << 48;
+        /* fallthrough */
+    case 6:
+        last |= (uint64_t)p[5] << 40;
+        /* fallthrough */
+    case 5:
+        last |= (uint64_t)p[4] << 32;
+        /* fallthrough */
+    case 4:
+        last |= get_unaligned_le32(p);
+        break;
+    case 3:
+        last |= (uint64_t)p[2] << 16;
+        /* fallthrough */
+    case 2:
+        last |= get_unaligned_le16(p);
+        break;
+    case 1:
+        last |= p[0];
+        break;
+    }
+
+    SIPHASH_WORD(last);
+    SIPHASH_FINISH;
+}
+
+uint64_t siphash_1u64(uint64_t first, const siphash_key_t *key)
+{
+    SIPHASH_START;
+
+    SIPHASH_WORD(first);
+    SIPHASH_WORD(8ULL << 56);
+    SIPHASH_FINISH;
+}
+
+uint64_t siphash_2u64(uint64_t first, uint64_t second, const siphash_key_t *key)
+{
+    SIPHASH_START;
+
+    SIPHASH_WORD(first);
+    SIPHASH_WORD(second);
+    SIPHASH_WORD(16ULL << 56);
+    SIPHASH_FINISH;
+}
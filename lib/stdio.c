@@ -7,18 +7,77 @@
 #include <valen/io.h>
 #include <valen/spinlock.h>
 #include <valen/color.h>
+#include <valen/vmm.h>
 
 /* Higher Half Virtual Address for VGA Buffer */
 #define VIRT_ADDR 0xFFFFFFFF800B8000
+#define VGA_PHYS 0xB8000
+#define VGA_CELLS (80 * 25)
 
+#ifdef CONFIG_CONSOLE_VGA
 static uint16_t *buffer = (uint16_t *)VIRT_ADDR;
+
+/* Cached copy of the screen: scrolling reads this, never video memory,
+ * which is uncached (and write-combined after console_map_wc()) */
+static uint16_t shadow[VGA_CELLS];
+
+static inline void vga_set(int index, uint16_t cell)
+{
+    shadow[index] = cell;
+    buffer[index] = cell;
+}
+#endif
 static int cursor_x = 0;
 static int cursor_y = 0;
 const int width = 80;
 const int height = 25;
 static uint8_t terminal_attribute = COLOR_GREEN;
 
-static spinlock_t lock = SPINLOCK_INIT;
+static spinlock_t lock = SPINLOCK_INIT_NAMED("console_lock");
+
+/* Everything written to the console or COM1, kept for crash images */
+static char log_ring[CONSOLE_LOG_SIZE];
+static uint64_t log_head = 0; /* Total characters ever logged */
+
+/**
+ * @brief Appends one character to the log ring (console lock held).
+ */
+static inline void log_char(char c)
+{
+    log_ring[log_head % CONSOLE_LOG_SIZE] = c;
+    log_head++;
+}
+
+/**
+ * @brief Copies the newest console output, oldest character first.
+ * Takes no lock so it can run on the crash path; a concurrent writer may
+ * tear the newest characters.
+ */
+uint64_t console_log_copy(char *out, uint64_t len)
+{
+    uint64_t head = log_head;
+    uint64_t count = head < CONSOLE_LOG_SIZE ? head : CONSOLE_LOG_SIZE;
+    if (count > len)
+        count = len;
+
+    for (uint64_t i = 0; i < count; i++)
+        out[i] = log_ring[(head - count + i) % CONSOLE_LOG_SIZE];
+    return count;
+}
+
+void console_map_wc(void)
+{
+#ifdef CONFIG_CONSOLE_VGA
+    uint16_t *wc = vmm_map_wc(VGA_PHYS, VGA_CELLS * sizeof(uint16_t));
+
+    if (wc)
+    {
+        spinlock_acquire(&lock);
+        buffer = wc;
+        spinlock_release(&lock);
+    }
+#endif
+}
 
 /**
  * @brief Sets the global text color for kprint.
@@ -42,6 +101,7 @@ void serial_write(char *s)
     spinlock_acquire(&lock);
     while (*s)
     {
+        log_char(*s);
         outb(0x3f8, *s++);
     }
     spinlock_release(&lock);
@@ -76,11 +136,16 @@ int get_cursor_y() { return cursor_y; }
  */
 void update_cursor(int x, int y)
 {
+#ifdef CONFIG_CONSOLE_VGA
     uint16_t pos = y * width + x;
     outb(0x3D4, 0x0F);
     outb(0x3D5, (uint8_t)(pos & 0xFF));
     outb(0x3D4, 0x0E);
     outb(0x3D5, (uint8_t)((pos >> 8) & 0xFF));
+#else
+    (void)x;
+    (void)y;
+#endif
 }
 
 /**
@@ -100,10 +165,15 @@ void set_cursor(int x, int y)
  */
 void enable_cursor(uint8_t cursor_start, uint8_t cursor_end)
 {
+#ifdef CONFIG_CONSOLE_VGA
     outb(0x3D4, 0x0A);
     outb(0x3D5, (inb(0x3D5) & 0xC0) | cursor_start);
     outb(0x3D4, 0x0B);
     outb(0x3D5, (inb(0x3D5) & 0xE0) | cursor_end);
+#else
+    (void)cursor_start;
+    (void)cursor_end;
+#endif
 }
 
 /**
@@ -112,11 +182,13 @@ void enable_cursor(uint8_t cursor_start, uint8_t cursor_end)
 void print_clear()
 {
     spinlock_acquire(&lock);
+#ifdef CONFIG_CONSOLE_VGA
     uint16_t blank = (uint16_t)' ' | ((uint16_t)terminal_attribute << 8);
     for (int i = 0; i < width * height; i++)
     {
-        buffer[i] = blank;
+        vga_set(i, blank);
     }
+#endif
 
     cursor_x = 0;
     cursor_y = 1;
@@ -139,20 +211,22 @@ void print_newline()
     }
     else
     {
+#ifdef CONFIG_CONSOLE_VGA
         /* Move all rows from row 1 to height-1 UP by one */
         for (int y = 1; y < height - 1; y++)
         {
             for (int x = 0; x < width; x++)
             {
-                buffer[y * width + x] = buffer[(y + 1) * width + x];
+                vga_set(y * width + x, shadow[(y + 1) * width + x]);
             }
         }
         /* Clear the bottom-most row only */
         uint16_t blank = (uint16_t)' ' | ((uint16_t)terminal_attribute << 8);
         for (int x = 0; x < width; x++)
         {
-            buffer[(height - 1) * width + x] = blank;
+            vga_set((height - 1) * width + x, blank);
         }
+#endif
         cursor_y = height - 1;
     }
     update_cursor(cursor_x, cursor_y);
@@ -174,6 +248,11 @@ void puts(const char *str)
 void putc(char c)
 {
     spinlock_acquire(&lock);
+    log_char(c);
+
+#ifdef CONFIG_CONSOLE_SERIAL
+    outb(0x3f8, c);
+#endif
     
     if (c == '\n')
     {
@@ -189,8 +268,10 @@ void putc(char c)
         spinlock_acquire(&lock);
     }
 
+#ifdef CONFIG_CONSOLE_VGA
     uint8_t uc = (uint8_t)c;
-    buffer[cursor_y * width + cursor_x] = (uint16_t)uc | ((uint16_t)terminal_attribute << 8);
+    vga_set(cursor_y * width + cursor_x, (uint16_t)uc | ((uint16_t)terminal_attribute << 8));
+#endif
 
     cursor_x++;
     update_cursor(cursor_x, cursor_y);
@@ -292,6 +373,192 @@ void printf(const char *format, ...)
     va_end(args);
 }
 
+/* --- Buffer formatting --- */
+
+struct fmt_buf
+{
+    char *buf;
+    uint64_t size;
+    uint64_t pos;
+};
+
+static void fmt_putc(struct fmt_buf *fb, char c)
+{
+    if (fb->pos + 1 < fb->size)
+        fb->buf[fb->pos] = c;
+    fb->pos++;
+}
+
+static void fmt_number(struct fmt_buf *fb, uint64_t num, int base, int upper,
+                       int negative, int width, char pad, int left)
+{
+    const char *digits = upper ? "0123456789ABCDEF" : "0123456789abcdef";
+    char tmp[24];
+    int len = 0;
+
+    do
+    {
+        tmp[len++] = digits[num % base];
+        num /= base;
+    } while (num);
+
+    if (negative)
+        tmp[len++] = '-';
+
+    /* Zero padding goes between the sign and the digits */
+    if (negative && pad == '0' && !left)
+    {
+        fmt_putc(fb, '-');
+        len--;
+        width--;
+    }
+
+    if (!left)
+        for (int i = len; i < width; i++)
+            fmt_putc(fb, pad);
+    for (int i = len - 1; i >= 0; i--)
+        fmt_putc(fb, tmp[i]);
+    if (left)
+        for (int i = len; i < width; i++)
+            fmt_putc(fb, ' ');
+}
+
+/**
+ * @brief Formats into a caller-supplied buffer without touching any console.
+ *
+ * Supports %d %i %u %x %X %p %s %c %% with the h/l/ll/z length modifiers,
+ * a field width and the '0' and '-' flags. Always NUL-terminates when
+ * size > 0 and returns the length the full output would have had.
+ */
+int vsnprintf(char *buf, uint64_t size, const char *format, va_list args)
+{
+    struct fmt_buf fb = {buf, size, 0};
+
+    for (; *format; format++)
+    {
+        if (*format != '%')
+        {
+            fmt_putc(&fb, *format);
+            continue;
+        }
+
+        format++;
+        int left = 0;
+        char pad = ' ';
+        int width = 0;
+        int lng = 0;
+
+        for (;; format++)
+        {
+            if (*format == '-')
+                left = 1;
+            else if (*format == '0')
+                pad = '0';
+            else
+                break;
+        }
+        while (*format >= '0' && *format <= '9')
+            width = width * 10 + (*format++ - '0');
+        while (*format == 'l' || *format == 'z' || *format == 'h')
+        {
+            if (*format != 'h')
+                lng++;
+            format++;
+        }
+
+        switch (*format)
+        {
+        case 'd':
+        case 'i':
+        {
+            int64_t v = lng ? va_arg(args, int64_t) : va_arg(args, int);
+            fmt_number(&fb, v < 0 ? -(uint64_t)v : (uint64_t)v, 10, 0, v < 0, width, pad, left);
+            break;
+        }
+        case 'u':
+            fmt_number(&fb, lng ? va_arg(args, uint64_t) : va_arg(args, unsigned int), 10, 0, 0, width, pad, left);
+            break;
+        case 'x':
+        case 'X':
+            fmt_number(&fb, lng ? va_arg(args, uint64_t) : va_arg(args, unsigned int), 16, *format == 'X', 0, width, pad, left);
+            break;
+        case 'p':
+            fmt_putc(&fb, '0');
+            fmt_putc(&fb, 'x');
+            fmt_number(&fb, (uint64_t)va_arg(args, void *), 16, 0, 0, 16, '0', 0);
+            break;
+        case 's':
+        {
+            const char *str = va_arg(args, const char *);
+            int len = 0;
+            if (!str)
+                str = "(null)";
+            while (str[len])
+                len++;
+            if (!left)
+                for (int i = len; i < width; i++)
+                    fmt_putc(&fb, ' ');
+            for (int i = 0; i < len; i++)
+                fmt_putc(&fb, str[i]);
+            if (left)
+                for (int i = len; i < width; i++)
+                    fmt_putc(&fb, ' ');
+            break;
+        }
+        case 'c':
+            fmt_putc(&fb, (char)va_arg(args, int));
+            break;
+        case '%':
+            fmt_putc(&fb, '%');
+            break;
+        case '\0':
+            format--;
+            break;
+        default:
+            fmt_putc(&fb, '%');
+            fmt_putc(&fb, *format);
+            break;
+        }
+    }
+
+    if (size)
+        buf[fb.pos < size ? fb.pos : size - 1] = '\0';
+    return (int)fb.pos;
+}
+
+int snprintf(char *buf, uint64_t size, const char *format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    int ret = vsnprintf(buf, size, format, args);
+    va_end(args);
+    return ret;
+}
+
+void printf_fmt(const char *format, ...)
+{
+    char buf[256];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(buf, sizeof(buf), format, args);
+    va_end(args);
+    puts(buf);
+}
+
+/**
+ * @brief printf-style output to COM1 only. Lines longer than 256 bytes
+ * are truncated.
+ */
+void serial_printf(const char *format, ...)
+{
+    char buf[256];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(buf, sizeof(buf), format, args);
+    va_end(args);
+    serial_write(buf);
+}
+
 void print_uint(uint64_t num)
 {
     if (num == 0)
@@ -444,8 +711,10 @@ void serial_write_hex(uint32_t n)
  */
 void hide_hardware_cursor()
 {
+#ifdef CONFIG_CONSOLE_VGA
     outb(0x3D4, 0x0A);
     outb(0x3D5, inb(0x3D5) | 0x20);
+#endif
 }
 
 /**
@@ -455,8 +724,10 @@ void hide_hardware_cursor()
  */
 void show_hardware_cursor()
 {
+#ifdef CONFIG_CONSOLE_VGA
     outb(0x3D4, 0x0A);
     outb(0x3D5, inb(0x3D5) & ~0x20);
+#endif
 }
 
 void print_backspace()
@@ -471,7 +742,14 @@ void print_backspace()
         cursor_y--;
         cursor_x = width - 1;
     }
-    buffer[cursor_y * width + cursor_x] = (uint16_t)' ' | ((uint16_t)terminal_attribute << 8);
+#ifdef CONFIG_CONSOLE_VGA
+    vga_set(cursor_y * width + cursor_x, (uint16_t)' ' | ((uint16_t)terminal_attribute << 8));
+#endif
+#ifdef CONFIG_CONSOLE_SERIAL
+    outb(0x3f8, '\b');
+    outb(0x3f8, ' ');
+    outb(0x3f8, '\b');
+#endif
     update_cursor(cursor_x, cursor_y);
     spinlock_release(&lock);
 }
@@ -1,8 +1,30 @@
 #include <valen/string.h>
+#include <valen/cpufeature.h>
 #include <stddef.h>
 
+/*
+ * Below this size the string instructions lose to a plain loop on their
+ * startup cost; with FSRM, rep movsb is fast at every size. KASAN builds
+ * keep the loops, which the compiler instruments.
+ */
+#define REP_STRING_MIN 64
+
 void *memset(void *ptr, int value, uint64_t num) {
     uint8_t *p = (uint8_t *)ptr;
+#ifndef CONFIG_KASAN
+    if (num >= REP_STRING_MIN) {
+        if (static_cpu_has(X86_FEATURE_ERMS)) {
+            asm volatile("rep stosb" : "+D"(p), "+c"(num) : "a"(value) : "memory");
+            return ptr;
+        }
+        uint64_t qwords = num / 8;
+        asm volatile("rep stosq"
+                     : "+D"(p), "+c"(qwords)
+                     : "a"(0x0101010101010101ULL * (uint8_t)value)
+                     : "memory");
+        num &= 7;
+    }
+#endif
     while (num--) {
         *p++ = (uint8_t)value;
     }
@@ -12,6 +34,18 @@ void *memset(void *ptr, int value, uint64_t num) {
 void *memcpy(void *dest, const void *src, uint64_t num) {
     uint8_t *d = (uint8_t *)dest;
     const uint8_t *s = (const uint8_t *)src;
+#ifndef CONFIG_KASAN
+    if (static_cpu_has(X86_FEATURE_FSRM) ||
+        (num >= REP_STRING_MIN && static_cpu_has(X86_FEATURE_ERMS))) {
+        asm volatile("rep movsb" : "+D"(d), "+S"(s), "+c"(num) : : "memory");
+        return dest;
+    }
+    if (num >= REP_STRING_MIN) {
+        uint64_t qwords = num / 8;
+        asm volatile("rep movsq" : "+D"(d), "+S"(s), "+c"(qwords) : : "memory");
+        num &= 7;
+    }
+#endif
     while (num--) {
         *d++ = *s++;
     }
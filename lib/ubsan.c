@@ -0,0 +1,403 @@
+/**
+ * @file ubsan.c
+ * @brief Undefined behaviour sanitizer runtime.
+ *
+ * With CONFIG_UBSAN the compiler adds checks for signed overflow, bad
+ * shifts, out-of-bounds array indexes, misaligned or null pointers, invalid
+ * bool/enum loads and more, and calls the matching handler here when one
+ * fails. Reports go to COM1 without locks and execution continues with
+ * the result the hardware produced. Each source location is reported only
+ * once: the handler marks its location as seen.
+ *
+ * This file is built without -fsanitize=undefined (ubsan-n in lib/Kbuild).
+ */
+
+#include <stdint.h>
+#include <valen/ubsan.h>
+#include <valen/stdio.h>
+#include <valen/panic.h>
+#include <valen/task.h>
+#include <valen/param.h>
+
+/* Set in a location's column once it has been reported */
+#define LOCATION_REPORTED 0x80000000u
+
+/* Layout of the data gcc passes to the handlers */
+struct source_location
+{
+    const char *file;
+    uint32_t line;
+    uint32_t column;
+};
+
+struct type_descriptor
+{
+    uint16_t kind; /* TYPE_KIND_* */
+    uint16_t info; /* Integers: bit 0 signed, bits 1+ log2 of the bit width */
+    char name[];
+};
+
+#define TYPE_KIND_INT 0
+#define TYPE_KIND_FLOAT 1
+
+struct overflow_data
+{
+    struct source_location loc;
+    struct type_descriptor *type;
+};
+
+struct shift_out_of_bounds_data
+{
+    struct source_location loc;
+    struct type_descriptor *lhs_type;
+    struct type_descriptor *rhs_type;
+};
+
+struct out_of_bounds_data
+{
+    struct source_location loc;
+    struct type_descriptor *array_type;
+    struct type_descriptor *index_type;
+};
+
+struct type_mismatch_data_v1
+{
+    struct source_location loc;
+    struct type_descriptor *type;
+    uint8_t log_alignment;
+    uint8_t type_check_kind;
+};
+
+struct unreachable_data
+{
+    struct source_location loc;
+};
+
+struct invalid_value_data
+{
+    struct source_location loc;
+    struct type_descriptor *type;
+};
+
+struct nonnull_arg_data
+{
+    struct source_location loc;
+    struct source_location attr_loc;
+    int arg_index;
+};
+
+struct nonnull_return_data
+{
+    struct source_location attr_loc;
+};
+
+struct vla_bound_data
+{
+    struct source_location loc;
+    struct type_descriptor *type;
+};
+
+struct pointer_overflow_data
+{
+    struct source_location loc;
+};
+
+struct invalid_builtin_data
+{
+    struct source_location loc;
+    uint8_t kind;
+};
+
+static const char *const type_check_kinds[] = {
+    "load of", "store to", "reference binding to", "member access within",
+    "member call on", "constructor call on", "downcast of", "downcast of",
+    "upcast of", "cast to virtual base of", "_Nonnull binding to",
+    "dynamic operation on",
+};
+
+static uint64_t reports = 0;
+
+static bool ubsan_panic = false;
+param_bool(ubsan_panic, ubsan_panic, "Panic after a UBSan report");
+
+uint64_t ubsan_report_count(void)
+{
+    return reports;
+}
+
+/**
+ * @brief Starts a report for loc unless it was reported before.
+ * @return 0 if the report should be skipped.
+ */
+static int report_begin(struct source_location *loc, const char *what)
+{
+    if (loc->column & LOCATION_REPORTED)
+        return 0;
+    loc->column |= LOCATION_REPORTED;
+    reports++;
+
+    task_t *task = current_task;
+    crash_printf("==================================================================\n");
+    crash_printf("UBSAN: %s in %s:%u:%u\n", what, loc->file, loc->line,
+                 loc->column & ~LOCATION_REPORTED);
+    if (task)
+        crash_printf("Task: pid %d '%s'\n", task->pid, task->comm);
+    return 1;
+}
+
+static void report_end(uint64_t ip, uint64_t rbp, const char *what)
+{
+    dump_backtrace(ip, rbp, crash_printf);
+    crash_printf("==================================================================\n");
+
+    if (ubsan_panic)
+        panic("UBSAN: %s", what);
+}
+
+static int type_is_int(const struct type_descriptor *type)
+{
+    return type->kind == TYPE_KIND_INT;
+}
+
+static int type_is_signed(const struct type_descriptor *type)
+{
+    return type_is_int(type) && (type->info & 1);
+}
+
+static unsigned type_bits(const struct type_descriptor *type)
+{
+    return 1u << (type->info >> 1);
+}
+
+/**
+ * @brief Formats a value of the given type. Values wider than 64 bits
+ * are passed by pointer; only their low 64 bits are shown.
+ */
+static void format_value(char *buf, int len, const struct type_descriptor *type, uintptr_t value)
+{
+    if (!type_is_int(type))
+    {
+        snprintf(buf, len, "(%s)", type->name);
+        return;
+    }
+
+    uint64_t v = type_bits(type) > 64 ? *(uint64_t *)value : (uint64_t)value;
+    if (type_is_signed(type))
+    {
+        unsigned bits = type_bits(type);
+        int64_t s = bits < 64 ? (int64_t)(v << (64 - bits)) >> (64 - bits) : (int64_t)v;
+        snprintf(buf, len, "%lld", (long long)s);
+    }
+    else
+    {
+        snprintf(buf, len, "%llu", (unsigned long long)v);
+    }
+}
+
+/*
+ * The handler's return address is in the instrumented code, and the rbp
+ * saved at the bottom of its frame continues the backtrace from there.
+ */
+#define REPORT_IP ((uint64_t)__builtin_return_address(0))
+#define REPORT_RBP (*(uint64_t *)__builtin_frame_address(0))
+
+static void handle_overflow(struct overflow_data *data, uintptr_t lhs, uintptr_t rhs,
+                            char op, uint64_t ip, uint64_t rbp)
+{
+    char l[24], r[24];
+
+    if (!report_begin(&data->loc, type_is_signed(data->type) ? "signed integer overflow"
+                                                              : "unsigned integer overflow"))
+        return;
+
+    format_value(l, sizeof(l), data->type, lhs);
+    format_value(r, sizeof(r), data->type, rhs);
+    crash_printf("%s %c %s cannot be represented in type %s\n", l, op, r, data->type->name);
+    report_end(ip, rbp, "integer overflow");
+}
+
+void __ubsan_handle_add_overflow(struct overflow_data *data, uintptr_t lhs, uintptr_t rhs)
+{
+    handle_overflow(data, lhs, rhs, '+', REPORT_IP, REPORT_RBP);
+}
+
+void __ubsan_handle_sub_overflow(struct overflow_data *data, uintptr_t lhs, uintptr_t rhs)
+{
+    handle_overflow(data, lhs, rhs, '-', REPORT_IP, REPORT_RBP);
+}
+
+void __ubsan_handle_mul_overflow(struct overflow_data *data, uintptr_t lhs, uintptr_t rhs)
+{
+    handle_overflow(data, lhs, rhs, '*', REPORT_IP, REPORT_RBP);
+}
+
+void __ubsan_handle_negate_overflow(struct overflow_data *data, uintptr_t old)
+{
+    char v[24];
+
+    if (!report_begin(&data->loc, "negation overflow"))
+        return;
+
+    format_value(v, sizeof(v), data->type, old);
+    crash_printf("negation of %s cannot be represented in type %s\n", v, data->type->name);
+    report_end(REPORT_IP, REPORT_RBP, "negation overflow");
+}
+
+void __ubsan_handle_divrem_overflow(struct overflow_data *data, uintptr_t lhs, uintptr_t rhs)
+{
+    char l[24], r[24];
+
+    if (!report_begin(&data->loc, "division overflow"))
+        return;
+
+    format_value(l, sizeof(l), data->type, lhs);
+    format_value(r, sizeof(r), data->type, rhs);
+    if (type_is_signed(data->type) && r[0] == '-' && r[1] == '1' && !r[2])
+        crash_printf("division of %s by -1 cannot be represented in type %s\n", l, data->type->name);
+    else
+        crash_printf("division of %s by zero\n", l);
+    report_end(REPORT_IP, REPORT_RBP, "division overflow");
+}
+
+void __ubsan_handle_shift_out_of_bounds(struct shift_out_of_bounds_data *data,
+                                        uintptr_t lhs, uintptr_t rhs)
+{
+    char l[24], r[24];
+
+    if (!report_begin(&data->loc, "shift out of bounds"))
+        return;
+
+    format_value(l, sizeof(l), data->lhs_type, lhs);
+    format_value(r, sizeof(r), data->rhs_type, rhs);
+    if (r[0] == '-')
+        crash_printf("shift exponent %s is negative\n", r);
+    else if ((uint64_t)rhs >= type_bits(data->lhs_type))
+        crash_printf("shift exponent %s is too large for %u-bit type %s\n", r,
+                     type_bits(data->lhs_type), data->lhs_type->name);
+    else if (l[0] == '-')
+        crash_printf("left shift of negative value %s\n", l);
+    else
+        crash_printf("left shift of %s by %s places cannot be represented in type %s\n",
+                     l, r, data->lhs_type->name);
+    report_end(REPORT_IP, REPORT_RBP, "shift out of bounds");
+}
+
+void __ubsan_handle_out_of_bounds(struct out_of_bounds_data *data, uintptr_t index)
+{
+    char i[24];
+
+    if (!report_begin(&data->loc, "array index out of bounds"))
+        return;
+
+    format_value(i, sizeof(i), data->index_type, index);
+    crash_printf("index %s is out of range for type %s\n", i, data->array_type->name);
+    report_end(REPORT_IP, REPORT_RBP, "array index out of bounds");
+}
+
+void __ubsan_handle_type_mismatch_v1(struct type_mismatch_data_v1 *data, uintptr_t ptr)
+{
+    uint64_t alignment = 1ULL << data->log_alignment;
+    const char *kind = data->type_check_kind < sizeof(type_check_kinds) / sizeof(type_check_kinds[0])
+                           ? type_check_kinds[data->type_check_kind]
+                           : "access to";
+
+    if (!ptr)
+    {
+        if (!report_begin(&data->loc, "null pointer dereference"))
+            return;
+        crash_printf("%s null pointer of type %s\n", kind, data->type->name);
+    }
+    else if (alignment > 1 && (ptr & (alignment - 1)))
+    {
+        if (!report_begin(&data->loc, "misaligned access"))
+            return;
+        crash_printf("%s misaligned address %016lx for type %s, which requires %lu byte alignment\n",
+                     kind, (uint64_t)ptr, data->type->name, alignment);
+    }
+    else
+    {
+        if (!report_begin(&data->loc, "object size mismatch"))
+            return;
+        crash_printf("%s address %016lx with insufficient space for an object of type %s\n",
+                     kind, (uint64_t)ptr, data->type->name);
+    }
+    report_end(REPORT_IP, REPORT_RBP, "type mismatch");
+}
+
+void __ubsan_handle_load_invalid_value(struct invalid_value_data *data, uintptr_t value)
+{
+    char v[24];
+
+    if (!report_begin(&data->loc, "invalid value"))
+        return;
+
+    format_value(v, sizeof(v), data->type, value);
+    crash_printf("load of value %s is not a valid value for type %s\n", v, data->type->name);
+    report_end(REPORT_IP, REPORT_RBP, "invalid value");
+}
+
+void __ubsan_handle_pointer_overflow(struct pointer_overflow_data *data, uintptr_t base,
+                                     uintptr_t result)
+{
+    if (!report_begin(&data->loc, "pointer overflow"))
+        return;
+
+    crash_printf("pointer arithmetic on %016lx overflowed to %016lx\n", (uint64_t)base,
+                 (uint64_t)result);
+    report_end(REPORT_IP, REPORT_RBP, "pointer overflow");
+}
+
+void __ubsan_handle_nonnull_arg(struct nonnull_arg_data *data)
+{
+    if (!report_begin(&data->loc, "null argument"))
+        return;
+
+    crash_printf("null pointer passed as argument %d, which is declared to never be null\n",
+                 data->arg_index);
+    report_end(REPORT_IP, REPORT_RBP, "null argument");
+}
+
+void __ubsan_handle_nonnull_return_v1(struct nonnull_return_data *data, struct source_location *loc)
+{
+    (void)data;
+
+    if (!report_begin(loc, "null return"))
+        return;
+
+    crash_printf("null pointer returned from a function declared to never return null\n");
+    report_end(REPORT_IP, REPORT_RBP, "null return");
+}
+
+void __ubsan_handle_vla_bound_not_positive(struct vla_bound_data *data, uintptr_t bound)
+{
+    char b[24];
+
+    if (!report_begin(&data->loc, "variable length array bound"))
+        return;
+
+    format_value(b, sizeof(b), data->type, bound);
+    crash_printf("variable length array bound evaluates to non-positive value %s\n", b);
+    report_end(REPORT_IP, REPORT_RBP, "vla bound");
+}
+
+void __ubsan_handle_invalid_builtin(struct invalid_builtin_data *data)
+{
+    if (!report_begin(&data->loc, "invalid builtin"))
+        return;
+
+    crash_printf("passing zero to %s, which is not a valid argument\n",
+                 data->kind ? "clz()" : "ctz()");
+    report_end(REPORT_IP, REPORT_RBP, "invalid builtin");
+}
+
+/* Execution cannot continue past these */
+
+void __ubsan_handle_builtin_unreachable(struct unreachable_data *data)
+{
+    panic("UBSAN: unreachable code reached at %s:%u", data->loc.file, data->loc.line);
+}
+
+void __ubsan_handle_missing_return(struct unreachable_data *data)
+{
+    panic("UBSAN: end of non-void function reached at %s:%u", data->loc.file, data->loc.line);
+}
@@ -3,9 +3,21 @@
 #include <valen/pmm.h>
 #include <valen/stdio.h>
 #include <valen/spinlock.h>
+#include <valen/param.h>
+#include <valen/kasan.h>
+#include <valen/kmemleak.h>
 
 #define HEAP_MAGIC 0x12345678
 
+#ifdef CONFIG_KASAN
+/* Poisoned gap after each object, on top of the next block's header */
+#define HEAP_REDZONE 32
+/* Freed blocks wait here before reuse, so stale pointers hit poison */
+#define HEAP_QUARANTINE 64
+#else
+#define HEAP_REDZONE 0
+#endif
+
 typedef struct heap_node
 {
     uint32_t magic;
@@ -15,7 +27,12 @@ typedef struct heap_node
 } __attribute__((packed)) heap_node_t;
 
 static heap_node_t *head = NULL;
-static spinlock_t heap_lock = SPINLOCK_INIT;
+static spinlock_t heap_lock = SPINLOCK_INIT_NAMED("heap_lock");
+
+/* Minimum growth step: larger steps mean fewer, bigger vmm_alloc() calls */
+static int heap_grow_pages = 1;
+
+param_int(heap_grow_pages, heap_grow_pages, 1, 4096, "Minimum pages added when the heap grows");
 
 void heap_init()
 {
@@ -28,6 +45,71 @@ void heap_init()
     head->size = 16384 - sizeof(heap_node_t);
     head->next = 0;
     head->free = 1;
+
+    kasan_poison(heap_area, sizeof(heap_area), KASAN_HEAP_FREE);
+    kasan_poison(head, sizeof(heap_node_t), KASAN_HEAP_REDZONE);
+
+    /* Objects in here are scanned one by one; freed blocks hold stale pointers */
+    kmemleak_exclude_area(heap_area, sizeof(heap_area));
+}
+
+/**
+ * @brief Finds a free block of at least size bytes (heap_lock held).
+ * First fit takes the first match; best fit the smallest, stopping early
+ * on an exact fit.
+ */
+static heap_node_t *heap_find(uint64_t size)
+{
+#ifdef CONFIG_HEAP_BEST_FIT
+    heap_node_t *best = NULL;
+
+    for (heap_node_t *curr = head; curr; curr = curr->next)
+    {
+        if (!curr->free || curr->size < size)
+            continue;
+        if (!best || curr->size < best->size)
+            best = curr;
+        if (curr->size == size)
+            break;
+    }
+    return best;
+#else
+    for (heap_node_t *curr = head; curr; curr = curr->next)
+    {
+        if (curr->free && curr->size >= size)
+            return curr;
+    }
+    return NULL;
+#endif
+}
+
+/**
+ * @brief Appends a free block big enough for size bytes (heap_lock held).
+ */
+static heap_node_t *heap_grow(uint64_t size)
+{
+    heap_node_t *tail = head;
+    while (tail->next)
+        tail = tail->next;
+
+    /* Grow by enough whole pages to satisfy this request */
+    uint64_t pages = (size + sizeof(heap_node_t) + 4095) / 4096;
+    if (pages < (uint64_t)heap_grow_pages)
+        pages = heap_grow_pages;
+    void *new_virt = vmm_alloc(pages, 0x03);
+    if (!new_virt)
+        return NULL;
+
+    heap_node_t *new_node = (heap_node_t *)new_virt;
+    new_node->magic = HEAP_MAGIC;
+    new_node->size = pages * 4096 - sizeof(heap_node_t);
+    new_node->next = 0;
+    new_node->free = 1;
+    tail->next = new_node;
+
+    kasan_poison(new_virt, pages * 4096, KASAN_HEAP_FREE);
+    kasan_poison(new_node, sizeof(heap_node_t), KASAN_HEAP_REDZONE);
+    return new_node;
 }
 
 void *malloc(uint64_t size)
@@ -42,58 +124,93 @@ void *malloc(uint64_t size)
         return 0;
     }
     
-    size = (size + 7) & ~7;
-    heap_node_t *curr = head;
+    uint64_t requested = size;
+    size = (size + HEAP_REDZONE + 7) & ~7;
 
-    while (curr)
+    heap_node_t *curr = heap_find(size);
+    if (!curr)
+        curr = heap_grow(size);
+    if (!curr)
     {
-        if (curr->free && curr->size >= size)
-        {
-            if (curr->size > size + sizeof(heap_node_t) + 32)
-            {
-                heap_node_t *new_node = (heap_node_t *)((uint8_t *)curr + sizeof(heap_node_t) + size);
-                new_node->magic = HEAP_MAGIC;
-                new_node->size = curr->size - size - sizeof(heap_node_t);
-                new_node->next = curr->next;
-                new_node->free = 1;
-
-                curr->size = size;
-                curr->next = new_node;
-            }
-            curr->free = 0;
-
-            spinlock_release(&heap_lock);
-            return (void *)((uint8_t *)curr + sizeof(heap_node_t));
-        }
+        spinlock_release(&heap_lock);
+        return 0;
+    }
+
+    if (curr->size > size + sizeof(heap_node_t) + 32)
+    {
+        heap_node_t *new_node = (heap_node_t *)((uint8_t *)curr + sizeof(heap_node_t) + size);
+        new_node->magic = HEAP_MAGIC;
+        new_node->size = curr->size - size - sizeof(heap_node_t);
+        new_node->next = curr->next;
+        new_node->free = 1;
+
+        curr->size = size;
+        curr->next = new_node;
+        kasan_poison(new_node, sizeof(heap_node_t), KASAN_HEAP_REDZONE);
+    }
+    curr->free = 0;
+
+    void *ptr = (uint8_t *)curr + sizeof(heap_node_t);
+    kasan_poison(ptr, curr->size, KASAN_HEAP_REDZONE);
+    kasan_unpoison(ptr, requested);
+
+    spinlock_release(&heap_lock);
+    kmemleak_alloc(ptr, requested);
+    return ptr;
+}
+
+/**
+ * @brief Marks a block free and merges it with free neighbours (heap_lock held).
+ */
+static void heap_release(heap_node_t *node)
+{
+    node->free = 1;
+    kasan_poison((uint8_t *)node + sizeof(heap_node_t), node->size, KASAN_HEAP_FREE);
 
-        if (!curr->next)
+    heap_node_t *temp = head;
+    while (temp)
+    {
+        /* Only merge blocks that are adjacent in memory; expansions from
+         * vmm_alloc() are not guaranteed to follow the previous block. */
+        if (temp->free && temp->next && temp->next->free &&
+            (uint8_t *)temp + sizeof(heap_node_t) + temp->size == (uint8_t *)temp->next)
         {
-            void *new_virt = vmm_alloc(4096, 0x03);
-            if (!new_virt)
-            {
-                spinlock_release(&heap_lock);
-                return 0;
-            }
-
-            heap_node_t *new_node = (heap_node_t *)new_virt;
-            new_node->magic = HEAP_MAGIC;
-            new_node->size = 4096 - sizeof(heap_node_t);
-            new_node->next = 0;
-            new_node->free = 1;
-            curr->next = new_node;
+            kasan_poison(temp->next, sizeof(heap_node_t), KASAN_HEAP_FREE);
+            temp->size += sizeof(heap_node_t) + temp->next->size;
+            temp->next = temp->next->next;
+            continue;
         }
-        curr = curr->next;
+                
+        temp = temp->next;
     }
+}
 
-    spinlock_release(&heap_lock);
-    return 0;
+#ifdef CONFIG_KASAN
+static heap_node_t *quarantine[HEAP_QUARANTINE];
+static int quarantine_next = 0;
+
+/**
+ * @brief Poisons a freed block and releases the oldest quarantined one
+ * (heap_lock held).
+ */
+static void heap_quarantine(heap_node_t *node)
+{
+    kasan_poison((uint8_t *)node + sizeof(heap_node_t), node->size, KASAN_HEAP_FREED);
+
+    heap_node_t *oldest = quarantine[quarantine_next];
+    quarantine[quarantine_next] = node;
+    quarantine_next = (quarantine_next + 1) % HEAP_QUARANTINE;
+    if (oldest)
+        heap_release(oldest);
 }
+#endif
 
 void free(void *ptr)
 {
     if (!ptr)
         return;
 
+    kmemleak_free(ptr);
     spinlock_acquire(&heap_lock);
     
     heap_node_t *node = (heap_node_t *)((uint8_t *)ptr - sizeof(heap_node_t));
@@ -101,23 +218,51 @@ void free(void *ptr)
     if (node->magic != HEAP_MAGIC)
     {
         spinlock_release(&heap_lock);
+        kasan_report_invalid_free(ptr, "invalid-free", (uint64_t)__builtin_return_address(0));
         return;
     }
 
-    node->free = 1;
+#ifdef CONFIG_KASAN
+    if (node->free || kasan_shadow_value(ptr) == KASAN_HEAP_FREED)
+    {
+        spinlock_release(&heap_lock);
+        kasan_report_invalid_free(ptr, "double-free", (uint64_t)__builtin_return_address(0));
+        return;
+    }
+    heap_quarantine(node);
+#else
+    heap_release(node);
+#endif
+    
+    spinlock_release(&heap_lock);
+}
 
-    heap_node_t *temp = head;
-    while (temp)
+/**
+ * @brief Snapshot of heap usage for diagnostics and fragmentation tracking.
+ */
+void heap_get_stats(heap_stats_t *stats)
+{
+    if (!stats)
+        return;
+
+    stats->total_bytes = 0;
+    stats->free_bytes = 0;
+    stats->largest_free = 0;
+    stats->nodes = 0;
+
+    spinlock_acquire(&heap_lock);
+
+    for (heap_node_t *node = head; node; node = node->next)
     {
-        if (temp->free && temp->next && temp->next->free)
+        stats->total_bytes += node->size;
+        stats->nodes++;
+        if (node->free)
         {
-            temp->size += sizeof(heap_node_t) + temp->next->size;
-            temp->next = temp->next->next;
-            continue;
+            stats->free_bytes += node->size;
+            if (node->size > stats->largest_free)
+                stats->largest_free = node->size;
         }
-                
-        temp = temp->next;
     }
-    
+
     spinlock_release(&heap_lock);
-}
\ No newline at end of file
+}
@@ -0,0 +1,408 @@
+/**
+ * @file kasan.c
+ * @brief Kernel address sanitizer runtime.
+ *
+ * With CONFIG_KASAN the compiler checks every load and store against the
+ * shadow (see kasan.h) by calling the __asan_load/__asan_store functions
+ * below, and poisons redzones around stack variables and globals itself.
+ * The heap and the PMM poison the memory they do not hand out. A bad
+ * access is reported on COM1 with the access, the task, a backtrace and
+ * the shadow around the address; the kernel then carries on, so one boot
+ * can turn up several bugs.
+ *
+ * This file is built without instrumentation (kasan-n in mm/Kbuild).
+ */
+
+#include <valen/kasan.h>
+#include <valen/stdio.h>
+#include <valen/panic.h>
+#include <valen/task.h>
+#include <valen/kallsyms.h>
+#include <valen/param.h>
+
+#define KERNEL_VIRT_OFFSET 0xFFFFFFFF80000000ULL
+#define PHYS_TO_VIRT(p) ((void *)((uint64_t)(p) + KERNEL_VIRT_OFFSET))
+
+#define SHADOW(addr) ((volatile int8_t *)(((uint64_t)(addr) >> 3) + KASAN_SHADOW_OFFSET))
+
+_Static_assert((KASAN_START >> 3) + KASAN_SHADOW_OFFSET == KASAN_START + KASAN_SHADOW_PHYS,
+               "KASAN_SHADOW_OFFSET does not match KASAN_SHADOW_PHYS");
+
+/* Redzone on each side of a variable-length array */
+#define ALLOCA_REDZONE 32
+
+/* Shadow rows printed around a bad address */
+#define SHADOW_ROWS 5
+#define SHADOW_ROW_BYTES 16
+
+/* Layout of the descriptors gcc emits for each instrumented global */
+struct kasan_global
+{
+    const void *beg;
+    uint64_t size;
+    uint64_t size_with_redzone;
+    const char *name;
+    const char *module_name;
+    uint64_t has_dynamic_init;
+    void *location;
+    uint64_t odr_indicator;
+};
+
+extern void (*__init_array_start[])(void);
+extern void (*__init_array_end[])(void);
+
+/* Off until the shadow is cleared: early stack poisoning writes garbage */
+static int kasan_enabled = 0;
+
+/* Checks are skipped while a report runs through instrumented code */
+static int in_report = 0;
+static uint64_t reports = 0;
+
+static bool kasan_multi_shot = false;
+static bool kasan_panic = false;
+param_bool(kasan_multi_shot, kasan_multi_shot, "Report every KASAN error, not only the first");
+param_bool(kasan_panic, kasan_panic, "Panic after a KASAN report");
+
+static int in_shadow(uint64_t addr)
+{
+    return addr >= KASAN_START;
+}
+
+void kasan_poison(const void *addr, uint64_t size, uint8_t value)
+{
+    uint64_t a = (uint64_t)addr;
+
+    if (!kasan_enabled || !in_shadow(a))
+        return;
+
+    volatile int8_t *s = SHADOW(a);
+    for (uint64_t i = 0; i < (size + KASAN_GRANULE - 1) / KASAN_GRANULE; i++)
+        s[i] = (int8_t)value;
+}
+
+void kasan_unpoison(const void *addr, uint64_t size)
+{
+    uint64_t a = (uint64_t)addr;
+
+    if (!kasan_enabled || !in_shadow(a))
+        return;
+
+    volatile int8_t *s = SHADOW(a);
+    for (uint64_t i = 0; i < size / KASAN_GRANULE; i++)
+        s[i] = 0;
+    if (size % KASAN_GRANULE)
+        s[size / KASAN_GRANULE] = (int8_t)(size % KASAN_GRANULE);
+}
+
+uint8_t kasan_shadow_value(const void *addr)
+{
+    uint64_t a = (uint64_t)addr;
+
+    if (!kasan_enabled || !in_shadow(a))
+        return 0;
+    return (uint8_t)*SHADOW(a);
+}
+
+uint64_t kasan_report_count(void)
+{
+    return reports;
+}
+
+void kasan_init(uint64_t max_phys)
+{
+    if (max_phys < KASAN_SHADOW_PHYS + KASAN_SHADOW_SIZE)
+    {
+        printf("kasan: needs %lluMB of RAM for the shadow, disabled\n",
+               (unsigned long long)((KASAN_SHADOW_PHYS + KASAN_SHADOW_SIZE) >> 20));
+        return;
+    }
+
+    volatile uint64_t *shadow = (volatile uint64_t *)PHYS_TO_VIRT(KASAN_SHADOW_PHYS);
+    for (uint64_t i = 0; i < KASAN_SHADOW_SIZE / 8; i++)
+        shadow[i] = 0;
+    kasan_enabled = 1;
+
+    /* gcc registers each file's globals from a constructor */
+    for (void (**ctor)(void) = __init_array_start; ctor < __init_array_end; ctor++)
+        (*ctor)();
+
+    printf("kasan: shadow at %llx (%lluMB)\n", (unsigned long long)KASAN_SHADOW_PHYS,
+           (unsigned long long)(KASAN_SHADOW_SIZE >> 20));
+}
+
+/**
+ * @brief First inaccessible byte in [addr, addr + size), or 0 if none.
+ */
+static uint64_t first_bad_byte(uint64_t addr, uint64_t size)
+{
+    uint64_t end = addr + size;
+
+    if (end < addr)
+        return addr;
+
+    for (uint64_t a = addr; a < end; a = (a | (KASAN_GRANULE - 1)) + 1)
+    {
+        int8_t s = *SHADOW(a);
+        if (s == 0)
+            continue;
+        if (s < 0)
+            return a;
+
+        /* Partial granule: only its first s bytes are accessible */
+        uint64_t valid_end = (a & ~(uint64_t)(KASAN_GRANULE - 1)) + s;
+        if (end > valid_end)
+            return a > valid_end ? a : valid_end;
+    }
+    return 0;
+}
+
+static const char *bug_type(uint64_t bad)
+{
+    int8_t s = *SHADOW(bad);
+
+    /* Past the valid part of a partial granule: the next one says why */
+    if (s > 0)
+        s = *SHADOW(bad + KASAN_GRANULE);
+
+    switch ((uint8_t)s)
+    {
+    case KASAN_PAGE_FREE:
+        return "page-use-after-free";
+    case KASAN_HEAP_FREED:
+        return "heap-use-after-free";
+    case KASAN_HEAP_FREE:
+    case KASAN_HEAP_REDZONE:
+        return "heap-out-of-bounds";
+    case KASAN_GLOBAL_REDZONE:
+        return "global-out-of-bounds";
+    case KASAN_STACK_LEFT:
+    case KASAN_STACK_MID:
+    case KASAN_STACK_RIGHT:
+        return "stack-out-of-bounds";
+    case KASAN_STACK_AFTER_RETURN:
+        return "stack-use-after-return";
+    case KASAN_STACK_AFTER_SCOPE:
+        return "stack-use-after-scope";
+    case KASAN_ALLOCA_LEFT:
+    case KASAN_ALLOCA_RIGHT:
+        return "alloca-out-of-bounds";
+    default:
+        return "wild-memory-access";
+    }
+}
+
+static void report_header(const char *type, uint64_t ip)
+{
+    uint64_t offset;
+    const char *name = kallsyms_lookup(ip - 1, &offset);
+
+    crash_printf("==================================================================\n");
+    if (name)
+        crash_printf("BUG: KASAN: %s in %s+0x%lx\n", type, name, offset + 1);
+    else
+        crash_printf("BUG: KASAN: %s at %016lx\n", type, ip);
+}
+
+static void report_task(void)
+{
+    task_t *task = current_task;
+
+    if (task)
+        crash_printf("Task: pid %d '%s'\n", task->pid, task->comm);
+    else
+        crash_printf("Task: none (boot context)\n");
+}
+
+static void report_shadow(uint64_t bad)
+{
+    uint64_t row = (bad & ~(uint64_t)(KASAN_GRANULE * SHADOW_ROW_BYTES - 1)) -
+                   (SHADOW_ROWS / 2) * KASAN_GRANULE * SHADOW_ROW_BYTES;
+    char line[16 + SHADOW_ROW_BYTES * 3 + 4];
+
+    crash_printf("Memory state around the buggy address:\n");
+    for (int r = 0; r < SHADOW_ROWS; r++, row += KASAN_GRANULE * SHADOW_ROW_BYTES)
+    {
+        int n = 0;
+        if (!in_shadow(row))
+            continue;
+        for (int i = 0; i < SHADOW_ROW_BYTES; i++)
+        {
+            uint64_t a = row + (uint64_t)i * KASAN_GRANULE;
+            int marked = (a >> 3) == (bad >> 3);
+            n += snprintf(line + n, sizeof(line) - n, "%c%02x", marked ? '>' : ' ',
+                          (uint8_t)*SHADOW(a));
+        }
+        crash_printf(" %016lx:%s\n", row, line);
+    }
+}
+
+/**
+ * @brief Prints one report unless reports are suppressed.
+ * @return 0 if the report was suppressed.
+ */
+static int report_begin(void)
+{
+    if (reports++ && !kasan_multi_shot)
+        return 0;
+    in_report = 1;
+    return 1;
+}
+
+static void report_end(const char *type)
+{
+    crash_printf("==================================================================\n");
+    if (reports == 1 && !kasan_multi_shot)
+        crash_printf("kasan: further reports suppressed, boot with kasan_multi_shot\n");
+    in_report = 0;
+
+    if (kasan_panic)
+        panic("KASAN: %s", type);
+}
+
+static void kasan_report(uint64_t addr, uint64_t size, int write, uint64_t ip, uint64_t rbp)
+{
+    uint64_t bad = first_bad_byte(addr, size);
+    const char *type = bug_type(bad);
+
+    if (!report_begin())
+        return;
+
+    report_header(type, ip);
+    crash_printf("%s of size %lu at addr %016lx\n", write ? "Write" : "Read", size, addr);
+    report_task();
+    dump_backtrace(ip, rbp, crash_printf);
+    report_shadow(bad);
+    report_end(type);
+}
+
+__attribute__((noinline)) void kasan_report_invalid_free(const void *ptr, const char *what, uint64_t ip)
+{
+    /* Called straight from free(): two saved rbps up is its caller's */
+    uint64_t rbp = *(uint64_t *)*(uint64_t *)__builtin_frame_address(0);
+
+    if (!kasan_enabled || in_report || !report_begin())
+        return;
+
+    report_header(what, ip);
+    crash_printf("free() of %016lx\n", (uint64_t)ptr);
+    report_task();
+    dump_backtrace(ip, rbp, crash_printf);
+    if (in_shadow((uint64_t)ptr))
+        report_shadow((uint64_t)ptr);
+    report_end(what);
+}
+
+static inline void check(uint64_t addr, uint64_t size, int write, uint64_t ip, uint64_t rbp)
+{
+    if (!kasan_enabled || in_report || !in_shadow(addr) || !size)
+        return;
+
+    /* Fast path: one granule, fully accessible */
+    if (((addr & 7) + size) <= KASAN_GRANULE && *SHADOW(addr) == 0)
+        return;
+
+    if (first_bad_byte(addr, size))
+        kasan_report(addr, size, write, ip, rbp);
+}
+
+/*
+ * The caller's return address and frame pointer start the backtrace at the
+ * instrumented function. Each entry point has its own frame, so the
+ * caller's rbp is the one saved at the bottom of it.
+ */
+#define CALLER_IP ((uint64_t)__builtin_return_address(0))
+#define CALLER_RBP (*(uint64_t *)__builtin_frame_address(0))
+
+#define DEFINE_ASAN_ACCESS(size)                                   \
+    void __asan_load##size##_noabort(uint64_t addr)                \
+    {                                                              \
+        check(addr, size, 0, CALLER_IP, CALLER_RBP);               \
+    }                                                              \
+    void __asan_store##size##_noabort(uint64_t addr)               \
+    {                                                              \
+        check(addr, size, 1, CALLER_IP, CALLER_RBP);               \
+    }
+
+DEFINE_ASAN_ACCESS(1)
+DEFINE_ASAN_ACCESS(2)
+DEFINE_ASAN_ACCESS(4)
+DEFINE_ASAN_ACCESS(8)
+DEFINE_ASAN_ACCESS(16)
+
+void __asan_loadN_noabort(uint64_t addr, uint64_t size)
+{
+    check(addr, size, 0, CALLER_IP, CALLER_RBP);
+}
+
+void __asan_storeN_noabort(uint64_t addr, uint64_t size)
+{
+    check(addr, size, 1, CALLER_IP, CALLER_RBP);
+}
+
+void __asan_register_globals(struct kasan_global *globals, uint64_t n)
+{
+    for (uint64_t i = 0; i < n; i++)
+    {
+        struct kasan_global *g = &globals[i];
+        uint64_t aligned = (g->size + KASAN_GRANULE - 1) & ~(uint64_t)(KASAN_GRANULE - 1);
+
+        kasan_unpoison(g->beg, g->size);
+        kasan_poison((const uint8_t *)g->beg + aligned, g->size_with_redzone - aligned,
+                     KASAN_GLOBAL_REDZONE);
+    }
+}
+
+void __asan_unregister_globals(struct kasan_global *globals, uint64_t n)
+{
+    (void)globals;
+    (void)n;
+}
+
+/**
+ * @brief Called before noreturn calls: the frames being abandoned would
+ * leave their redzones poisoned below the stack pointer.
+ */
+void __asan_handle_no_return(void)
+{
+    task_t *task = current_task;
+    uint64_t sp = (uint64_t)__builtin_frame_address(0);
+
+    if (!kasan_enabled || !task || !task->stack)
+        return;
+
+    uint64_t base = (uint64_t)task->stack;
+    if (sp > base && sp <= base + task->stack_size)
+        kasan_unpoison((void *)base, (sp - base) & ~(uint64_t)(KASAN_GRANULE - 1));
+}
+
+void __asan_alloca_poison(uint64_t addr, uint64_t size)
+{
+    uint64_t rounded = (size + KASAN_GRANULE - 1) & ~(uint64_t)(KASAN_GRANULE - 1);
+    uint64_t padded = (size + ALLOCA_REDZONE - 1) & ~(uint64_t)(ALLOCA_REDZONE - 1);
+
+    kasan_unpoison((void *)addr, size);
+    kasan_poison((void *)(addr - ALLOCA_REDZONE), ALLOCA_REDZONE, KASAN_ALLOCA_LEFT);
+    kasan_poison((void *)(addr + rounded), padded - rounded + ALLOCA_REDZONE, KASAN_ALLOCA_RIGHT);
+}
+
+void __asan_allocas_unpoison(uint64_t top, uint64_t bottom)
+{
+    if (top && top < bottom)
+        kasan_unpoison((void *)top, bottom - top);
+}
+
+/* Large stack frames are poisoned through these instead of inline stores */
+#define DEFINE_ASAN_SET_SHADOW(byte)                                     \
+    void __asan_set_shadow_##byte(uint64_t shadow, uint64_t size)        \
+    {                                                                    \
+        volatile uint8_t *s = (volatile uint8_t *)shadow;                \
+        for (uint64_t i = 0; i < size; i++)                              \
+            s[i] = 0x##byte;                                             \
+    }
+
+DEFINE_ASAN_SET_SHADOW(00)
+DEFINE_ASAN_SET_SHADOW(f1)
+DEFINE_ASAN_SET_SHADOW(f2)
+DEFINE_ASAN_SET_SHADOW(f3)
+DEFINE_ASAN_SET_SHADOW(f5)
+DEFINE_ASAN_SET_SHADOW(f8)
@@ -0,0 +1,578 @@
+/**
+ * @file kmemleak.c
+ * @brief Conservative memory leak detector.
+ *
+ * malloc() blocks and task stacks are recorded with their size, the
+ * allocating task and a short backtrace. A scan starts from the roots:
+ * .data, .bss and the live part of every task's stack. Any aligned word
+ * that points into a recorded object counts as a reference, and the
+ * objects reached this way are scanned in turn. Objects left unreached,
+ * and older than a few seconds, are suspected leaks.
+ *
+ * Like any conservative scan it can miss a leak whose address happens to
+ * sit in scanned memory. It reports an object whose only reference lives
+ * in memory it does not scan (pages from the PMM or vmm_alloc() that are
+ * not task stacks); kmemleak_not_leak() marks such objects.
+ *
+ * Metadata comes from a static pool, never from the heap it watches.
+ */
+
+#include <valen/kmemleak.h>
+#include <valen/heap.h>
+#include <valen/pmm.h>
+#include <valen/vmm.h>
+#include <valen/task.h>
+#include <valen/clock.h>
+#include <valen/panic.h>
+#include <valen/kallsyms.h>
+#include <valen/param.h>
+#include <valen/spinlock.h>
+#include <valen/string.h>
+#include <valen/stdio.h>
+#include <stdarg.h>
+
+#define NSEC_PER_SEC 1000000000ULL
+
+#define KMEMLEAK_OBJECTS 4096
+#define KMEMLEAK_HASH_BITS 10
+#define KMEMLEAK_TRACE 4
+#define KMEMLEAK_EXCLUDED 8
+
+/* A pointer to a new object may still be only in a register */
+#define KMEMLEAK_MIN_AGE_NS (5 * NSEC_PER_SEC)
+
+/* Leaks listed on the screen; COM1 gets all of them */
+#define KMEMLEAK_SHOWN 8
+
+#define OBJECT_NOT_LEAK 0x1 /* Scanned like a root, never reported */
+#define OBJECT_NO_SCAN 0x2  /* Contents hold no references */
+#define OBJECT_REACHED 0x4  /* Referenced, in the current scan */
+#define OBJECT_LEAK 0x8     /* Unreferenced in the last scan */
+#define OBJECT_REPORTED 0x10
+
+struct kmemleak_object
+{
+    uint64_t ptr;
+    uint64_t size;
+    uint64_t alloc_ns;
+    uint64_t trace[KMEMLEAK_TRACE];
+    char comm[16];
+    int pid;
+    uint16_t flags;
+    uint16_t trace_len;
+    int next; /* Hash chain or free list, as index + 1; 0 ends it */
+};
+
+static struct kmemleak_object objects[KMEMLEAK_OBJECTS];
+static int hash_heads[1 << KMEMLEAK_HASH_BITS];
+static int free_list;
+static int next_unused;
+static int nr_objects;
+static int disabled;
+static spinlock_t kmemleak_lock = SPINLOCK_INIT_NAMED("kmemleak_lock");
+
+static struct
+{
+    uint64_t start;
+    uint64_t end;
+} excluded[KMEMLEAK_EXCLUDED];
+static int nr_excluded;
+
+/* Scan state: objects sorted by address, and the ones still to scan */
+static int sorted[KMEMLEAK_OBJECTS];
+static int gray[KMEMLEAK_OBJECTS];
+static int nr_sorted;
+static int nr_gray;
+static uint64_t lowest;
+static uint64_t highest;
+
+static uint64_t scans;
+static uint64_t last_scan_ns;
+static int last_leaks;
+static int last_new;
+static uint64_t last_leak_bytes;
+
+static int kmemleak_scan_secs = 600;
+param_int(kmemleak_scan_secs, kmemleak_scan_secs, 0, 86400,
+          "Seconds between automatic leak scans (0: only on request)");
+
+extern char _data_start[];
+extern char _bss_end[];
+
+static uint32_t hash_ptr(uint64_t ptr)
+{
+    return (uint32_t)(((ptr >> 4) * 0x9E3779B97F4A7C15ULL) >> (64 - KMEMLEAK_HASH_BITS));
+}
+
+/**
+ * @brief Object registered at exactly ptr, or NULL (kmemleak_lock held).
+ * @param link Set to the link that points at it, for unlinking.
+ */
+static struct kmemleak_object *find_object(uint64_t ptr, int **link)
+{
+    int *l = &hash_heads[hash_ptr(ptr)];
+
+    while (*l)
+    {
+        struct kmemleak_object *o = &objects[*l - 1];
+        if (o->ptr == ptr)
+        {
+            if (link)
+                *link = l;
+            return o;
+        }
+        l = &o->next;
+    }
+    return NULL;
+}
+
+void kmemleak_alloc(const void *ptr, uint64_t size)
+{
+    uint64_t frames[KMEMLEAK_TRACE + 1];
+    int report_full = 0;
+
+    if (!ptr || disabled)
+        return;
+
+    /* frames[0] is inside the allocator; the trace starts at its caller */
+    int n = backtrace_collect((uint64_t)__builtin_return_address(0),
+                              *(uint64_t *)__builtin_frame_address(0), frames, KMEMLEAK_TRACE + 1);
+
+    spinlock_acquire(&kmemleak_lock);
+    int index;
+    if (free_list)
+    {
+        index = free_list - 1;
+        free_list = objects[index].next;
+    }
+    else if (next_unused < KMEMLEAK_OBJECTS)
+    {
+        index = next_unused++;
+    }
+    else
+    {
+        /* Untracked objects would be false positives from here on */
+        disabled = 1;
+        report_full = 1;
+        index = -1;
+    }
+
+    if (index >= 0)
+    {
+        struct kmemleak_object *o = &objects[index];
+        task_t *task = current_task;
+
+        memset(o, 0, sizeof(*o));
+        o->ptr = (uint64_t)ptr;
+        o->size = size;
+        o->alloc_ns = clock_ns();
+        o->trace_len = n > 1 ? n - 1 : 0;
+        memcpy(o->trace, frames + 1, o->trace_len * sizeof(uint64_t));
+        if (task)
+        {
+            o->pid = task->pid;
+            memcpy(o->comm, task->comm, sizeof(o->comm));
+        }
+        else
+        {
+            strcpy(o->comm, "boot");
+        }
+
+        uint32_t h = hash_ptr(o->ptr);
+        o->next = hash_heads[h];
+        hash_heads[h] = index + 1;
+        nr_objects++;
+    }
+    spinlock_release(&kmemleak_lock);
+
+    if (report_full)
+        printf("kmemleak: %d objects tracked, pool full: leak detection disabled\n",
+               KMEMLEAK_OBJECTS);
+}
+
+void kmemleak_free(const void *ptr)
+{
+    int *link;
+
+    if (!ptr || disabled)
+        return;
+
+    spinlock_acquire(&kmemleak_lock);
+    struct kmemleak_object *o = find_object((uint64_t)ptr, &link);
+    if (o)
+    {
+        int index = *link;
+        *link = o->next;
+        o->ptr = 0;
+        o->next = free_list;
+        free_list = index;
+        nr_objects--;
+    }
+    spinlock_release(&kmemleak_lock);
+}
+
+static void set_flag(const void *ptr, uint16_t flag)
+{
+    spinlock_acquire(&kmemleak_lock);
+    struct kmemleak_object *o = find_object((uint64_t)ptr, NULL);
+    if (o)
+        o->flags |= flag;
+    spinlock_release(&kmemleak_lock);
+}
+
+void kmemleak_not_leak(const void *ptr)
+{
+    set_flag(ptr, OBJECT_NOT_LEAK);
+}
+
+void kmemleak_no_scan(const void *ptr)
+{
+    set_flag(ptr, OBJECT_NO_SCAN);
+}
+
+void kmemleak_exclude_area(const void *start, uint64_t size)
+{
+    spinlock_acquire(&kmemleak_lock);
+    if (nr_excluded < KMEMLEAK_EXCLUDED)
+    {
+        excluded[nr_excluded].start = (uint64_t)start;
+        excluded[nr_excluded].end = (uint64_t)start + size;
+        nr_excluded++;
+    }
+    spinlock_release(&kmemleak_lock);
+}
+
+/* --- Scanning (kmemleak_lock held throughout) --- */
+
+/**
+ * @brief Sorts the live objects by address for lookup().
+ */
+static void sort_objects(void)
+{
+    nr_sorted = 0;
+    for (int i = 0; i < next_unused; i++)
+    {
+        if (objects[i].ptr)
+            sorted[nr_sorted++] = i;
+    }
+
+    /* Shell sort: no recursion, no extra memory */
+    for (int gap = nr_sorted / 2; gap > 0; gap /= 2)
+    {
+        for (int i = gap; i < nr_sorted; i++)
+        {
+            int v = sorted[i];
+            int j = i;
+            for (; j >= gap && objects[sorted[j - gap]].ptr > objects[v].ptr; j -= gap)
+                sorted[j] = sorted[j - gap];
+            sorted[j] = v;
+        }
+    }
+
+    lowest = nr_sorted ? objects[sorted[0]].ptr : 0;
+    highest = 0;
+    for (int i = 0; i < nr_sorted; i++)
+    {
+        struct kmemleak_object *o = &objects[sorted[i]];
+        if (o->ptr + o->size > highest)
+            highest = o->ptr + o->size;
+    }
+}
+
+/**
+ * @brief Object containing addr, or NULL. Pointers into the middle of an
+ * object count as references to it.
+ */
+static struct kmemleak_object *lookup(uint64_t addr)
+{
+    int lo = 0, hi = nr_sorted - 1, found = -1;
+
+    while (lo <= hi)
+    {
+        int mid = (lo + hi) / 2;
+        if (objects[sorted[mid]].ptr <= addr)
+        {
+            found = mid;
+            lo = mid + 1;
+        }
+        else
+        {
+            hi = mid - 1;
+        }
+    }
+    if (found < 0)
+        return NULL;
+
+    struct kmemleak_object *o = &objects[sorted[found]];
+    return addr < o->ptr + o->size ? o : NULL;
+}
+
+static void mark(struct kmemleak_object *o)
+{
+    if (o->flags & OBJECT_REACHED)
+        return;
+    o->flags |= OBJECT_REACHED;
+    if (!(o->flags & OBJECT_NO_SCAN))
+        gray[nr_gray++] = o - objects;
+}
+
+static void scan_block(uint64_t start, uint64_t end)
+{
+    for (uint64_t p = (start + 7) & ~7ULL; p + 8 <= end; p += 8)
+    {
+        uint64_t value = *(const uint64_t *)p;
+        if (value < lowest || value >= highest)
+            continue;
+
+        struct kmemleak_object *o = lookup(value);
+        if (o)
+            mark(o);
+    }
+}
+
+/**
+ * @brief Scans a root area minus the excluded areas inside it.
+ */
+static void scan_root(uint64_t start, uint64_t end)
+{
+    uint64_t self = (uint64_t)objects;
+
+    if (start >= end)
+        return;
+
+    /* The pool holds the address of every object */
+    if (start < self + sizeof(objects) && self < end)
+    {
+        scan_root(start, self);
+        scan_root(self + sizeof(objects), end);
+        return;
+    }
+    for (int i = 0; i < nr_excluded; i++)
+    {
+        if (start < excluded[i].end && excluded[i].start < end)
+        {
+            scan_root(start, excluded[i].start);
+            scan_root(excluded[i].end, end);
+            return;
+        }
+    }
+    scan_block(start, end);
+}
+
+/**
+ * @brief Scans the in-use part of every task's stack. Stacks of tasks
+ * that have exited are not roots.
+ */
+static void scan_stacks(void)
+{
+    for_each_task(t)
+    {
+        uint64_t base = (uint64_t)t->stack;
+        uint64_t top = base + t->stack_size;
+        uint64_t sp = t == current_task ? (uint64_t)__builtin_frame_address(0) : t->context.rsp;
+
+        if (t->stack && sp >= base && sp < top)
+            scan_block(sp, top);
+    }
+}
+
+int kmemleak_scan(void)
+{
+    uint64_t now = clock_ns();
+    int new_leaks = 0;
+
+    if (disabled)
+        return 0;
+
+    spinlock_acquire(&kmemleak_lock);
+    sort_objects();
+    nr_gray = 0;
+    for (int i = 0; i < nr_sorted; i++)
+        objects[sorted[i]].flags &= ~(OBJECT_REACHED | OBJECT_LEAK);
+
+    for (int i = 0; i < nr_sorted; i++)
+    {
+        struct kmemleak_object *o = &objects[sorted[i]];
+        if (o->flags & OBJECT_NOT_LEAK)
+            mark(o);
+    }
+    scan_root((uint64_t)_data_start, (uint64_t)_bss_end);
+    scan_stacks();
+
+    while (nr_gray)
+    {
+        struct kmemleak_object *o = &objects[gray[--nr_gray]];
+        scan_block(o->ptr, o->ptr + o->size);
+    }
+
+    last_leaks = 0;
+    last_leak_bytes = 0;
+    for (int i = 0; i < nr_sorted; i++)
+    {
+        struct kmemleak_object *o = &objects[sorted[i]];
+        if ((o->flags & OBJECT_REACHED) || now - o->alloc_ns < KMEMLEAK_MIN_AGE_NS)
+            continue;
+
+        o->flags |= OBJECT_LEAK;
+        last_leaks++;
+        last_leak_bytes += o->size;
+        if (!(o->flags & OBJECT_REPORTED))
+        {
+            o->flags |= OBJECT_REPORTED;
+            new_leaks++;
+        }
+    }
+
+    scans++;
+    last_scan_ns = now;
+    last_new = new_leaks;
+    spinlock_release(&kmemleak_lock);
+    return new_leaks;
+}
+
+/* --- Reporting --- */
+
+/**
+ * @brief Formats a line for COM1, and for the screen too when screen is set.
+ */
+static void emit(int screen, const char *format, ...)
+{
+    char line[128];
+    va_list args;
+
+    va_start(args, format);
+    vsnprintf(line, sizeof(line), format, args);
+    va_end(args);
+    if (screen)
+        puts(line);
+    serial_printf("%s", line);
+}
+
+static void show_object(struct kmemleak_object *o, int screen, uint64_t now)
+{
+    uint64_t age_ms = (now - o->alloc_ns) / 1000000;
+    char hex[3 * 16 + 1];
+    uint64_t len = o->size < 16 ? o->size : 16;
+
+    emit(screen, "unreferenced object 0x%lx (size %lu):\n", o->ptr, o->size);
+    emit(screen, "  comm \"%s\", pid %d, age %lu.%03lus\n", o->comm, o->pid, age_ms / 1000,
+         age_ms % 1000);
+
+    /* Task stacks are not scanned and their bytes say little */
+    if (!(o->flags & OBJECT_NO_SCAN))
+    {
+        for (uint64_t i = 0; i < len; i++)
+            snprintf(hex + i * 3, 4, " %02x", ((const uint8_t *)o->ptr)[i]);
+        emit(screen, "  hex dump (first %lu bytes):%s\n", len, hex);
+    }
+
+    emit(screen, "  backtrace:\n");
+    for (int i = 0; i < o->trace_len; i++)
+    {
+        uint64_t offset;
+        /* Return addresses: look up the call instruction's function */
+        const char *name = kallsyms_lookup(o->trace[i] - 1, &offset);
+        if (name)
+            emit(screen, "    [<%016lx>] %s+0x%lx\n", o->trace[i], name, offset + 1);
+        else
+            emit(screen, "    [<%016lx>] ?\n", o->trace[i]);
+    }
+}
+
+/**
+ * @brief One COM1 line per scan or look, so a serial log shows the trend
+ * of leaks and memory use over days of uptime.
+ */
+static void log_state(const heap_stats_t *heap)
+{
+    serial_printf("KMEMLEAK uptime_s=%lu scans=%lu objects=%d leaks=%d leak_bytes=%lu new=%d "
+                  "heap_used=%lu heap_blocks=%lu pmm_used_kb=%lu vmm_kb=%lu\n",
+                  clock_ns() / NSEC_PER_SEC, scans, nr_objects, last_leaks, last_leak_bytes,
+                  last_new, heap->total_bytes - heap->free_bytes, heap->nodes, pmm_get_used_kb(),
+                  vmm_get_used_kb());
+}
+
+void kmemleak_dump(void)
+{
+    uint64_t now = clock_ns();
+    int shown = 0;
+    heap_stats_t heap;
+
+    if (disabled)
+        puts("kmemleak: disabled, the object pool ran out\n");
+
+    spinlock_acquire(&kmemleak_lock);
+    for (int i = 0; i < next_unused; i++)
+    {
+        struct kmemleak_object *o = &objects[i];
+        if (!o->ptr || !(o->flags & OBJECT_LEAK))
+            continue;
+        show_object(o, shown < KMEMLEAK_SHOWN, now);
+        shown++;
+    }
+    int tracked = nr_objects;
+    spinlock_release(&kmemleak_lock);
+
+    if (shown > KMEMLEAK_SHOWN)
+        printf("... %d more on COM1\n", shown - KMEMLEAK_SHOWN);
+
+    heap_get_stats(&heap);
+    if (scans)
+        printf("\n%d suspected leaks (%llu bytes), %d new, in scan %llu %llus ago\n", last_leaks,
+               (unsigned long long)last_leak_bytes, last_new, (unsigned long long)scans,
+               (unsigned long long)((now - last_scan_ns) / NSEC_PER_SEC));
+    else
+        puts("\nNo scan yet; 'kmemleak scan' runs one.\n");
+    printf("%d objects tracked; heap %llu of %llu bytes used in %llu blocks; "
+           "%llu KB pages, %llu KB vmm\n",
+           tracked, (unsigned long long)(heap.total_bytes - heap.free_bytes),
+           (unsigned long long)heap.total_bytes, (unsigned long long)heap.nodes,
+           (unsigned long long)pmm_get_used_kb(), (unsigned long long)vmm_get_used_kb());
+    log_state(&heap);
+}
+
+void kmemleak_clear(void)
+{
+    spinlock_acquire(&kmemleak_lock);
+    for (int i = 0; i < next_unused; i++)
+    {
+        if (objects[i].ptr && (objects[i].flags & OBJECT_LEAK))
+        {
+            objects[i].flags &= ~OBJECT_LEAK;
+            objects[i].flags |= OBJECT_NOT_LEAK;
+        }
+    }
+    last_leaks = 0;
+    last_leak_bytes = 0;
+    last_new = 0;
+    spinlock_release(&kmemleak_lock);
+}
+
+static void kmemleak_task_main(void)
+{
+    uint64_t last = clock_ns();
+
+    while (1)
+    {
+        /* Wake every second so a new kmemleak_scan_secs applies promptly */
+        task_sleep_until(clock_ns() + NSEC_PER_SEC);
+        if (!kmemleak_scan_secs ||
+            clock_ns() - last < (uint64_t)kmemleak_scan_secs * NSEC_PER_SEC)
+            continue;
+
+        heap_stats_t heap;
+
+        last = clock_ns();
+        int found = kmemleak_scan();
+        if (found)
+            printf("kmemleak: %d new suspected memory leaks (see 'kmemleak')\n", found);
+        heap_get_stats(&heap);
+        log_state(&heap);
+    }
+}
+
+void kmemleak_init(void)
+{
+    if (!task_create(kmemleak_task_main, "kmemleak"))
+        printf("kmemleak: cannot start the scan task, scans run on request only\n");
+}
@@ -0,0 +1,228 @@
+/**
+ * @file numa.c
+ * @brief NUMA nodes from the ACPI SRAT and SLIT.
+ *
+ * Each proximity domain with memory becomes a node. Its ranges go to the
+ * PMM, which keeps per-node free counts and tries nodes in SLIT distance
+ * order when one runs out. Tasks get a home node when they are created;
+ * their stack and, under the default policy, every page they allocate
+ * afterwards (page tables, heap growth) come from it.
+ */
+
+#include <valen/numa.h>
+#include <valen/acpi.h>
+#include <valen/pmm.h>
+#include <valen/smp.h>
+#include <valen/task.h>
+#include <valen/stdio.h>
+
+static int node_count = 1;
+static uint32_t node_pxm[MAX_NUMNODES];
+static int cpu_to_node[NR_CPUS];
+static int cpu_count = 1;
+static unsigned int interleave_next;
+
+/**
+ * @brief Node of a proximity domain; adds a node when create is set.
+ * @return Node index, or NUMA_NO_NODE.
+ */
+static int pxm_to_node(uint32_t pxm, int create)
+{
+    for (int n = 0; n < node_count; n++)
+    {
+        if (node_pxm[n] == pxm)
+            return n;
+    }
+    if (!create || node_count == MAX_NUMNODES)
+        return NUMA_NO_NODE;
+
+    node_pxm[node_count] = pxm;
+    return node_count++;
+}
+
+/**
+ * @brief Proximity domain of a CPU from the SRAT, by APIC ID.
+ */
+static int apic_to_node(uint32_t apic_id)
+{
+    acpi_for_each_srat(cpu, ACPI_SRAT_CPU, struct acpi_srat_cpu)
+    {
+        if ((cpu->flags & ACPI_SRAT_ENABLED) && cpu->apic_id == apic_id)
+            return pxm_to_node(acpi_srat_cpu_domain(cpu), 0);
+    }
+    acpi_for_each_srat(cpu, ACPI_SRAT_X2APIC, struct acpi_srat_x2apic)
+    {
+        if ((cpu->flags & ACPI_SRAT_ENABLED) && cpu->x2apic_id == apic_id)
+            return pxm_to_node(cpu->domain, 0);
+    }
+    return NUMA_NO_NODE;
+}
+
+static uint32_t boot_apic_id(void)
+{
+    uint32_t eax = 1, ebx, ecx = 0, edx;
+    asm volatile("cpuid" : "+a"(eax), "=b"(ebx), "+c"(ecx), "=d"(edx));
+    return ebx >> 24;
+}
+
+/**
+ * @brief CPU numbers follow the MADT, with the boot CPU as CPU 0.
+ */
+static void map_cpus(void)
+{
+    uint32_t bsp = boot_apic_id();
+    int node = apic_to_node(bsp);
+    int cpu = 1;
+
+    cpu_to_node[0] = node == NUMA_NO_NODE ? 0 : node;
+
+    acpi_for_each_madt(lapic, ACPI_MADT_LAPIC, struct acpi_madt_lapic)
+    {
+        if (!(lapic->flags & (ACPI_MADT_ENABLED | ACPI_MADT_ONLINE_CAPABLE)) ||
+            lapic->apic_id == bsp || cpu == NR_CPUS)
+            continue;
+        node = apic_to_node(lapic->apic_id);
+        cpu_to_node[cpu++] = node == NUMA_NO_NODE ? 0 : node;
+    }
+    cpu_count = cpu;
+}
+
+/**
+ * @brief Gives the PMM each node's fallback list: all nodes, nearest first.
+ */
+static void build_fallback(void)
+{
+    for (int n = 0; n < node_count; n++)
+    {
+        int order[MAX_NUMNODES];
+
+        for (int i = 0; i < node_count; i++)
+            order[i] = i;
+
+        /* Insertion sort by distance; ties keep node order */
+        for (int i = 1; i < node_count; i++)
+        {
+            int m = order[i], j = i;
+            while (j > 0 && numa_distance(n, order[j - 1]) > numa_distance(n, m))
+            {
+                order[j] = order[j - 1];
+                j--;
+            }
+            order[j] = m;
+        }
+        pmm_set_node_fallback(n, order, node_count);
+    }
+}
+
+void numa_init(void)
+{
+    uint64_t ram_end = pmm_get_total_kb() * 1024;
+
+    node_count = 0;
+    acpi_for_each_srat(mem, ACPI_SRAT_MEMORY, struct acpi_srat_memory)
+    {
+        /* Hotplug windows past the end of RAM have nothing to allocate */
+        if (!(mem->flags & ACPI_SRAT_ENABLED) || mem->length == 0 || mem->base >= ram_end)
+            continue;
+
+        int node = pxm_to_node(mem->domain, 1);
+        if (node == NUMA_NO_NODE)
+        {
+            printf("numa: more than %d nodes, domain %u ignored\n", MAX_NUMNODES, mem->domain);
+            continue;
+        }
+        pmm_add_node_range(node, mem->base, mem->base + mem->length);
+    }
+
+    if (node_count == 0)
+    {
+        /* No SRAT: the PMM keeps its single node */
+        node_count = 1;
+        node_pxm[0] = 0;
+        return;
+    }
+
+    map_cpus();
+    build_fallback();
+
+    if (node_count > 1)
+        printf("numa: %d nodes, boot CPU on node %d\n", node_count, cpu_to_node[0]);
+}
+
+int numa_node_count(void)
+{
+    return node_count;
+}
+
+int numa_cpu_node(void)
+{
+    return cpu_to_node[smp_processor_id()];
+}
+
+int numa_mem_node(void)
+{
+    task_t *task = current_task;
+
+    if (!task)
+        return numa_cpu_node();
+    if (task->mempolicy == NUMA_POLICY_INTERLEAVE)
+        return numa_interleave_node();
+    return task->numa_node;
+}
+
+int numa_interleave_node(void)
+{
+    return __atomic_fetch_add(&interleave_next, 1, __ATOMIC_RELAXED) % node_count;
+}
+
+int numa_distance(int from, int to)
+{
+    if (from < 0 || to < 0 || from >= node_count || to >= node_count)
+        return ACPI_REMOTE_DISTANCE;
+    return acpi_slit_distance(node_pxm[from], node_pxm[to]);
+}
+
+void numa_set_policy(int policy)
+{
+    if (current_task)
+        current_task->mempolicy = policy;
+}
+
+void numa_dump(void)
+{
+    puts("\n--- NUMA Nodes ---\n");
+    for (int n = 0; n < node_count; n++)
+    {
+        uint64_t total_kb, free_kb;
+        pmm_node_usage(n, &total_kb, &free_kb);
+        printf_fmt("  node %d (domain %u): %6llu MB, %6llu MB free, cpus", n, node_pxm[n],
+                   (unsigned long long)(total_kb / 1024), (unsigned long long)(free_kb / 1024));
+        for (int cpu = 0; cpu < cpu_count; cpu++)
+        {
+            if (cpu_to_node[cpu] == n)
+                printf_fmt(" %d", cpu);
+        }
+        puts("\n");
+    }
+
+    if (node_count > 1)
+    {
+        puts("\nDistances:\n      ");
+        for (int to = 0; to < node_count; to++)
+            printf_fmt(" %4d", to);
+        puts("\n");
+        for (int from = 0; from < node_count; from++)
+        {
+            printf_fmt("  %3d ", from);
+            for (int to = 0; to < node_count; to++)
+                printf_fmt(" %4d", numa_distance(from, to));
+            puts("\n");
+        }
+    }
+
+    puts("\nTasks:\n");
+    for_each_task(t)
+        printf_fmt("  %-5d %-16s node %d %-10s remote runs %llu\n", t->pid, t->comm, t->numa_node,
+                   t->mempolicy == NUMA_POLICY_INTERLEAVE ? "interleave" : "local",
+                   (unsigned long long)t->numa_remote_runs);
+}
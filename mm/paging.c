@@ -37,7 +37,7 @@ extern uint64_t p4_table[];
  */
 uint64_t *kernel_pml4 = (uint64_t *)p4_table;
 
-static spinlock_t paging_lock = SPINLOCK_INIT;
+static spinlock_t paging_lock = SPINLOCK_INIT_NAMED("paging_lock");
 
 /**
  * @brief Initializes paging by ensuring the PML4 is loaded into CR3.
@@ -132,4 +132,39 @@ void paging_map_range(uint64_t virt, uint64_t phys, uint64_t size, uint64_t flag
     {
         paging_map(virt + offset, phys + offset, flags);
     }
-}
\ No newline at end of file
+}
+
+/**
+ * @brief Removes the 4KB mapping of a virtual page. Page tables are kept.
+ *
+ * @return The physical address it was mapped to, or 0 if it was not.
+ */
+uint64_t paging_unmap(uint64_t virt)
+{
+    uint64_t phys = 0;
+
+    spinlock_acquire(&paging_lock);
+
+    uint64_t pml4e = kernel_pml4[(virt >> 39) & 0x1FF];
+    if (pml4e & PAGE_PRESENT)
+    {
+        uint64_t pdpte = ((uint64_t *)PHYS_TO_VIRT(ENTRY_TO_PHYS(pml4e)))[(virt >> 30) & 0x1FF];
+        if ((pdpte & (PAGE_PRESENT | PAGE_HUGE)) == PAGE_PRESENT)
+        {
+            uint64_t pde = ((uint64_t *)PHYS_TO_VIRT(ENTRY_TO_PHYS(pdpte)))[(virt >> 21) & 0x1FF];
+            if ((pde & (PAGE_PRESENT | PAGE_HUGE)) == PAGE_PRESENT)
+            {
+                uint64_t *pt = (uint64_t *)PHYS_TO_VIRT(ENTRY_TO_PHYS(pde));
+                uint64_t pt_idx = (virt >> 12) & 0x1FF;
+                if (pt[pt_idx] & PAGE_PRESENT)
+                    phys = ENTRY_TO_PHYS(pt[pt_idx]);
+                pt[pt_idx] = 0;
+            }
+        }
+    }
+
+    spinlock_release(&paging_lock);
+    /* Invalidate TLB */
+    asm volatile("invlpg (%0)" ::"r"(virt) : "memory");
+    return phys;
+}
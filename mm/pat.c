@@ -0,0 +1,191 @@
+/**
+ * @file pat.c
+ * @brief Page Attribute Table and memory type tracking.
+ *
+ * The PAT MSR maps the PWT/PCD/PAT bits of a PTE to one of eight memory
+ * types. After pat_init() every type a driver asks for (WB, WC, UC-, UC,
+ * WT) has an entry, so vmm_map_phys_cache() can give a framebuffer WC
+ * and a register block UC.
+ *
+ * Two mappings of one frame with different types give undefined results,
+ * so every typed mapping reserves its physical range here first. The
+ * first 1GB is direct-mapped write-back by boot.s; RAM there can only be
+ * mapped WB again. The legacy VGA/BIOS hole is exempt: the fixed MTRRs
+ * already make the direct map of it uncached.
+ */
+
+#include <valen/pat.h>
+#include <valen/vmm.h>
+#include <valen/pmm.h>
+#include <valen/msr.h>
+#include <valen/cpufeature.h>
+#include <valen/spinlock.h>
+#include <valen/stdio.h>
+
+#define DIRECT_MAP_SIZE 0x40000000ULL
+
+/* Legacy VGA memory and option/system ROMs, below 1MB */
+#define ISA_START 0xA0000ULL
+#define ISA_END 0x100000ULL
+
+#define MEMTYPE_MAX 64
+
+/* Architectural encodings of the types in the PAT MSR */
+#define PAT_UC 0x00
+#define PAT_WC 0x01
+#define PAT_WT 0x04
+#define PAT_WP 0x05
+#define PAT_WB 0x06
+#define PAT_UC_MINUS 0x07
+
+#define PAT_ENTRY(index, type) ((uint64_t)(type) << ((index) * 8))
+
+/* The layout in pat.h; 4 and 6 repeat 0 and 2 */
+#define PAT_VALUE                                                                          \
+    (PAT_ENTRY(0, PAT_WB) | PAT_ENTRY(1, PAT_WC) | PAT_ENTRY(2, PAT_UC_MINUS) |            \
+     PAT_ENTRY(3, PAT_UC) | PAT_ENTRY(4, PAT_WB) | PAT_ENTRY(5, PAT_WP) |                  \
+     PAT_ENTRY(6, PAT_UC_MINUS) | PAT_ENTRY(7, PAT_WT))
+
+struct memtype
+{
+    uint64_t start;
+    uint64_t end;
+    enum page_cache type;
+};
+
+static struct memtype memtypes[MEMTYPE_MAX];
+static int memtype_count;
+static int pat_enabled;
+static spinlock_t memtype_lock = SPINLOCK_INIT_NAMED("memtype_lock");
+
+static const char *const cache_names[] = {"WB", "WC", "UC-", "UC", "WT", "WP"};
+
+/* Type of each PAT index: as programmed, and the power-on default */
+static const enum page_cache pat_types[8] = {
+    PAGE_CACHE_WB, PAGE_CACHE_WC, PAGE_CACHE_UC_MINUS, PAGE_CACHE_UC,
+    PAGE_CACHE_WB, PAGE_CACHE_WP, PAGE_CACHE_UC_MINUS, PAGE_CACHE_WT,
+};
+static const enum page_cache reset_types[8] = {
+    PAGE_CACHE_WB, PAGE_CACHE_WT, PAGE_CACHE_UC_MINUS, PAGE_CACHE_UC,
+    PAGE_CACHE_WB, PAGE_CACHE_WT, PAGE_CACHE_UC_MINUS, PAGE_CACHE_UC,
+};
+
+void pat_init(void)
+{
+    if (!boot_cpu_has(X86_FEATURE_PAT))
+    {
+        printf("pat: not supported, WC mappings fall back to UC-\n");
+        return;
+    }
+
+    /* Nothing maps with PWT alone yet, so no live mapping changes type.
+     * Flush anyway: the SDM asks for it around PAT writes. */
+    asm volatile("wbinvd" ::: "memory");
+    wrmsr(MSR_IA32_PAT, PAT_VALUE);
+    asm volatile("wbinvd" ::: "memory");
+
+    uint64_t cr3;
+    asm volatile("mov %%cr3, %0; mov %0, %%cr3" : "=r"(cr3) : : "memory");
+    pat_enabled = 1;
+}
+
+uint64_t pat_cache_flags(enum page_cache type)
+{
+    switch (type)
+    {
+    case PAGE_CACHE_WC:
+        return pat_enabled ? PAGE_PWT : PAGE_PCD;
+    case PAGE_CACHE_UC_MINUS:
+        return PAGE_PCD;
+    case PAGE_CACHE_UC:
+        return PAGE_PCD | PAGE_PWT;
+    case PAGE_CACHE_WT:
+        /* Index 1 is WT until the PAT is programmed */
+        return pat_enabled ? PAGE_PAT | PAGE_PCD | PAGE_PWT : PAGE_PWT;
+    case PAGE_CACHE_WP:
+        return pat_enabled ? PAGE_PAT | PAGE_PWT : PAGE_PCD | PAGE_PWT;
+    default:
+        return 0;
+    }
+}
+
+enum page_cache pat_flags_cache(uint64_t flags)
+{
+    int index = ((flags & PAGE_PAT) ? 4 : 0) | ((flags & PAGE_PCD) ? 2 : 0) |
+                ((flags & PAGE_PWT) ? 1 : 0);
+    return pat_enabled ? pat_types[index] : reset_types[index];
+}
+
+const char *pat_cache_name(enum page_cache type)
+{
+    return (unsigned)type < sizeof(cache_names) / sizeof(cache_names[0]) ? cache_names[type] : "?";
+}
+
+int memtype_reserve(uint64_t start, uint64_t end, enum page_cache type)
+{
+    uint64_t ram_end = pmm_get_total_kb() * 1024;
+    uint64_t direct_end = ram_end < DIRECT_MAP_SIZE ? ram_end : DIRECT_MAP_SIZE;
+
+    if (type != PAGE_CACHE_WB && start < direct_end && !(start >= ISA_START && end <= ISA_END))
+    {
+        printf("pat: %s mapping of %llx-%llx aliases the WB direct map\n", pat_cache_name(type),
+               (unsigned long long)start, (unsigned long long)end);
+        return -1;
+    }
+
+    spinlock_acquire(&memtype_lock);
+    for (int i = 0; i < memtype_count; i++)
+    {
+        struct memtype *m = &memtypes[i];
+        if (start < m->end && m->start < end && m->type != type)
+        {
+            spinlock_release(&memtype_lock);
+            printf("pat: %s mapping of %llx-%llx conflicts with %s mapping of %llx-%llx\n",
+                   pat_cache_name(type), (unsigned long long)start, (unsigned long long)end,
+                   pat_cache_name(m->type), (unsigned long long)m->start,
+                   (unsigned long long)m->end);
+            return -1;
+        }
+    }
+
+    /* Grow a range of the same type that this one overlaps or touches:
+     * ACPI tables, mapped one by one, end up as a single entry */
+    for (int i = 0; i < memtype_count; i++)
+    {
+        struct memtype *m = &memtypes[i];
+        if (m->type == type && start <= m->end && m->start <= end)
+        {
+            if (start < m->start)
+                m->start = start;
+            if (end > m->end)
+                m->end = end;
+            spinlock_release(&memtype_lock);
+            return 0;
+        }
+    }
+
+    if (memtype_count == MEMTYPE_MAX)
+    {
+        spinlock_release(&memtype_lock);
+        printf("pat: memtype table full\n");
+        return -1;
+    }
+    memtypes[memtype_count++] = (struct memtype){start, end, type};
+    spinlock_release(&memtype_lock);
+    return 0;
+}
+
+void pat_dump(void)
+{
+    printf("\nPAT %s:", pat_enabled ? "programmed" : "at power-on defaults");
+    for (int i = 0; i < 8; i++)
+        printf(" %d=%s", i, pat_cache_name(pat_enabled ? pat_types[i] : reset_types[i]));
+
+    puts("\n\nMapped ranges:\n");
+    spinlock_acquire(&memtype_lock);
+    for (int i = 0; i < memtype_count; i++)
+        printf("  %llx-%llx %s\n", (unsigned long long)memtypes[i].start,
+               (unsigned long long)memtypes[i].end, pat_cache_name(memtypes[i].type));
+    spinlock_release(&memtype_lock);
+    printf("  0-%llx WB (direct map)\n", (unsigned long long)DIRECT_MAP_SIZE);
+}
@@ -2,17 +2,71 @@
 #include <valen/pmm.h>
 #include <valen/paging.h>
 #include <valen/spinlock.h>
+#include <valen/kasan.h>
+#include <valen/numa.h>
+#include <valen/bitmap.h>
 
 /* The offset used to access physical memory in the higher half */
 #define KERNEL_VIRT_OFFSET 0xFFFFFFFF80000000
 #define PHYS_TO_VIRT(p) ((void *)((uint64_t)(p) + KERNEL_VIRT_OFFSET))
 #define VIRT_TO_PHYS(v) ((uint64_t)(v) - KERNEL_VIRT_OFFSET)
 
-static uint8_t *bitmap;
-static uint64_t bitmap_size;
+/* Only this much is direct-mapped (boot.s); KASAN has no shadow beyond it */
+#define DIRECT_MAP_SIZE 0x40000000ULL
+
+/* One bit per frame, set while the frame is in use */
+static uint64_t *bitmap;
 static uint64_t total_pages;
 static uint64_t used_pages;
-static spinlock_t pmm_lock = SPINLOCK_INIT;
+static spinlock_t pmm_lock = SPINLOCK_INIT_NAMED("pmm_lock");
+
+/* Never hand out the bottom 2MB (Kernel/BIOS/Page Tables) */
+#define LOW_RESERVED_PAGES (0x200000 / 4096)
+
+#define PMM_MAX_RANGES 32
+
+/* PHYSICAL page frames [start, end) that belong to one NUMA node */
+struct pmm_range
+{
+    uint64_t start;
+    uint64_t end;
+    int node;
+};
+
+struct pmm_node
+{
+    uint64_t present_pages; /* Frames in the node's ranges */
+    uint64_t free_pages;
+    int nr_fallback;
+    int fallback[MAX_NUMNODES]; /* Nodes to try, nearest first */
+};
+
+static struct pmm_range ranges[PMM_MAX_RANGES];
+static int range_count;
+static struct pmm_node nodes[MAX_NUMNODES];
+
+/* Set once numa_init() has replaced the single boot-time node */
+static int nodes_from_firmware;
+
+/**
+ * @brief Node of a page frame, or -1 for frames outside every range.
+ */
+static int pfn_node(uint64_t pfn)
+{
+    for (int i = 0; i < range_count; i++)
+    {
+        if (pfn >= ranges[i].start && pfn < ranges[i].end)
+            return ranges[i].node;
+    }
+    return -1;
+}
+
+static void node_account(uint64_t pfn, int64_t delta)
+{
+    int node = pfn_node(pfn);
+    if (node >= 0)
+        nodes[node].free_pages += delta;
+}
 
 /**
  * @brief Initializes the PMM bitmap.
@@ -22,18 +76,22 @@ static spinlock_t pmm_lock = SPINLOCK_INIT;
 void pmm_init(uintptr_t start, uint64_t size)
 {
     /* The bitmap pointer is a virtual address in the higher half */
-    bitmap = (uint8_t *)start;
+    bitmap = (uint64_t *)start;
     total_pages = size / 4096;
-    bitmap_size = (total_pages + 7) / 8;
 
     /* Initially mark everything as USED until kmain calls pmm_mark_free */
     used_pages = total_pages;
+    bitmap_fill(bitmap, total_pages);
 
-    /* Fill bitmap with 0xFF (all used) */
-    for (uint64_t i = 0; i < bitmap_size; i++)
-    {
-        bitmap[i] = 0xFF;
-    }
+    /* One node covers all of RAM until numa_init() knows better */
+    for (int n = 0; n < MAX_NUMNODES; n++)
+        nodes[n] = (struct pmm_node){0};
+    ranges[0] = (struct pmm_range){0, total_pages, 0};
+    range_count = 1;
+    nodes[0].present_pages = total_pages;
+    nodes[0].nr_fallback = 1;
+    nodes[0].fallback[0] = 0;
+    nodes_from_firmware = 0;
 }
 
 /**
@@ -46,11 +104,12 @@ void pmm_mark_free(uintptr_t addr)
     uint64_t block = addr / 4096;
     if (block < total_pages)
     {
-        if (bitmap[block / 8] & (1 << (block % 8)))
+        if (test_bit(block, bitmap))
         {
-            bitmap[block / 8] &= ~(1 << (block % 8));
+            __clear_bit(block, bitmap);
             if (used_pages > 0)
                 used_pages--;
+            node_account(block, 1);
         }
     }
     
@@ -67,10 +126,11 @@ void pmm_mark_used(uintptr_t addr)
     uint64_t block = addr / 4096;
     if (block < total_pages)
     {
-        if (!(bitmap[block / 8] & (1 << (block % 8))))
+        if (!test_bit(block, bitmap))
         {
-            bitmap[block / 8] |= (1 << (block % 8));
+            __set_bit(block, bitmap);
             used_pages++;
+            node_account(block, -1);
         }
     }
     
@@ -78,91 +138,214 @@ void pmm_mark_used(uintptr_t addr)
 }
 
 /**
- * @brief Finds a free physical frame and returns its PHYSICAL address.
+ * @brief Finds and takes count free contiguous frames in [first, end)
+ * (pmm_lock held).
+ * @return The first frame of the run, or 0.
  */
-void *pmm_alloc_page()
+static uint64_t alloc_run(uint64_t count, uint64_t first, uint64_t end)
 {
-    spinlock_acquire(&pmm_lock);
-    
-    for (uint64_t i = 0; i < bitmap_size; i++)
+    if (first < LOW_RESERVED_PAGES)
+        first = LOW_RESERVED_PAGES;
+    if (end > total_pages)
+        end = total_pages;
+
+    uint64_t pfn = bitmap_find_next_zero_area(bitmap, end, first, count, 0);
+    if (pfn >= end)
+        return 0;
+
+    bitmap_set(bitmap, pfn, count);
+    for (uint64_t k = pfn; k < pfn + count; k++)
+        node_account(k, -1);
+    used_pages += count;
+    return pfn;
+}
+
+/**
+ * @brief Takes count contiguous frames below limit, trying node first and
+ * then its fallback list (pmm_lock held).
+ */
+static uint64_t node_alloc(uint64_t count, int node, uint64_t limit)
+{
+    if (node < 0 || node >= MAX_NUMNODES || nodes[node].nr_fallback == 0)
+        node = 0;
+
+    for (int f = 0; f < nodes[node].nr_fallback; f++)
     {
-        if (bitmap[i] != 0xFF)
+        int n = nodes[node].fallback[f];
+        if (nodes[n].free_pages < count)
+            continue;
+
+        for (int i = 0; i < range_count; i++)
         {
-            for (int j = 0; j < 8; j++)
-            {
-                if (!(bitmap[i] & (1 << j)))
-                {
-                    uintptr_t addr = (i * 8 + j) * 4096;
-
-                    /* Safety: Never allocate bottom 2MB (Kernel/BIOS/Page Tables) */
-                    /* Note: These are physical address checks */
-                    if (addr < 0x200000)
-                        continue;
-
-                    bitmap[i] |= (1 << j);
-                    used_pages++;
-
-                    spinlock_release(&pmm_lock);
-                    /* Return virtual address that can be used by kernel */
-                    return PHYS_TO_VIRT(addr);
-                }
-            }
+            if (ranges[i].node != n || ranges[i].start >= limit)
+                continue;
+
+            uint64_t end = ranges[i].end < limit ? ranges[i].end : limit;
+            uint64_t pfn = alloc_run(count, ranges[i].start, end);
+            if (pfn)
+                return pfn;
         }
     }
-    
-    spinlock_release(&pmm_lock);
+
+    /* Holes the SRAT left out still hold usable RAM */
+    if (nodes_from_firmware)
+        return alloc_run(count, 0, limit);
     return 0;
 }
 
+void *pmm_alloc_pages_node(uint64_t count, int node)
+{
+    if (count == 0)
+        return 0;
+
+    /* Callers get a direct-map pointer, so stay inside the direct map */
+    spinlock_acquire(&pmm_lock);
+    uint64_t pfn = node_alloc(count, node, DIRECT_MAP_SIZE / 4096);
+    spinlock_release(&pmm_lock);
+
+    if (!pfn)
+        return 0;
+
+    kasan_unpoison(PHYS_TO_VIRT(pfn * 4096), count * 4096);
+    /* Return virtual address that can be used by kernel */
+    return PHYS_TO_VIRT(pfn * 4096);
+}
+
+uint64_t pmm_alloc_frame_node(int node)
+{
+    spinlock_acquire(&pmm_lock);
+    uint64_t pfn = node_alloc(1, node, total_pages);
+    spinlock_release(&pmm_lock);
+
+    if (pfn && pfn < DIRECT_MAP_SIZE / 4096)
+        kasan_unpoison(PHYS_TO_VIRT(pfn * 4096), 4096);
+    return pfn * 4096;
+}
+
+/**
+ * @brief Finds a free physical frame on the current node.
+ */
+void *pmm_alloc_page()
+{
+    return pmm_alloc_pages_node(1, numa_mem_node());
+}
+
 /**
- * @brief Allocates multiple contiguous physical pages
+ * @brief Allocates multiple contiguous physical pages on the current node.
  */
 void *pmm_alloc_pages(uint64_t count)
 {
+    return pmm_alloc_pages_node(count, numa_mem_node());
+}
+
+int pmm_add_node_range(int node, uint64_t start, uint64_t end)
+{
+    uint64_t first = (start + 4095) / 4096;
+    uint64_t last = end / 4096;
+
+    if (node < 0 || node >= MAX_NUMNODES)
+        return -1;
+
     spinlock_acquire(&pmm_lock);
-    
-    // Find enough contiguous free pages
-    for (uint64_t i = 0; i < bitmap_size; i++) {
-        if (bitmap[i] != 0xFF) {
-            // Check if we have enough contiguous pages starting here
-            uint64_t found = 0;
-            for (int j = 0; j < 8 && found < count; j++) {
-                if (!(bitmap[i] & (1 << j))) {
-                    found++;
-                } else {
-                    break;
-                }
-            }
-            
-            if (found >= count) {
-                // Found enough contiguous pages
-                uintptr_t start_addr = (i * 8 + (8 - found)) * 4096;
-                
-                // Mark all pages as used
-                for (uint64_t k = 0; k < count; k++) {
-                    uint64_t page_idx = (start_addr / 4096) + k;
-                    uint64_t byte_idx = page_idx / 8;
-                    uint64_t bit_idx = page_idx % 8;
-                    bitmap[byte_idx] |= (1 << bit_idx);
-                    used_pages++;
-                }
-                
-                spinlock_release(&pmm_lock);
-                return PHYS_TO_VIRT(start_addr);
-            }
-        }
+
+    if (last > total_pages)
+        last = total_pages;
+    if (first >= last || (nodes_from_firmware && range_count == PMM_MAX_RANGES))
+    {
+        spinlock_release(&pmm_lock);
+        return -1;
     }
-    
+
+    if (!nodes_from_firmware)
+    {
+        for (int n = 0; n < MAX_NUMNODES; n++)
+            nodes[n] = (struct pmm_node){0};
+        range_count = 0;
+        nodes_from_firmware = 1;
+    }
+
+    ranges[range_count++] = (struct pmm_range){first, last, node};
+
+    struct pmm_node *pn = &nodes[node];
+    pn->present_pages += last - first;
+    pn->free_pages += (last - first) - bitmap_weight_range(bitmap, first, last);
+    if (pn->nr_fallback == 0)
+    {
+        pn->fallback[0] = node;
+        pn->nr_fallback = 1;
+    }
+
     spinlock_release(&pmm_lock);
     return 0;
 }
 
+void pmm_set_node_fallback(int node, const int *order, int count)
+{
+    if (node < 0 || node >= MAX_NUMNODES)
+        return;
+
+    spinlock_acquire(&pmm_lock);
+    int n = 0;
+    for (int i = 0; i < count && n < MAX_NUMNODES; i++)
+    {
+        if (order[i] >= 0 && order[i] < MAX_NUMNODES)
+            nodes[node].fallback[n++] = order[i];
+    }
+    if (n)
+        nodes[node].nr_fallback = n;
+    spinlock_release(&pmm_lock);
+}
+
+int pmm_page_node(uint64_t phys)
+{
+    return pfn_node(phys / 4096);
+}
+
+void pmm_node_usage(int node, uint64_t *total_kb, uint64_t *free_kb)
+{
+    if (node < 0 || node >= MAX_NUMNODES)
+    {
+        *total_kb = *free_kb = 0;
+        return;
+    }
+    *total_kb = nodes[node].present_pages * 4ULL;
+    *free_kb = nodes[node].free_pages * 4ULL;
+}
+
 /**
- * @brief Frees a page given its PHYSICAL address.
+ * @brief Frees a page given the address returned by pmm_alloc_page().
+ * Higher-half pointers are translated back to PHYSICAL addresses first;
+ * plain physical addresses are accepted as well.
  */
 void pmm_free_page(void *addr)
 {
-    pmm_mark_free((uintptr_t)addr);
+    uintptr_t a = (uintptr_t)addr;
+    if (a >= KERNEL_VIRT_OFFSET)
+        a = VIRT_TO_PHYS(a);
+    pmm_mark_free(a);
+    if (a < DIRECT_MAP_SIZE)
+        kasan_poison(PHYS_TO_VIRT(a & ~0xFFFULL), 4096, KASAN_PAGE_FREE);
+}
+
+/**
+ * @brief Counts used pages per 2MB chunk of PHYSICAL memory.
+ * Takes no lock so it can run on the crash path.
+ * @return Number of chunks filled in.
+ */
+uint64_t pmm_usage_map(uint16_t *used, uint64_t chunks)
+{
+    uint64_t pages_per_chunk = 0x200000 / 4096;
+    uint64_t n = (total_pages + pages_per_chunk - 1) / pages_per_chunk;
+    if (n > chunks)
+        n = chunks;
+
+    for (uint64_t c = 0; c < n; c++)
+    {
+        uint64_t end = (c + 1) * pages_per_chunk;
+        used[c] = bitmap_weight_range(bitmap, c * pages_per_chunk,
+                                      end < total_pages ? end : total_pages);
+    }
+    return n;
 }
 
 uint64_t pmm_get_total_kb() { return total_pages * 4ULL; }
@@ -8,18 +8,25 @@
 #include <valen/pmm.h>
 #include <valen/stdio.h>
 #include <valen/spinlock.h>
+#include <valen/numa.h>
 
 #define KERNEL_VIRT_OFFSET 0xFFFFFFFF80000000ULL
 
 #define PHYS_TO_VIRT(phys) ((void *)((uint64_t)(phys) + KERNEL_VIRT_OFFSET))
+#define VIRT_TO_PHYS(virt) ((uint64_t)(virt) - KERNEL_VIRT_OFFSET)
 #define ENTRY_TO_PHYS(entry) ((uint64_t)(entry) & ~0xFFF)
 
-static spinlock_t vmm_lock = SPINLOCK_INIT;
+static spinlock_t vmm_lock = SPINLOCK_INIT_NAMED("vmm_lock");
+
+/* Bump allocator for kernel virtual space above the 1GB direct map */
+#define VMM_ALLOC_BASE 0xFFFFFFFFC0000000
+static uintptr_t next_virt_addr = VMM_ALLOC_BASE;
 
 
 void vmm_init()
 {
     paging_init();
+    pat_init();
 }
 
 /**
@@ -51,22 +58,20 @@ void *vmm_alloc(uint64_t pages, uint64_t flags)
 {
     spinlock_acquire(&vmm_lock);
     
-    // Allocate contiguous physical pages first
+    // Allocate contiguous physical pages first (pmm returns their direct mapping)
     void *phys_pages = pmm_alloc_pages(pages);
     if (!phys_pages) {
         spinlock_release(&vmm_lock);
         return 0;
     }
     
-    // Find a free virtual address range
-    // For now, use a simple allocator starting from a base address
-    static uintptr_t next_virt_addr = 0xFFFFFFFFC0000000;
+    // Take the next free virtual address range
     uintptr_t start_addr = next_virt_addr;
     
     // Map each page
     for (uint64_t i = 0; i < pages; i++) {
         uintptr_t virt = next_virt_addr + (i * 4096);
-        uintptr_t phys = (uintptr_t)phys_pages + (i * 4096);
+        uintptr_t phys = VIRT_TO_PHYS(phys_pages) + (i * 4096);
         paging_map(virt, phys, flags);
         asm volatile("invlpg (%0)" : : "r"(virt) : "memory");
     }
@@ -76,6 +81,86 @@ void *vmm_alloc(uint64_t pages, uint64_t flags)
     return (void *)start_addr;
 }
 
+/**
+ * @brief Allocates virtual pages backed by frames taken from each NUMA node
+ * in turn, so a large shared buffer spreads its bandwidth over all nodes.
+ */
+void *vmm_alloc_interleave(uint64_t pages, uint64_t flags)
+{
+    if (pages == 0)
+        return 0;
+
+    spinlock_acquire(&vmm_lock);
+
+    uintptr_t start_addr = next_virt_addr;
+    for (uint64_t i = 0; i < pages; i++) {
+        uint64_t frame = pmm_alloc_frame_node(numa_interleave_node());
+        if (!frame) {
+            // Unmap and give back what was taken; the virtual range is reused next time
+            while (i--) {
+                uintptr_t virt = start_addr + (i * 4096);
+                uint64_t phys = paging_unmap(virt);
+                asm volatile("invlpg (%0)" : : "r"(virt) : "memory");
+                pmm_free_page((void *)phys);
+            }
+            spinlock_release(&vmm_lock);
+            return 0;
+        }
+        uintptr_t virt = start_addr + (i * 4096);
+        paging_map(virt, frame, flags);
+        asm volatile("invlpg (%0)" : : "r"(virt) : "memory");
+    }
+
+    next_virt_addr += pages * 4096;
+    spinlock_release(&vmm_lock);
+    return (void *)start_addr;
+}
+
+uint64_t vmm_get_used_kb(void)
+{
+    return (next_virt_addr - VMM_ALLOC_BASE) / 1024;
+}
+
+/**
+ * @brief Maps physical memory outside the direct map (firmware tables, MMIO).
+ */
+void *vmm_map_phys(uint64_t phys, uint64_t size, uint64_t flags)
+{
+    uint64_t cache_bits = PAGE_PWT | PAGE_PCD | PAGE_PAT;
+
+    return vmm_map_phys_cache(phys, size, flags & ~cache_bits, pat_flags_cache(flags));
+}
+
+/**
+ * @brief Maps physical memory with a memory type, after checking that no
+ * other mapping of it uses a different one.
+ */
+void *vmm_map_phys_cache(uint64_t phys, uint64_t size, uint64_t flags, enum page_cache type)
+{
+    if (size == 0)
+        return 0;
+
+    uint64_t first = phys & ~0xFFFULL;
+    uint64_t pages = (phys + size - first + 4095) / 4096;
+
+    if (memtype_reserve(first, first + pages * 4096, type) < 0)
+        return 0;
+    flags |= pat_cache_flags(type);
+
+    spinlock_acquire(&vmm_lock);
+
+    uintptr_t start_addr = next_virt_addr;
+    for (uint64_t i = 0; i < pages; i++) {
+        uintptr_t virt = start_addr + (i * 4096);
+        paging_map(virt, first + (i * 4096), flags);
+        asm volatile("invlpg (%0)" : : "r"(virt) : "memory");
+    }
+
+    next_virt_addr += pages * 4096;
+    spinlock_release(&vmm_lock);
+    return (void *)(start_addr + (phys - first));
+}
+
 /**
  * @brief Translates a virtual address back to physical.
  */
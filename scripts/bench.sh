@@ -0,0 +1,46 @@
+#!/bin/bash
+
+# Runs the in-kernel benchmark suite headless and prints its BENCH lines.
+#
+# Usage: scripts/bench.sh [mode] [output-file]
+#   mode         'all' (default) or a single benchmark name, see 'bench list'
+#   output-file  also save the BENCH lines here (for scripts/bench_compare.sh)
+#
+# The kernel leaves QEMU through isa-debug-exit: exit code 1 means the
+# suite ran to completion, 3 means it failed, anything else is a crash
+# or the timeout.
+
+MODE=${1:-all}
+OUT=${2:-}
+TIMEOUT=${BENCH_TIMEOUT:-120}
+
+Q_MEM=$(echo ${CONFIG_MEM_SIZE:-2G} | tr -d '"')
+Q_CPU=$(echo ${CONFIG_CPU_TYPE:-qemu64} | tr -d '"')
+
+echo "[INFO]: Building Valen with bench=$MODE..."
+make -j$(nproc) all KERNEL_CMDLINE="bench=$MODE" > /dev/null || exit 1
+
+LOG=$(mktemp)
+timeout $TIMEOUT qemu-system-x86_64 \
+    -m $Q_MEM \
+    -cpu $Q_CPU \
+    -display none \
+    -serial file:$LOG \
+    -device isa-debug-exit,iobase=0xf4,iosize=0x04 \
+    -cdrom bin/valen.iso \
+    $EXTRA_ARGS
+STATUS=$?
+
+grep '^BENCH ' $LOG
+if [ -n "$OUT" ]; then
+    grep '^BENCH ' $LOG > "$OUT"
+fi
+rm -f $LOG
+
+# Rebuild the normal image so 'make run' does not boot into the suite
+make -j$(nproc) all > /dev/null
+
+if [ $STATUS -ne 1 ]; then
+    echo "[ERROR]: Benchmark run failed (QEMU exit status $STATUS)"
+    exit 1
+fi
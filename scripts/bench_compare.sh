@@ -0,0 +1,39 @@
+#!/bin/bash
+
+# Compares two files of BENCH lines (from scripts/bench.sh) by p50.
+#
+# Usage: scripts/bench_compare.sh <baseline> <candidate> [threshold-percent]
+#
+# Exits with status 1 if any benchmark's p50 got slower by more than the
+# threshold (default 10%).
+
+BASE=$1
+NEW=$2
+THRESHOLD=${3:-10}
+
+if [ ! -f "$BASE" ] || [ ! -f "$NEW" ]; then
+    echo "Usage: $0 <baseline> <candidate> [threshold-percent]"
+    exit 2
+fi
+
+awk -v threshold="$THRESHOLD" '
+function field(line, key,    i, n, kv) {
+    n = split(line, kv, " ")
+    for (i = 1; i <= n; i++)
+        if (index(kv[i], key "=") == 1)
+            return substr(kv[i], length(key) + 2)
+    return ""
+}
+FNR == NR { base[field($0, "name")] = field($0, "p50"); next }
+{
+    name = field($0, "name"); p50 = field($0, "p50")
+    if (!(name in base) || base[name] == "" || p50 == "" || base[name] == 0)
+        next
+    delta = (p50 - base[name]) * 100.0 / base[name]
+    flag = delta > threshold ? "REGRESSION" : ""
+    if (flag != "")
+        bad = 1
+    printf "%-16s %10d -> %10d  %+7.1f%%  %s\n", name, base[name], p50, delta, flag
+}
+END { exit bad }
+' "$BASE" "$NEW"
@@ -0,0 +1,34 @@
+#!/bin/bash
+
+# Recovers the binary crash image from a serial log of 'crashdump export'.
+#
+# Usage: scripts/crashdump_extract.sh <serial-log> <output>
+#
+# The last CRASHDUMP-BEGIN/END block in the log is used. The layout of the
+# image is struct crashdump in include/valen/crashdump.h.
+
+LOG=$1
+OUT=$2
+
+if [ ! -f "$LOG" ] || [ -z "$OUT" ]; then
+    echo "Usage: $0 <serial-log> <output>"
+    exit 2
+fi
+
+HEX=$(tr -d '\r' < "$LOG" | awk '
+    /^CRASHDUMP-BEGIN/ { block = ""; size = $2; sub("size=", "", size); inside = 1; next }
+    /^CRASHDUMP-END/   { if (inside) { last = block; last_size = size } inside = 0; next }
+    inside             { block = block $0 }
+    END {
+        if (last == "") exit 1
+        if (length(last) != last_size * 2) { print "truncated" > "/dev/stderr"; exit 1 }
+        print last
+    }')
+
+if [ -z "$HEX" ]; then
+    echo "[ERROR]: No complete crash image in $LOG"
+    exit 1
+fi
+
+echo "$HEX" | xxd -r -p > "$OUT" || exit 1
+echo "[INFO]: Wrote $(stat -c %s "$OUT") bytes to $OUT"
@@ -0,0 +1,75 @@
+#!/bin/bash
+
+# Samples the program counter of a running kernel through the GDB stub and
+# prints the hottest functions.
+#
+# Usage: scripts/gdb_sample.sh [host:port] [samples] [interval-seconds]
+#
+# Needs CONFIG_GDB_STUB, COM2 on TCP (make run EXTRA_ARGS="-serial tcp::1234,server,nowait")
+# and sampling enabled: gdb_sample on the kernel command line, 'sysctl gdb_sample=1',
+# or 'monitor sample on' from gdb. Without it every read stops the kernel.
+
+TARGET=${1:-localhost:1234}
+SAMPLES=${2:-500}
+INTERVAL=${3:-0.01}
+NM=${NM:-x86_64-elf-nm}
+KERNEL=${KERNEL:-bin/valen.bin}
+
+exec 3<>/dev/tcp/${TARGET%:*}/${TARGET#*:} || exit 1
+
+send() {
+    local sum=0 i
+    for ((i = 0; i < ${#1}; i++)); do
+        sum=$(( (sum + $(printf '%d' "'${1:i:1}")) & 255 ))
+    done
+    printf '$%s#%02x' "$1" $sum >&3
+}
+
+# Reads one reply packet and prints its payload
+receive() {
+    local reply
+    read -r -d '#' -u 3 reply
+    read -r -n 2 -u 3 _
+    echo "${reply#*\$}"
+}
+
+send QStartNoAckMode
+receive > /dev/null
+printf '+' >&3
+
+# Register 16 is rip, sent as little-endian bytes
+for ((n = 0; n < SAMPLES; n++)); do
+    send p10
+    hex=$(receive)
+    rip=""
+    for ((i = 14; i >= 0; i -= 2)); do rip+=${hex:i:2}; done
+    echo "$rip"
+    sleep "$INTERVAL"
+done > /tmp/valen_samples.$$
+
+# Detaching also ends no-ack mode
+send D
+receive > /dev/null
+exec 3>&-
+
+echo "[INFO]: $SAMPLES samples from $TARGET"
+if [ -f "$KERNEL" ] && command -v "$NM" > /dev/null; then
+    # Symbolize against the text symbols, like scripts/kallsyms.sh
+    sort /tmp/valen_samples.$$ | awk -v nm="$NM -n $KERNEL" '
+        BEGIN {
+            while ((nm | getline line) > 0) {
+                split(line, f, " ")
+                if (f[2] ~ /^[tTwW]$/) { addr[n] = f[1]; name[n] = f[3]; n++ }
+            }
+        }
+        {
+            sym = "?"
+            for (i = n - 1; i >= 0; i--)
+                if ((addr[i] "") <= ($1 "")) { sym = name[i]; break }
+            count[sym]++
+        }
+        END { for (s in count) printf "%7d %s\n", count[s], s }' | sort -rn | head -20
+else
+    sort /tmp/valen_samples.$$ | uniq -c | sort -rn | head -20
+fi
+rm -f /tmp/valen_samples.$$
@@ -0,0 +1,47 @@
+#!/bin/bash
+
+# Emits the kernel symbol table as C for symbolized backtraces.
+#
+# Usage: scripts/kallsyms.sh [kernel-elf]
+#
+# With no argument, emits an empty table for the first link pass. The
+# kernel is then linked again with the table of the first pass: it only
+# lists text symbols and only adds .rodata, so code addresses do not move.
+
+NM=${NM:-x86_64-elf-nm}
+
+echo "/* Generated by scripts/kallsyms.sh - do not edit */"
+echo "#include <stdint.h>"
+echo
+
+if [ -z "$1" ]; then
+    echo "const uint64_t kallsyms_num = 0;"
+    echo "const uint64_t kallsyms_addresses[1] = {0};"
+    echo "const uint32_t kallsyms_offsets[1] = {0};"
+    echo "const char kallsyms_names[1] = {0};"
+    exit 0
+fi
+
+$NM -n "$1" | awk '
+BEGIN { n = 0 }
+NF == 3 && $2 ~ /^[tTwW]$/ && $3 !~ /^\./ {
+    addr[n] = $1; name[n] = $3; n++
+}
+END {
+    printf "const uint64_t kallsyms_num = %d;\n\n", n
+    printf "const uint64_t kallsyms_addresses[] = {\n"
+    for (i = 0; i < n; i++)
+        printf "    0x%s,\n", addr[i]
+    printf "};\n\n"
+    printf "const uint32_t kallsyms_offsets[] = {\n"
+    off = 0
+    for (i = 0; i < n; i++) {
+        printf "    %d,\n", off
+        off += length(name[i]) + 1
+    }
+    printf "};\n\n"
+    printf "const char kallsyms_names[] =\n"
+    for (i = 0; i < n; i++)
+        printf "    \"%s\\0\"\n", name[i]
+    printf "    ;\n"
+}'
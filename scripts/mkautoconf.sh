@@ -0,0 +1,55 @@
+#!/bin/bash
+
+# Generates the build's view of the configuration from .config.
+#
+# Usage: scripts/mkautoconf.sh <defconfig> <.config> <outdir>
+#
+# Symbols missing from .config (an older .config predating a Kconfig option)
+# take their value from the defconfig. Writes:
+#   <outdir>/autoconf.h  #define CONFIG_FOO 1 for every enabled option,
+#                        force-included into every kernel source file
+#   <outdir>/auto.conf   CONFIG_FOO=y lines for the Makefile and scripts
+# autoconf.h is only rewritten when its contents change, so editing an
+# unrelated part of .config does not rebuild the whole kernel.
+
+DEFCONFIG=$1
+CONFIG=$2
+OUT=$3
+
+mkdir -p "$OUT"
+
+awk -v hdr="$OUT/autoconf.h.tmp" -v mk="$OUT/auto.conf" '
+/^CONFIG_[A-Za-z0-9_]+=/ {
+    eq = index($0, "=")
+    key = substr($0, 1, eq - 1)
+    if (!(key in val)) order[++n] = key
+    val[key] = substr($0, eq + 1)
+    next
+}
+/^# CONFIG_[A-Za-z0-9_]+ is not set/ {
+    if (!($2 in val)) order[++n] = $2
+    val[$2] = "n"
+}
+END {
+    print "/* Generated from .config by scripts/mkautoconf.sh - do not edit */" > hdr
+    print "#ifndef VALEN_AUTOCONF_H" > hdr
+    print "#define VALEN_AUTOCONF_H" > hdr
+    print "# Generated from .config by scripts/mkautoconf.sh - do not edit" > mk
+    for (i = 1; i <= n; i++) {
+        key = order[i]; v = val[key]
+        if (v == "n" || v == "")
+            continue
+        print key "=" v > mk
+        if (v == "y")
+            print "#define " key " 1" > hdr
+        else
+            print "#define " key " " v > hdr
+    }
+    print "#endif" > hdr
+}' "$DEFCONFIG" "$CONFIG" || exit 1
+
+if cmp -s "$OUT/autoconf.h.tmp" "$OUT/autoconf.h"; then
+    rm -f "$OUT/autoconf.h.tmp"
+else
+    mv "$OUT/autoconf.h.tmp" "$OUT/autoconf.h"
+fi
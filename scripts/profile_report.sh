@@ -0,0 +1,52 @@
+#!/bin/bash
+
+# Builds the kernel in every build profile and reports image size, and with
+# PERF=1 also the benchmark p50s side by side.
+#
+# Usage: [PERF=1] scripts/profile_report.sh [profiles...]
+#   profiles  defaults to: debug release max
+
+PROFILES=${@:-debug release max}
+SIZE=${SIZE:-x86_64-elf-size}
+RESULTS=$(mktemp -d)
+
+printf "%-10s %10s %10s %10s %10s\n" profile text data bss total
+for p in $PROFILES; do
+    make -j$(nproc) all BUILD_PROFILE=$p > /dev/null || { echo "[ERROR]: $p build failed"; exit 1; }
+    $SIZE bin/valen.bin | awk -v p=$p 'NR == 2 { printf "%-10s %10d %10d %10d %10d\n", p, $1, $2, $3, $4 }'
+
+    if [ -n "$PERF" ]; then
+        BUILD_PROFILE=$p ./scripts/bench.sh all "$RESULTS/$p" > /dev/null || echo "[WARN]: $p benchmark run failed"
+    fi
+done
+
+if [ -n "$PERF" ]; then
+    echo
+    echo "p50 cycles:"
+    awk '
+    function field(line, key,    i, n, kv) {
+        n = split(line, kv, " ")
+        for (i = 1; i <= n; i++)
+            if (index(kv[i], key "=") == 1)
+                return substr(kv[i], length(key) + 2)
+        return ""
+    }
+    FNR == 1 { np++; prof[np] = FILENAME; sub(".*/", "", prof[np]) }
+    {
+        name = field($0, "name")
+        if (!(name in seen)) { seen[name] = 1; order[++nn] = name }
+        p50[name, np] = field($0, "p50")
+    }
+    END {
+        printf "%-16s", "benchmark"
+        for (i = 1; i <= np; i++) printf " %10s", prof[i]
+        printf "\n"
+        for (j = 1; j <= nn; j++) {
+            printf "%-16s", order[j]
+            for (i = 1; i <= np; i++) printf " %10s", p50[order[j], i]
+            printf "\n"
+        }
+    }' $(for p in $PROFILES; do [ -f "$RESULTS/$p" ] && echo "$RESULTS/$p"; done)
+fi
+
+rm -rf "$RESULTS"
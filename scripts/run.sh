@@ -22,11 +22,32 @@ if [ "$CONFIG_AUDIO_ENABLED" = "y" ]; then
     Q_AUDIO="-machine $Q_ARCH,pcspk-audiodev=audio0 -audiodev sdl,id=audio0 -soundhw ${CONFIG_SOUNDHW:-pcspk}"
 fi
 
+# Split memory and CPUs evenly over the NUMA nodes (the last node takes the remainder)
+Q_NUMA=""
+Q_NODES=${CONFIG_NUMA_NODES:-1}
+if [ "$Q_NODES" -gt 1 ]; then
+    case $Q_MEM in
+        *G) MEM_MB=$(( ${Q_MEM%G} * 1024 )) ;;
+        *M) MEM_MB=${Q_MEM%M} ;;
+        *)  MEM_MB=$Q_MEM ;;
+    esac
+    for ((n = 0; n < Q_NODES; n++)); do
+        SIZE=$(( MEM_MB / Q_NODES ))
+        if [ $n -eq $((Q_NODES - 1)) ]; then SIZE=$(( MEM_MB - SIZE * n )); fi
+        CPUS=""
+        FIRST=$(( n * Q_SMP / Q_NODES ))
+        LAST=$(( (n + 1) * Q_SMP / Q_NODES - 1 ))
+        if [ $LAST -ge $FIRST ]; then CPUS=",cpus=$FIRST-$LAST"; fi
+        Q_NUMA="$Q_NUMA -object memory-backend-ram,id=mem$n,size=${SIZE}M -numa node,nodeid=$n,memdev=mem$n$CPUS"
+    done
+fi
+
 # --- 2. BUILD & RUN ---
-echo "[INFO]: Cleaning and Building Valen..."
-make clean && make all
+# Incremental: only sources whose dependencies changed are rebuilt
+echo "[INFO]: Building Valen..."
+make -j$(nproc) all || exit 1
 
-echo "[INFO]: Launching QEMU ($Q_ARCH | $Q_CPU | $Q_MEM RAM)"
+echo "[INFO]: Launching QEMU ($Q_ARCH | $Q_CPU | $Q_MEM RAM | $Q_NODES node(s))"
 
 qemu-system-x86_64 \
     -m $Q_MEM \
@@ -36,9 +57,8 @@ qemu-system-x86_64 \
     -vga $Q_VGA \
     -d $Q_DEBUG \
     -serial stdio \
+    -device isa-debug-exit,iobase=0xf4,iosize=0x04 \
     -cdrom bin/valen.iso \
     $Q_AUDIO \
+    $Q_NUMA \
     $EXTRA_ARGS
-
-# Cleanup after closing QEMU
-make clean
\ No newline at end of file
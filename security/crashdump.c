@@ -0,0 +1,237 @@
+/**
+ * @file crashdump.c
+ * @brief Crash image that survives a warm reboot.
+ *
+ * On a fatal exception or panic(), crashdump_save() fills a fixed region of
+ * physical memory (CRASHDUMP_PHYS) with the registers, the backtrace, the
+ * task list, a PMM usage map and the newest console output. kmain never
+ * gives that region to the PMM, and RAM keeps its contents across a reset
+ * without power loss, so crashdump_init() finds the image on the next boot.
+ * It stays there until 'crashdump clear' or the next crash.
+ *
+ * 'crashdump export' writes the raw image to COM1 as hex between
+ * CRASHDUMP-BEGIN and CRASHDUMP-END lines; scripts/crashdump_extract.sh
+ * turns a serial log back into the binary image.
+ */
+
+#include <valen/crashdump.h>
+#include <valen/stdio.h>
+#include <valen/string.h>
+#include <valen/task.h>
+#include <valen/pmm.h>
+#include <valen/tsc.h>
+#include <valen/kallsyms.h>
+
+#define KERNEL_VIRT_OFFSET 0xFFFFFFFF80000000ULL
+#define PHYS_TO_VIRT(p) ((void *)((uint64_t)(p) + KERNEL_VIRT_OFFSET))
+
+#define IMAGE ((struct crashdump *)PHYS_TO_VIRT(CRASHDUMP_PHYS))
+
+/* Bytes of the saved console log shown by 'crashdump show' */
+#define SHOW_LOG_TAIL 1024
+
+static int image_valid = 0;
+
+static uint32_t image_checksum(struct crashdump *img)
+{
+    uint32_t saved = img->checksum;
+    uint32_t hash = 2166136261u;
+    const uint8_t *p = (const uint8_t *)img;
+
+    img->checksum = 0;
+    for (uint32_t i = 0; i < img->size; i++)
+    {
+        hash ^= p[i];
+        hash *= 16777619u;
+    }
+    img->checksum = saved;
+    return hash;
+}
+
+static int image_check(struct crashdump *img)
+{
+    if (img->magic != CRASHDUMP_MAGIC || img->version != CRASHDUMP_VERSION)
+        return 0;
+    if (img->log_len > CRASHDUMP_LOG_MAX || img->size != sizeof(*img) + img->log_len)
+        return 0;
+    if (img->nframes > CRASHDUMP_MAX_FRAMES || img->ntasks > CRASHDUMP_MAX_TASKS)
+        return 0;
+    return image_checksum(img) == img->checksum;
+}
+
+int crashdump_init(void)
+{
+    struct crashdump *img = IMAGE;
+
+    if (img->magic != CRASHDUMP_MAGIC)
+        return 0;
+
+    if (!image_check(img))
+    {
+        /* Power loss or a partial write: never show half an image */
+        printf("crashdump: ignoring corrupt crash image at %llx\n",
+               (unsigned long long)CRASHDUMP_PHYS);
+        img->magic = 0;
+        return 0;
+    }
+
+    image_valid = 1;
+    printf("crashdump: previous boot crashed: %s\n", img->reason);
+    printf("crashdump: run 'crashdump' for details\n");
+    return 1;
+}
+
+void crashdump_save(const char *reason, struct pt_regs *regs,
+                    const uint64_t *frames, int nframes)
+{
+    struct crashdump *img = IMAGE;
+
+    memset(img, 0, sizeof(*img));
+    img->magic = CRASHDUMP_MAGIC;
+    img->version = CRASHDUMP_VERSION;
+    img->tsc = rdtsc();
+    img->build_id = kallsyms_build_id();
+
+    strncpy(img->reason, reason, sizeof(img->reason) - 1);
+    if (regs)
+    {
+        img->regs = *regs;
+        img->flags |= CRASHDUMP_HAS_REGS;
+    }
+    asm volatile("mov %%cr2, %0" : "=r"(img->cr2));
+    asm volatile("mov %%cr3, %0" : "=r"(img->cr3));
+
+    if (nframes > CRASHDUMP_MAX_FRAMES)
+        nframes = CRASHDUMP_MAX_FRAMES;
+    memcpy(img->frames, frames, nframes * sizeof(uint64_t));
+    img->nframes = nframes;
+
+    /* No locks: the crashed code may hold the runqueue lock */
+    task_t *cur = current_task;
+    img->current_pid = cur ? cur->pid : 0;
+    for_each_task(t)
+    {
+        if (img->ntasks == CRASHDUMP_MAX_TASKS)
+            break;
+        struct crashdump_task *ct = &img->tasks[img->ntasks++];
+        ct->pid = t->pid;
+        ct->state = (int32_t)t->state;
+        memcpy(ct->comm, t->comm, sizeof(ct->comm));
+        ct->comm[sizeof(ct->comm) - 1] = '\0';
+        ct->rsp = t->context.rsp;
+        ct->stack = (uint64_t)t->stack;
+        ct->stack_size = t->stack_size;
+    }
+
+    img->pmm_total_kb = pmm_get_total_kb();
+    img->pmm_used_kb = pmm_get_used_kb();
+    pmm_usage_map(img->pmm_chunks, CRASHDUMP_PMM_CHUNKS);
+
+    img->log_len = console_log_copy(img->log, CRASHDUMP_LOG_MAX);
+    img->size = sizeof(*img) + img->log_len;
+    img->checksum = image_checksum(img);
+}
+
+static void show_frames(struct crashdump *img, int same_kernel)
+{
+    printf_fmt("  Backtrace%s:\n", same_kernel ? "" : " (different kernel, not symbolized)");
+
+    for (uint32_t i = 0; i < img->nframes; i++)
+    {
+        uint64_t addr = img->frames[i];
+        uint64_t offset;
+        /* Entries after the first are return addresses, see print_symbol() */
+        const char *name = same_kernel ? kallsyms_lookup(i ? addr - 1 : addr, &offset) : 0;
+
+        if (name)
+            printf_fmt("    [<%016lx>] %s+0x%lx\n", addr, name, i ? offset + 1 : offset);
+        else
+            printf_fmt("    [<%016lx>]\n", addr);
+    }
+}
+
+static void show_log_tail(struct crashdump *img)
+{
+    uint32_t start = img->log_len > SHOW_LOG_TAIL ? img->log_len - SHOW_LOG_TAIL : 0;
+
+    /* Begin at a line boundary */
+    while (start > 0 && start < img->log_len && img->log[start - 1] != '\n')
+        start++;
+
+    puts("  Console (tail):\n");
+    for (uint32_t i = start; i < img->log_len; i++)
+        putc(img->log[i]);
+    if (img->log_len && img->log[img->log_len - 1] != '\n')
+        putc('\n');
+}
+
+void crashdump_show(void)
+{
+    struct crashdump *img = IMAGE;
+
+    if (!image_valid)
+    {
+        puts("No crash image from a previous boot.\n");
+        return;
+    }
+
+    puts("\n--- Crash Image ---\n");
+    printf_fmt("  Reason: %s\n", img->reason);
+    if (img->flags & CRASHDUMP_HAS_REGS)
+    {
+        printf_fmt("  RIP: %04lx:%016lx RSP: %016lx\n", img->regs.cs, img->regs.rip, img->regs.rsp);
+        printf_fmt("  Vector: %lu Error: %lx RFLAGS: %lx\n", img->regs.vector, img->regs.error_code,
+                   img->regs.rflags);
+    }
+    printf_fmt("  CR2: %016lx CR3: %016lx\n", img->cr2, img->cr3);
+
+    show_frames(img, img->build_id == kallsyms_build_id());
+
+    printf_fmt("  Tasks (current pid %d):\n", img->current_pid);
+    for (uint32_t i = 0; i < img->ntasks; i++)
+    {
+        struct crashdump_task *t = &img->tasks[i];
+        printf_fmt("    %-5d %-16s state %d rsp %016lx\n", t->pid, t->comm, t->state, t->rsp);
+    }
+
+    printf_fmt("  Memory: %lu of %lu KB used\n", img->pmm_used_kb, img->pmm_total_kb);
+    show_log_tail(img);
+    puts("-------------------\n");
+}
+
+void crashdump_export(void)
+{
+    static const char hex[] = "0123456789abcdef";
+    struct crashdump *img = IMAGE;
+    const uint8_t *p = (const uint8_t *)img;
+    char line[2 * 32 + 2];
+
+    if (!image_valid)
+    {
+        puts("No crash image from a previous boot.\n");
+        return;
+    }
+
+    serial_printf("CRASHDUMP-BEGIN size=%u\n", img->size);
+    for (uint32_t off = 0; off < img->size; off += 32)
+    {
+        int n = 0;
+        for (uint32_t i = off; i < off + 32 && i < img->size; i++)
+        {
+            line[n++] = hex[p[i] >> 4];
+            line[n++] = hex[p[i] & 0xF];
+        }
+        line[n++] = '\n';
+        line[n] = '\0';
+        serial_write(line);
+    }
+    serial_write((char *)"CRASHDUMP-END\n");
+
+    printf_fmt("Crash image (%u bytes) written to COM1.\n", img->size);
+}
+
+void crashdump_clear(void)
+{
+    IMAGE->magic = 0;
+    image_valid = 0;
+}
@@ -1,42 +1,301 @@
+/**
+ * @file panic.c
+ * @brief Exception handling, panic() and crash dumps.
+ *
+ * A crash is reported on COM1 with polled, lockless output: the code that
+ * crashed may hold the console lock, and on #DF or NMI the interrupted
+ * context may be in any state. The dump contains the exception, the full
+ * register set, the current task, a symbolized frame-pointer backtrace and,
+ * with CONFIG_TRACING, the most recent trace events. The VGA console only
+ * gets a one-line notice, also written without locks. With CONFIG_CRASHDUMP
+ * the same state is kept in a crash image for the next boot (crashdump.c).
+ */
+
 #include <stdint.h>
 #include <valen/stdio.h>
 #include <valen/panic.h>
 #include <valen/color.h>
+#include <valen/io.h>
+#include <valen/task.h>
+#include <valen/trace.h>
+#include <valen/kallsyms.h>
+#include <valen/param.h>
+#include <valen/crashdump.h>
+#include <valen/gdbstub.h>
+
+#define KERNEL_VIRT_OFFSET 0xFFFFFFFF80000000ULL
+
+#define COM1 0x3F8
+#define COM1_LSR (COM1 + 5)
+#define LSR_THR_EMPTY 0x20
+
+#define BACKTRACE_MAX 32
+#define CRASH_TRACE_EVENTS 32
+
+/* Reset instead of halting, e.g. to collect the crash image unattended */
+static bool panic_reboot = false;
+param_bool(panic_reboot, panic_reboot, "Reboot after a crash dump instead of halting");
+
+static const char *const exception_names[32] = {
+    "#DE Divide Error", "#DB Debug", "NMI", "#BP Breakpoint",
+    "#OF Overflow", "#BR Bound Range Exceeded", "#UD Invalid Opcode", "#NM Device Not Available",
+    "#DF Double Fault", "Coprocessor Segment Overrun", "#TS Invalid TSS", "#NP Segment Not Present",
+    "#SS Stack-Segment Fault", "#GP General Protection", "#PF Page Fault", "Reserved",
+    "#MF x87 Floating-Point", "#AC Alignment Check", "#MC Machine Check", "#XM SIMD Floating-Point",
+    "#VE Virtualization", "#CP Control Protection", "Reserved", "Reserved",
+    "Reserved", "Reserved", "Reserved", "Reserved",
+    "#HV Hypervisor Injection", "#VC VMM Communication", "#SX Security", "Reserved",
+};
+
+/* Set by the first crash; a fault while dumping must not recurse */
+static volatile int crash_in_progress = 0;
+
+/* Static so the dump works on the small IST stacks */
+static char crash_buf[256];
+
+static void crash_putc(char c)
+{
+    while (!(inb(COM1_LSR) & LSR_THR_EMPTY))
+        ;
+    outb(COM1, c);
+}
+
+static void crash_puts(const char *s)
+{
+    while (*s)
+        crash_putc(*s++);
+}
+
+void crash_printf(const char *format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    vsnprintf(crash_buf, sizeof(crash_buf), format, args);
+    va_end(args);
+    crash_puts(crash_buf);
+}
+
+void crash_notice(const char *format, ...)
+{
+#ifdef CONFIG_CONSOLE_VGA
+    uint16_t *row = (uint16_t *)(KERNEL_VIRT_OFFSET + 0xB8000) + 24 * 80;
+    uint16_t attr = (uint16_t)((COLOR_RED << 4) | COLOR_WHITE) << 8;
+    char line[81];
+    va_list args;
+
+    va_start(args, format);
+    vsnprintf(line, sizeof(line), format, args);
+    va_end(args);
+
+    int end = 0;
+    for (int i = 0; i < 80; i++)
+    {
+        if (!line[i])
+            end = 1;
+        row[i] = attr | (uint8_t)(end ? ' ' : line[i]);
+    }
+#else
+    (void)format;
+#endif
+}
+
+static int valid_frame(uint64_t rbp)
+{
+    return rbp >= KERNEL_VIRT_OFFSET && rbp < 0xFFFFFFFFFFFFF000ULL && !(rbp & 7);
+}
+
+static void print_symbol(void (*out)(const char *format, ...), uint64_t addr, int is_return)
+{
+    uint64_t offset;
+    /* A return address may be the first byte after the calling function */
+    const char *name = kallsyms_lookup(is_return ? addr - 1 : addr, &offset);
+
+    if (name)
+        out("  [<%016lx>] %s+0x%lx\n", addr, name, is_return ? offset + 1 : offset);
+    else
+        out("  [<%016lx>] ?\n", addr);
+}
+
+int backtrace_collect(uint64_t rip, uint64_t rbp, uint64_t *frames, int max)
+{
+    int n = 0;
+
+    if (max > 0)
+        frames[n++] = rip;
+
+    while (n < max && valid_frame(rbp))
+    {
+        uint64_t *frame = (uint64_t *)rbp;
+        uint64_t ret = frame[1];
+        if (!ret)
+            break;
+        frames[n++] = ret;
+
+        /* Frames grow towards higher addresses; anything else is corrupt */
+        if (frame[0] <= rbp)
+            break;
+        rbp = frame[0];
+    }
+    return n;
+}
+
+static void print_backtrace(const uint64_t *frames, int n, void (*out)(const char *format, ...))
+{
+    out("Backtrace:\n");
+    for (int i = 0; i < n; i++)
+        print_symbol(out, frames[i], i > 0);
+}
+
+void dump_backtrace(uint64_t rip, uint64_t rbp, void (*out)(const char *format, ...))
+{
+    uint64_t frames[BACKTRACE_MAX + 1];
+    print_backtrace(frames, backtrace_collect(rip, rbp, frames, BACKTRACE_MAX + 1), out);
+}
+
+void show_regs(struct pt_regs *regs)
+{
+    uint64_t cr0, cr2, cr3, cr4;
+    asm volatile("mov %%cr0, %0" : "=r"(cr0));
+    asm volatile("mov %%cr2, %0" : "=r"(cr2));
+    asm volatile("mov %%cr3, %0" : "=r"(cr3));
+    asm volatile("mov %%cr4, %0" : "=r"(cr4));
+
+    crash_printf("RIP: %04lx:%016lx RFLAGS: %016lx\n", regs->cs, regs->rip, regs->rflags);
+    crash_printf("RSP: %04lx:%016lx ERR: %016lx\n", regs->ss, regs->rsp, regs->error_code);
+    crash_printf("RAX: %016lx RBX: %016lx RCX: %016lx\n", regs->rax, regs->rbx, regs->rcx);
+    crash_printf("RDX: %016lx RSI: %016lx RDI: %016lx\n", regs->rdx, regs->rsi, regs->rdi);
+    crash_printf("RBP: %016lx R08: %016lx R09: %016lx\n", regs->rbp, regs->r8, regs->r9);
+    crash_printf("R10: %016lx R11: %016lx R12: %016lx\n", regs->r10, regs->r11, regs->r12);
+    crash_printf("R13: %016lx R14: %016lx R15: %016lx\n", regs->r13, regs->r14, regs->r15);
+    crash_printf("CR0: %016lx CR2: %016lx CR3: %016lx\n", cr0, cr2, cr3);
+    crash_printf("CR4: %016lx\n", cr4);
+}
+
+static void show_task(void)
+{
+    /* Read without current_task_lock: its holder may be what crashed */
+    task_t *task = current_task;
+    if (task)
+        crash_printf("Task: pid %d '%s', stack %p-%p\n", task->pid, task->comm,
+                     task->stack, (uint8_t *)task->stack + task->stack_size);
+    else
+        crash_printf("Task: none (boot context)\n");
+}
+
+/**
+ * @brief Starts a crash report, or halts at once if one is already running.
+ */
+static void crash_begin(const char *title)
+{
+    asm volatile("cli");
+    if (__atomic_exchange_n(&crash_in_progress, 1, __ATOMIC_ACQUIRE))
+    {
+        crash_puts("\n*** nested fault during crash dump, halting ***\n");
+        while (1)
+            asm volatile("hlt");
+    }
+
+    crash_notice("KERNEL PANIC: %s - dump on COM1", title);
+    crash_printf("\n------------[ KERNEL PANIC ]------------\n%s\n", title);
+    show_task();
+}
+
+/**
+ * @brief Prints the backtrace, saves the crash image and stops the system.
+ * @param regs Exception frame, or NULL for panic().
+ */
+static void __attribute__((noreturn)) crash_end(const char *title, struct pt_regs *regs,
+                                                uint64_t rip, uint64_t rbp)
+{
+    static uint64_t frames[BACKTRACE_MAX + 1];
+    int nframes = backtrace_collect(rip, rbp, frames, BACKTRACE_MAX + 1);
+    print_backtrace(frames, nframes, crash_printf);
+
+#ifdef CONFIG_TRACING
+    crash_printf("Last trace events:\n");
+    trace_dump(CRASH_TRACE_EVENTS, crash_printf);
+#endif
+
+#ifdef CONFIG_CRASHDUMP
+    crashdump_save(title, regs, frames, nframes);
+    crash_printf("Crash image saved at %lx, run 'crashdump' after a warm reboot\n",
+                 (uint64_t)CRASHDUMP_PHYS);
+#else
+    (void)title;
+    (void)regs;
+#endif
+
+    if (panic_reboot)
+    {
+        crash_printf("------------[ end of dump, rebooting ]------------\n");
+        outb(0x64, 0xFE);
+    }
+    crash_printf("------------[ end of dump, halted ]------------\n");
+
+    while (1)
+        asm volatile("cli; hlt");
+}
 
 /**
- * @brief Panic-level Page Fault Handler.
+ * @brief Appends the faulting address and decoded error code of a #PF.
  */
-void page_fault_handler(uint64_t error_code)
+static void describe_page_fault(struct pt_regs *regs, char *buf, uint64_t len)
 {
-    print_clear();
-    set_color(COLOR_LIGHT_RED);
-    
     uint64_t fault_addr;
     asm volatile("mov %%cr2, %0" : "=r"(fault_addr));
 
-    printf("\n--- FATAL PAGE FAULT ---\n");
-    printf("Address: ");
-    print_hex(fault_addr);
-    printf("\nError Code: ");
-    print_int(error_code);
+    snprintf(buf, len, "Page fault at %016lx: %s, %s, %s%s", fault_addr,
+             (regs->error_code & 1) ? "protection violation" : "non-present page",
+             (regs->error_code & 2) ? "write" : "read",
+             (regs->error_code & 4) ? "user mode" : "kernel mode",
+             (regs->error_code & 16) ? ", instruction fetch" : "");
+}
 
-    /* Decode error code for debugging */
-    if (error_code & 1)
-        printf(" [Protection Violation]");
-    else
-        printf(" [Non-present Page]");
+void exception_handler(struct pt_regs *regs)
+{
+    static char title[128];
+    const char *name = regs->vector < 32 ? exception_names[regs->vector] : "Unknown";
 
-    if (error_code & 2)
-        printf(" [Write]");
-    else
-        printf(" [Read]");
+    /* NMIs are informational (e.g. 'nmi' in the QEMU monitor): dump where
+     * the CPU was and resume, which makes them useful to debug hangs */
+    if (regs->vector == 2)
+    {
+        crash_printf("\n------------[ NMI ]------------\n");
+        show_regs(regs);
+        dump_backtrace(regs->rip, regs->rbp, crash_printf);
+        crash_printf("------------[ end of NMI ]------------\n");
+        return;
+    }
+
+#ifdef CONFIG_GDB_STUB
+    /* Breakpoints, single steps, the COM2 interrupt, and a first look at
+     * fatal exceptions when gdb is attached */
+    if (gdb_handle_exception(regs))
+        return;
+#endif
 
-    if (error_code & 4)
-        printf(" [User Mode]");
+    if (regs->vector == 14)
+        describe_page_fault(regs, title, sizeof(title));
     else
-        printf(" [Kernel Mode]");
+        snprintf(title, sizeof(title), "Exception %lu: %s", regs->vector, name);
 
-    printf("\nSystem Halted.");
-    while (1)
-        asm volatile("hlt");
-}
\ No newline at end of file
+    crash_begin(title);
+    show_regs(regs);
+    crash_end(title, regs, regs->rip, regs->rbp);
+}
+
+void panic(const char *format, ...)
+{
+    static char message[128];
+    va_list args;
+
+    va_start(args, format);
+    vsnprintf(message, sizeof(message), format, args);
+    va_end(args);
+
+    crash_begin(message);
+
+    /* Start at our caller: panic() itself is not interesting */
+    uint64_t *frame = (uint64_t *)__builtin_frame_address(0);
+    crash_end(message, NULL, (uint64_t)__builtin_return_address(0), frame[0]);
+}
@@ -0,0 +1,124 @@
+/**
+ * @file harness.h
+ * @brief Minimal test and benchmark harness for host-side kernel testing.
+ *
+ * Test files are regular hosted C: they use libc freely and reach the
+ * kernel code under test through the valen_* names that host.h gives the
+ * symbols which would otherwise collide with libc.
+ */
+
+#ifndef VALEN_TESTS_HARNESS_H
+#define VALEN_TESTS_HARNESS_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* --- Kernel symbols renamed by host.h --- */
+
+void *valen_malloc(uint64_t size);
+void valen_free(void *ptr);
+void *valen_memset(void *ptr, int value, uint64_t num);
+void *valen_memcpy(void *dest, const void *src, uint64_t num);
+int valen_strlen(const char *str);
+int valen_strcmp(const char *str1, const char *str2);
+int valen_strncmp(const char *str1, const char *str2, uint64_t n);
+char *valen_strchr(const char *str, int c);
+char *valen_strcpy(char *dest, const char *src);
+char *valen_strncpy(char *dest, const char *src, uint64_t n);
+
+/* --- Shims (shim.c) --- */
+
+/** @brief Pages handed out by the vmm_alloc() stub so far. */
+extern uint64_t shim_vmm_pages;
+
+/** @brief Fail the next vmm_alloc() calls (simulates exhausted memory). */
+extern int shim_vmm_fail;
+
+/** @brief Node returned by the numa_mem_node() stub (default 0). */
+extern int shim_numa_node;
+
+/** @brief Monotonic host clock in nanoseconds. */
+uint64_t host_now_ns(void);
+
+/** @brief Deterministic xorshift64* PRNG shared by all fuzzers. */
+uint64_t host_rand(void);
+void host_srand(uint64_t seed);
+
+/* --- Test cases --- */
+
+struct test_case
+{
+    const char *name;
+    void (*fn)(void);
+};
+
+struct bench_case
+{
+    const char *name;
+    void (*fn)(void);
+};
+
+extern int harness_failed;
+
+void harness_fail(const char *file, int line, const char *expr);
+
+#define CHECK(cond)                                    \
+    do                                                 \
+    {                                                  \
+        if (!(cond))                                   \
+        {                                              \
+            harness_fail(__FILE__, __LINE__, #cond);   \
+            return;                                    \
+        }                                              \
+    } while (0)
+
+#define CHECK_EQ(a, b) CHECK((a) == (b))
+
+/**
+ * @brief Emits one benchmark result in the same key=value form the
+ * in-kernel suite uses, so host and guest numbers can be diffed by script.
+ */
+#define BENCH_REPORT(name, fmt, ...) \
+    printf("BENCH host name=%s " fmt "\n", name, __VA_ARGS__)
+
+/* Suites, terminated by a { NULL, NULL } entry */
+extern const struct test_case pmm_tests[];
+extern const struct test_case heap_tests[];
+extern const struct test_case string_tests[];
+extern const struct test_case list_tests[];
+extern const struct test_case rbtree_tests[];
+extern const struct test_case hashtable_tests[];
+extern const struct test_case radix_tree_tests[];
+extern const struct test_case min_heap_tests[];
+extern const struct test_case atomic_tests[];
+extern const struct test_case ring_tests[];
+extern const struct test_case lfstack_tests[];
+extern const struct test_case percpu_counter_tests[];
+extern const struct test_case bitmap_tests[];
+extern const struct test_case crc32c_tests[];
+extern const struct test_case hash_tests[];
+extern const struct test_case checksum_tests[];
+extern const struct test_case lz4_tests[];
+
+extern const struct bench_case pmm_benches[];
+extern const struct bench_case heap_benches[];
+extern const struct bench_case string_benches[];
+extern const struct bench_case list_benches[];
+extern const struct bench_case rbtree_benches[];
+extern const struct bench_case hashtable_benches[];
+extern const struct bench_case radix_tree_benches[];
+extern const struct bench_case min_heap_benches[];
+extern const struct bench_case atomic_benches[];
+extern const struct bench_case ring_benches[];
+extern const struct bench_case lfstack_benches[];
+extern const struct bench_case percpu_counter_benches[];
+extern const struct bench_case bitmap_benches[];
+extern const struct bench_case crc32c_benches[];
+extern const struct bench_case hash_benches[];
+extern const struct bench_case checksum_benches[];
+extern const struct bench_case lz4_benches[];
+
+#endif
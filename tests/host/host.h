@@ -0,0 +1,29 @@
+/**
+ * @file host.h
+ * @brief Host build shim for kernel sources under test.
+ *
+ * Force-included (-include) into every kernel translation unit that is
+ * compiled for the host harness. The kernel defines its own malloc/free
+ * and string routines; linking those into a hosted binary unchanged would
+ * replace the C library's versions for the whole process. Renaming them
+ * here keeps the kernel code untouched while the harness links against libc.
+ */
+
+#ifndef VALEN_TESTS_HOST_H
+#define VALEN_TESTS_HOST_H
+
+#define VALEN_HOST 1
+
+#define malloc valen_malloc
+#define free valen_free
+
+#define memset valen_memset
+#define memcpy valen_memcpy
+#define strlen valen_strlen
+#define strcmp valen_strcmp
+#define strncmp valen_strncmp
+#define strchr valen_strchr
+#define strcpy valen_strcpy
+#define strncpy valen_strncpy
+
+#endif
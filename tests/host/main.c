@@ -0,0 +1,104 @@
+/**
+ * @file main.c
+ * @brief Entry point of the host-side test and benchmark runner.
+ *
+ * Usage: valen-host [test|bench] [seed]
+ */
+
+#include "harness.h"
+
+int harness_failed = 0;
+
+void harness_fail(const char *file, int line, const char *expr)
+{
+    printf("    FAIL %s:%d: %s\n", file, line, expr);
+    harness_failed = 1;
+}
+
+static const struct test_case *const test_suites[] = {
+    pmm_tests,
+    heap_tests,
+    string_tests,
+    list_tests,
+    rbtree_tests,
+    hashtable_tests,
+    radix_tree_tests,
+    min_heap_tests,
+    atomic_tests,
+    ring_tests,
+    lfstack_tests,
+    percpu_counter_tests,
+    bitmap_tests,
+    crc32c_tests,
+    hash_tests,
+    checksum_tests,
+    lz4_tests,
+};
+
+static const struct bench_case *const bench_suites[] = {
+    pmm_benches,
+    heap_benches,
+    string_benches,
+    list_benches,
+    rbtree_benches,
+    hashtable_benches,
+    radix_tree_benches,
+    min_heap_benches,
+    atomic_benches,
+    ring_benches,
+    lfstack_benches,
+    percpu_counter_benches,
+    bitmap_benches,
+    crc32c_benches,
+    hash_benches,
+    checksum_benches,
+    lz4_benches,
+};
+
+static int run_tests(void)
+{
+    int total = 0;
+    int failed = 0;
+
+    for (size_t s = 0; s < sizeof(test_suites) / sizeof(test_suites[0]); s++)
+    {
+        for (const struct test_case *t = test_suites[s]; t->name; t++)
+        {
+            harness_failed = 0;
+            t->fn();
+            printf("[%s] %s\n", harness_failed ? "FAIL" : " OK ", t->name);
+            total++;
+            failed += harness_failed;
+        }
+    }
+
+    printf("%d/%d tests passed\n", total - failed, total);
+    return failed ? 1 : 0;
+}
+
+static int run_benches(void)
+{
+    for (size_t s = 0; s < sizeof(bench_suites) / sizeof(bench_suites[0]); s++)
+    {
+        for (const struct bench_case *b = bench_suites[s]; b->name; b++)
+            b->fn();
+    }
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    const char *mode = argc > 1 ? argv[1] : "test";
+    uint64_t seed = argc > 2 ? strtoull(argv[2], NULL, 0) : 0x5EED;
+
+    host_srand(seed);
+    setvbuf(stdout, NULL, _IOLBF, 0);
+
+    if (strcmp(mode, "test") == 0)
+        return run_tests();
+    if (strcmp(mode, "bench") == 0)
+        return run_benches();
+
+    fprintf(stderr, "usage: %s [test|bench] [seed]\n", argv[0]);
+    return 2;
+}
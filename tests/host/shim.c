@@ -0,0 +1,65 @@
+/**
+ * @file shim.c
+ * @brief Host replacements for the kernel services mm/ and lib/ depend on.
+ */
+
+#include "harness.h"
+
+#include <time.h>
+
+/* What smp_processor_id() returns; each stress-test thread sets its own */
+__thread int host_cpu;
+
+uint64_t shim_vmm_pages = 0;
+int shim_vmm_fail = 0;
+
+/**
+ * @brief Stub for the VMM: backs "virtual kernel memory" with page-aligned
+ * host memory. Never freed, exactly like the kernel's bump allocator.
+ */
+void *vmm_alloc(uint64_t pages, uint64_t flags)
+{
+    (void)flags;
+
+    if (shim_vmm_fail || pages == 0)
+        return NULL;
+
+    void *mem = NULL;
+    if (posix_memalign(&mem, 4096, pages * 4096) != 0)
+        return NULL;
+
+    shim_vmm_pages += pages;
+    return mem;
+}
+
+int shim_numa_node = 0;
+
+/**
+ * @brief Stub for mm/numa.c: the PMM asks which node the caller is on.
+ */
+int numa_mem_node(void)
+{
+    return shim_numa_node;
+}
+
+uint64_t host_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static uint64_t rand_state = 0x9E3779B97F4A7C15ULL;
+
+void host_srand(uint64_t seed)
+{
+    rand_state = seed ? seed : 0x9E3779B97F4A7C15ULL;
+}
+
+uint64_t host_rand(void)
+{
+    rand_state ^= rand_state >> 12;
+    rand_state ^= rand_state << 25;
+    rand_state ^= rand_state >> 27;
+    return rand_state * 0x2545F4914F6CDD1DULL;
+}
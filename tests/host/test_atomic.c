@@ -0,0 +1,109 @@
+/**
+ * @file test_atomic.c
+ * @brief Tests and benchmarks for the atomic_t wrappers in valen/atomic.h.
+ */
+
+#include "harness.h"
+
+#include <pthread.h>
+#include <valen/atomic.h>
+
+enum { THREADS = 4, ITERS = 200000 };
+
+static void test_atomic_ops(void)
+{
+    atomic_t v = ATOMIC_INIT(5);
+
+    CHECK_EQ(atomic_read(&v), 5);
+    atomic_add(3, &v);
+    atomic_sub(1, &v);
+    atomic_inc(&v);
+    CHECK_EQ(atomic_read(&v), 8);
+    CHECK_EQ(atomic_fetch_add(2, &v), 8);
+    CHECK_EQ(atomic_add_return(2, &v), 12);
+    CHECK_EQ(atomic_inc_return(&v), 13);
+    CHECK_EQ(atomic_dec_return(&v), 12);
+    CHECK_EQ(atomic_xchg(&v, 1), 12);
+    CHECK(atomic_dec_and_test(&v));
+
+    CHECK_EQ(atomic_cmpxchg(&v, 7, 9), 0);
+    CHECK_EQ(atomic_cmpxchg(&v, 0, 9), 0);
+    CHECK_EQ(atomic_read(&v), 9);
+
+    int old = 4;
+    CHECK(!atomic_try_cmpxchg(&v, &old, 10));
+    CHECK_EQ(old, 9);
+    CHECK(atomic_try_cmpxchg(&v, &old, 10));
+    CHECK_EQ(atomic_read(&v), 10);
+
+    atomic64_t w = ATOMIC64_INIT(1LL << 40);
+    atomic64_add(1, &w);
+    CHECK_EQ(atomic64_read(&w), (1LL << 40) + 1);
+    CHECK_EQ(atomic64_cmpxchg(&w, (1LL << 40) + 1, -1), (1LL << 40) + 1);
+    CHECK_EQ(atomic64_inc_return(&w), 0);
+}
+
+static atomic_t shared = ATOMIC_INIT(0);
+static atomic64_t shared64 = ATOMIC64_INIT(0);
+
+static void *inc_thread(void *arg)
+{
+    (void)arg;
+    for (int i = 0; i < ITERS; i++)
+    {
+        atomic_inc(&shared);
+        /* cmpxchg loop: the same pattern lock-free updates use */
+        int64_t old = atomic64_read(&shared64);
+        while (!atomic64_try_cmpxchg(&shared64, &old, old + 2))
+            ;
+    }
+    return NULL;
+}
+
+static void test_atomic_threads(void)
+{
+    pthread_t threads[THREADS];
+
+    atomic_set(&shared, 0);
+    atomic64_set(&shared64, 0);
+    for (int i = 0; i < THREADS; i++)
+        pthread_create(&threads[i], NULL, inc_thread, NULL);
+    for (int i = 0; i < THREADS; i++)
+        pthread_join(threads[i], NULL);
+
+    CHECK_EQ(atomic_read(&shared), THREADS * ITERS);
+    CHECK_EQ(atomic64_read(&shared64), 2LL * THREADS * ITERS);
+}
+
+const struct test_case atomic_tests[] = {
+    {"atomic: single-threaded ops", test_atomic_ops},
+    {"atomic: contended inc and cmpxchg", test_atomic_threads},
+    {NULL, NULL},
+};
+
+static void bench_atomic(void)
+{
+    enum { OPS = 1 << 24 };
+    atomic_t v = ATOMIC_INIT(0);
+
+    uint64_t t0 = host_now_ns();
+    for (int i = 0; i < OPS; i++)
+        atomic_inc(&v);
+    uint64_t inc_ns = host_now_ns() - t0;
+
+    t0 = host_now_ns();
+    for (int i = 0; i < OPS; i++)
+    {
+        int old = atomic_read(&v);
+        atomic_try_cmpxchg(&v, &old, old + 1);
+    }
+    uint64_t cas_ns = host_now_ns() - t0;
+
+    BENCH_REPORT("atomic_inc", "ops=%d ns_per_op=%.2f", OPS, (double)inc_ns / OPS);
+    BENCH_REPORT("atomic_try_cmpxchg", "ops=%d ns_per_op=%.2f", OPS, (double)cas_ns / OPS);
+}
+
+const struct bench_case atomic_benches[] = {
+    {"atomic", bench_atomic},
+    {NULL, NULL},
+};
@@ -0,0 +1,273 @@
+/**
+ * @file test_bitmap.c
+ * @brief Correctness tests, fuzzer and benchmarks for lib/bitmap.c.
+ *
+ * The fuzzer keeps a byte-per-bit copy of the map and checks every
+ * search and count against a plain loop over it.
+ */
+
+#include "harness.h"
+
+#include <valen/bitmap.h>
+
+static void test_word_ops(void)
+{
+    for (int i = 0; i < 64; i++)
+    {
+        uint64_t w = 1ULL << i;
+        CHECK_EQ(__ffs(w), (unsigned)i);
+        CHECK_EQ(__fls(w), (unsigned)i);
+        CHECK_EQ(ffz(~w), (unsigned)i);
+        CHECK_EQ(__ffs(w | (1ULL << 63)), (unsigned)i);
+    }
+
+    for (int i = 0; i < 1000; i++)
+    {
+        uint64_t w = host_rand();
+        CHECK_EQ(hweight64(w), (unsigned)__builtin_popcountll(w));
+        CHECK_EQ(__sw_hweight64(w), (unsigned)__builtin_popcountll(w));
+    }
+    CHECK_EQ(hweight64(0), 0);
+    CHECK_EQ(hweight64(~0ULL), 64);
+}
+
+static void test_bit_ops(void)
+{
+    DECLARE_BITMAP(map, 130);
+
+    CHECK_EQ(sizeof(map), 3 * sizeof(uint64_t));
+    bitmap_zero(map, 130);
+    __set_bit(0, map);
+    __set_bit(64, map);
+    set_bit(129, map);
+    CHECK(test_bit(0, map) && test_bit(64, map) && test_bit(129, map));
+    CHECK(!test_bit(1, map) && !test_bit(63, map) && !test_bit(128, map));
+    CHECK_EQ(map[2], 2);
+
+    CHECK(!test_and_set_bit(100, map));
+    CHECK(test_and_set_bit(100, map));
+    CHECK(test_and_clear_bit(100, map));
+    CHECK(!test_and_clear_bit(100, map));
+    clear_bit(129, map);
+    __clear_bit(64, map);
+    CHECK_EQ(map[1], 0);
+    CHECK_EQ(map[2], 0);
+    CHECK_EQ(bitmap_weight(map, 130), 1);
+
+    bitmap_fill(map, 130);
+    CHECK_EQ(bitmap_weight(map, 130), 130);
+    CHECK_EQ(find_first_zero_bit(map, 130), 130);
+}
+
+static void test_find(void)
+{
+    DECLARE_BITMAP(map, 200);
+    uint64_t bit, n = 0;
+
+    bitmap_zero(map, 200);
+    CHECK_EQ(find_first_bit(map, 200), 200);
+    CHECK_EQ(find_first_zero_bit(map, 200), 0);
+    CHECK_EQ(find_next_bit(map, 200, 250), 200);
+
+    __set_bit(3, map);
+    __set_bit(64, map);
+    __set_bit(199, map);
+    CHECK_EQ(find_first_bit(map, 200), 3);
+    CHECK_EQ(find_next_bit(map, 200, 4), 64);
+    CHECK_EQ(find_next_bit(map, 200, 65), 199);
+    CHECK_EQ(find_next_bit(map, 199, 65), 199); /* Past size: not found */
+    CHECK_EQ(find_next_bit(map, 200, 200), 200);
+
+    for_each_set_bit(bit, map, 200)
+        n += bit;
+    CHECK_EQ(n, 3 + 64 + 199);
+
+    /* Bits past size in the last word must not be reported */
+    bitmap_fill(map, 200);
+    __clear_bit(150, map);
+    CHECK_EQ(find_first_zero_bit(map, 200), 150);
+    CHECK_EQ(find_next_zero_bit(map, 200, 151), 200);
+    CHECK_EQ(find_first_zero_bit(map, 140), 140);
+}
+
+static void test_ranges(void)
+{
+    DECLARE_BITMAP(map, 256);
+
+    bitmap_zero(map, 256);
+    bitmap_set(map, 60, 10);
+    CHECK_EQ(map[0], 0xFULL << 60);
+    CHECK_EQ(map[1], 0x3FULL);
+    bitmap_set(map, 64, 128);
+    CHECK_EQ(map[1], ~0ULL);
+    CHECK_EQ(map[2], ~0ULL);
+    CHECK_EQ(map[3], 0);
+    CHECK_EQ(bitmap_weight(map, 256), 132);
+    CHECK_EQ(bitmap_weight_range(map, 62, 66), 4);
+    CHECK_EQ(bitmap_weight_range(map, 66, 66), 0);
+
+    bitmap_clear(map, 61, 130);
+    CHECK_EQ(map[0], 1ULL << 60);
+    CHECK_EQ(map[1], 0);
+    CHECK_EQ(map[2], 1ULL << 63);
+    bitmap_set(map, 5, 0);
+    bitmap_clear(map, 5, 0);
+    CHECK_EQ(bitmap_weight(map, 256), 2);
+}
+
+static void test_zero_area(void)
+{
+    DECLARE_BITMAP(map, 256);
+
+    bitmap_fill(map, 256);
+    CHECK_EQ(bitmap_find_next_zero_area(map, 256, 0, 1, 0), 256);
+
+    bitmap_clear(map, 10, 5);   /* 10..14 */
+    bitmap_clear(map, 20, 20);  /* 20..39 */
+    bitmap_clear(map, 250, 6);  /* 250..255 */
+    CHECK_EQ(bitmap_find_next_zero_area(map, 256, 0, 5, 0), 10);
+    CHECK_EQ(bitmap_find_next_zero_area(map, 256, 0, 6, 0), 20);
+    CHECK_EQ(bitmap_find_next_zero_area(map, 256, 11, 4, 0), 11);
+    CHECK_EQ(bitmap_find_next_zero_area(map, 256, 0, 8, 15), 32);
+    CHECK_EQ(bitmap_find_next_zero_area(map, 256, 0, 16, 15), 256);
+    CHECK_EQ(bitmap_find_next_zero_area(map, 256, 41, 6, 0), 250);
+    CHECK_EQ(bitmap_find_next_zero_area(map, 256, 41, 7, 0), 256);
+    CHECK_EQ(bitmap_find_next_zero_area(map, 255, 41, 6, 0), 255);
+}
+
+/* --- Fuzzer --- */
+
+#define FUZZ_BITS 1000
+
+static uint64_t ref_find(const uint8_t *ref, uint64_t size, uint64_t start, int value)
+{
+    for (uint64_t i = start; i < size; i++)
+        if (ref[i] == value)
+            return i;
+    return size;
+}
+
+static uint64_t ref_zero_area(const uint8_t *ref, uint64_t size, uint64_t start, uint64_t nr,
+                              uint64_t align)
+{
+    for (uint64_t i = (start + align - 1) / align * align; i + nr <= size; i += align)
+    {
+        uint64_t k = 0;
+        while (k < nr && !ref[i + k])
+            k++;
+        if (k == nr)
+            return i;
+    }
+    return size;
+}
+
+static void test_fuzz(void)
+{
+    DECLARE_BITMAP(map, FUZZ_BITS);
+    uint8_t ref[FUZZ_BITS] = {0};
+
+    bitmap_zero(map, FUZZ_BITS);
+    for (int op = 0; op < 20000; op++)
+    {
+        uint64_t a = host_rand() % FUZZ_BITS;
+        uint64_t len = host_rand() % 4 == 0 ? host_rand() % 200 : host_rand() % 8;
+        if (a + len > FUZZ_BITS)
+            len = FUZZ_BITS - a;
+        /* Size below the map's, to check the tail is ignored */
+        uint64_t size = FUZZ_BITS - host_rand() % 70;
+
+        switch (host_rand() % 6)
+        {
+        case 0:
+            bitmap_set(map, a, len);
+            for (uint64_t i = a; i < a + len; i++)
+                ref[i] = 1;
+            break;
+        case 1:
+            bitmap_clear(map, a, len);
+            for (uint64_t i = a; i < a + len; i++)
+                ref[i] = 0;
+            break;
+        case 2:
+            CHECK_EQ(find_next_bit(map, size, a), ref_find(ref, size, a, 1));
+            CHECK_EQ(find_next_zero_bit(map, size, a), ref_find(ref, size, a, 0));
+            break;
+        case 3:
+        {
+            uint64_t w = 0;
+            for (uint64_t i = a; i < a + len; i++)
+                w += ref[i];
+            CHECK_EQ(bitmap_weight_range(map, a, a + len), w);
+            break;
+        }
+        case 4:
+        {
+            uint64_t align = 1ULL << (host_rand() % 7);
+            uint64_t nr = 1 + host_rand() % 40;
+            CHECK_EQ(bitmap_find_next_zero_area(map, size, a, nr, align - 1),
+                     ref_zero_area(ref, size, a, nr, align));
+            break;
+        }
+        default:
+            CHECK_EQ(test_bit(a, map), ref[a]);
+            break;
+        }
+    }
+}
+
+const struct test_case bitmap_tests[] = {
+    {"bitmap: ffs, fls, ffz and hweight", test_word_ops},
+    {"bitmap: single-bit ops", test_bit_ops},
+    {"bitmap: find next set and clear", test_find},
+    {"bitmap: set, clear and weight ranges", test_ranges},
+    {"bitmap: find zero area", test_zero_area},
+    {"bitmap: fuzz against a byte array", test_fuzz},
+    {NULL, NULL},
+};
+
+/* 4GB of frames, 7/8 used in scattered runs: the PMM's worst case */
+#define BENCH_BITS (1ULL << 20)
+
+static void bench_bitmap(void)
+{
+    uint64_t *map = malloc(BITS_TO_LONGS(BENCH_BITS) * sizeof(uint64_t));
+    enum { ROUNDS = 64 };
+
+    bitmap_fill(map, BENCH_BITS);
+    for (int i = 0; i < 2048; i++)
+        bitmap_clear(map, host_rand() % (BENCH_BITS - 64), 1 + host_rand() % 32);
+
+    uint64_t sink = 0;
+    uint64_t t0 = host_now_ns();
+    for (int r = 0; r < ROUNDS; r++)
+    {
+        uint64_t bit;
+        for_each_clear_bit(bit, map, BENCH_BITS)
+            sink += bit;
+    }
+    uint64_t scan_ns = host_now_ns() - t0;
+
+    t0 = host_now_ns();
+    for (int r = 0; r < ROUNDS; r++)
+        sink += bitmap_find_next_zero_area(map, BENCH_BITS, r, 512, 511);
+    uint64_t area_ns = host_now_ns() - t0;
+
+    t0 = host_now_ns();
+    for (int r = 0; r < ROUNDS; r++)
+        sink += bitmap_weight(map, BENCH_BITS);
+    uint64_t weight_ns = host_now_ns() - t0;
+
+    double gb = (double)BENCH_BITS / 8 * ROUNDS;
+    BENCH_REPORT("bitmap_for_each_clear", "bits=%llu gbps=%.2f sink=%llu",
+                 (unsigned long long)BENCH_BITS, gb / scan_ns, (unsigned long long)(sink & 1));
+    BENCH_REPORT("bitmap_zero_area_2mb", "bits=%llu ns_per_op=%.0f", (unsigned long long)BENCH_BITS,
+                 (double)area_ns / ROUNDS);
+    BENCH_REPORT("bitmap_weight", "bits=%llu gbps=%.2f", (unsigned long long)BENCH_BITS,
+                 gb / weight_ns);
+    free(map);
+}
+
+const struct bench_case bitmap_benches[] = {
+    {"bitmap", bench_bitmap},
+    {NULL, NULL},
+};
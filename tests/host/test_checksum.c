@@ -0,0 +1,100 @@
+/**
+ * @file test_checksum.c
+ * @brief Tests, a fuzzer and benchmarks for lib/checksum.c.
+ */
+
+#include "harness.h"
+
+#include <valen/checksum.h>
+
+/** @brief RFC 1071, 16 bits at a time. */
+static uint16_t csum_ref(const uint8_t *p, uint64_t len)
+{
+    uint64_t sum = 0;
+
+    for (; len >= 2; p += 2, len -= 2)
+        sum += p[0] | (p[1] << 8);
+    if (len)
+        sum += p[0];
+    while (sum >> 16)
+        sum = (sum & 0xFFFF) + (sum >> 16);
+    return (uint16_t)~sum;
+}
+
+static void test_csum_ipv4_header(void)
+{
+    /* The header from RFC 1071's example traffic, checksum field zeroed */
+    uint8_t hdr[20] = {0x45, 0x00, 0x00, 0x73, 0x00, 0x00, 0x40, 0x00, 0x40, 0x11,
+                       0x00, 0x00, 0xC0, 0xA8, 0x00, 0x01, 0xC0, 0xA8, 0x00, 0xC7};
+
+    uint16_t csum = ip_compute_csum(hdr, sizeof(hdr));
+    /* Stored as is, the sum is in network order: b8 61 */
+    CHECK_EQ(csum, 0x61B8);
+
+    hdr[10] = csum & 0xFF;
+    hdr[11] = csum >> 8;
+    CHECK_EQ(ip_compute_csum(hdr, sizeof(hdr)), 0);
+}
+
+static void test_csum_fuzz(void)
+{
+    static uint8_t buf[4096 + 16];
+
+    for (uint64_t i = 0; i < sizeof(buf); i++)
+        buf[i] = host_rand();
+    /* All-ones words stress the carries */
+    for (uint64_t i = 2048; i < 2048 + 512; i++)
+        buf[i] = 0xFF;
+
+    for (int i = 0; i < 3000; i++)
+    {
+        uint64_t off = host_rand() % 16;
+        uint64_t len = host_rand() % 2 ? host_rand() % 4096 : host_rand() % 80;
+
+        CHECK_EQ(ip_compute_csum(buf + off, len), csum_ref(buf + off, len));
+
+        /* Even-length pieces chain, starting from any partial sum */
+        uint64_t cut = (host_rand() % (len + 1)) & ~1ULL;
+        uint32_t part = csum_partial(buf + off, cut, 0);
+        CHECK_EQ(csum_fold(csum_partial(buf + off + cut, len - cut, part)),
+                 csum_ref(buf + off, len));
+        CHECK_EQ(csum_fold(csum_add(part, csum_partial(buf + off + cut, len - cut, 0))),
+                 csum_ref(buf + off, len));
+    }
+}
+
+const struct test_case checksum_tests[] = {
+    {"checksum: IPv4 header", test_csum_ipv4_header},
+    {"checksum: chaining fuzz against RFC 1071", test_csum_fuzz},
+    {NULL, NULL},
+};
+
+static void bench_checksum(void)
+{
+    static uint8_t buf[1500];
+    enum { ROUNDS = 1 << 18 };
+    uint32_t sink = 0;
+
+    for (uint64_t i = 0; i < sizeof(buf); i++)
+        buf[i] = i;
+
+    /* One Ethernet frame's worth of payload */
+    uint64_t t0 = host_now_ns();
+    for (int r = 0; r < ROUNDS; r++)
+        sink += csum_partial(buf, sizeof(buf), r);
+    uint64_t ns = host_now_ns() - t0;
+
+    t0 = host_now_ns();
+    for (int r = 0; r < ROUNDS; r++)
+        sink += csum_ref(buf, sizeof(buf));
+    uint64_t ref_ns = host_now_ns() - t0;
+
+    BENCH_REPORT("csum_partial_1500", "gbps=%.2f sink=%u", (double)ROUNDS * sizeof(buf) / ns,
+                 sink & 1);
+    BENCH_REPORT("csum_16bit_loop_1500", "gbps=%.2f", (double)ROUNDS * sizeof(buf) / ref_ns);
+}
+
+const struct bench_case checksum_benches[] = {
+    {"checksum", bench_checksum},
+    {NULL, NULL},
+};
@@ -0,0 +1,146 @@
+/**
+ * @file test_crc32c.c
+ * @brief Known-answer tests, a fuzzer and benchmarks for lib/crc32c.c.
+ *
+ * crc32c() itself takes the table path here (alternatives are never
+ * patched on the host); the hardware variant is called directly when the
+ * host CPU has SSE4.2.
+ */
+
+#include "harness.h"
+
+#include <stdbool.h>
+#include <valen/crc32c.h>
+
+static bool host_has_sse42(void)
+{
+    return __builtin_cpu_supports("sse4.2");
+}
+
+/** @brief Bit at a time: the definition, too slow for anything else. */
+static uint32_t crc32c_bitwise(uint32_t crc, const uint8_t *p, uint64_t len)
+{
+    crc = ~crc;
+    while (len--)
+    {
+        crc ^= *p++;
+        for (int k = 0; k < 8; k++)
+            crc = (crc >> 1) ^ (0x82F63B78U & -(crc & 1));
+    }
+    return ~crc;
+}
+
+static void fill(uint8_t *buf, uint64_t len)
+{
+    for (uint64_t i = 0; i < len; i++)
+        buf[i] = (uint8_t)(i * 31 + 7);
+}
+
+static void test_crc32c_known(void)
+{
+    static const struct
+    {
+        uint64_t len;
+        uint32_t crc;
+    } vectors[] = {
+        {0, 0x00000000}, {1, 0x86B737BA},   {3, 0x765A7C83},   {7, 0x5110A112},
+        {8, 0x40795C72}, {31, 0x17430993},  {32, 0x9AC661B0},  {33, 0xD7082B08},
+        {100, 0xE26C441C}, {255, 0x0FD95F5E}, {1000, 0xFF52EE97}, {4096, 0xE1C2F7E8},
+    };
+    static uint8_t buf[4096];
+
+    crc32c_init();
+    CHECK_EQ(crc32c(0, "123456789", 9), 0xE3069283);
+    CHECK_EQ(__crc32c_sw(0, "123456789", 9), 0xE3069283);
+
+    fill(buf, sizeof(buf));
+    for (size_t i = 0; i < sizeof(vectors) / sizeof(vectors[0]); i++)
+    {
+        CHECK_EQ(__crc32c_sw(0, buf, vectors[i].len), vectors[i].crc);
+        if (host_has_sse42())
+            CHECK_EQ(__crc32c_hw(0, buf, vectors[i].len), vectors[i].crc);
+    }
+}
+
+static void test_crc32c_chain_combine(void)
+{
+    static uint8_t buf[10000];
+
+    crc32c_init();
+    fill(buf, sizeof(buf));
+    uint32_t whole = __crc32c_sw(0, buf, sizeof(buf));
+
+    for (int i = 0; i < 200; i++)
+    {
+        uint64_t cut = host_rand() % (sizeof(buf) + 1);
+        uint32_t a = __crc32c_sw(0, buf, cut);
+        uint32_t b = __crc32c_sw(0, buf + cut, sizeof(buf) - cut);
+
+        CHECK_EQ(__crc32c_sw(a, buf + cut, sizeof(buf) - cut), whole);
+        CHECK_EQ(crc32c_combine(a, b, sizeof(buf) - cut), whole);
+    }
+}
+
+static void test_crc32c_fuzz(void)
+{
+    static uint8_t buf[8192 + 16];
+
+    crc32c_init();
+    for (uint64_t i = 0; i < sizeof(buf); i++)
+        buf[i] = host_rand();
+
+    /* Every length class of the hardware path: 3-way long and short
+     * lanes, words and bytes, at every alignment */
+    for (int i = 0; i < 2000; i++)
+    {
+        uint64_t off = host_rand() % 16;
+        uint64_t len = host_rand() % 4 == 0 ? host_rand() % 8192 : host_rand() % 64;
+        uint32_t seed = i & 1 ? (uint32_t)host_rand() : 0;
+        uint32_t ref = crc32c_bitwise(seed, buf + off, len);
+
+        CHECK_EQ(__crc32c_sw(seed, buf + off, len), ref);
+        if (host_has_sse42())
+            CHECK_EQ(__crc32c_hw(seed, buf + off, len), ref);
+    }
+}
+
+const struct test_case crc32c_tests[] = {
+    {"crc32c: known answers", test_crc32c_known},
+    {"crc32c: chaining and combine", test_crc32c_chain_combine},
+    {"crc32c: fuzz against a bitwise CRC", test_crc32c_fuzz},
+    {NULL, NULL},
+};
+
+static void bench_one(const char *name, uint32_t (*fn)(uint32_t, const void *, uint64_t),
+                      uint64_t len)
+{
+    static uint8_t buf[65536];
+    uint64_t rounds = (256ULL << 20) / len;
+    uint32_t crc = 0;
+
+    fill(buf, len);
+    uint64_t t0 = host_now_ns();
+    for (uint64_t r = 0; r < rounds; r++)
+        crc = fn(crc, buf, len);
+    uint64_t ns = host_now_ns() - t0;
+
+    BENCH_REPORT(name, "len=%llu gbps=%.2f crc=%08x", (unsigned long long)len,
+                 (double)(rounds * len) / ns, crc);
+}
+
+static void bench_crc32c(void)
+{
+    crc32c_init();
+    bench_one("crc32c_sw_64", __crc32c_sw, 64);
+    bench_one("crc32c_sw_4096", __crc32c_sw, 4096);
+    if (!host_has_sse42())
+        return;
+    bench_one("crc32c_hw_64", __crc32c_hw, 64);
+    bench_one("crc32c_hw_4096", __crc32c_hw, 4096);
+    bench_one("crc32c_hw_65536", __crc32c_hw, 65536);
+}
+
+const struct bench_case crc32c_benches[] = {
+    {"crc32c", bench_crc32c},
+    {NULL, NULL},
+};
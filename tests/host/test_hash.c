@@ -0,0 +1,135 @@
+/**
+ * @file test_hash.c
+ * @brief Known-answer tests and benchmarks for lib/xxhash.c and
+ * lib/siphash.c.
+ */
+
+#include "harness.h"
+
+#include <valen/xxhash.h>
+#include <valen/siphash.h>
+
+static void fill(uint8_t *buf, uint64_t len)
+{
+    for (uint64_t i = 0; i < len; i++)
+        buf[i] = (uint8_t)(i * 31 + 7);
+}
+
+/* Reference outputs for the fill() pattern; lengths cover every tail path */
+static const struct
+{
+    uint64_t len;
+    uint64_t xxh_seed0;
+    uint64_t xxh_seed;
+    uint64_t sip;
+} vectors[] = {
+    {0, 0xEF46DB3751D8E999, 0xC4349FC93C010000, 0x726FDB47DD0E0E31},
+    {1, 0xA96C7F0CE858BBB7, 0x585882422A6165E7, 0xE53C134F96DBA15D},
+    {3, 0x56E6957632A487F9, 0x5ACB303E78133C22, 0xC8D488EE539EE971},
+    {7, 0xAFBEFC3D6C6F9A8E, 0x2CE9ADEC2B2C8104, 0x43B14A8FED8CA51E},
+    {8, 0x3DA5C7AA269683E0, 0x758848F033FA76A2, 0x959BBC8A2CCD1F48},
+    {31, 0x4A74F3A1A39AD4A1, 0x8137041F5AF88413, 0x7ABD9380078249C4},
+    {32, 0x8D57D6A4671CC43D, 0x184EBCF3745CD46C, 0x4B1990B93A53E1E6},
+    {33, 0x62C9FD21ED857664, 0x52FAC3C981F3CC2E, 0x54EE93E423613C2B},
+    {100, 0xEFA0AD2D3E70C151, 0xBC7AB33BE7528C18, 0x385C26EC82256998},
+    {255, 0x2C3DB4BB567F731E, 0x76DC2BA578C894B9, 0x0DDE1EF1BDC265DF},
+    {1000, 0x99594F4828043D35, 0xDA717F741F399F3F, 0x82369C4DB07A6D1A},
+    {4096, 0xE21174BE82DC78D9, 0xE4D8CED124DF0294, 0xE7DB71C0159AB2A1},
+};
+
+#define XXH_SEED 0x9E3779B97F4A7C15ULL
+
+/* Key 00 01 .. 0f, as in the SipHash paper */
+static const siphash_key_t sip_key = {{0x0706050403020100ULL, 0x0F0E0D0C0B0A0908ULL}};
+
+static void test_xxh64(void)
+{
+    static uint8_t buf[4096 + 8];
+
+    CHECK_EQ(xxh64("abc", 3, 0), 0x44BC2CF5AD770999ULL);
+
+    fill(buf, 4096);
+    for (size_t i = 0; i < sizeof(vectors) / sizeof(vectors[0]); i++)
+    {
+        CHECK_EQ(xxh64(buf, vectors[i].len, 0), vectors[i].xxh_seed0);
+        CHECK_EQ(xxh64(buf, vectors[i].len, XXH_SEED), vectors[i].xxh_seed);
+    }
+
+    /* Alignment must not matter */
+    memmove(buf + 3, buf, 4096);
+    CHECK_EQ(xxh64(buf + 3, 1000, 0), 0x99594F4828043D35ULL);
+}
+
+static void test_siphash(void)
+{
+    static uint8_t buf[4096];
+    uint8_t seq[64];
+
+    /* First, second, 16th and last vectors of the reference vectors.h */
+    for (int i = 0; i < 64; i++)
+        seq[i] = i;
+    CHECK_EQ(siphash(seq, 0, &sip_key), 0x726FDB47DD0E0E31ULL);
+    CHECK_EQ(siphash(seq, 1, &sip_key), 0x74F839C593DC67FDULL);
+    CHECK_EQ(siphash(seq, 15, &sip_key), 0xA129CA6149BE45E5ULL);
+    CHECK_EQ(siphash(seq, 63, &sip_key), 0x958A324CEB064572ULL);
+
+    fill(buf, sizeof(buf));
+    for (size_t i = 0; i < sizeof(vectors) / sizeof(vectors[0]); i++)
+        CHECK_EQ(siphash(buf, vectors[i].len, &sip_key), vectors[i].sip);
+
+    /* The fixed-size variants hash the same bytes */
+    uint64_t words[2] = {0x1122334455667788ULL, 0x99AABBCCDDEEFF00ULL};
+    CHECK_EQ(siphash_1u64(words[0], &sip_key), siphash(words, 8, &sip_key));
+    CHECK_EQ(siphash_2u64(words[0], words[1], &sip_key), siphash(words, 16, &sip_key));
+
+    /* A different key gives a different hash */
+    siphash_key_t other = sip_key;
+    other.key[1] ^= 1;
+    CHECK(siphash(buf, 100, &other) != siphash(buf, 100, &sip_key));
+}
+
+const struct test_case hash_tests[] = {
+    {"hash: xxh64 known answers", test_xxh64},
+    {"hash: siphash known answers", test_siphash},
+    {NULL, NULL},
+};
+
+static void bench_hash(void)
+{
+    static uint8_t buf[4096];
+    enum { ROUNDS = 1 << 16, KEYS = 1 << 22 };
+    uint64_t sink = 0;
+
+    fill(buf, sizeof(buf));
+    uint64_t t0 = host_now_ns();
+    for (int r = 0; r < ROUNDS; r++)
+        sink += xxh64(buf, sizeof(buf), r);
+    uint64_t xxh_ns = host_now_ns() - t0;
+
+    t0 = host_now_ns();
+    for (int r = 0; r < ROUNDS / 4; r++)
+        sink += siphash(buf, sizeof(buf), &sip_key);
+    uint64_t sip_ns = host_now_ns() - t0;
+
+    /* Hash-table shape: one integer key per call */
+    t0 = host_now_ns();
+    for (uint64_t k = 0; k < KEYS; k++)
+        sink += siphash_1u64(k, &sip_key);
+    uint64_t sip1_ns = host_now_ns() - t0;
+
+    t0 = host_now_ns();
+    for (uint64_t k = 0; k < KEYS; k++)
+        sink += xxh64(&k, 8, 0);
+    uint64_t xxh1_ns = host_now_ns() - t0;
+
+    BENCH_REPORT("xxh64_4096", "gbps=%.2f sink=%llu", (double)ROUNDS * sizeof(buf) / xxh_ns,
+                 (unsigned long long)(sink & 1));
+    BENCH_REPORT("siphash_4096", "gbps=%.2f", (double)ROUNDS / 4 * sizeof(buf) / sip_ns);
+    BENCH_REPORT("siphash_1u64", "ns_per_op=%.2f", (double)sip1_ns / KEYS);
+    BENCH_REPORT("xxh64_8", "ns_per_op=%.2f", (double)xxh1_ns / KEYS);
+}
+
+const struct bench_case hash_benches[] = {
+    {"hash", bench_hash},
+    {NULL, NULL},
+};
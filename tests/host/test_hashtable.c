@@ -0,0 +1,162 @@
+/**
+ * @file test_hashtable.c
+ * @brief Correctness tests, fuzzer and benchmarks for lib/hashtable.c.
+ *
+ * Bucket arrays come from the kernel heap, so every test starts with
+ * heap_init().
+ */
+
+#include "harness.h"
+
+#include <valen/hashtable.h>
+#include <valen/heap.h>
+
+struct entry
+{
+    struct htable_node node;
+    int value;
+};
+
+static void test_basic(void)
+{
+    struct htable ht;
+    struct entry e[3] = {{.value = 1}, {.value = 2}, {.value = 3}};
+
+    heap_init();
+    CHECK_EQ(htable_init(&ht, 0), 0);
+    CHECK_EQ(ht.bits, HTABLE_LOCK_BITS);
+
+    CHECK_EQ(htable_insert(&ht, &e[0].node, 10), 0);
+    CHECK_EQ(htable_insert(&ht, &e[1].node, 20), 0);
+    CHECK_EQ(htable_insert(&ht, &e[2].node, 10), -1);
+    CHECK_EQ(htable_count(&ht), 2);
+
+    struct htable_node *n = htable_lookup(&ht, 20);
+    CHECK(n != NULL);
+    CHECK_EQ(htable_entry(n, struct entry, node)->value, 2);
+    CHECK(htable_lookup(&ht, 30) == NULL);
+
+    CHECK(htable_remove(&ht, 10) == &e[0].node);
+    CHECK(htable_remove(&ht, 10) == NULL);
+    CHECK(htable_lookup(&ht, 10) == NULL);
+    CHECK_EQ(htable_count(&ht), 1);
+    htable_destroy(&ht);
+}
+
+static void count_node(struct htable_node *node, void *arg)
+{
+    (void)node;
+    (*(int *)arg)++;
+}
+
+static void test_resize(void)
+{
+    enum { N = 5000 };
+    static struct entry e[N];
+    struct htable ht;
+
+    heap_init();
+    CHECK_EQ(htable_init(&ht, 6), 0);
+    for (int i = 0; i < N; i++)
+        CHECK_EQ(htable_insert(&ht, &e[i].node, (uint64_t)i << 12), 0);
+
+    /* Grown to keep one entry per bucket or fewer */
+    CHECK((1ULL << ht.bits) >= N);
+    for (int i = 0; i < N; i++)
+        CHECK(htable_lookup(&ht, (uint64_t)i << 12) == &e[i].node);
+
+    int walked = 0;
+    htable_walk(&ht, count_node, &walked);
+    CHECK_EQ(walked, N);
+
+    for (int i = 0; i < N - 10; i++)
+        CHECK(htable_remove(&ht, (uint64_t)i << 12) == &e[i].node);
+    CHECK_EQ(ht.bits, 6);
+    for (int i = N - 10; i < N; i++)
+        CHECK(htable_lookup(&ht, (uint64_t)i << 12) == &e[i].node);
+    htable_destroy(&ht);
+}
+
+/**
+ * @brief Random operations on a small key space against a presence array.
+ */
+static void test_fuzz(void)
+{
+    enum { KEYS = 2048 };
+    static struct entry e[KEYS];
+    static int present[KEYS];
+    struct htable ht;
+    uint64_t count = 0;
+
+    heap_init();
+    memset(present, 0, sizeof(present));
+    CHECK_EQ(htable_init(&ht, 0), 0);
+    for (int iter = 0; iter < 100000; iter++)
+    {
+        int k = host_rand() % KEYS;
+        uint64_t key = (uint64_t)k * 0x100000001ULL;
+
+        switch (host_rand() % 3)
+        {
+        case 0:
+            CHECK_EQ(htable_insert(&ht, &e[k].node, key), present[k] ? -1 : 0);
+            count += !present[k];
+            present[k] = 1;
+            break;
+        case 1:
+            CHECK(htable_remove(&ht, key) == (present[k] ? &e[k].node : NULL));
+            count -= present[k];
+            present[k] = 0;
+            break;
+        default:
+            CHECK(htable_lookup(&ht, key) == (present[k] ? &e[k].node : NULL));
+        }
+        CHECK_EQ(htable_count(&ht), count);
+    }
+    htable_destroy(&ht);
+}
+
+const struct test_case hashtable_tests[] = {
+    {"hashtable: insert, lookup, remove", test_basic},
+    {"hashtable: grow and shrink", test_resize},
+    {"hashtable: fuzz against reference", test_fuzz},
+    {NULL, NULL},
+};
+
+static void bench_hashtable(void)
+{
+    enum { N = 1 << 20 };
+    struct entry *e = malloc(N * sizeof(*e));
+    uint64_t *keys = malloc(N * sizeof(*keys));
+    struct htable ht;
+
+    heap_init();
+    htable_init(&ht, 0);
+    for (int i = 0; i < N; i++)
+        keys[i] = host_rand();
+
+    uint64_t t0 = host_now_ns();
+    for (int i = 0; i < N; i++)
+        htable_insert(&ht, &e[i].node, keys[i]);
+    uint64_t t1 = host_now_ns();
+    int found = 0;
+    for (int i = 0; i < N; i++)
+        found += htable_lookup(&ht, keys[(uint32_t)i * 7919u % N]) != NULL;
+    uint64_t t2 = host_now_ns();
+    for (int i = 0; i < N; i++)
+        htable_remove(&ht, keys[i]);
+    uint64_t t3 = host_now_ns();
+
+    BENCH_REPORT("hashtable_insert", "n=%d ns_per_op=%.1f", N, (double)(t1 - t0) / N);
+    BENCH_REPORT("hashtable_lookup", "n=%d ns_per_op=%.1f found=%d", N, (double)(t2 - t1) / N,
+                 found);
+    BENCH_REPORT("hashtable_remove", "n=%d ns_per_op=%.1f", N, (double)(t3 - t2) / N);
+    htable_destroy(&ht);
+    free(keys);
+    free(e);
+}
+
+const struct bench_case hashtable_benches[] = {
+    {"hashtable", bench_hashtable},
+    {NULL, NULL},
+};
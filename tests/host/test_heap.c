@@ -0,0 +1,223 @@
+/**
+ * @file test_heap.c
+ * @brief Correctness tests, fuzzer and benchmarks for mm/heap.c.
+ *
+ * vmm_alloc() is stubbed by shim.c, so heap growth is backed by host
+ * memory and can be made to fail on demand.
+ */
+
+#include "harness.h"
+
+#include <valen/heap.h>
+
+static void test_zero_size(void)
+{
+    heap_init();
+    CHECK(valen_malloc(0) == NULL);
+    valen_free(NULL);
+}
+
+static void test_alignment_and_isolation(void)
+{
+    heap_init();
+    uint8_t *blocks[16];
+
+    for (int i = 0; i < 16; i++)
+    {
+        blocks[i] = valen_malloc(1 + i * 13);
+        CHECK(blocks[i] != NULL);
+        CHECK(((uintptr_t)blocks[i] & 7) == 0);
+        memset(blocks[i], i, 1 + i * 13);
+    }
+
+    for (int i = 0; i < 16; i++)
+    {
+        for (int j = 0; j < 1 + i * 13; j++)
+            CHECK_EQ(blocks[i][j], i);
+        valen_free(blocks[i]);
+    }
+}
+
+static void test_coalesce_reuses_space(void)
+{
+    heap_init();
+    heap_stats_t before, after;
+    void *blocks[64];
+
+    heap_get_stats(&before);
+    for (int i = 0; i < 64; i++)
+        blocks[i] = valen_malloc(64);
+    for (int i = 0; i < 64; i++)
+        valen_free(blocks[i]);
+    heap_get_stats(&after);
+
+    CHECK_EQ(after.nodes, 1);
+    CHECK_EQ(after.free_bytes, before.free_bytes);
+    CHECK_EQ(after.largest_free, before.largest_free);
+}
+
+static void test_large_allocation_grows(void)
+{
+    heap_init();
+    uint64_t pages = shim_vmm_pages;
+
+    uint8_t *big = valen_malloc(64 * 1024);
+    CHECK(big != NULL);
+    memset(big, 0xA5, 64 * 1024);
+
+    /* One expansion, sized for the request rather than one page at a time */
+    CHECK(shim_vmm_pages - pages <= 17);
+    valen_free(big);
+}
+
+static void test_growth_failure(void)
+{
+    heap_init();
+    shim_vmm_fail = 1;
+    void *p = valen_malloc(1 << 20);
+    shim_vmm_fail = 0;
+
+    CHECK(p == NULL);
+    CHECK(valen_malloc(32) != NULL);
+}
+
+static void test_foreign_pointer_ignored(void)
+{
+    heap_init();
+    uint64_t junk[8] = {0};
+    heap_stats_t before, after;
+
+    heap_get_stats(&before);
+    valen_free(&junk[4]);
+    heap_get_stats(&after);
+
+    CHECK_EQ(before.free_bytes, after.free_bytes);
+}
+
+/**
+ * @brief Random malloc/free mix; every block carries a fill pattern that
+ * must survive until it is freed.
+ */
+static void test_fuzz(void)
+{
+    heap_init();
+    struct
+    {
+        uint8_t *p;
+        uint64_t size;
+        uint8_t tag;
+    } live[256];
+    int nlive = 0;
+
+    for (int iter = 0; iter < 50000; iter++)
+    {
+        if (nlive < 256 && (nlive == 0 || host_rand() % 2))
+        {
+            uint64_t size = 1 + host_rand() % (host_rand() % 16 == 0 ? 9000 : 300);
+            uint8_t *p = valen_malloc(size);
+            CHECK(p != NULL);
+
+            uint8_t tag = (uint8_t)host_rand();
+            memset(p, tag, size);
+            live[nlive].p = p;
+            live[nlive].size = size;
+            live[nlive].tag = tag;
+            nlive++;
+        }
+        else
+        {
+            int victim = host_rand() % nlive;
+            for (uint64_t i = 0; i < live[victim].size; i++)
+                CHECK_EQ(live[victim].p[i], live[victim].tag);
+            valen_free(live[victim].p);
+            live[victim] = live[--nlive];
+        }
+    }
+
+    while (nlive)
+        valen_free(live[--nlive].p);
+}
+
+const struct test_case heap_tests[] = {
+    {"heap: zero-sized requests", test_zero_size},
+    {"heap: alignment and isolation", test_alignment_and_isolation},
+    {"heap: freed neighbours coalesce", test_coalesce_reuses_space},
+    {"heap: large allocations grow the heap", test_large_allocation_grows},
+    {"heap: growth failure returns NULL", test_growth_failure},
+    {"heap: foreign pointers are ignored", test_foreign_pointer_ignored},
+    {"heap: fuzz with fill patterns", test_fuzz},
+    {NULL, NULL},
+};
+
+/* --- Benchmarks --- */
+
+static void bench_fixed_size(void)
+{
+    static const uint64_t sizes[] = {16, 64, 256, 1024};
+    static void *blocks[1024];
+
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++)
+    {
+        heap_init();
+        uint64_t t0 = host_now_ns();
+        for (int round = 0; round < 16; round++)
+        {
+            for (int i = 0; i < 1024; i++)
+                blocks[i] = valen_malloc(sizes[s]);
+            for (int i = 1023; i >= 0; i--)
+                valen_free(blocks[i]);
+        }
+        uint64_t ns = host_now_ns() - t0;
+
+        char name[32];
+        snprintf(name, sizeof(name), "heap_fixed_%lu", (unsigned long)sizes[s]);
+        BENCH_REPORT(name, "ops=%d ns_per_op=%.1f", 16 * 1024 * 2, (double)ns / (16 * 1024 * 2));
+    }
+}
+
+/**
+ * @brief Fragmentation curve: steady-state random churn, sampling how much
+ * of the free space is still usable as one block.
+ */
+static void bench_fragmentation(void)
+{
+    heap_init();
+    static void *slots[512];
+    memset(slots, 0, sizeof(slots));
+
+    uint64_t t0 = host_now_ns();
+    for (int iter = 1; iter <= 65536; iter++)
+    {
+        int i = host_rand() % 512;
+        if (slots[i])
+        {
+            valen_free(slots[i]);
+            slots[i] = NULL;
+        }
+        else
+        {
+            slots[i] = valen_malloc(8 + host_rand() % 1024);
+        }
+
+        if ((iter & (iter - 1)) == 0 && iter >= 256)
+        {
+            heap_stats_t st;
+            heap_get_stats(&st);
+            double frag = st.free_bytes ? 1.0 - (double)st.largest_free / st.free_bytes : 0.0;
+            printf("BENCH host name=heap_frag ops=%d nodes=%lu free=%lu largest=%lu frag=%.3f\n",
+                   iter, (unsigned long)st.nodes, (unsigned long)st.free_bytes,
+                   (unsigned long)st.largest_free, frag);
+        }
+    }
+    uint64_t ns = host_now_ns() - t0;
+    BENCH_REPORT("heap_churn", "ops=65536 ns_per_op=%.1f", (double)ns / 65536);
+
+    for (int i = 0; i < 512; i++)
+        valen_free(slots[i]);
+}
+
+const struct bench_case heap_benches[] = {
+    {"heap_fixed", bench_fixed_size},
+    {"heap_fragmentation", bench_fragmentation},
+    {NULL, NULL},
+};
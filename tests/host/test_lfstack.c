@@ -0,0 +1,143 @@
+/**
+ * @file test_lfstack.c
+ * @brief Correctness tests, threaded stress test and benchmarks for
+ * lib/lfstack.c.
+ */
+
+#include "harness.h"
+
+#include <pthread.h>
+#include <valen/lfstack.h>
+
+struct item
+{
+    struct lfstack_node node;
+    uint32_t value;
+    uint32_t owner; /* Thread holding it, for the stress test */
+};
+
+static void test_lfstack_basic(void)
+{
+    struct lfstack stack = LFSTACK_INIT;
+    struct item items[4];
+
+    CHECK(lfstack_empty(&stack));
+    CHECK(lfstack_pop(&stack) == NULL);
+    CHECK(lfstack_pop_all(&stack) == NULL);
+
+    for (uint32_t i = 0; i < 4; i++)
+    {
+        items[i].value = i;
+        lfstack_push(&stack, &items[i].node);
+    }
+    CHECK(!lfstack_empty(&stack));
+
+    /* LIFO */
+    for (int i = 3; i >= 2; i--)
+    {
+        struct lfstack_node *n = lfstack_pop(&stack);
+        CHECK(n != NULL);
+        CHECK_EQ(lfstack_entry(n, struct item, node)->value, (uint32_t)i);
+    }
+
+    struct lfstack_node *chain = lfstack_pop_all(&stack);
+    CHECK(lfstack_empty(&stack));
+    CHECK(chain == &items[1].node);
+    CHECK(chain->next == &items[0].node);
+    CHECK(chain->next->next == NULL);
+
+    /* Every update bumps the generation */
+    CHECK_EQ(stack.gen, 7);
+}
+
+/* --- Threaded --- */
+
+enum { THREADS = 4, PER_THREAD = 256, ROUNDS = 200000 };
+
+static struct lfstack shared = LFSTACK_INIT;
+static struct item pool[THREADS * PER_THREAD];
+static uint64_t errors;
+
+/*
+ * Each thread pops a node, claims it, and pushes it back. With a plain
+ * pointer CAS, ABA would hand one node to two threads at once (or lose
+ * nodes); the owner field catches the former, the final count the latter.
+ */
+static void *churn_thread(void *arg)
+{
+    uint32_t id = (uint32_t)(uintptr_t)arg + 1;
+    uint64_t bad = 0;
+
+    for (int i = 0; i < ROUNDS; i++)
+    {
+        struct lfstack_node *n = lfstack_pop(&shared);
+        if (!n)
+            continue;
+        struct item *it = lfstack_entry(n, struct item, node);
+        if (__atomic_exchange_n(&it->owner, id, __ATOMIC_RELAXED) != 0)
+            bad++;
+        it->value++;
+        if (__atomic_exchange_n(&it->owner, 0, __ATOMIC_RELAXED) != id)
+            bad++;
+        lfstack_push(&shared, n);
+    }
+    __atomic_fetch_add(&errors, bad, __ATOMIC_RELAXED);
+    return NULL;
+}
+
+static void test_lfstack_threads(void)
+{
+    pthread_t threads[THREADS];
+
+    shared = (struct lfstack)LFSTACK_INIT;
+    errors = 0;
+    for (int i = 0; i < THREADS * PER_THREAD; i++)
+    {
+        pool[i].value = pool[i].owner = 0;
+        lfstack_push(&shared, &pool[i].node);
+    }
+
+    for (uintptr_t i = 0; i < THREADS; i++)
+        pthread_create(&threads[i], NULL, churn_thread, (void *)i);
+    for (int i = 0; i < THREADS; i++)
+        pthread_join(threads[i], NULL);
+
+    CHECK_EQ(errors, 0);
+
+    uint64_t count = 0, touched = 0;
+    for (struct lfstack_node *n = lfstack_pop_all(&shared); n; n = n->next)
+    {
+        count++;
+        touched += lfstack_entry(n, struct item, node)->value;
+    }
+    CHECK_EQ(count, THREADS * PER_THREAD);
+    CHECK(touched > 0 && touched <= (uint64_t)THREADS * ROUNDS);
+}
+
+const struct test_case lfstack_tests[] = {
+    {"lfstack: push and pop", test_lfstack_basic},
+    {"lfstack: threaded ABA check", test_lfstack_threads},
+    {NULL, NULL},
+};
+
+static void bench_lfstack(void)
+{
+    enum { OPS = 1 << 22 };
+    struct lfstack stack = LFSTACK_INIT;
+    struct item item;
+
+    uint64_t t0 = host_now_ns();
+    for (int i = 0; i < OPS; i++)
+    {
+        lfstack_push(&stack, &item.node);
+        lfstack_pop(&stack);
+    }
+    uint64_t ns = host_now_ns() - t0;
+
+    BENCH_REPORT("lfstack", "ops=%d ns_per_push_pop=%.2f", OPS, (double)ns / OPS);
+}
+
+const struct bench_case lfstack_benches[] = {
+    {"lfstack", bench_lfstack},
+    {NULL, NULL},
+};
@@ -0,0 +1,177 @@
+/**
+ * @file test_list.c
+ * @brief Tests and benchmark for the intrusive lists in include/valen/list.h.
+ */
+
+#include "harness.h"
+
+#include <valen/list.h>
+
+struct item
+{
+    int value;
+    struct list_head link;
+    struct hlist_node hlink;
+};
+
+static int collect(struct list_head *head, int *out, int max)
+{
+    struct item *it;
+    int n = 0;
+
+    list_for_each_entry(it, head, link)
+    {
+        if (n < max)
+            out[n] = it->value;
+        n++;
+    }
+    return n;
+}
+
+static void test_add_del(void)
+{
+    LIST_HEAD(head);
+    struct item items[4];
+    int got[8];
+
+    CHECK(list_empty(&head));
+    for (int i = 0; i < 4; i++)
+    {
+        items[i].value = i;
+        list_add_tail(&items[i].link, &head);
+    }
+    CHECK(!list_empty(&head));
+    CHECK_EQ(collect(&head, got, 8), 4);
+    for (int i = 0; i < 4; i++)
+        CHECK_EQ(got[i], i);
+
+    list_del(&items[0].link);
+    CHECK(items[0].link.next == NULL);
+    list_del_init(&items[2].link);
+    CHECK(list_empty(&items[2].link));
+    CHECK_EQ(collect(&head, got, 8), 2);
+    CHECK_EQ(got[0], 1);
+    CHECK_EQ(got[1], 3);
+
+    list_add(&items[2].link, &head);
+    CHECK(list_first_entry(&head, struct item, link) == &items[2]);
+    CHECK(list_last_entry(&head, struct item, link) == &items[3]);
+
+    /* Reverse order */
+    struct item *it;
+    int n = 0;
+    list_for_each_entry_reverse(it, &head, link)
+        got[n++] = it->value;
+    CHECK_EQ(n, 3);
+    CHECK_EQ(got[0], 3);
+    CHECK_EQ(got[2], 2);
+
+    list_del(&items[1].link);
+    list_del(&items[2].link);
+    CHECK(list_is_singular(&head));
+}
+
+static void test_move_splice(void)
+{
+    LIST_HEAD(a);
+    LIST_HEAD(b);
+    struct item items[6];
+    int got[8];
+
+    for (int i = 0; i < 6; i++)
+    {
+        items[i].value = i;
+        list_add_tail(&items[i].link, i < 3 ? &a : &b);
+    }
+
+    list_move_tail(&items[0].link, &a);
+    CHECK_EQ(collect(&a, got, 8), 3);
+    CHECK_EQ(got[0], 1);
+    CHECK_EQ(got[2], 0);
+
+    list_move(&items[5].link, &a);
+    CHECK(list_first_entry(&a, struct item, link) == &items[5]);
+
+    list_splice_init(&b, &a);
+    CHECK(list_empty(&b));
+    CHECK_EQ(collect(&a, got, 8), 6);
+    CHECK_EQ(got[0], 3);
+    CHECK_EQ(got[1], 4);
+    CHECK_EQ(got[2], 5);
+
+    /* Deleting while walking */
+    struct item *it, *next;
+    list_for_each_entry_safe(it, next, &a, link)
+    {
+        if (it->value % 2)
+            list_del(&it->link);
+    }
+    CHECK_EQ(collect(&a, got, 8), 3);
+    for (int i = 0; i < 3; i++)
+        CHECK_EQ(got[i] % 2, 0);
+}
+
+static void test_hlist(void)
+{
+    struct hlist_head head = HLIST_HEAD_INIT;
+    struct item items[3];
+    struct hlist_node *pos, *n;
+    int count = 0;
+
+    CHECK(hlist_empty(&head));
+    for (int i = 0; i < 3; i++)
+    {
+        items[i].value = i;
+        INIT_HLIST_NODE(&items[i].hlink);
+        CHECK(hlist_unhashed(&items[i].hlink));
+        hlist_add_head(&items[i].hlink, &head);
+    }
+    CHECK(hlist_entry(head.first, struct item, hlink) == &items[2]);
+
+    hlist_del_init(&items[1].hlink);
+    CHECK(hlist_unhashed(&items[1].hlink));
+    hlist_del_init(&items[1].hlink); /* Twice is harmless */
+
+    hlist_for_each(pos, &head)
+        count++;
+    CHECK_EQ(count, 2);
+
+    hlist_for_each_safe(pos, n, &head)
+        hlist_del_init(pos);
+    CHECK(hlist_empty(&head));
+}
+
+const struct test_case list_tests[] = {
+    {"list: add, delete, walk", test_add_del},
+    {"list: move and splice", test_move_splice},
+    {"list: hlist", test_hlist},
+    {NULL, NULL},
+};
+
+/**
+ * @brief LRU touches: move random entries to the tail of a long list.
+ */
+static void bench_lru(void)
+{
+    enum { N = 4096, OPS = 1 << 22 };
+    static struct item items[N];
+    static uint32_t picks[4096];
+    LIST_HEAD(lru);
+
+    for (int i = 0; i < N; i++)
+        list_add_tail(&items[i].link, &lru);
+    for (int i = 0; i < 4096; i++)
+        picks[i] = host_rand() % N;
+
+    uint64_t t0 = host_now_ns();
+    for (int i = 0; i < OPS; i++)
+        list_move_tail(&items[picks[i & 4095]].link, &lru);
+    uint64_t ns = host_now_ns() - t0;
+
+    BENCH_REPORT("list_lru_move", "ops=%d ns_per_op=%.2f", OPS, (double)ns / OPS);
+}
+
+const struct bench_case list_benches[] = {
+    {"list_lru", bench_lru},
+    {NULL, NULL},
+};
@@ -0,0 +1,273 @@
+/**
+ * @file test_lz4.c
+ * @brief Round trips, a reference block, a corruption fuzzer and
+ * benchmarks for lib/lz4.c.
+ */
+
+#include "harness.h"
+
+#include <valen/lz4.h>
+
+static uint32_t wrkmem[LZ4_MEM_COMPRESS / sizeof(uint32_t)];
+
+/* 171 bytes, and the block liblz4 1.9 (lz4 -1) makes of them */
+static const char ref_text[] =
+    "Valen is a small x86-64 kernel. Valen is a small kernel; a small kernel is a kernel. "
+    "abcabcabcabcabcabcabcabcabcabcabc"
+    "\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0\0"
+    "end of block.";
+
+static const uint8_t ref_block[] = {
+    0xFD, 0x11, 0x56, 0x61, 0x6C, 0x65, 0x6E, 0x20, 0x69, 0x73, 0x20, 0x61, 0x20, 0x73,
+    0x6D, 0x61, 0x6C, 0x6C, 0x20, 0x78, 0x38, 0x36, 0x2D, 0x36, 0x34, 0x20, 0x6B, 0x65,
+    0x72, 0x6E, 0x65, 0x6C, 0x2E, 0x20, 0x20, 0x00, 0x02, 0x19, 0x00, 0x15, 0x3B, 0x30,
+    0x00, 0x02, 0x10, 0x00, 0x02, 0x42, 0x00, 0x02, 0x0C, 0x00, 0x5F, 0x2E, 0x20, 0x61,
+    0x62, 0x63, 0x03, 0x00, 0x0B, 0x1F, 0x00, 0x01, 0x00, 0x14, 0xD0, 0x65, 0x6E, 0x64,
+    0x20, 0x6F, 0x66, 0x20, 0x62, 0x6C, 0x6F, 0x63, 0x6B, 0x2E,
+};
+
+#define REF_LEN (sizeof(ref_text) - 1)
+
+enum data_kind
+{
+    DATA_ZERO,
+    DATA_RANDOM,
+    DATA_TEXT,
+    DATA_PERIODIC,
+    DATA_MIXED,
+    DATA_KINDS,
+};
+
+/**
+ * @brief Fills buf with data of the given kind: incompressible, runs,
+ * words from a small vocabulary, a short repeating pattern, or all mixed.
+ */
+static void fill(uint8_t *buf, uint64_t len, enum data_kind kind)
+{
+    static const char *const words[] = {"the ", "page ", "frame ", "kernel ", "lock ", "of ",
+                                        "a ", "queue ", "task\n", "irq ", "0x1000 ", "\t"};
+    uint64_t period = 1 + host_rand() % 11;
+    uint64_t i = 0;
+
+    while (i < len)
+    {
+        enum data_kind k = kind == DATA_MIXED ? host_rand() % DATA_MIXED : kind;
+        uint64_t run = kind == DATA_MIXED ? 1 + host_rand() % 300 : len;
+
+        for (uint64_t end = i + run < len ? i + run : len; i < end;)
+        {
+            switch (k)
+            {
+            case DATA_ZERO:
+                buf[i++] = 0;
+                break;
+            case DATA_RANDOM:
+                buf[i++] = host_rand();
+                break;
+            case DATA_TEXT:
+                for (const char *w = words[host_rand() % 12]; *w && i < end; w++)
+                    buf[i++] = *w;
+                break;
+            default:
+                buf[i] = i >= period ? buf[i - period] : host_rand();
+                i++;
+                break;
+            }
+        }
+    }
+}
+
+/**
+ * @brief Compresses and decompresses len bytes of buf; the output must be
+ * the input again, and decompressing into one byte less must fail.
+ */
+static int round_trip(const uint8_t *buf, uint64_t len)
+{
+    uint64_t bound = LZ4_COMPRESS_BOUND(len);
+    uint8_t *comp = malloc(bound);
+    uint8_t *out = malloc(len + 1);
+    int ok = 0;
+
+    uint64_t clen = lz4_compress(buf, len, comp, bound, wrkmem);
+    if (clen > 0 && clen <= bound && lz4_decompress(comp, clen, out, len) == (int64_t)len &&
+        memcmp(out, buf, len) == 0)
+        ok = len == 0 || lz4_decompress(comp, clen, out, len - 1) == -1;
+
+    free(comp);
+    free(out);
+    return ok;
+}
+
+static void test_lz4_reference(void)
+{
+    uint8_t out[REF_LEN];
+    uint8_t comp[LZ4_COMPRESS_BOUND(REF_LEN)];
+
+    CHECK_EQ(lz4_decompress(ref_block, sizeof(ref_block), out, sizeof(out)), (int64_t)REF_LEN);
+    CHECK(memcmp(out, ref_text, REF_LEN) == 0);
+
+    /* Same hash and search as the reference's fast mode, so same bytes */
+    CHECK_EQ(lz4_compress(ref_text, REF_LEN, comp, sizeof(comp), wrkmem), sizeof(ref_block));
+    CHECK(memcmp(comp, ref_block, sizeof(ref_block)) == 0);
+
+    /* Empty input is a single empty-literals token */
+    CHECK_EQ(lz4_compress("", 0, comp, sizeof(comp), wrkmem), 1);
+    CHECK_EQ(comp[0], 0);
+    CHECK_EQ(lz4_decompress(comp, 1, out, 0), 0);
+    CHECK_EQ(lz4_decompress(comp, 0, out, sizeof(out)), -1);
+}
+
+static void test_lz4_round_trip(void)
+{
+    static uint8_t buf[300000];
+
+    host_srand(12);
+    for (int kind = 0; kind < DATA_KINDS; kind++)
+    {
+        /* Every length around the 13-byte minimum and the copy widths */
+        for (uint64_t len = 0; len < 100; len++)
+        {
+            fill(buf, len, kind);
+            CHECK(round_trip(buf, len));
+        }
+
+        /* A page, and more than the 64KB match window */
+        fill(buf, sizeof(buf), kind);
+        CHECK(round_trip(buf, 4096));
+        CHECK(round_trip(buf + 1, 4095));
+        CHECK(round_trip(buf, sizeof(buf)));
+    }
+
+    /* Long runs need several length extension bytes */
+    memset(buf, 'x', sizeof(buf));
+    CHECK(round_trip(buf, sizeof(buf)));
+    uint8_t comp[LZ4_COMPRESS_BOUND(4096)];
+    CHECK(lz4_compress(buf, 4096, comp, sizeof(comp), wrkmem) < 40);
+
+    /* Random data grows by no more than the bound allows */
+    fill(buf, 4096, DATA_RANDOM);
+    CHECK(lz4_compress(buf, 4096, comp, sizeof(comp), wrkmem) > 4096);
+}
+
+static void test_lz4_small_dst(void)
+{
+    static uint8_t buf[8192], comp[LZ4_COMPRESS_BOUND(8192)], out[8192];
+
+    host_srand(34);
+    for (int kind = 0; kind < DATA_KINDS; kind++)
+    {
+        fill(buf, sizeof(buf), kind);
+        uint64_t full = lz4_compress(buf, sizeof(buf), comp, sizeof(comp), wrkmem);
+        CHECK(full > 0);
+
+        /* Any capacity either fails cleanly or gives a valid block, and
+         * nothing is written past it */
+        for (uint64_t cap = 0; cap < full + 16; cap += 1 + cap / 16)
+        {
+            memset(comp, 0xA5, sizeof(comp));
+            uint64_t clen = lz4_compress(buf, sizeof(buf), comp, cap, wrkmem);
+            CHECK(clen <= cap);
+            for (uint64_t i = cap; i < sizeof(comp); i++)
+                CHECK_EQ(comp[i], 0xA5);
+            if (clen)
+            {
+                CHECK_EQ(lz4_decompress(comp, clen, out, sizeof(out)), (int64_t)sizeof(buf));
+                CHECK(memcmp(out, buf, sizeof(buf)) == 0);
+            }
+        }
+    }
+}
+
+static void test_lz4_corrupt(void)
+{
+    static uint8_t buf[4096], comp[LZ4_COMPRESS_BOUND(4096)];
+
+    host_srand(56);
+    for (int round = 0; round < 2000; round++)
+    {
+        fill(buf, sizeof(buf), DATA_MIXED);
+        uint64_t clen = lz4_compress(buf, sizeof(buf), comp, sizeof(comp), wrkmem);
+        CHECK(clen > 0);
+
+        /* Flip bytes, truncate, or both. The output goes in an exactly
+         * sized heap block, so an overrun is an ASan report. */
+        for (int flips = host_rand() % 4; flips > 0; flips--)
+            comp[host_rand() % clen] = host_rand();
+        if (host_rand() % 2)
+            clen = host_rand() % clen;
+
+        uint64_t cap = host_rand() % (sizeof(buf) + 64);
+        uint8_t *out = malloc(cap ? cap : 1);
+        uint8_t *in = malloc(clen ? clen : 1);
+        memcpy(in, comp, clen);
+
+        int64_t n = lz4_decompress(in, clen, out, cap);
+        CHECK(n >= -1 && n <= (int64_t)cap);
+
+        free(in);
+        free(out);
+    }
+}
+
+const struct test_case lz4_tests[] = {
+    {"lz4: liblz4 reference block", test_lz4_reference},
+    {"lz4: round trips", test_lz4_round_trip},
+    {"lz4: too-small output buffers", test_lz4_small_dst},
+    {"lz4: corrupt and truncated blocks", test_lz4_corrupt},
+    {NULL, NULL},
+};
+
+/**
+ * @brief Compresses and decompresses 4KB pages of one kind of data and
+ * reports the ratio and both throughputs.
+ */
+static void bench_kind(const char *name, enum data_kind kind)
+{
+    enum { PAGES = 256, ROUNDS = 8 };
+    uint64_t bound = LZ4_COMPRESS_BOUND(4096);
+    uint8_t *buf = malloc(PAGES * 4096);
+    uint8_t *comp = malloc(PAGES * bound);
+    uint8_t *out = malloc(PAGES * 4096);
+    uint64_t clen[PAGES];
+    uint64_t total = 0;
+    char label[32];
+
+    fill(buf, PAGES * 4096, kind);
+
+    uint64_t t0 = host_now_ns();
+    for (int r = 0; r < ROUNDS; r++)
+        for (int p = 0; p < PAGES; p++)
+            clen[p] = lz4_compress(buf + p * 4096, 4096, comp + p * bound, bound, wrkmem);
+    uint64_t comp_ns = host_now_ns() - t0;
+
+    t0 = host_now_ns();
+    for (int r = 0; r < ROUNDS; r++)
+        for (int p = 0; p < PAGES; p++)
+            lz4_decompress(comp + p * bound, clen[p], out + p * 4096, 4096);
+    uint64_t decomp_ns = host_now_ns() - t0;
+
+    for (int p = 0; p < PAGES; p++)
+        total += clen[p];
+    snprintf(label, sizeof(label), "lz4_4k_%s", name);
+    BENCH_REPORT(label, "ratio=%.3f compress_gbps=%.2f decompress_gbps=%.2f ok=%d",
+                 (double)total / (PAGES * 4096), (double)ROUNDS * PAGES * 4096 / comp_ns,
+                 (double)ROUNDS * PAGES * 4096 / decomp_ns, memcmp(out, buf, PAGES * 4096) == 0);
+
+    free(buf);
+    free(comp);
+    free(out);
+}
+
+static void bench_lz4(void)
+{
+    host_srand(78);
+    bench_kind("text", DATA_TEXT);
+    bench_kind("mixed", DATA_MIXED);
+    bench_kind("random", DATA_RANDOM);
+    bench_kind("zero", DATA_ZERO);
+}
+
+const struct bench_case lz4_benches[] = {
+    {"lz4", bench_lz4},
+    {NULL, NULL},
+};
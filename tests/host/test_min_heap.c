@@ -0,0 +1,151 @@
+/**
+ * @file test_min_heap.c
+ * @brief Correctness tests, fuzzer and benchmarks for lib/min_heap.c.
+ */
+
+#include "harness.h"
+
+#include <valen/min_heap.h>
+
+static bool u64_less(const void *a, const void *b)
+{
+    return *(const uint64_t *)a < *(const uint64_t *)b;
+}
+
+/* 12 bytes: exercises the byte-wise swap */
+struct odd
+{
+    uint32_t key;
+    uint32_t a, b;
+} __attribute__((packed));
+
+static bool odd_less(const void *a, const void *b)
+{
+    return ((const struct odd *)a)->key < ((const struct odd *)b)->key;
+}
+
+static void test_push_pop(void)
+{
+    uint64_t data[8], v;
+    struct min_heap heap;
+
+    min_heap_init(&heap, data, 8, sizeof(uint64_t), u64_less);
+    CHECK(min_heap_peek(&heap) == NULL);
+    CHECK_EQ(min_heap_pop(&heap, &v), -1);
+
+    static const uint64_t in[] = {5, 3, 8, 1, 9, 2, 7, 3};
+    for (int i = 0; i < 8; i++)
+        CHECK_EQ(min_heap_push(&heap, &in[i]), 0);
+    v = 4;
+    CHECK_EQ(min_heap_push(&heap, &v), -1);
+    CHECK_EQ(*(uint64_t *)min_heap_peek(&heap), 1);
+
+    static const uint64_t out[] = {1, 2, 3, 3, 5, 7, 8, 9};
+    for (int i = 0; i < 8; i++)
+    {
+        CHECK_EQ(min_heap_pop(&heap, &v), 0);
+        CHECK_EQ(v, out[i]);
+    }
+    CHECK_EQ(heap.nr, 0);
+}
+
+static void test_heapify(void)
+{
+    struct odd data[100];
+    struct min_heap heap;
+
+    for (int i = 0; i < 100; i++)
+        data[i] = (struct odd){.key = (uint32_t)((i * 61) % 100), .a = (uint32_t)i, .b = ~0U};
+    min_heap_init(&heap, data, 100, sizeof(struct odd), odd_less);
+    heap.nr = 100;
+    min_heap_heapify(&heap);
+
+    /* k-way merge pattern: replace the minimum with a larger key */
+    struct odd top = {.key = 1000};
+    min_heap_pop_push(&heap, &top);
+
+    for (uint32_t i = 1; i < 100; i++)
+    {
+        struct odd o;
+        CHECK_EQ(min_heap_pop(&heap, &o), 0);
+        CHECK_EQ(o.key, i);
+        CHECK_EQ(o.b, ~0U);
+        CHECK_EQ((o.a * 61) % 100, i);
+    }
+    CHECK_EQ(((struct odd *)min_heap_peek(&heap))->key, 1000);
+}
+
+static int cmp_u64(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+/**
+ * @brief Random pushes and pops; every pop must return the smallest key
+ * still in the reference multiset.
+ */
+static void test_fuzz(void)
+{
+    enum { N = 512 };
+    static uint64_t data[N], ref[N];
+    struct min_heap heap;
+    int nref = 0;
+
+    min_heap_init(&heap, data, N, sizeof(uint64_t), u64_less);
+    for (int iter = 0; iter < 50000; iter++)
+    {
+        if (nref < N && (nref == 0 || host_rand() % 3))
+        {
+            uint64_t v = host_rand() % 1000;
+            CHECK_EQ(min_heap_push(&heap, &v), 0);
+            ref[nref++] = v;
+        }
+        else
+        {
+            uint64_t v;
+            qsort(ref, nref, sizeof(uint64_t), cmp_u64);
+            CHECK_EQ(min_heap_pop(&heap, &v), 0);
+            CHECK_EQ(v, ref[0]);
+            ref[0] = ref[--nref];
+        }
+        CHECK_EQ(heap.nr, nref);
+    }
+}
+
+const struct test_case min_heap_tests[] = {
+    {"min_heap: push and pop", test_push_pop},
+    {"min_heap: heapify and pop_push", test_heapify},
+    {"min_heap: fuzz against reference", test_fuzz},
+    {NULL, NULL},
+};
+
+static void bench_min_heap(void)
+{
+    enum { N = 1 << 16, OPS = 1 << 22 };
+    static uint64_t data[N];
+    struct min_heap heap;
+
+    min_heap_init(&heap, data, N, sizeof(uint64_t), u64_less);
+    for (int i = 0; i < N; i++)
+    {
+        uint64_t v = host_rand();
+        min_heap_push(&heap, &v);
+    }
+
+    /* Timer-queue shape: take the earliest, queue one further out */
+    uint64_t t0 = host_now_ns();
+    for (int i = 0; i < OPS; i++)
+    {
+        uint64_t v = *(uint64_t *)min_heap_peek(&heap) + (host_rand() >> 20);
+        min_heap_pop_push(&heap, &v);
+    }
+    uint64_t ns = host_now_ns() - t0;
+
+    BENCH_REPORT("min_heap_pop_push", "n=%d ops=%d ns_per_op=%.1f", N, OPS, (double)ns / OPS);
+}
+
+const struct bench_case min_heap_benches[] = {
+    {"min_heap", bench_min_heap},
+    {NULL, NULL},
+};
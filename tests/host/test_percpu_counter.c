@@ -0,0 +1,154 @@
+/**
+ * @file test_percpu_counter.c
+ * @brief Tests and benchmarks for lib/percpu_counter.c. Each thread sets
+ * host_cpu, so it updates its own slot like a CPU would.
+ */
+
+#include "harness.h"
+
+#include <pthread.h>
+#include <valen/percpu_counter.h>
+#include <valen/atomic.h>
+
+static void test_percpu_counter_basic(void)
+{
+    static struct percpu_counter c;
+
+    percpu_counter_init(&c, 100, 8);
+    CHECK_EQ(percpu_counter_sum(&c), 100);
+
+    /* Below the batch everything stays in the slot */
+    for (int i = 0; i < 7; i++)
+        percpu_counter_inc(&c);
+    CHECK_EQ(percpu_counter_read(&c), 100);
+    CHECK_EQ(percpu_counter_sum(&c), 107);
+
+    /* Reaching it folds */
+    percpu_counter_inc(&c);
+    CHECK_EQ(percpu_counter_read(&c), 108);
+    CHECK_EQ(c.cpu[0].delta, 0);
+
+    percpu_counter_add(&c, -20);
+    CHECK_EQ(percpu_counter_read(&c), 88);
+    percpu_counter_dec(&c);
+    CHECK_EQ(percpu_counter_sum(&c), 87);
+
+    percpu_counter_set(&c, 5);
+    CHECK_EQ(percpu_counter_sum(&c), 5);
+    CHECK_EQ(percpu_counter_read(&c), 5);
+
+    percpu_counter_init(&c, 0, 0);
+    CHECK_EQ(c.batch, PERCPU_COUNTER_BATCH);
+}
+
+static void test_percpu_counter_layout(void)
+{
+    static struct percpu_counter c;
+
+    /* No two CPUs' slots, and not the shared total, in one cache line */
+    CHECK_EQ(sizeof(c.cpu[0]), SMP_CACHE_BYTES);
+    CHECK_EQ((uintptr_t)&c.cpu[0] % SMP_CACHE_BYTES, 0);
+    CHECK((uintptr_t)&c.cpu[0] - (uintptr_t)&c.count >= SMP_CACHE_BYTES);
+}
+
+/* --- Threaded --- */
+
+enum { THREADS = NR_CPUS < 4 ? NR_CPUS : 4, ITERS = 1000000 };
+
+static struct percpu_counter shared;
+static atomic64_t drift;
+
+static void *add_thread(void *arg)
+{
+    host_cpu = (int)(uintptr_t)arg;
+    for (int i = 0; i < ITERS; i++)
+    {
+        percpu_counter_add(&shared, i & 1 ? 3 : -1);
+        /* The cheap read never strays more than batch per CPU */
+        if (i % 1024 == 0)
+        {
+            int64_t read = percpu_counter_read(&shared);
+            if (read < -(int64_t)shared.batch * NR_CPUS)
+                atomic64_inc(&drift);
+        }
+    }
+    return NULL;
+}
+
+static void test_percpu_counter_threads(void)
+{
+    pthread_t threads[THREADS];
+
+    percpu_counter_init(&shared, 0, 0);
+    atomic64_set(&drift, 0);
+    for (uintptr_t i = 0; i < THREADS; i++)
+        pthread_create(&threads[i], NULL, add_thread, (void *)i);
+    for (int i = 0; i < THREADS; i++)
+        pthread_join(threads[i], NULL);
+    host_cpu = 0;
+
+    int64_t expect = (int64_t)THREADS * ITERS;
+    CHECK_EQ(percpu_counter_sum(&shared), expect);
+    CHECK(expect - percpu_counter_read(&shared) <= (int64_t)shared.batch * THREADS);
+    CHECK_EQ(atomic64_read(&drift), 0);
+}
+
+const struct test_case percpu_counter_tests[] = {
+    {"percpu_counter: batch folding", test_percpu_counter_basic},
+    {"percpu_counter: cache-line layout", test_percpu_counter_layout},
+    {"percpu_counter: threaded sum", test_percpu_counter_threads},
+    {NULL, NULL},
+};
+
+/* --- Benchmarks: per-CPU slots against one shared atomic --- */
+
+enum { BENCH_OPS = 1 << 22 };
+
+static atomic64_t bench_atomic;
+
+static void *bench_percpu_thread(void *arg)
+{
+    host_cpu = (int)(uintptr_t)arg;
+    for (int i = 0; i < BENCH_OPS; i++)
+        percpu_counter_inc(&shared);
+    return NULL;
+}
+
+static void *bench_atomic_thread(void *arg)
+{
+    (void)arg;
+    for (int i = 0; i < BENCH_OPS; i++)
+        atomic64_inc(&bench_atomic);
+    return NULL;
+}
+
+static uint64_t run_threads(void *(*fn)(void *))
+{
+    pthread_t threads[THREADS];
+
+    uint64_t t0 = host_now_ns();
+    for (uintptr_t i = 0; i < THREADS; i++)
+        pthread_create(&threads[i], NULL, fn, (void *)i);
+    for (int i = 0; i < THREADS; i++)
+        pthread_join(threads[i], NULL);
+    return host_now_ns() - t0;
+}
+
+static void bench_percpu_counter(void)
+{
+    percpu_counter_init(&shared, 0, 0);
+    uint64_t percpu_ns = run_threads(bench_percpu_thread);
+    atomic64_set(&bench_atomic, 0);
+    uint64_t atomic_ns = run_threads(bench_atomic_thread);
+    host_cpu = 0;
+
+    BENCH_REPORT("percpu_counter_inc", "threads=%d ops=%d ns_per_op=%.2f", THREADS, BENCH_OPS,
+                 (double)percpu_ns / BENCH_OPS);
+    BENCH_REPORT("shared_atomic_inc", "threads=%d ops=%d ns_per_op=%.2f", THREADS, BENCH_OPS,
+                 (double)atomic_ns / BENCH_OPS);
+}
+
+const struct bench_case percpu_counter_benches[] = {
+    {"percpu_counter", bench_percpu_counter},
+    {NULL, NULL},
+};
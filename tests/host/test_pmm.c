@@ -0,0 +1,384 @@
+/**
+ * @file test_pmm.c
+ * @brief Correctness tests, fuzzer and benchmarks for mm/pmm.c.
+ *
+ * The PMM only ever touches its bitmap, so a heap buffer stands in for the
+ * region kmain() carves out after the kernel image. Returned "pages" are
+ * higher-half addresses that are compared, never dereferenced.
+ */
+
+#include "harness.h"
+
+#include <valen/pmm.h>
+#include <valen/bitmap.h>
+
+#define KOFF 0xFFFFFFFF80000000ULL
+#define LOW_RESERVED (0x200000 / 4096)
+
+static uint64_t *fake_bitmap;
+
+/**
+ * @brief Mirrors kmain(): everything used, then free every page of RAM.
+ */
+static uint64_t setup(uint64_t ram_bytes)
+{
+    uint64_t pages = ram_bytes / 4096;
+
+    free(fake_bitmap);
+    fake_bitmap = malloc(BITS_TO_LONGS(pages) * sizeof(uint64_t));
+    pmm_init((uintptr_t)fake_bitmap, ram_bytes);
+
+    for (uint64_t a = 0; a < ram_bytes; a += 4096)
+        pmm_mark_free(a);
+
+    return pages;
+}
+
+static uint64_t to_pfn(void *page)
+{
+    return ((uint64_t)(uintptr_t)page - KOFF) / 4096;
+}
+
+static void test_init_all_used(void)
+{
+    free(fake_bitmap);
+    fake_bitmap = malloc(512);
+    pmm_init((uintptr_t)fake_bitmap, 16ULL << 20);
+
+    CHECK_EQ(pmm_get_used_kb(), pmm_get_total_kb());
+    CHECK(pmm_alloc_page() == NULL);
+    CHECK(pmm_alloc_pages(4) == NULL);
+}
+
+static void test_never_below_2mb(void)
+{
+    uint64_t pages = setup(4ULL << 20);
+    uint64_t got = 0;
+    void *p;
+
+    while ((p = pmm_alloc_page()) != NULL)
+    {
+        CHECK(to_pfn(p) >= LOW_RESERVED);
+        CHECK(((uintptr_t)p & 0xFFF) == 0);
+        got++;
+    }
+
+    CHECK_EQ(got, pages - LOW_RESERVED);
+}
+
+static void test_unique_pages(void)
+{
+    uint64_t pages = setup(8ULL << 20);
+    uint8_t *seen = calloc(pages, 1);
+    void *p;
+
+    while ((p = pmm_alloc_page()) != NULL)
+    {
+        uint64_t pfn = to_pfn(p);
+        CHECK(pfn < pages);
+        CHECK(!seen[pfn]);
+        seen[pfn] = 1;
+    }
+
+    free(seen);
+}
+
+static void test_free_roundtrip(void)
+{
+    setup(8ULL << 20);
+    uint64_t used = pmm_get_used_kb();
+
+    void *p = pmm_alloc_page();
+    CHECK(p != NULL);
+    CHECK_EQ(pmm_get_used_kb(), used + 4);
+
+    pmm_free_page(p);
+    CHECK_EQ(pmm_get_used_kb(), used);
+    CHECK(pmm_alloc_page() == p);
+
+    /* Double free must not underflow the counter */
+    pmm_free_page(p);
+    pmm_free_page(p);
+    CHECK_EQ(pmm_get_used_kb(), used);
+}
+
+static void test_contiguous_runs(void)
+{
+    setup(16ULL << 20);
+
+    void *a = pmm_alloc_pages(3);
+    void *b = pmm_alloc_pages(37);
+    void *c = pmm_alloc_page();
+    CHECK(a && b && c);
+
+    uint64_t pa = to_pfn(a), pb = to_pfn(b), pc = to_pfn(c);
+    CHECK(pb >= pa + 3 || pb + 37 <= pa);
+    CHECK(pc < pb || pc >= pb + 37);
+    CHECK(pc < pa || pc >= pa + 3);
+}
+
+static void test_runs_need_contiguity(void)
+{
+    setup(4ULL << 20);
+
+    /* Take everything, then free every other page */
+    void *p;
+    uint64_t first = 0;
+    while ((p = pmm_alloc_page()) != NULL)
+    {
+        if (!first)
+            first = to_pfn(p);
+    }
+    for (uint64_t pfn = first; pfn < (4ULL << 20) / 4096; pfn += 2)
+        pmm_free_page((void *)(uintptr_t)(pfn * 4096 + KOFF));
+
+    CHECK(pmm_alloc_pages(2) == NULL);
+    CHECK(pmm_alloc_pages(1) != NULL);
+}
+
+/**
+ * @brief Random single/multi-page allocations checked against a shadow map.
+ */
+static void test_fuzz(void)
+{
+    uint64_t pages = setup(32ULL << 20);
+    uint8_t *owner = calloc(pages, 1);
+    struct
+    {
+        void *p;
+        uint64_t n;
+    } live[512];
+    int nlive = 0;
+
+    for (int iter = 0; iter < 20000; iter++)
+    {
+        if (nlive < 512 && (host_rand() % 3 != 0 || nlive == 0))
+        {
+            uint64_t n = 1 + (host_rand() % 4 == 0 ? host_rand() % 64 : 0);
+            void *p = n == 1 ? pmm_alloc_page() : pmm_alloc_pages(n);
+            if (!p)
+                continue;
+
+            uint64_t pfn = to_pfn(p);
+            CHECK(pfn >= LOW_RESERVED && pfn + n <= pages);
+            for (uint64_t i = 0; i < n; i++)
+            {
+                CHECK(!owner[pfn + i]);
+                owner[pfn + i] = 1;
+            }
+            live[nlive].p = p;
+            live[nlive].n = n;
+            nlive++;
+        }
+        else
+        {
+            int victim = host_rand() % nlive;
+            uint64_t pfn = to_pfn(live[victim].p);
+            for (uint64_t i = 0; i < live[victim].n; i++)
+            {
+                owner[pfn + i] = 0;
+                pmm_free_page((void *)(uintptr_t)((pfn + i) * 4096 + KOFF));
+            }
+            live[victim] = live[--nlive];
+        }
+
+        uint64_t owned = 0;
+        if (iter % 1024 == 0)
+        {
+            for (uint64_t i = 0; i < pages; i++)
+                owned += owner[i];
+            CHECK_EQ(pmm_get_used_kb() / 4, owned);
+        }
+    }
+
+    free(owner);
+}
+
+/**
+ * @brief Node of a pfn in the layouts below: nodes are equal slices of RAM.
+ */
+static int slice_node(uint64_t pfn, uint64_t pages, int nodes)
+{
+    return (int)(pfn / (pages / nodes));
+}
+
+/**
+ * @brief Splits RAM into equal nodes. Returns 0 when the kernel was built
+ * without NUMA and only has one node.
+ */
+static int setup_nodes(uint64_t ram_bytes, int count)
+{
+    setup(ram_bytes);
+    for (int n = 0; n < count; n++)
+    {
+        uint64_t size = ram_bytes / count;
+        if (pmm_add_node_range(n, n * size, (n + 1) * size) != 0)
+            return 0;
+    }
+    return 1;
+}
+
+static void test_node_local(void)
+{
+    uint64_t pages = 64ULL << 20 >> 12;
+    if (!setup_nodes(64ULL << 20, 2))
+        return;
+
+    int both[] = {0, 1};
+    int back[] = {1, 0};
+    pmm_set_node_fallback(0, both, 2);
+    pmm_set_node_fallback(1, back, 2);
+
+    uint64_t total0, free0, total1, free1;
+    pmm_node_usage(0, &total0, &free0);
+    pmm_node_usage(1, &total1, &free1);
+    CHECK_EQ(total0, 32 * 1024);
+    CHECK_EQ(free0, 32 * 1024);
+    CHECK_EQ(free1, 32 * 1024);
+
+    shim_numa_node = 1;
+    void *a = pmm_alloc_page();
+    void *b = pmm_alloc_pages(16);
+    shim_numa_node = 0;
+    void *c = pmm_alloc_page();
+
+    CHECK(a && b && c);
+    CHECK_EQ(slice_node(to_pfn(a), pages, 2), 1);
+    CHECK_EQ(slice_node(to_pfn(b), pages, 2), 1);
+    CHECK_EQ(slice_node(to_pfn(b) + 15, pages, 2), 1);
+    CHECK_EQ(slice_node(to_pfn(c), pages, 2), 0);
+    CHECK_EQ(pmm_page_node(to_pfn(a) * 4096), 1);
+
+    pmm_node_usage(1, &total1, &free1);
+    CHECK_EQ(free1, 32 * 1024 - 17 * 4);
+
+    pmm_free_page(a);
+    pmm_node_usage(1, &total1, &free1);
+    CHECK_EQ(free1, 32 * 1024 - 16 * 4);
+}
+
+static void test_node_fallback_order(void)
+{
+    uint64_t pages = 48ULL << 20 >> 12;
+    if (!setup_nodes(48ULL << 20, 3))
+        return;
+
+    /* Node 2 is nearer to node 1 than node 0 is */
+    int order[] = {1, 2, 0};
+    pmm_set_node_fallback(1, order, 3);
+
+    uint64_t total, free_kb;
+    pmm_node_usage(1, &total, &free_kb);
+    for (uint64_t i = 0; i < free_kb / 4; i++)
+    {
+        void *p = pmm_alloc_pages_node(1, 1);
+        CHECK(p && slice_node(to_pfn(p), pages, 3) == 1);
+    }
+
+    void *spill = pmm_alloc_pages_node(1, 1);
+    CHECK(spill != NULL);
+    CHECK_EQ(slice_node(to_pfn(spill), pages, 3), 2);
+
+    /* A run larger than any node's free space still fails cleanly */
+    CHECK(pmm_alloc_pages_node(pages, 1) == NULL);
+}
+
+static void test_node_holes(void)
+{
+    /* The firmware only describes the first half of RAM */
+    setup(16ULL << 20);
+    if (pmm_add_node_range(0, 0, 8ULL << 20) != 0)
+        return;
+
+    uint64_t got = 0;
+    while (pmm_alloc_page())
+        got++;
+    CHECK_EQ(got, (16ULL << 20 >> 12) - LOW_RESERVED);
+    CHECK_EQ(pmm_get_free_kb(), LOW_RESERVED * 4);
+}
+
+static void test_frames_above_direct_map(void)
+{
+    if (!setup_nodes(2ULL << 30, 2))
+        return;
+
+    int order[] = {1, 0};
+    pmm_set_node_fallback(1, order, 2);
+
+    /* Direct-map pointers can only come from the first 1GB */
+    void *p = pmm_alloc_pages_node(1, 1);
+    CHECK(p != NULL);
+    CHECK(to_pfn(p) < (1ULL << 30 >> 12));
+
+    uint64_t frame = pmm_alloc_frame_node(1);
+    CHECK(frame >= 1ULL << 30 && frame < 2ULL << 30);
+    CHECK_EQ(pmm_page_node(frame), 1);
+
+    uint64_t total, free_kb;
+    pmm_node_usage(1, &total, &free_kb);
+    pmm_free_page((void *)(uintptr_t)frame);
+    uint64_t after;
+    pmm_node_usage(1, &total, &after);
+    CHECK_EQ(after, free_kb + 4);
+}
+
+const struct test_case pmm_tests[] = {
+    {"pmm: init marks everything used", test_init_all_used},
+    {"pmm: bottom 2MB is never allocated", test_never_below_2mb},
+    {"pmm: pages are unique", test_unique_pages},
+    {"pmm: free round trip", test_free_roundtrip},
+    {"pmm: contiguous runs", test_contiguous_runs},
+    {"pmm: runs require contiguity", test_runs_need_contiguity},
+    {"pmm: fuzz against shadow map", test_fuzz},
+    {"pmm: node-local allocation", test_node_local},
+    {"pmm: node fallback order", test_node_fallback_order},
+    {"pmm: pages outside every node", test_node_holes},
+    {"pmm: frames above the direct map", test_frames_above_direct_map},
+    {NULL, NULL},
+};
+
+/* --- Benchmarks --- */
+
+static void bench_alloc_free(void)
+{
+    setup(1ULL << 30);
+    static void *pages[4096];
+
+    uint64_t t0 = host_now_ns();
+    for (int round = 0; round < 64; round++)
+    {
+        for (int i = 0; i < 4096; i++)
+            pages[i] = pmm_alloc_page();
+        for (int i = 0; i < 4096; i++)
+            pmm_free_page(pages[i]);
+    }
+    uint64_t ns = host_now_ns() - t0;
+
+    BENCH_REPORT("pmm_alloc_free", "ops=%d ns_per_op=%.1f", 64 * 4096 * 2,
+                 (double)ns / (64 * 4096 * 2));
+}
+
+static void bench_alloc_full(void)
+{
+    /* Worst case: the last free page sits at the end of a 1GB bitmap */
+    uint64_t pages = setup(1ULL << 30);
+    while (pmm_alloc_page())
+        ;
+    pmm_free_page((void *)(uintptr_t)((pages - 1) * 4096 + KOFF));
+
+    uint64_t t0 = host_now_ns();
+    for (int i = 0; i < 256; i++)
+    {
+        void *p = pmm_alloc_page();
+        pmm_free_page(p);
+    }
+    uint64_t ns = host_now_ns() - t0;
+
+    BENCH_REPORT("pmm_alloc_last_page", "ops=256 ns_per_op=%.1f", (double)ns / 256);
+}
+
+const struct bench_case pmm_benches[] = {
+    {"pmm_alloc_free", bench_alloc_free},
+    {"pmm_alloc_last_page", bench_alloc_full},
+    {NULL, NULL},
+};
@@ -0,0 +1,191 @@
+/**
+ * @file test_radix_tree.c
+ * @brief Correctness tests, fuzzer and benchmarks for lib/radix_tree.c.
+ *
+ * Nodes come from the kernel heap, so every test starts with heap_init().
+ * Items are fake pointers derived from the index; they are never
+ * dereferenced.
+ */
+
+#include "harness.h"
+
+#include <valen/radix_tree.h>
+#include <valen/heap.h>
+
+#define ITEM(i) ((void *)(uintptr_t)(((i) << 4) | 8))
+
+static void test_basic(void)
+{
+    struct radix_tree_root root = RADIX_TREE_INIT;
+    static const uint64_t idx[] = {0, 1, 63, 64, 4095, 4096, 1ULL << 32, ~0ULL, ~0ULL - 1};
+
+    heap_init();
+    CHECK(radix_tree_lookup(&root, 0) == NULL);
+    CHECK(radix_tree_delete(&root, 5) == NULL);
+
+    CHECK_EQ(radix_tree_insert(&root, 5, ITEM(5ULL)), 0);
+    CHECK_EQ(root.height, 1);
+    CHECK_EQ(radix_tree_insert(&root, 5, ITEM(5ULL)), -2);
+
+    for (size_t i = 0; i < sizeof(idx) / sizeof(idx[0]); i++)
+        CHECK_EQ(radix_tree_insert(&root, idx[i], ITEM(idx[i] & 0xFFFFFF)), 0);
+    CHECK_EQ(root.height, 11);
+    CHECK_EQ(root.items, 10);
+
+    for (size_t i = 0; i < sizeof(idx) / sizeof(idx[0]); i++)
+        CHECK(radix_tree_lookup(&root, idx[i]) == ITEM(idx[i] & 0xFFFFFF));
+    CHECK(radix_tree_lookup(&root, 2) == NULL);
+    CHECK(radix_tree_lookup(&root, 1ULL << 40) == NULL);
+
+    /* Deleting the large indices lowers the tree again */
+    CHECK(radix_tree_delete(&root, ~0ULL) == ITEM(~0ULL & 0xFFFFFF));
+    CHECK(radix_tree_delete(&root, ~0ULL - 1) != NULL);
+    CHECK(radix_tree_delete(&root, 1ULL << 32) != NULL);
+    CHECK_EQ(root.height, 3);
+    CHECK(radix_tree_delete(&root, 4096) != NULL);
+    CHECK_EQ(root.height, 2);
+    CHECK(radix_tree_delete(&root, 4095) != NULL);
+    CHECK(radix_tree_delete(&root, 64) != NULL);
+    CHECK_EQ(root.height, 1);
+    CHECK(radix_tree_lookup(&root, 63) == ITEM(63ULL));
+
+    CHECK(radix_tree_delete(&root, 0) != NULL);
+    CHECK(radix_tree_delete(&root, 1) != NULL);
+    CHECK(radix_tree_delete(&root, 5) != NULL);
+    CHECK(radix_tree_delete(&root, 63) != NULL);
+    CHECK(root.node == NULL);
+    CHECK_EQ(root.height, 0);
+    CHECK_EQ(root.items, 0);
+}
+
+static void test_gang(void)
+{
+    struct radix_tree_root root = RADIX_TREE_INIT;
+    void *results[16];
+    uint64_t indices[16];
+
+    heap_init();
+    for (uint64_t i = 0; i < 1000; i += 7)
+        radix_tree_insert(&root, i * 1000, ITEM(i));
+    radix_tree_insert(&root, ~0ULL, ITEM(1ULL));
+
+    CHECK_EQ(radix_tree_gang_lookup(&root, results, indices, 0, 4), 4);
+    CHECK_EQ(indices[0], 0);
+    CHECK_EQ(indices[3], 21000);
+    CHECK(results[1] == ITEM(7ULL));
+
+    /* Starting between items */
+    CHECK_EQ(radix_tree_gang_lookup(&root, results, indices, 21001, 2), 2);
+    CHECK_EQ(indices[0], 28000);
+    CHECK_EQ(indices[1], 35000);
+
+    /* The last item and the end of the index space */
+    CHECK_EQ(radix_tree_gang_lookup(&root, results, indices, 994001, 16), 1);
+    CHECK_EQ(indices[0], ~0ULL);
+
+    /* Walk everything in batches */
+    uint64_t next = 0;
+    int total = 0, n;
+    while ((n = radix_tree_gang_lookup(&root, results, indices, next, 16)) > 0)
+    {
+        total += n;
+        if (indices[n - 1] == ~0ULL)
+            break;
+        next = indices[n - 1] + 1;
+    }
+    CHECK_EQ(total, (int)root.items);
+    radix_tree_destroy(&root);
+    CHECK(root.node == NULL);
+}
+
+/**
+ * @brief Random operations over clustered and sparse indices against a
+ * sorted reference array.
+ */
+static void test_fuzz(void)
+{
+    enum { KEYS = 1024 };
+    static uint64_t keys[KEYS];
+    static int present[KEYS];
+    struct radix_tree_root root = RADIX_TREE_INIT;
+
+    heap_init();
+    memset(present, 0, sizeof(present));
+    for (int i = 0; i < KEYS; i++)
+    {
+        /* Half dense around 0, half spread over the 64-bit space, sorted */
+        keys[i] = i < KEYS / 2 ? (uint64_t)i * 3 : ((uint64_t)i << 50) + (host_rand() & 0xFFFF);
+    }
+
+    for (int iter = 0; iter < 30000; iter++)
+    {
+        int k = host_rand() % KEYS;
+        switch (host_rand() % 3)
+        {
+        case 0:
+            CHECK_EQ(radix_tree_insert(&root, keys[k], ITEM((uint64_t)k)), present[k] ? -2 : 0);
+            present[k] = 1;
+            break;
+        case 1:
+            CHECK(radix_tree_delete(&root, keys[k]) == (present[k] ? ITEM((uint64_t)k) : NULL));
+            present[k] = 0;
+            break;
+        default:
+        {
+            void *results[4];
+            uint64_t indices[4];
+            int n = radix_tree_gang_lookup(&root, results, indices, keys[k], 4);
+            int j = k, m = 0;
+            for (; j < KEYS && m < 4; j++)
+            {
+                if (!present[j])
+                    continue;
+                CHECK(m < n);
+                CHECK_EQ(indices[m], keys[j]);
+                CHECK(results[m] == ITEM((uint64_t)j));
+                m++;
+            }
+            CHECK_EQ(n, m);
+        }
+        }
+        CHECK(radix_tree_lookup(&root, keys[k]) == (present[k] ? ITEM((uint64_t)k) : NULL));
+    }
+    radix_tree_destroy(&root);
+}
+
+const struct test_case radix_tree_tests[] = {
+    {"radix_tree: insert, lookup, delete, height", test_basic},
+    {"radix_tree: gang lookup", test_gang},
+    {"radix_tree: fuzz against reference", test_fuzz},
+    {NULL, NULL},
+};
+
+static void bench_radix_tree(void)
+{
+    enum { N = 1 << 18 };
+    struct radix_tree_root root = RADIX_TREE_INIT;
+
+    /* Page-cache shape: consecutive page indices of a file */
+    heap_init();
+    uint64_t t0 = host_now_ns();
+    for (uint64_t i = 0; i < N; i++)
+        radix_tree_insert(&root, i, ITEM(i));
+    uint64_t t1 = host_now_ns();
+    uint64_t hits = 0;
+    for (uint64_t i = 0; i < N; i++)
+        hits += radix_tree_lookup(&root, (i * 7919) % N) != NULL;
+    uint64_t t2 = host_now_ns();
+    for (uint64_t i = 0; i < N; i++)
+        radix_tree_delete(&root, i);
+    uint64_t t3 = host_now_ns();
+
+    BENCH_REPORT("radix_insert_seq", "n=%d ns_per_op=%.1f", N, (double)(t1 - t0) / N);
+    BENCH_REPORT("radix_lookup_seq", "n=%d ns_per_op=%.1f hits=%lu", N, (double)(t2 - t1) / N,
+                 (unsigned long)hits);
+    BENCH_REPORT("radix_delete_seq", "n=%d ns_per_op=%.1f", N, (double)(t3 - t2) / N);
+}
+
+const struct bench_case radix_tree_benches[] = {
+    {"radix_tree", bench_radix_tree},
+    {NULL, NULL},
+};
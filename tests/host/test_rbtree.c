@@ -0,0 +1,356 @@
+/**
+ * @file test_rbtree.c
+ * @brief Correctness tests, fuzzer and benchmarks for lib/rbtree.c.
+ *
+ * After every operation the fuzzer checks the red-black invariants
+ * directly: parent links, no red node with a red child, and the same
+ * number of black nodes on every path. The augmented case is an interval
+ * tree whose overlap queries are compared against a linear scan.
+ */
+
+#include "harness.h"
+
+#include <valen/rbtree.h>
+
+struct knode
+{
+    struct rb_node rb;
+    uint64_t key;
+};
+
+static struct knode *kentry(struct rb_node *rb)
+{
+    return rb_entry(rb, struct knode, rb);
+}
+
+static void insert_key(struct rb_root *root, struct knode *n)
+{
+    struct rb_node **link = &root->rb_node, *parent = NULL;
+
+    while (*link)
+    {
+        parent = *link;
+        link = n->key < kentry(parent)->key ? &parent->rb_left : &parent->rb_right;
+    }
+    rb_link_node(&n->rb, parent, link);
+    rb_insert_color(&n->rb, root);
+}
+
+static struct knode *find_key(struct rb_root *root, uint64_t key)
+{
+    struct rb_node *rb = root->rb_node;
+
+    while (rb)
+    {
+        struct knode *n = kentry(rb);
+        if (key < n->key)
+            rb = rb->rb_left;
+        else if (key > n->key)
+            rb = rb->rb_right;
+        else
+            return n;
+    }
+    return NULL;
+}
+
+#define IS_BLACK(rb) (!(rb) || ((rb)->__rb_parent_color & 1))
+
+/**
+ * @brief Black height of the subtree, or -1 if it breaks an invariant.
+ */
+static int check_subtree(struct rb_node *rb, struct rb_node *parent, int *count)
+{
+    if (!rb)
+        return 1;
+    if (rb_parent(rb) != parent)
+        return -1;
+    if (!IS_BLACK(rb) && (!IS_BLACK(rb->rb_left) || !IS_BLACK(rb->rb_right)))
+        return -1;
+
+    (*count)++;
+    int left = check_subtree(rb->rb_left, rb, count);
+    int right = check_subtree(rb->rb_right, rb, count);
+    if (left < 0 || left != right)
+        return -1;
+    return left + IS_BLACK(rb);
+}
+
+static int tree_valid(struct rb_root *root, int expected)
+{
+    int count = 0;
+
+    if (root->rb_node && !IS_BLACK(root->rb_node))
+        return 0;
+    return check_subtree(root->rb_node, NULL, &count) > 0 && count == expected;
+}
+
+static void test_basic(void)
+{
+    struct rb_root root = RB_ROOT;
+    struct knode nodes[100];
+
+    CHECK(rb_first(&root) == NULL);
+    for (int i = 0; i < 100; i++)
+    {
+        nodes[i].key = (i * 37) % 100;
+        insert_key(&root, &nodes[i]);
+        CHECK(tree_valid(&root, i + 1));
+    }
+
+    /* In order both ways */
+    uint64_t expect = 0;
+    for (struct rb_node *rb = rb_first(&root); rb; rb = rb_next(rb))
+        CHECK_EQ(kentry(rb)->key, expect++);
+    CHECK_EQ(expect, 100);
+    for (struct rb_node *rb = rb_last(&root); rb; rb = rb_prev(rb))
+        CHECK_EQ(kentry(rb)->key, --expect);
+
+    /* Replace without rebalancing */
+    struct knode twin = {.key = 42};
+    struct knode *old = find_key(&root, 42);
+    rb_replace_node(&old->rb, &twin.rb, &root);
+    CHECK(find_key(&root, 42) == &twin);
+    CHECK(tree_valid(&root, 100));
+
+    for (int i = 0; i < 100; i++)
+    {
+        struct knode *n = find_key(&root, i);
+        CHECK(n != NULL);
+        rb_erase(&n->rb, &root);
+        RB_CLEAR_NODE(&n->rb);
+        CHECK(RB_EMPTY_NODE(&n->rb));
+        CHECK(tree_valid(&root, 99 - i));
+    }
+    CHECK(RB_EMPTY_ROOT(&root));
+}
+
+static bool knode_less(struct rb_node *a, const struct rb_node *b)
+{
+    return kentry(a)->key < rb_entry(b, struct knode, rb)->key;
+}
+
+static int knode_cmp(const void *key, const struct rb_node *b)
+{
+    uint64_t k = *(const uint64_t *)key, bk = rb_entry(b, struct knode, rb)->key;
+    return k < bk ? -1 : k > bk;
+}
+
+static void test_cached(void)
+{
+    struct rb_root_cached root = RB_ROOT_CACHED;
+    struct knode nodes[64];
+
+    for (int i = 0; i < 64; i++)
+    {
+        nodes[i].key = host_rand() % 1000;
+        rb_add_cached(&nodes[i].rb, &root, knode_less);
+
+        uint64_t min = ~0ULL;
+        for (int j = 0; j <= i; j++)
+            min = nodes[j].key < min ? nodes[j].key : min;
+        CHECK_EQ(kentry(rb_first_cached(&root))->key, min);
+        CHECK(rb_first_cached(&root) == rb_first(&root.rb_root));
+    }
+
+    uint64_t key = nodes[7].key;
+    CHECK(rb_find(&key, &root.rb_root, knode_cmp) != NULL);
+
+    /* Always remove the minimum, as a scheduler picking its next task */
+    uint64_t last = 0;
+    for (int i = 0; i < 64; i++)
+    {
+        struct rb_node *first = rb_first_cached(&root);
+        CHECK(first != NULL);
+        CHECK(kentry(first)->key >= last);
+        last = kentry(first)->key;
+        rb_erase_cached(first, &root);
+        CHECK(tree_valid(&root.rb_root, 63 - i));
+    }
+    CHECK(rb_first_cached(&root) == NULL);
+}
+
+/**
+ * @brief Random inserts and erases against a presence array.
+ */
+static void test_fuzz(void)
+{
+    enum { KEYS = 512 };
+    static struct knode nodes[KEYS];
+    static int present[KEYS];
+    struct rb_root root = RB_ROOT;
+    int count = 0;
+
+    memset(present, 0, sizeof(present));
+    for (int iter = 0; iter < 20000; iter++)
+    {
+        int k = host_rand() % KEYS;
+        if (present[k])
+        {
+            rb_erase(&nodes[k].rb, &root);
+            present[k] = 0;
+            count--;
+        }
+        else
+        {
+            nodes[k].key = k;
+            insert_key(&root, &nodes[k]);
+            present[k] = 1;
+            count++;
+        }
+        if (iter % 16 == 0 || count < 8)
+            CHECK(tree_valid(&root, count));
+
+        int q = host_rand() % KEYS;
+        CHECK((find_key(&root, q) != NULL) == present[q]);
+    }
+}
+
+/* --- Augmented: interval tree --- */
+
+struct interval
+{
+    struct rb_node rb;
+    uint64_t start;
+    uint64_t last;         /* Inclusive end */
+    uint64_t subtree_last; /* Largest last in the subtree */
+};
+
+static inline uint64_t interval_last(struct interval *iv)
+{
+    return iv->last;
+}
+
+RB_DECLARE_CALLBACKS_MAX(static, interval_augment, struct interval, rb, uint64_t, subtree_last,
+                         interval_last);
+
+static void interval_insert(struct rb_root *root, struct interval *iv)
+{
+    struct rb_node **link = &root->rb_node, *parent = NULL;
+
+    /* Update the maxima on the way down, as rb_insert_augmented() expects */
+    while (*link)
+    {
+        struct interval *p = rb_entry(*link, struct interval, rb);
+        parent = *link;
+        if (p->subtree_last < iv->last)
+            p->subtree_last = iv->last;
+        link = iv->start < p->start ? &parent->rb_left : &parent->rb_right;
+    }
+    iv->subtree_last = iv->last;
+    rb_link_node(&iv->rb, parent, link);
+    rb_insert_augmented(&iv->rb, root, &interval_augment);
+}
+
+/**
+ * @brief Counts intervals overlapping [start, last], pruning subtrees
+ * whose largest end is before start.
+ */
+static int interval_count(struct rb_node *rb, uint64_t start, uint64_t last)
+{
+    if (!rb)
+        return 0;
+
+    struct interval *iv = rb_entry(rb, struct interval, rb);
+    if (iv->subtree_last < start)
+        return 0;
+
+    int n = interval_count(rb->rb_left, start, last);
+    if (iv->start <= last)
+    {
+        n += iv->last >= start;
+        n += interval_count(rb->rb_right, start, last);
+    }
+    return n;
+}
+
+static int augment_valid(struct rb_node *rb)
+{
+    if (!rb)
+        return 1;
+
+    struct interval *iv = rb_entry(rb, struct interval, rb);
+    uint64_t max = iv->last;
+    if (rb->rb_left && rb_entry(rb->rb_left, struct interval, rb)->subtree_last > max)
+        max = rb_entry(rb->rb_left, struct interval, rb)->subtree_last;
+    if (rb->rb_right && rb_entry(rb->rb_right, struct interval, rb)->subtree_last > max)
+        max = rb_entry(rb->rb_right, struct interval, rb)->subtree_last;
+    return iv->subtree_last == max && augment_valid(rb->rb_left) && augment_valid(rb->rb_right);
+}
+
+static void test_augmented(void)
+{
+    enum { N = 256 };
+    static struct interval ivs[N];
+    static int present[N];
+    struct rb_root root = RB_ROOT;
+    int count = 0;
+
+    memset(present, 0, sizeof(present));
+    for (int iter = 0; iter < 10000; iter++)
+    {
+        int i = host_rand() % N;
+        if (present[i])
+        {
+            rb_erase_augmented(&ivs[i].rb, &root, &interval_augment);
+            present[i] = 0;
+            count--;
+        }
+        else
+        {
+            ivs[i].start = host_rand() % 10000;
+            ivs[i].last = ivs[i].start + host_rand() % 500;
+            interval_insert(&root, &ivs[i]);
+            present[i] = 1;
+            count++;
+        }
+        CHECK(augment_valid(root.rb_node));
+        if (iter % 32 == 0)
+            CHECK(tree_valid(&root, count));
+
+        uint64_t qs = host_rand() % 10000, ql = qs + host_rand() % 200;
+        int expect = 0;
+        for (int j = 0; j < N; j++)
+            expect += present[j] && ivs[j].start <= ql && ivs[j].last >= qs;
+        CHECK_EQ(interval_count(root.rb_node, qs, ql), expect);
+    }
+}
+
+const struct test_case rbtree_tests[] = {
+    {"rbtree: insert, walk, erase", test_basic},
+    {"rbtree: cached leftmost", test_cached},
+    {"rbtree: fuzz against invariants", test_fuzz},
+    {"rbtree: augmented interval tree", test_augmented},
+    {NULL, NULL},
+};
+
+static void bench_rbtree(void)
+{
+    enum { N = 1 << 20 };
+    struct knode *nodes = malloc(N * sizeof(*nodes));
+    struct rb_root root = RB_ROOT;
+
+    for (int i = 0; i < N; i++)
+        nodes[i].key = host_rand();
+
+    uint64_t t0 = host_now_ns();
+    for (int i = 0; i < N; i++)
+        insert_key(&root, &nodes[i]);
+    uint64_t t1 = host_now_ns();
+    int found = 0;
+    for (int i = 0; i < N; i++)
+        found += find_key(&root, nodes[(uint32_t)i * 7919u % N].key) != NULL;
+    uint64_t t2 = host_now_ns();
+    for (int i = 0; i < N; i++)
+        rb_erase(&nodes[i].rb, &root);
+    uint64_t t3 = host_now_ns();
+
+    BENCH_REPORT("rbtree_insert", "n=%d ns_per_op=%.1f", N, (double)(t1 - t0) / N);
+    BENCH_REPORT("rbtree_lookup", "n=%d ns_per_op=%.1f found=%d", N, (double)(t2 - t1) / N, found);
+    BENCH_REPORT("rbtree_erase", "n=%d ns_per_op=%.1f", N, (double)(t3 - t2) / N);
+    free(nodes);
+}
+
+const struct bench_case rbtree_benches[] = {
+    {"rbtree", bench_rbtree},
+    {NULL, NULL},
+};
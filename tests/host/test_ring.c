@@ -0,0 +1,269 @@
+/**
+ * @file test_ring.c
+ * @brief Correctness tests, threaded stress tests and benchmarks for
+ * lib/ring.c.
+ */
+
+#include "harness.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <valen/ring.h>
+
+static void test_spsc_basic(void)
+{
+    struct spsc_ring ring;
+    uint32_t buf[8], v;
+
+    CHECK_EQ(spsc_ring_init(&ring, buf, 6, sizeof(uint32_t)), -1);
+    CHECK_EQ(spsc_ring_init(&ring, buf, 8, sizeof(uint32_t)), 0);
+    CHECK(spsc_ring_empty(&ring));
+    CHECK(!spsc_ring_pop(&ring, &v));
+
+    /* Several laps, so the free-running indices wrap the mask */
+    for (uint32_t lap = 0; lap < 5; lap++)
+    {
+        for (uint32_t i = 0; i < 8; i++)
+        {
+            v = lap * 8 + i;
+            CHECK(spsc_ring_push(&ring, &v));
+        }
+        CHECK(!spsc_ring_push(&ring, &v));
+        CHECK_EQ(spsc_ring_count(&ring), 8);
+        for (uint32_t i = 0; i < 8; i++)
+        {
+            CHECK(spsc_ring_pop(&ring, &v));
+            CHECK_EQ(v, lap * 8 + i);
+        }
+        CHECK(!spsc_ring_pop(&ring, &v));
+    }
+}
+
+static void test_spsc_wrap(void)
+{
+    struct spsc_ring ring;
+    char buf[4], c;
+
+    /* Indices near 2^32 must still tell full from empty */
+    spsc_ring_init(&ring, buf, 4, 1);
+    ring.head = ring.cached_tail = ring.tail = ring.cached_head = 0xFFFFFFFEu;
+    for (int i = 0; i < 4; i++)
+    {
+        c = 'a' + i;
+        CHECK(spsc_ring_push(&ring, &c));
+    }
+    CHECK(!spsc_ring_push(&ring, &c));
+    for (int i = 0; i < 4; i++)
+    {
+        CHECK(spsc_ring_pop(&ring, &c));
+        CHECK_EQ(c, 'a' + i);
+    }
+    CHECK(spsc_ring_empty(&ring));
+}
+
+static void test_mpmc_basic(void)
+{
+    struct mpmc_ring ring;
+    uint64_t cells[MPMC_RING_BYTES(4, 12) / 8];
+    struct
+    {
+        uint32_t a, b, c;
+    } e;
+
+    CHECK_EQ(MPMC_RING_STRIDE(12), 24);
+    CHECK_EQ(mpmc_ring_init(&ring, cells, 3, 12), -1);
+    CHECK_EQ(mpmc_ring_init(&ring, cells, 4, 12), 0);
+    CHECK(!mpmc_ring_pop(&ring, &e));
+
+    for (uint32_t lap = 0; lap < 3; lap++)
+    {
+        for (uint32_t i = 0; i < 4; i++)
+        {
+            e.a = lap;
+            e.b = i;
+            e.c = lap ^ i;
+            CHECK(mpmc_ring_push(&ring, &e));
+        }
+        CHECK(!mpmc_ring_push(&ring, &e));
+        for (uint32_t i = 0; i < 4; i++)
+        {
+            CHECK(mpmc_ring_pop(&ring, &e));
+            CHECK(e.a == lap && e.b == i && e.c == (lap ^ i));
+        }
+        CHECK(!mpmc_ring_pop(&ring, &e));
+    }
+}
+
+/* --- Threaded --- */
+
+/* Full/empty spins yield, so the tests also finish on one host CPU */
+enum { STRESS_ITEMS = 1 << 20, MPMC_THREADS = 4, MPMC_ITEMS = 1 << 18 };
+
+static struct spsc_ring spsc;
+static uint64_t spsc_buf[256];
+
+static void *spsc_producer(void *arg)
+{
+    (void)arg;
+    for (uint64_t i = 1; i <= STRESS_ITEMS; i++)
+        while (!spsc_ring_push(&spsc, &i))
+            sched_yield();
+    return NULL;
+}
+
+static void test_spsc_threads(void)
+{
+    pthread_t producer;
+    uint64_t v, expect = 1;
+    int in_order = 1;
+
+    spsc_ring_init(&spsc, spsc_buf, 256, sizeof(uint64_t));
+    pthread_create(&producer, NULL, spsc_producer, NULL);
+    while (expect <= STRESS_ITEMS)
+    {
+        if (!spsc_ring_pop(&spsc, &v))
+        {
+            sched_yield();
+            continue;
+        }
+        in_order &= v == expect;
+        expect++;
+    }
+    pthread_join(producer, NULL);
+
+    CHECK(in_order);
+    CHECK(spsc_ring_empty(&spsc));
+}
+
+static struct mpmc_ring mpmc;
+static uint64_t mpmc_cells[MPMC_RING_BYTES(1024, 8) / 8];
+static uint64_t mpmc_popped_sum[MPMC_THREADS];
+static uint64_t mpmc_popped[MPMC_THREADS];
+static uint64_t mpmc_taken;
+
+static void *mpmc_producer(void *arg)
+{
+    uint64_t id = (uintptr_t)arg;
+
+    for (uint64_t i = 0; i < MPMC_ITEMS; i++)
+    {
+        uint64_t v = id * MPMC_ITEMS + i + 1;
+        while (!mpmc_ring_push(&mpmc, &v))
+            sched_yield();
+    }
+    return NULL;
+}
+
+static void *mpmc_consumer(void *arg)
+{
+    uint64_t id = (uintptr_t)arg;
+    uint64_t total = (uint64_t)MPMC_THREADS * MPMC_ITEMS;
+
+    /* Consumers share the work: stop once every item has been claimed */
+    while (__atomic_load_n(&mpmc_taken, __ATOMIC_RELAXED) < total)
+    {
+        uint64_t v;
+        if (!mpmc_ring_pop(&mpmc, &v))
+        {
+            sched_yield();
+            continue;
+        }
+        __atomic_fetch_add(&mpmc_taken, 1, __ATOMIC_RELAXED);
+        mpmc_popped_sum[id] += v;
+        mpmc_popped[id]++;
+    }
+    return NULL;
+}
+
+static void test_mpmc_threads(void)
+{
+    pthread_t producers[MPMC_THREADS], consumers[MPMC_THREADS];
+    uint64_t n = (uint64_t)MPMC_THREADS * MPMC_ITEMS;
+    uint64_t sum = 0, count = 0;
+
+    mpmc_ring_init(&mpmc, mpmc_cells, 1024, sizeof(uint64_t));
+    mpmc_taken = 0;
+    for (uintptr_t i = 0; i < MPMC_THREADS; i++)
+    {
+        pthread_create(&consumers[i], NULL, mpmc_consumer, (void *)i);
+        pthread_create(&producers[i], NULL, mpmc_producer, (void *)i);
+    }
+    for (int i = 0; i < MPMC_THREADS; i++)
+    {
+        pthread_join(producers[i], NULL);
+        pthread_join(consumers[i], NULL);
+        sum += mpmc_popped_sum[i];
+        count += mpmc_popped[i];
+        mpmc_popped_sum[i] = mpmc_popped[i] = 0;
+    }
+
+    /* Every value 1..n exactly once */
+    CHECK_EQ(count, n);
+    CHECK_EQ(sum, n * (n + 1) / 2);
+    uint64_t v;
+    CHECK(!mpmc_ring_pop(&mpmc, &v));
+}
+
+const struct test_case ring_tests[] = {
+    {"ring: spsc push and pop", test_spsc_basic},
+    {"ring: spsc index wrap", test_spsc_wrap},
+    {"ring: mpmc push and pop", test_mpmc_basic},
+    {"ring: spsc threaded FIFO order", test_spsc_threads},
+    {"ring: mpmc threaded, every item once", test_mpmc_threads},
+    {NULL, NULL},
+};
+
+static void bench_ring(void)
+{
+    enum { OPS = 1 << 22, BATCH = 64 };
+    static uint64_t cells[MPMC_RING_BYTES(BATCH, 8) / 8];
+    uint64_t buf[BATCH], v = 0;
+
+    /* Uncontended: cost of the protocol itself, in bursts of BATCH */
+    spsc_ring_init(&spsc, buf, BATCH, sizeof(uint64_t));
+    uint64_t t0 = host_now_ns();
+    for (int i = 0; i < OPS / BATCH; i++)
+    {
+        for (int j = 0; j < BATCH; j++)
+            spsc_ring_push(&spsc, &v);
+        for (int j = 0; j < BATCH; j++)
+            spsc_ring_pop(&spsc, &v);
+    }
+    uint64_t spsc_ns = host_now_ns() - t0;
+
+    mpmc_ring_init(&mpmc, cells, BATCH, sizeof(uint64_t));
+    t0 = host_now_ns();
+    for (int i = 0; i < OPS / BATCH; i++)
+    {
+        for (int j = 0; j < BATCH; j++)
+            mpmc_ring_push(&mpmc, &v);
+        for (int j = 0; j < BATCH; j++)
+            mpmc_ring_pop(&mpmc, &v);
+    }
+    uint64_t mpmc_ns = host_now_ns() - t0;
+
+    /* Two threads: the cross-core handoff the cached indices are for */
+    spsc_ring_init(&spsc, spsc_buf, 256, sizeof(uint64_t));
+    pthread_t producer;
+    t0 = host_now_ns();
+    pthread_create(&producer, NULL, spsc_producer, NULL);
+    for (uint64_t got = 0; got < STRESS_ITEMS;)
+    {
+        if (spsc_ring_pop(&spsc, &v))
+            got++;
+        else
+            sched_yield();
+    }
+    pthread_join(producer, NULL);
+    uint64_t xfer_ns = host_now_ns() - t0;
+
+    BENCH_REPORT("spsc_ring", "ops=%d ns_per_push_pop=%.2f", OPS, (double)spsc_ns / OPS);
+    BENCH_REPORT("mpmc_ring", "ops=%d ns_per_push_pop=%.2f", OPS, (double)mpmc_ns / OPS);
+    BENCH_REPORT("spsc_ring_2threads", "items=%d ns_per_item=%.2f", STRESS_ITEMS,
+                 (double)xfer_ns / STRESS_ITEMS);
+}
+
+const struct bench_case ring_benches[] = {
+    {"ring", bench_ring},
+    {NULL, NULL},
+};
@@ -0,0 +1,165 @@
+/**
+ * @file test_string.c
+ * @brief Correctness tests, fuzzer and benchmarks for lib/string.c.
+ *
+ * libc serves as the reference implementation.
+ */
+
+#include "harness.h"
+
+static void test_memset(void)
+{
+    uint8_t buf[64];
+    memset(buf, 0x11, sizeof(buf));
+
+    CHECK(valen_memset(buf + 3, 0xAB, 40) == buf + 3);
+    for (int i = 0; i < 64; i++)
+        CHECK_EQ(buf[i], (i >= 3 && i < 43) ? 0xAB : 0x11);
+
+    valen_memset(buf, 0x1FF, 1);
+    CHECK_EQ(buf[0], 0xFF);
+}
+
+static void test_memcpy(void)
+{
+    uint8_t src[100], dst[100];
+    for (int i = 0; i < 100; i++)
+        src[i] = (uint8_t)(i * 7);
+    memset(dst, 0, sizeof(dst));
+
+    CHECK(valen_memcpy(dst + 1, src, 98) == dst + 1);
+    CHECK(memcmp(dst + 1, src, 98) == 0);
+    CHECK_EQ(dst[0], 0);
+    CHECK_EQ(dst[99], 0);
+}
+
+static void test_str_basic(void)
+{
+    const char *cmd = "kill 12";
+    char buf[32];
+
+    CHECK_EQ(valen_strlen(""), 0);
+    CHECK_EQ(valen_strlen("valen"), 5);
+    CHECK(valen_strcmp("abc", "abc") == 0);
+    CHECK(valen_strcmp("abc", "abd") < 0);
+    CHECK(valen_strcmp("b", "abc") > 0);
+    CHECK(valen_strcmp("\xff", "a") > 0);
+    CHECK(valen_strncmp("help", "helper", 4) == 0);
+    CHECK(valen_strncmp("help", "helper", 5) != 0);
+    CHECK(valen_strncmp("a", "b", 0) == 0);
+    CHECK(valen_strchr(cmd, ' ') == cmd + 4);
+    CHECK(valen_strchr("mem", 'x') == NULL);
+
+    CHECK(valen_strcpy(buf, "tasks") == buf);
+    CHECK(strcmp(buf, "tasks") == 0);
+
+    memset(buf, 'z', sizeof(buf));
+    valen_strncpy(buf, "ab", 6);
+    CHECK(memcmp(buf, "ab\0\0\0\0z", 7) == 0);
+
+    memset(buf, 'z', sizeof(buf));
+    valen_strncpy(buf, "abcdef", 3);
+    CHECK(memcmp(buf, "abcz", 4) == 0);
+}
+
+static int sign(int v)
+{
+    return (v > 0) - (v < 0);
+}
+
+/**
+ * @brief Random lengths and misalignments compared against libc.
+ */
+static void test_fuzz(void)
+{
+    static uint8_t a[4096 + 64], b[4096 + 64], ref[4096 + 64];
+
+    for (int iter = 0; iter < 20000; iter++)
+    {
+        uint64_t len = host_rand() % 4096;
+        uint64_t so = host_rand() % 32, doff = host_rand() % 32;
+
+        for (size_t i = 0; i < sizeof(a); i++)
+            a[i] = (uint8_t)host_rand();
+        memcpy(b, a, sizeof(b));
+        memcpy(ref, a, sizeof(ref));
+
+        if (iter & 1)
+        {
+            int v = (int)host_rand();
+            valen_memset(b + doff, v, len);
+            memset(ref + doff, v, len);
+        }
+        else
+        {
+            valen_memcpy(b + doff, a + 2048 + so % 16, len > 2048 ? 2048 : len);
+            memcpy(ref + doff, a + 2048 + so % 16, len > 2048 ? 2048 : len);
+        }
+        CHECK(memcmp(b, ref, sizeof(b)) == 0);
+
+        /* Strings: random printable text, sometimes sharing a prefix */
+        char s1[64], s2[64];
+        int l1 = host_rand() % 63, l2 = host_rand() % 63;
+        for (int i = 0; i < l1; i++)
+            s1[i] = 'a' + host_rand() % 3;
+        s1[l1] = '\0';
+        for (int i = 0; i < l2; i++)
+            s2[i] = i < l1 && host_rand() % 4 ? s1[i] : 'a' + host_rand() % 3;
+        s2[l2] = '\0';
+
+        uint64_t n = host_rand() % 70;
+        CHECK_EQ(valen_strlen(s1), (int)strlen(s1));
+        CHECK_EQ(sign(valen_strcmp(s1, s2)), sign(strcmp(s1, s2)));
+        CHECK_EQ(sign(valen_strncmp(s1, s2, n)), sign(strncmp(s1, s2, n)));
+        CHECK(valen_strchr(s1, 'c') == strchr(s1, 'c') || (!strchr(s1, 'c') && !valen_strchr(s1, 'c')));
+    }
+}
+
+const struct test_case string_tests[] = {
+    {"string: memset", test_memset},
+    {"string: memcpy", test_memcpy},
+    {"string: str* basics", test_str_basic},
+    {"string: fuzz against libc", test_fuzz},
+    {NULL, NULL},
+};
+
+/* --- Benchmarks --- */
+
+static void bench_memcpy(void)
+{
+    static const uint64_t sizes[] = {64, 512, 4096, 65536, 1 << 20};
+    uint8_t *src = aligned_alloc(64, (1 << 20) + 64);
+    uint8_t *dst = aligned_alloc(64, (1 << 20) + 64);
+    memset(src, 0x5A, (1 << 20) + 64);
+
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++)
+    {
+        uint64_t total = 256ULL << 20;
+        uint64_t iters = total / sizes[s];
+
+        uint64_t t0 = host_now_ns();
+        for (uint64_t i = 0; i < iters; i++)
+            valen_memcpy(dst, src, sizes[s]);
+        uint64_t ns = host_now_ns() - t0;
+
+        char name[32];
+        snprintf(name, sizeof(name), "memcpy_%lu", (unsigned long)sizes[s]);
+        BENCH_REPORT(name, "bytes=%lu gbps=%.3f", (unsigned long)total, (double)total / (double)ns);
+
+        t0 = host_now_ns();
+        for (uint64_t i = 0; i < iters; i++)
+            valen_memset(dst, (int)i, sizes[s]);
+        ns = host_now_ns() - t0;
+
+        snprintf(name, sizeof(name), "memset_%lu", (unsigned long)sizes[s]);
+        BENCH_REPORT(name, "bytes=%lu gbps=%.3f", (unsigned long)total, (double)total / (double)ns);
+    }
+
+    free(src);
+    free(dst);
+}
+
+const struct bench_case string_benches[] = {
+    {"memcpy", bench_memcpy},
+    {NULL, NULL},
+};